@@ -15,7 +15,9 @@ from .nbi     import NBI
 from a5py.ascot5io.state      import State
 from a5py.ascot5io.orbits     import Orbits
 from a5py.ascot5io.transcoef  import Transcoef
+from a5py.ascot5io.wallload   import WallLoad
 from .dist import Dist_5D, Dist_6D, Dist_rho5D, Dist_rho6D, Dist_COM
+from .dist import Dist_moments
 from .dist import Dist
 
 from .coreio.fileapi import INPUTGROUPS
@@ -46,7 +48,9 @@ HDF5TOOBJ = {
     "distrho5d" : Dist_rho5D,
     "distrho6d" : Dist_rho6D,
     "distcom" : Dist_COM,
-    "transcoef": Transcoef
+    "distmoments" : Dist_moments,
+    "transcoef": Transcoef,
+    "wallload" : WallLoad
 }
 """Dictionary connecting group names in HDF5 file to corresponding data objects.
 """
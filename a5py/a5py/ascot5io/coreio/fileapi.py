@@ -61,7 +61,7 @@ INPUTGROUPS = ["options", "bfield", "efield", "marker", "plasma", "neutral",
 """
 
 OUTPUTGROUPS = ["inistate", "endstate", "dist5d", "distrho5d", "dist6d",
-                "distrho6d", "orbit", "transcoef"]
+                "distrho6d", "distmoments", "orbit", "transcoef", "wallload"]
 """Names of the output data containers in runs.
 """
 
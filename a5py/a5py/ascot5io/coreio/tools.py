@@ -229,24 +229,40 @@ def combineoutput(fnt, addfns=None, contfns=None):
         with target.dist5d as tdata, \
              source.dist5d as sdata:
             tdata["ordinate"][:] += sdata["ordinate"][:]
+            if "ordinate2" in tdata and "ordinate2" in sdata:
+                tdata["ordinate2"][:] += sdata["ordinate2"][:]
 
     if hasattr(target, "dist6d") and \
        hasattr(source, "dist6d"):
         with target.dist6d as tdata, \
              source.dist6d as sdata:
             tdata["ordinate"][:] += sdata["ordinate"][:]
+            if "ordinate2" in tdata and "ordinate2" in sdata:
+                tdata["ordinate2"][:] += sdata["ordinate2"][:]
 
     if hasattr(target, "distrho5d") and \
        hasattr(source, "distrho5d"):
         with target.distrho5d as tdata, \
              source.distrho5d as sdata:
             tdata["ordinate"][:] += sdata["ordinate"][:]
+            if "ordinate2" in tdata and "ordinate2" in sdata:
+                tdata["ordinate2"][:] += sdata["ordinate2"][:]
 
     if hasattr(target, "distrho6d") and \
        hasattr(source, "distrho6d"):
         with target.distrho6d as tdata, \
              source.distrho6d as sdata:
             tdata["ordinate"][:] += sdata["ordinate"][:]
+            if "ordinate2" in tdata and "ordinate2" in sdata:
+                tdata["ordinate2"][:] += sdata["ordinate2"][:]
+
+    if hasattr(target, "distmoments") and \
+       hasattr(source, "distmoments"):
+        with target.distmoments as tdata, \
+             source.distmoments as sdata:
+            tdata["ordinate"][:] += sdata["ordinate"][:]
+            if "ordinate2" in tdata and "ordinate2" in sdata:
+                tdata["ordinate2"][:] += sdata["ordinate2"][:]
 
     # Combine orbits
     if hasattr(target, "orbit") and hasattr(source, "orbit"):
@@ -267,3 +283,10 @@ def combineoutput(fnt, addfns=None, contfns=None):
 
                 tdata[field].resize((tsize+ssize, ))
                 tdata[field][tsize:] = sdata[field][:]
+
+    # Combine wall loads
+    if hasattr(target, "wallload") and hasattr(source, "wallload"):
+        with target.wallload as tdata, source.wallload as sdata:
+            for field in ["flux", "power", "angle", "flux2", "power2"]:
+                if field in tdata and field in sdata:
+                    tdata[field][:] += sdata[field][:]
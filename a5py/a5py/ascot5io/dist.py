@@ -442,6 +442,26 @@ class Dist(DataContainer):
 
         return DistData(histogram, **abscissa_edges)
 
+    def relerr(self):
+        """Return the relative statistical error of each bin.
+
+        The error is available only if the second moments were collected
+        (ENABLE_VARIANCE). Empty bins have infinite error.
+
+        Returns
+        -------
+        relerr : array_like
+            Relative error, sqrt(sum w^2) / |sum w|, of each bin.
+        """
+        with self as f:
+            if "ordinate2" not in f:
+                raise ValueError(
+                    "Second moments were not collected for this distribution")
+            hist  = np.sum(f["ordinate"][:], axis=0)
+            hist2 = np.sum(f["ordinate2"][:], axis=0)
+        with np.errstate(divide="ignore", invalid="ignore"):
+            return np.where(hist != 0, np.sqrt(hist2) / np.abs(hist), np.inf)
+
     @staticmethod
     def density(dist, moment):
         """Calculate number density.
@@ -1066,3 +1086,62 @@ class Dist_COM(Dist):
                 * unyt.dimensionless
 
         return out
+
+class Dist_moments(DataContainer):
+    """Moment profiles accumulated during the simulation.
+    """
+
+    def get(self):
+        """Return the moments and the abscissa edges.
+
+        The moments are not divided by the bin volume.
+
+        Returns
+        -------
+        moments : dict [str, array_like]
+            Name and value of each moment in each (rho, theta, time) bin.
+        abscissa_edges : dict [str, array_like]
+            Name and edges of each abscissa.
+        """
+        moments = {}
+        abscissa_edges = {}
+        with self as f:
+            for i in range(int(f["abscissa_ndim"][:])):
+                abscissa = f["abscissa_vec_0"+str(i+1)]
+                name     = abscissa.attrs["name_0"+str(i)].decode("utf-8")
+                unit     = abscissa.attrs["unit_0"+str(i)].decode("utf-8")
+                abscissa_edges[name] = abscissa[:] * unyt.Unit(unit)
+
+            ordinate = f["ordinate"]
+            for i in range(int(f["ordinate_ndim"][:])):
+                name = ordinate.attrs["name_%02d" % i].decode("utf-8")
+                unit = ordinate.attrs["unit_%02d" % i].decode("utf-8")
+                moments[name] = ordinate[i,:,:,:] * unyt.Unit(unit)
+
+        return moments, abscissa_edges
+
+    def relerr(self):
+        """Return the relative statistical error of each moment and bin.
+
+        The error is available only if the second moments were collected
+        (ENABLE_VARIANCE). Empty bins have infinite error.
+
+        Returns
+        -------
+        relerr : dict [str, array_like]
+            Name and relative error of each moment in each bin.
+        """
+        out = {}
+        with self as f:
+            if "ordinate2" not in f:
+                raise ValueError(
+                    "Second moments were not collected for the moments")
+            ordinate = f["ordinate"]
+            for i in range(int(f["ordinate_ndim"][:])):
+                name  = ordinate.attrs["name_%02d" % i].decode("utf-8")
+                hist  = ordinate[i,:,:,:]
+                hist2 = f["ordinate2"][i,:,:,:]
+                with np.errstate(divide="ignore", invalid="ignore"):
+                    out[name] = np.where(
+                        hist != 0, np.sqrt(hist2) / np.abs(hist), np.inf)
+        return out
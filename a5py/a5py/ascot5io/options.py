@@ -42,10 +42,13 @@ class Opt(DataGroup):
         self._OPT_FIXEDSTEP_USE_USERDEFINED  = 0
         self._OPT_FIXEDSTEP_USERDEFINED      = 1.0e-8
         self._OPT_FIXEDSTEP_GYRODEFINED      = 20
+        self._OPT_FIXEDSTEP_CONSERVE_INVARIANTS = 0
         self._OPT_ADAPTIVE_TOL_ORBIT         = 1.0e-8
         self._OPT_ADAPTIVE_TOL_CCOL          = 1.0e-1
         self._OPT_ADAPTIVE_MAX_DRHO          = 0.1
         self._OPT_ADAPTIVE_MAX_DPHI          = 2.0
+        self._OPT_ADAPTIVE_ORBIT_METHOD      = 0
+        self._OPT_ENABLE_SIMD_GROUPING       = 0
         self._OPT_ENDCOND_SIMTIMELIM         = 0
         self._OPT_ENDCOND_CPUTIMELIM         = 0
         self._OPT_ENDCOND_RHOLIM             = 0
@@ -71,6 +74,14 @@ class Opt(DataGroup):
         self._OPT_DISABLE_ENERGY_CCOLL       = 0
         self._OPT_DISABLE_PITCH_CCOLL        = 0
         self._OPT_DISABLE_GCDIFF_CCOLL       = 0
+        self._OPT_ENABLE_TABULATED_CCOLL     = 0
+        self._OPT_ENABLE_CCOLL_CACHE         = 0
+        self._OPT_CCOLL_CACHE_DRHO           = 1.0e-3
+        self._OPT_CCOLL_CACHE_DEKIN          = 1.0e-3
+        self._OPT_CCOLL_CACHE_DT             = 1.0e-3
+        self._OPT_ENABLE_CCOLL_SUBCYCLE      = 0
+        self._OPT_ENABLE_ORBITAVG_CCOLL      = 0
+        self._OPT_ORBITAVG_CCOLL_MAXCHANGE   = 1.0e-2
         self._OPT_REVERSE_TIME               = 0
         self._OPT_ENABLE_DIST_5D             = 0
         self._OPT_ENABLE_DIST_6D             = 0
@@ -122,6 +133,10 @@ class Opt(DataGroup):
         self._OPT_DIST_MIN_PTOR              = -1.0e-18
         self._OPT_DIST_MAX_PTOR              = 1.0e-18
         self._OPT_DIST_NBIN_PTOR             = 200
+        self._OPT_ENABLE_DIST_MOMENTS        = 0
+        self._OPT_DIST_ACCUMULATION          = 1
+        self._OPT_DIST_PRIVATE_MAXMEM        = 1024
+        self._OPT_DIST_SPARSE                = 0
         self._OPT_ENABLE_ORBITWRITE          = 0
         self._OPT_ORBITWRITE_MODE            = 1
         self._OPT_ORBITWRITE_NPOINT          = 100
@@ -129,10 +144,18 @@ class Opt(DataGroup):
         self._OPT_ORBITWRITE_TOROIDALANGLES  = [0.0]
         self._OPT_ORBITWRITE_RADIALDISTANCES = [1.0]
         self._OPT_ORBITWRITE_INTERVAL        = 0.0
+        self._OPT_ORBITWRITE_STREAM          = 0
+        self._OPT_ORBITWRITE_COMPACT         = 0
         self._OPT_ENABLE_TRANSCOEF           = 0
         self._OPT_TRANSCOEF_INTERVAL         = 0
         self._OPT_TRANSCOEF_NAVG             = 5
         self._OPT_TRANSCOEF_RECORDRHO        = 0
+        self._OPT_ENABLE_WALLLOAD            = 0
+        self._OPT_WALLLOAD_NANGLE            = 18
+        self._OPT_ENABLE_VARIANCE            = 0
+        self._OPT_CONVERGENCE_TARGET         = 0
+        self._OPT_CONVERGENCE_RELERR         = 0.05
+        self._OPT_CONVERGENCE_BATCH          = 1000
 
     @property
     def _SIM_MODE(self):
@@ -147,14 +170,18 @@ class Opt(DataGroup):
 
     @property
     def _ENABLE_ADAPTIVE(self):
-        """Use adaptive time-step (0, 1)
+        """Use adaptive time-step (0, 1, 2)
 
-        This option is used only if SIM_MODE = 2 or 3. Gyro-orbit
-        simulations are always done with fixed time-step and magnetic field line
-        simulations with adaptive time-step.
+        Magnetic field line simulations are always done with adaptive
+        time-step.
 
         - 0 Use fixed time-step
-        - 1 Use adaptive time-step
+        - 1 Use adaptive time-step for guiding centers (SIM_MODE = 2 or 3)
+          while gyro-orbits use fixed time-step
+        - 2 Use adaptive time-step for guiding centers and gyro-orbits. For
+          gyro-orbits ADAPTIVE_TOL_ORBIT is the tolerance for the error in
+          gyrophase [rad] per time-step, so values around 1e-3 are typical.
+          The initial time-step is taken from the fixed time-step options.
         """
         return self._OPT_ENABLE_ADAPTIVE
 
@@ -190,6 +217,19 @@ class Opt(DataGroup):
         """
         return self._OPT_FIXEDSTEP_GYRODEFINED
 
+    @property
+    def _FIXEDSTEP_CONSERVE_INVARIANTS(self):
+        """Project each guiding center orbit step back onto the constants of
+        motion
+
+        Energy and, in axisymmetric fields, the canonical toroidal momentum are
+        restored exactly after each RK4 step so that the invariant errors stay
+        bounded in long collisionless runs even with FIXEDSTEP_GYRODEFINED
+        well below 20. Only used in guiding center simulations with fixed
+        time-step, and ignored with MHD or a nonzero electric field.
+        """
+        return self._OPT_FIXEDSTEP_CONSERVE_INVARIANTS
+
     @property
     def _ADAPTIVE_TOL_ORBIT(self):
         """Relative error tolerance for orbit following in adaptive scheme
@@ -214,6 +254,35 @@ class Opt(DataGroup):
         """
         return self._OPT_ADAPTIVE_MAX_DPHI
 
+    @property
+    def _ADAPTIVE_ORBIT_METHOD(self):
+        """Integrator used for orbit-following in adaptive scheme
+
+        - 0 Cash-Karp
+        - 1 Dormand-Prince, which usually takes fewer steps for the same
+          tolerance since its last stage is reused as the first stage of the
+          next step. MHD simulations always use Cash-Karp.
+        """
+        return self._OPT_ADAPTIVE_ORBIT_METHOD
+
+    @property
+    def _ENABLE_SIMD_GROUPING(self):
+        """Order markers so that markers simulated together need similar time
+        steps
+
+        Markers are simulated in groups whose size is the SIMD vector width,
+        and with adaptive time step a group keeps going until its slowest
+        marker has finished. When enabled, markers are sorted before the
+        simulation by whether they are trapped, by speed and by rho so that
+        each group is roughly homogeneous. Results do not change since random
+        numbers are tied to marker IDs, except when ASCOT5 is compiled with
+        the MKL or GSL random number generators.
+
+        - 0 Markers are simulated in input order
+        - 1 Markers are grouped by step size class
+        """
+        return self._OPT_ENABLE_SIMD_GROUPING
+
     @property
     def _ENDCOND_SIMTIMELIM(self):
         """Terminate when marker time passes ENDCOND_LIM_SIMTIME or when marker
@@ -395,6 +464,99 @@ class Opt(DataGroup):
         """
         return self._OPT_DISABLE_GCDIFF_CCOLL
 
+    @property
+    def _ENABLE_TABULATED_CCOLL(self):
+        """Use tabulated special functions in Coulomb collision coefficients
+
+        - 0 Special functions (erf and exp) are evaluated directly
+        - N > 0 Special functions are interpolated from a table with N
+          intervals (at most 512), the error being about 1e-6 for N = 100
+          and 1e-9 for N = 500
+        """
+        return self._OPT_ENABLE_TABULATED_CCOLL
+
+    @property
+    def _ENABLE_CCOLL_CACHE(self):
+        """Reuse plasma density, temperature and Coulomb logarithm between
+        collision steps
+
+        - 0 Background quantities are evaluated at every step
+        - 1 Background quantities are re-evaluated only when rho, energy or
+          time has changed more than the thresholds since the last evaluation
+        - 2 Validation mode: quantities are evaluated at every step, and the
+          largest relative deviation of the values the cache would have given
+          is printed at the end
+        """
+        return self._OPT_ENABLE_CCOLL_CACHE
+
+    @property
+    def _CCOLL_CACHE_DRHO(self):
+        """Change in rho after which cached collision background is refreshed
+        """
+        return self._OPT_CCOLL_CACHE_DRHO
+
+    @property
+    def _CCOLL_CACHE_DEKIN(self):
+        """Relative change in energy after which cached collision background is
+        refreshed
+        """
+        return self._OPT_CCOLL_CACHE_DEKIN
+
+    @property
+    def _CCOLL_CACHE_DT(self):
+        """Change in time [s] after which cached collision background is
+        refreshed
+        """
+        return self._OPT_CCOLL_CACHE_DT
+
+    @property
+    def _ENABLE_CCOLL_SUBCYCLE(self):
+        """Sub-cycle orbit-following within collision steps
+
+        Only used with guiding centers and adaptive time step. Normally the
+        collision operator is applied at every orbit step, and the step is
+        the shorter of the two suggestions. With sub-cycling, orbit-following
+        takes its own steps until the accumulated time reaches the collision
+        step, and collisions are then applied over the whole interval. This is
+        faster when the collision step is much longer than the orbit step,
+        i.e. when the plasma is not very collisional.
+
+        Since the collision coefficients are evaluated at a single point of
+        the orbit, the collision step is limited to the given number of orbit
+        steps. Values around 100 are a good compromise.
+
+        - 0 Collisions are applied at every orbit step
+        - N > 0 Collision step is at most N orbit steps long
+        """
+        return self._OPT_ENABLE_CCOLL_SUBCYCLE
+
+    @property
+    def _ENABLE_ORBITAVG_CCOLL(self):
+        """Apply orbit-averaged collisions once per poloidal transit
+
+        Only used with guiding centers and adaptive time step when collisions
+        are enabled. Collision coefficients are averaged over each transit and
+        applied as a single jump in energy and pitch, and the orbit time is
+        stretched so that one transit represents many when the collision time
+        is long. This gives the slowing-down distribution at a fraction of the
+        cost when collisions are weak, but collisional transport in space is
+        not included.
+
+        - 0 Collisions are applied at every time step
+        - 1 Collisions are orbit-averaged
+        """
+        return self._OPT_ENABLE_ORBITAVG_CCOLL
+
+    @property
+    def _ORBITAVG_CCOLL_MAXCHANGE(self):
+        """Maximum relative change of speed or pitch allowed in a single
+        orbit-averaged collision jump
+
+        Sets how many transits a single followed transit may represent. Smaller
+        values follow the orbit more often.
+        """
+        return self._OPT_ORBITAVG_CCOLL_MAXCHANGE
+
     @property
     def _REVERSE_TIME(self):
          """Trace markers backwards in time.
@@ -756,6 +918,54 @@ class Opt(DataGroup):
         """
         return self._OPT_DIST_NBIN_PTOR
 
+    @property
+    def _ENABLE_DIST_MOMENTS(self):
+        """Collect profiles of distribution moments in [rho, pol, t]
+
+        The moments are density, charge density, energy density, pressure,
+        parallel and toroidal current density, and power deposition. They are
+        accumulated during the simulation, so the profiles are obtained
+        without recording the 5D distribution. The abscissae are the same as
+        for the rho distributions.
+        """
+        return self._OPT_ENABLE_DIST_MOMENTS
+
+    @property
+    def _DIST_ACCUMULATION(self):
+        """How threads accumulate distribution updates
+
+        - 0 All threads update shared histograms atomically
+        - 1 Use thread-private copies of the histograms if they fit within
+          DIST_PRIVATE_MAXMEM and buffered updates otherwise
+        - 2 Each thread buffers its updates and adds them to the shared
+          histograms in blocks
+        - 3 Each thread updates a private copy of the histograms and the
+          copies are summed at the end
+        """
+        return self._OPT_DIST_ACCUMULATION
+
+    @property
+    def _DIST_PRIVATE_MAXMEM(self):
+        """Memory allowed for thread-private histogram copies [MB]
+
+        Used when DIST_ACCUMULATION = 1. The memory needed is the number of
+        threads times the size of all collected distributions.
+        """
+        return self._OPT_DIST_PRIVATE_MAXMEM
+
+    @property
+    def _DIST_SPARSE(self):
+        """Store 6D distributions sparsely
+
+        - 0 The 6D distributions are allocated in full
+        - 1 The 6D distributions are stored as tiles that are allocated only
+          when a marker first enters them, which allows higher resolutions
+
+        Only the tiles that were entered are written to the output file, but
+        the distribution still reads as a full array.
+        """
+        return self._OPT_DIST_SPARSE
+
     @property
     def _ENABLE_ORBITWRITE(self):
         """Enable diagnostics that store marker orbit
@@ -819,6 +1029,35 @@ class Opt(DataGroup):
         """
         return self._OPT_ORBITWRITE_INTERVAL
 
+    @property
+    def _ORBITWRITE_STREAM(self):
+        """Write orbits to the output file during the simulation
+
+        - 0 The last ORBITWRITE_NPOINT points of each marker are kept in memory
+          and written when the simulation is complete
+        - 1 All points are written while the markers are simulated, so the
+          memory used does not depend on the number of markers
+
+        ORBITWRITE_NPOINT is not used when orbits are streamed.
+        """
+        return self._OPT_ORBITWRITE_STREAM
+
+    @property
+    def _ORBITWRITE_COMPACT(self):
+        """How compactly orbits are written
+
+        - 0 Quantities are written in double precision and without compression
+        - 1 Integer quantities are written as 32 bit integers and the data is
+          compressed without loss of precision
+        - 2 As 1, but quantities other than the mileage and the cumulative
+          angles are written in single precision
+
+        When written compactly, the points are grouped by marker and ordered
+        by marker ID, unless the orbits are streamed. They are read back in
+        double precision regardless of how they were written.
+        """
+        return self._OPT_ORBITWRITE_COMPACT
+
     @property
     def _ENABLE_TRANSCOEF(self):
         """Enable evaluation of transport coefficients.
@@ -851,6 +1090,66 @@ class Opt(DataGroup):
         """
         return self._OPT_TRANSCOEF_RECORDRHO
 
+    @property
+    def _ENABLE_WALLLOAD(self):
+        """Collect wall loads during the simulation.
+
+        - 0 Wall loads are evaluated afterwards from the marker endstates
+        - 1 Particle flux, power and incidence angle are accumulated for each
+          wall element as markers hit the wall
+        """
+        return self._OPT_ENABLE_WALLLOAD
+
+    @property
+    def _WALLLOAD_NANGLE(self):
+        """Number of incidence angle bins between 0 and 90 degrees
+        """
+        return self._OPT_WALLLOAD_NANGLE
+
+    @property
+    def _ENABLE_VARIANCE(self):
+        """Collect second moments of the distributions and wall loads.
+
+        - 0 Only the distributions and wall loads are collected
+        - 1 The sum of squared contributions of each marker is collected for
+          each bin and wall element, from which their relative statistical
+          error can be evaluated. Not collected for sparse distributions.
+        """
+        return self._OPT_ENABLE_VARIANCE
+
+    @property
+    def _CONVERGENCE_TARGET(self):
+        """End the simulation once this quantity has converged (0, 1, 2, 3)
+
+        Markers are simulated in batches, in random order, until the relative
+        error of the target is below CONVERGENCE_RELERR. The results and
+        the weights of the simulated markers are then scaled to represent all
+        markers, and the markers that were not simulated get zero weight and
+        no end condition.
+        Implies ENABLE_VARIANCE.
+
+        - 0 All markers are simulated
+        - 1 Distributions, by the bin-content-weighted average relative error
+          of the worst converged distribution or moment
+        - 2 Total power deposited on the wall
+        - 3 Power deposited on the wall element receiving the most power
+        """
+        return self._OPT_CONVERGENCE_TARGET
+
+    @property
+    def _CONVERGENCE_RELERR(self):
+        """Relative error of the target at which the simulation ends
+        """
+        return self._OPT_CONVERGENCE_RELERR
+
+    @property
+    def _CONVERGENCE_BATCH(self):
+        """Number of markers simulated between evaluations of the error
+
+        Each MPI process simulates its own batches.
+        """
+        return self._OPT_CONVERGENCE_BATCH
+
     def read(self):
         """Read data from HDF5 file.
 
@@ -971,6 +1270,10 @@ class Opt(DataGroup):
                     out.extend(makebanner("ORBIT WRITE"))
                 elif name == "ENABLE_TRANSCOEF":
                     out.extend(makebanner("TRANSPORT COEFFICIENT"))
+                elif name == "ENABLE_WALLLOAD":
+                    out.extend(makebanner("WALL LOADS"))
+                elif name == "ENABLE_VARIANCE":
+                    out.extend(makebanner("STATISTICAL ERROR"))
 
                 # Clean docstrings a little bit by removing extra whispace and
                 # empty lines.
@@ -20,11 +20,14 @@ class Orbits(DataContainer):
 
     def read(self):
         """Read raw state data to a dictionary.
+
+        Quantities written in single precision are returned in double
+        precision.
         """
         out = {}
         with self as f:
             for key in f:
-                out[key] = f[key][:]
+                out[key] = Orbits._todouble(f[key][:])
 
         return out
 
@@ -59,7 +62,7 @@ class Orbits(DataContainer):
             """
             with self as h5:
                 if q in h5:
-                    return fileapi.read_data(h5, q)
+                    return Orbits._todouble(fileapi.read_data(h5, q))
             return None
 
         # Sort using the fact that inistate.get return values ordered by ID
@@ -82,6 +85,25 @@ class Orbits(DataContainer):
 
         return Orbits._getactual(mass, time, connlen, mode, _val, _eval, *qnt)
 
+    @staticmethod
+    def _todouble(data):
+        """Convert data that was written compactly in single precision.
+
+        Parameters
+        ----------
+        data : array_like
+            Data read from the file.
+
+        Returns
+        -------
+        data : array_like
+            The data in double precision if it was stored as floats, otherwise
+            unchanged.
+        """
+        if data.dtype == np.float32:
+            return data.astype(np.float64)
+        return data
+
     @staticmethod
     def _getactual(mass, time, totmil, mode, _val, _eval, *qnt):
         """Calculate orbit quantities using the helper functions and data.
@@ -182,6 +182,9 @@ class wall_3D(DataGroup):
         out = {}
         with h5py.File(fn,"r") as f:
             for key in f[path]:
+                # Octree stored by ascot5_main is not part of the input
+                if key == "tree_array":
+                    continue
                 out[key] = f[path][key][:]
                 if key == "nelements":
                     out[key] = int(out[key])
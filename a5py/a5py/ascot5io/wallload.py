@@ -0,0 +1,73 @@
+"""Wall load data IO module.
+"""
+import numpy as np
+import unyt
+
+from .coreio.treedata import DataContainer
+
+
+class WallLoad(DataContainer):
+    """Wall loads accumulated for each wall element during the simulation.
+    """
+
+    def read(self):
+        """Read raw wall load data to a dictionary.
+        """
+        out = {}
+        with self as f:
+            for key in f:
+                out[key] = f[key][:]
+
+        return out
+
+    def get(self):
+        """Return wall loads with units.
+
+        Returns
+        -------
+        flux : array_like, (nelement,)
+            Particle flux deposited on each wall element.
+        power : array_like, (nelement,)
+            Power deposited on each wall element.
+        angle : array_like, (nelement, nangle)
+            Particle flux on each wall element histogrammed in the angle of
+            incidence.
+        edges : array_like, (nangle+1,)
+            Edges of the incidence angle bins.
+        """
+        out = []
+        with self as f:
+            for key in ["flux", "power", "angle", "angle_edges"]:
+                unit = f[key].attrs["unit"]
+                if isinstance(unit, bytes): unit = unit.decode("utf-8")
+                out.append(f[key][:] * unyt.Unit(unit))
+
+        return tuple(out)
+
+    def relerr(self):
+        """Return the relative statistical error of the wall loads.
+
+        The error is available only if the second moments were collected
+        (ENABLE_VARIANCE). Elements that were not hit have infinite error.
+
+        Returns
+        -------
+        flux : array_like, (nelement,)
+            Relative error of the particle flux on each wall element.
+        power : array_like, (nelement,)
+            Relative error of the power on each wall element.
+        total : float
+            Relative error of the total power deposited on the wall.
+        """
+        with self as f:
+            if "power2" not in f:
+                raise ValueError("Second moments were not collected")
+            flux, flux2   = f["flux"][:], f["flux2"][:]
+            power, power2 = f["power"][:], f["power2"][:]
+        with np.errstate(divide="ignore", invalid="ignore"):
+            eflux  = np.where(flux > 0, np.sqrt(flux2) / flux, np.inf)
+            epower = np.where(power > 0, np.sqrt(power2) / power, np.inf)
+        total = np.inf
+        if np.sum(power) > 0:
+            total = np.sqrt(np.sum(power2)) / np.sum(power)
+        return eflux, epower, total
@@ -881,13 +881,21 @@ struct_c__SA_wall_2d_offload_data._pack_ = 1 # source:False
 struct_c__SA_wall_2d_offload_data._fields_ = [
     ('n', ctypes.c_int32),
     ('offload_array_length', ctypes.c_int32),
+    ('int_offload_array_length', ctypes.c_int32),
+    ('nr', ctypes.c_int32),
+    ('nz', ctypes.c_int32),
+    ('PADDING_0', ctypes.c_ubyte * 4),
+    ('rmin', ctypes.c_double),
+    ('rmax', ctypes.c_double),
+    ('zmin', ctypes.c_double),
+    ('zmax', ctypes.c_double),
 ]
 
 struct_c__SA_wall_offload_data._pack_ = 1 # source:False
 struct_c__SA_wall_offload_data._fields_ = [
     ('type', wall_type),
-    ('w2d', struct_c__SA_wall_2d_offload_data),
     ('PADDING_0', ctypes.c_ubyte * 4),
+    ('w2d', struct_c__SA_wall_2d_offload_data),
     ('w3d', struct_c__SA_wall_3d_offload_data),
     ('offload_array_length', ctypes.c_int32),
     ('int_offload_array_length', ctypes.c_int32),
@@ -906,6 +914,14 @@ struct_c__SA_wall_2d_data._fields_ = [
     ('PADDING_0', ctypes.c_ubyte * 4),
     ('wall_r', ctypes.POINTER(ctypes.c_double)),
     ('wall_z', ctypes.POINTER(ctypes.c_double)),
+    ('nr', ctypes.c_int32),
+    ('nz', ctypes.c_int32),
+    ('rmin', ctypes.c_double),
+    ('rmax', ctypes.c_double),
+    ('zmin', ctypes.c_double),
+    ('zmax', ctypes.c_double),
+    ('dist', ctypes.POINTER(ctypes.c_double)),
+    ('row_array', ctypes.POINTER(ctypes.c_int32)),
 ]
 
 class struct_c__SA_wall_3d_data(Structure):
@@ -930,6 +946,8 @@ struct_c__SA_wall_3d_data._fields_ = [
     ('tree_array_size', ctypes.c_int32),
     ('PADDING_1', ctypes.c_ubyte * 4),
     ('tree_array', ctypes.POINTER(ctypes.c_int32)),
+    ('tri_soa', ctypes.POINTER(ctypes.c_double)),
+    ('dist', ctypes.POINTER(ctypes.c_double)),
 ]
 
 struct_c__SA_wall_data._pack_ = 1 # source:False
@@ -959,6 +977,27 @@ diag_orb_check_plane_crossing.argtypes = [real, real, real]
 diag_orb_check_radial_crossing = _libraries['libascot.so'].diag_orb_check_radial_crossing
 diag_orb_check_radial_crossing.restype = real
 diag_orb_check_radial_crossing.argtypes = [real, real, real]
+class struct_c__SA_diag_orb_stream(Structure):
+    pass
+
+struct_c__SA_diag_orb_stream._pack_ = 1 # source:False
+struct_c__SA_diag_orb_stream._fields_ = [
+    ('nfld', ctypes.c_int32),
+    ('nrec', ctypes.c_int32),
+    ('nchunk', ctypes.c_int32),
+    ('nthread', ctypes.c_int32),
+    ('pool', ctypes.POINTER(ctypes.c_double)),
+    ('count', ctypes.POINTER(ctypes.c_int32)),
+    ('filling', ctypes.POINTER(ctypes.c_int32)),
+    ('full', ctypes.POINTER(ctypes.c_int32)),
+    ('nfull', ctypes.c_int32),
+    ('first', ctypes.c_int32),
+    ('empty', ctypes.POINTER(ctypes.c_int32)),
+    ('nempty', ctypes.c_int32),
+    ('done', ctypes.c_int32),
+]
+
+diag_orb_stream = struct_c__SA_diag_orb_stream
 class struct_c__SA_diag_orb_offload_data(Structure):
     pass
 
@@ -969,15 +1008,16 @@ struct_c__SA_diag_orb_offload_data._fields_ = [
     ('Npnt', ctypes.c_int32),
     ('Nmrk', ctypes.c_int32),
     ('Nfld', ctypes.c_int32),
-    ('PADDING_0', ctypes.c_ubyte * 4),
+    ('stream', ctypes.c_int32),
     ('writeInterval', ctypes.c_double),
     ('ntoroidalplots', ctypes.c_int32),
     ('npoloidalplots', ctypes.c_int32),
     ('nradialplots', ctypes.c_int32),
-    ('PADDING_1', ctypes.c_ubyte * 4),
+    ('compact', ctypes.c_int32),
     ('toroidalangles', ctypes.c_double * 30),
     ('poloidalangles', ctypes.c_double * 30),
     ('radialdistances', ctypes.c_double * 30),
+    ('chunks', ctypes.POINTER(struct_c__SA_diag_orb_stream)),
 ]
 
 diag_orb_offload_data = struct_c__SA_diag_orb_offload_data
@@ -1021,6 +1061,7 @@ struct_c__SA_diag_orb_data._fields_ = [
     ('toroidalangles', ctypes.c_double * 30),
     ('poloidalangles', ctypes.c_double * 30),
     ('radialdistances', ctypes.c_double * 30),
+    ('chunks', ctypes.POINTER(struct_c__SA_diag_orb_stream)),
 ]
 
 diag_orb_data = struct_c__SA_diag_orb_data
@@ -1077,6 +1118,18 @@ struct_c__SA_dist_5D_offload_data._fields_ = [
     ('max_q', ctypes.c_double),
 ]
 
+class struct_c__SA_dist_sparse(Structure):
+    pass
+
+struct_c__SA_dist_sparse._pack_ = 1 # source:False
+struct_c__SA_dist_sparse._fields_ = [
+    ('length', ctypes.c_uint64),
+    ('tilesize', ctypes.c_uint64),
+    ('ntile', ctypes.c_uint64),
+    ('npage', ctypes.c_uint64),
+    ('page', ctypes.POINTER(ctypes.POINTER(ctypes.POINTER(ctypes.c_double)))),
+]
+
 class struct_c__SA_dist_6D_offload_data(Structure):
     pass
 
@@ -1114,6 +1167,7 @@ struct_c__SA_dist_6D_offload_data._fields_ = [
     ('PADDING_7', ctypes.c_ubyte * 4),
     ('min_q', ctypes.c_double),
     ('max_q', ctypes.c_double),
+    ('sparse', struct_c__SA_dist_sparse),
 ]
 
 class struct_c__SA_diag_transcoef_offload_data(Structure):
@@ -1127,6 +1181,28 @@ struct_c__SA_diag_transcoef_offload_data._fields_ = [
     ('interval', ctypes.c_double),
 ]
 
+class struct_c__SA_diag_wallload_offload_data(Structure):
+    pass
+
+struct_c__SA_diag_wallload_offload_data._pack_ = 1 # source:False
+struct_c__SA_diag_wallload_offload_data._fields_ = [
+    ('nelement', ctypes.c_int32),
+    ('nangle', ctypes.c_int32),
+    ('variance', ctypes.c_int32),
+]
+
+class struct_c__SA_dist_accum_offload_data(Structure):
+    pass
+
+struct_c__SA_dist_accum_offload_data._pack_ = 1 # source:False
+struct_c__SA_dist_accum_offload_data._fields_ = [
+    ('mode', ctypes.c_int32),
+    ('PADDING_0', ctypes.c_ubyte * 4),
+    ('maxmem', ctypes.c_double),
+    ('variance', ctypes.c_int32),
+    ('PADDING_1', ctypes.c_ubyte * 4),
+]
+
 class struct_c__SA_dist_COM_offload_data(Structure):
     pass
 
@@ -1146,6 +1222,25 @@ struct_c__SA_dist_COM_offload_data._fields_ = [
     ('max_Ptor', ctypes.c_double),
 ]
 
+class struct_c__SA_dist_moments_offload_data(Structure):
+    pass
+
+struct_c__SA_dist_moments_offload_data._pack_ = 1 # source:False
+struct_c__SA_dist_moments_offload_data._fields_ = [
+    ('n_rho', ctypes.c_int32),
+    ('PADDING_0', ctypes.c_ubyte * 4),
+    ('min_rho', ctypes.c_double),
+    ('max_rho', ctypes.c_double),
+    ('n_theta', ctypes.c_int32),
+    ('PADDING_1', ctypes.c_ubyte * 4),
+    ('min_theta', ctypes.c_double),
+    ('max_theta', ctypes.c_double),
+    ('n_time', ctypes.c_int32),
+    ('PADDING_2', ctypes.c_ubyte * 4),
+    ('min_time', ctypes.c_double),
+    ('max_time', ctypes.c_double),
+]
+
 class struct_c__SA_dist_rho5D_offload_data(Structure):
     pass
 
@@ -1218,6 +1313,7 @@ struct_c__SA_dist_rho6D_offload_data._fields_ = [
     ('PADDING_7', ctypes.c_ubyte * 4),
     ('min_q', ctypes.c_double),
     ('max_q', ctypes.c_double),
+    ('sparse', struct_c__SA_dist_sparse),
 ]
 
 struct_c__SA_diag_offload_data._pack_ = 1 # source:False
@@ -1229,21 +1325,31 @@ struct_c__SA_diag_offload_data._fields_ = [
     ('distrho6D_collect', ctypes.c_int32),
     ('distCOM_collect', ctypes.c_int32),
     ('diagtrcof_collect', ctypes.c_int32),
-    ('PADDING_0', ctypes.c_ubyte * 4),
+    ('diagwall_collect', ctypes.c_int32),
+    ('distmom_collect', ctypes.c_int32),
+    ('variance_collect', ctypes.c_int32),
     ('diagorb', diag_orb_offload_data),
     ('dist5D', struct_c__SA_dist_5D_offload_data),
     ('dist6D', struct_c__SA_dist_6D_offload_data),
     ('distrho5D', struct_c__SA_dist_rho5D_offload_data),
     ('distrho6D', struct_c__SA_dist_rho6D_offload_data),
     ('distCOM', struct_c__SA_dist_COM_offload_data),
+    ('distmom', struct_c__SA_dist_moments_offload_data),
     ('diagtrcof', struct_c__SA_diag_transcoef_offload_data),
+    ('diagwall', struct_c__SA_diag_wallload_offload_data),
+    ('PADDING_0', ctypes.c_ubyte * 4),
+    ('distaccum', struct_c__SA_dist_accum_offload_data),
+    ('dist_sparse', ctypes.c_int32),
     ('offload_dist5D_index', ctypes.c_int32),
     ('offload_dist6D_index', ctypes.c_int32),
     ('offload_distrho5D_index', ctypes.c_int32),
     ('offload_distrho6D_index', ctypes.c_int32),
     ('offload_distCOM_index', ctypes.c_int32),
+    ('offload_distmom_index', ctypes.c_int32),
+    ('offload_distvar_index', ctypes.c_int32),
     ('offload_diagorb_index', ctypes.c_int32),
     ('offload_diagtrcof_index', ctypes.c_int32),
+    ('offload_diagwall_index', ctypes.c_int32),
     ('offload_dist_length', ctypes.c_int32),
     ('offload_array_length', ctypes.c_int32),
     ('PADDING_1', ctypes.c_ubyte * 4),
@@ -1345,23 +1451,126 @@ struct_c__SA_dist_COM_data._fields_ = [
     ('histogram', ctypes.POINTER(ctypes.c_double)),
 ]
 
+class struct_c__SA_dist_moments_data(Structure):
+    pass
+
+struct_c__SA_dist_moments_data._pack_ = 1 # source:False
+struct_c__SA_dist_moments_data._fields_ = [
+    ('n_rho', ctypes.c_int32),
+    ('PADDING_0', ctypes.c_ubyte * 4),
+    ('min_rho', ctypes.c_double),
+    ('max_rho', ctypes.c_double),
+    ('n_theta', ctypes.c_int32),
+    ('PADDING_1', ctypes.c_ubyte * 4),
+    ('min_theta', ctypes.c_double),
+    ('max_theta', ctypes.c_double),
+    ('n_time', ctypes.c_int32),
+    ('PADDING_2', ctypes.c_ubyte * 4),
+    ('min_time', ctypes.c_double),
+    ('max_time', ctypes.c_double),
+    ('histogram', ctypes.POINTER(ctypes.c_double)),
+]
+
 class struct_c__SA_diag_transcoef_data(Structure):
     pass
 
-class struct_diag_transcoef_link(Structure):
+class struct_c__SA_diag_transcoef_marker(Structure):
     pass
 
+class struct_c__SA_diag_transcoef_sums(Structure):
+    pass
+
+struct_c__SA_diag_transcoef_sums._pack_ = 1 # source:False
+struct_c__SA_diag_transcoef_sums._fields_ = [
+    ('ncross', ctypes.c_int32),
+    ('npnt', ctypes.c_int32),
+    ('ngroup', ctypes.c_int32),
+    ('PADDING_0', ctypes.c_ubyte * 4),
+    ('rho', ctypes.c_double),
+    ('time', ctypes.c_double),
+    ('prevrho', ctypes.c_double),
+    ('prevtime', ctypes.c_double),
+    ('sumk', ctypes.c_double),
+    ('sumdt', ctypes.c_double),
+    ('meank', ctypes.c_double),
+    ('m2', ctypes.c_double),
+]
+
+struct_c__SA_diag_transcoef_marker._pack_ = 1 # source:False
+struct_c__SA_diag_transcoef_marker._fields_ = [
+    ('time', ctypes.c_double),
+    ('sign', struct_c__SA_diag_transcoef_sums * 2),
+]
+
 struct_c__SA_diag_transcoef_data._pack_ = 1 # source:False
 struct_c__SA_diag_transcoef_data._fields_ = [
     ('Navg', ctypes.c_int32),
     ('recordrho', ctypes.c_int32),
     ('interval', ctypes.c_double),
-    ('datapoints', ctypes.POINTER(ctypes.POINTER(struct_diag_transcoef_link))),
+    ('markers', ctypes.POINTER(struct_c__SA_diag_transcoef_marker)),
     ('id', ctypes.POINTER(ctypes.c_double)),
     ('Kcoef', ctypes.POINTER(ctypes.c_double)),
     ('Dcoef', ctypes.POINTER(ctypes.c_double)),
 ]
 
+class struct_c__SA_diag_wallload_data(Structure):
+    pass
+
+class struct_c__SA_diag_wallload_buffer(Structure):
+    pass
+
+struct_c__SA_diag_wallload_buffer._pack_ = 1 # source:False
+struct_c__SA_diag_wallload_buffer._fields_ = [
+    ('n', ctypes.c_int32),
+    ('size', ctypes.c_int32),
+    ('element', ctypes.POINTER(ctypes.c_int32)),
+    ('bin', ctypes.POINTER(ctypes.c_int32)),
+    ('flux', ctypes.POINTER(ctypes.c_double)),
+    ('power', ctypes.POINTER(ctypes.c_double)),
+]
+
+class struct_c__SA_dist_accum_data(Structure):
+    pass
+
+class struct_c__SA_dist_accum_buffer(Structure):
+    pass
+
+struct_c__SA_dist_accum_buffer._pack_ = 1 # source:False
+struct_c__SA_dist_accum_buffer._fields_ = [
+    ('n', ctypes.c_int32),
+    ('PADDING_0', ctypes.c_ubyte * 4),
+    ('index', ctypes.c_uint64 * 2048),
+    ('weight', ctypes.c_double * 2048),
+]
+
+struct_c__SA_dist_accum_data._pack_ = 1 # source:False
+struct_c__SA_dist_accum_data._fields_ = [
+    ('mode', ctypes.c_int32),
+    ('variance', ctypes.c_int32),
+    ('nthread', ctypes.c_int32),
+    ('PADDING_0', ctypes.c_ubyte * 4),
+    ('nbin', ctypes.c_uint64),
+    ('length', ctypes.c_uint64),
+    ('histogram', ctypes.POINTER(ctypes.c_double)),
+    ('copy', ctypes.POINTER(ctypes.POINTER(ctypes.c_double))),
+    ('buffer', ctypes.POINTER(ctypes.POINTER(struct_c__SA_dist_accum_buffer))),
+    ('tally', ctypes.POINTER(ctypes.POINTER(struct_c__SA_dist_accum_buffer))),
+]
+
+struct_c__SA_diag_wallload_data._pack_ = 1 # source:False
+struct_c__SA_diag_wallload_data._fields_ = [
+    ('nelement', ctypes.c_int32),
+    ('nangle', ctypes.c_int32),
+    ('flux', ctypes.POINTER(ctypes.c_double)),
+    ('power', ctypes.POINTER(ctypes.c_double)),
+    ('angle', ctypes.POINTER(ctypes.c_double)),
+    ('flux2', ctypes.POINTER(ctypes.c_double)),
+    ('power2', ctypes.POINTER(ctypes.c_double)),
+    ('nbuffer', ctypes.c_int32),
+    ('PADDING_0', ctypes.c_ubyte * 4),
+    ('buffer', ctypes.POINTER(struct_c__SA_diag_wallload_buffer)),
+]
+
 class struct_c__SA_dist_6D_data(Structure):
     pass
 
@@ -1400,6 +1609,7 @@ struct_c__SA_dist_6D_data._fields_ = [
     ('min_q', ctypes.c_double),
     ('max_q', ctypes.c_double),
     ('histogram', ctypes.POINTER(ctypes.c_double)),
+    ('sparse', struct_c__SA_dist_sparse),
 ]
 
 class struct_c__SA_dist_rho6D_data(Structure):
@@ -1440,6 +1650,7 @@ struct_c__SA_dist_rho6D_data._fields_ = [
     ('min_q', ctypes.c_double),
     ('max_q', ctypes.c_double),
     ('histogram', ctypes.POINTER(ctypes.c_double)),
+    ('sparse', struct_c__SA_dist_sparse),
 ]
 
 struct_c__SA_diag_data._pack_ = 1 # source:False
@@ -1451,23 +1662,19 @@ struct_c__SA_diag_data._fields_ = [
     ('distrho6D_collect', ctypes.c_int32),
     ('distCOM_collect', ctypes.c_int32),
     ('diagtrcof_collect', ctypes.c_int32),
-    ('PADDING_0', ctypes.c_ubyte * 4),
+    ('diagwall_collect', ctypes.c_int32),
+    ('distmom_collect', ctypes.c_int32),
+    ('variance_collect', ctypes.c_int32),
     ('diagorb', diag_orb_data),
     ('dist5D', struct_c__SA_dist_5D_data),
     ('dist6D', struct_c__SA_dist_6D_data),
     ('distrho5D', struct_c__SA_dist_rho5D_data),
     ('distrho6D', struct_c__SA_dist_rho6D_data),
     ('distCOM', struct_c__SA_dist_COM_data),
+    ('distmom', struct_c__SA_dist_moments_data),
     ('diagtrcof', struct_c__SA_diag_transcoef_data),
-]
-
-struct_diag_transcoef_link._pack_ = 1 # source:False
-struct_diag_transcoef_link._fields_ = [
-    ('rho', ctypes.c_double),
-    ('time', ctypes.c_double),
-    ('pitchsign', ctypes.c_int32),
-    ('PADDING_0', ctypes.c_ubyte * 4),
-    ('prevlink', ctypes.POINTER(struct_diag_transcoef_link)),
+    ('diagwall', struct_c__SA_diag_wallload_data),
+    ('distaccum', struct_c__SA_dist_accum_data),
 ]
 
 diag_data = struct_c__SA_diag_data
@@ -1480,12 +1687,21 @@ diag_free_offload.argtypes = [ctypes.POINTER(struct_c__SA_diag_offload_data), ct
 diag_sum = _libraries['libascot.so'].diag_sum
 diag_sum.restype = None
 diag_sum.argtypes = [ctypes.POINTER(struct_c__SA_diag_offload_data), ctypes.POINTER(ctypes.c_double), ctypes.POINTER(ctypes.c_double)]
+diag_relerr = _libraries['libascot.so'].diag_relerr
+diag_relerr.restype = real
+diag_relerr.argtypes = [ctypes.POINTER(struct_c__SA_diag_offload_data), ctypes.POINTER(ctypes.c_double), ctypes.c_int32]
+diag_scale = _libraries['libascot.so'].diag_scale
+diag_scale.restype = None
+diag_scale.argtypes = [ctypes.POINTER(struct_c__SA_diag_offload_data), ctypes.POINTER(ctypes.c_double), real]
 diag_init = _libraries['libascot.so'].diag_init
 diag_init.restype = None
 diag_init.argtypes = [ctypes.POINTER(struct_c__SA_diag_data), ctypes.POINTER(struct_c__SA_diag_offload_data), ctypes.POINTER(ctypes.c_double)]
 diag_free = _libraries['libascot.so'].diag_free
 diag_free.restype = None
 diag_free.argtypes = [ctypes.POINTER(struct_c__SA_diag_data)]
+diag_reduce = _libraries['libascot.so'].diag_reduce
+diag_reduce.restype = None
+diag_reduce.argtypes = [ctypes.POINTER(struct_c__SA_diag_data)]
 diag_update_fo = _libraries['libascot.so'].diag_update_fo
 diag_update_fo.restype = None
 diag_update_fo.argtypes = [ctypes.POINTER(struct_c__SA_diag_data), ctypes.POINTER(struct_c__SA_B_field_data), ctypes.POINTER(struct_c__SA_particle_simd_fo), ctypes.POINTER(struct_c__SA_particle_simd_fo)]
@@ -1848,14 +2064,19 @@ struct_c__SA_sim_offload_data._fields_ = [
     ('sim_mode', ctypes.c_int32),
     ('enable_ada', ctypes.c_int32),
     ('record_mode', ctypes.c_int32),
+    ('convergence_target', ctypes.c_int32),
+    ('convergence_relerr', ctypes.c_double),
+    ('convergence_batch', ctypes.c_int32),
     ('fix_usrdef_use', ctypes.c_int32),
     ('fix_usrdef_val', ctypes.c_double),
     ('fix_gyrodef_nstep', ctypes.c_int32),
-    ('PADDING_1', ctypes.c_ubyte * 4),
+    ('fix_conserve_invariants', ctypes.c_int32),
     ('ada_tol_orbfol', ctypes.c_double),
     ('ada_tol_clmbcol', ctypes.c_double),
     ('ada_max_drho', ctypes.c_double),
     ('ada_max_dphi', ctypes.c_double),
+    ('ada_orbfol_method', ctypes.c_int32),
+    ('enable_simdgrouping', ctypes.c_int32),
     ('enable_orbfol', ctypes.c_int32),
     ('enable_clmbcol', ctypes.c_int32),
     ('enable_mhd', ctypes.c_int32),
@@ -1864,6 +2085,14 @@ struct_c__SA_sim_offload_data._fields_ = [
     ('disable_energyccoll', ctypes.c_int32),
     ('disable_pitchccoll', ctypes.c_int32),
     ('disable_gcdiffccoll', ctypes.c_int32),
+    ('enable_tabulatedccoll', ctypes.c_int32),
+    ('enable_ccollcache', ctypes.c_int32),
+    ('ccollcache_drho', ctypes.c_double),
+    ('ccollcache_dekin', ctypes.c_double),
+    ('ccollcache_dt', ctypes.c_double),
+    ('enable_ccollsubcycle', ctypes.c_int32),
+    ('enable_orbitavgccoll', ctypes.c_int32),
+    ('orbitavgccoll_maxchange', ctypes.c_double),
     ('reverse_time', ctypes.c_int32),
     ('endcond_active', ctypes.c_int32),
     ('endcond_lim_simtime', ctypes.c_double),
@@ -1892,7 +2121,7 @@ struct_c__SA_sim_offload_data._fields_ = [
     ('qid_boozer', ctypes.c_char * 256),
     ('qid_mhd', ctypes.c_char * 256),
     ('qid_asigma', ctypes.c_char * 256),
-    ('PADDING_2', ctypes.c_ubyte * 4),
+    ('PADDING_1', ctypes.c_ubyte * 4),
 ]
 
 sim_offload_data = struct_c__SA_sim_offload_data
@@ -2152,6 +2381,16 @@ struct_c__SA_neutral_data._fields_ = [
     ('N03D', struct_c__SA_N0_3D_data),
 ]
 
+class struct_c__SA_random_data(Structure):
+    pass
+
+struct_c__SA_random_data._pack_ = 1 # source:False
+struct_c__SA_random_data._fields_ = [
+    ('seed', ctypes.c_uint64),
+    ('ctr', ctypes.c_uint64 * 16),
+    ('stream', ctypes.c_uint64 * 16),
+]
+
 class struct_c__SA_mccc_data(Structure):
     pass
 
@@ -2161,6 +2400,18 @@ struct_c__SA_mccc_data._fields_ = [
     ('include_energy', ctypes.c_int32),
     ('include_pitch', ctypes.c_int32),
     ('include_gcdiff', ctypes.c_int32),
+    ('usecache', ctypes.c_int32),
+    ('PADDING_0', ctypes.c_ubyte * 4),
+    ('cache_drho', ctypes.c_double),
+    ('cache_dekin', ctypes.c_double),
+    ('cache_dt', ctypes.c_double),
+    ('cache_neval', ctypes.c_int64),
+    ('cache_nrefresh', ctypes.c_int64),
+    ('cache_maxdev', ctypes.c_double),
+    ('tab_n', ctypes.c_int32),
+    ('PADDING_1', ctypes.c_ubyte * 4),
+    ('tab_invdx', ctypes.c_double),
+    ('tab_c', ctypes.c_double * 6144),
 ]
 
 struct_c__SA_sim_data._pack_ = 1 # source:False
@@ -2174,19 +2425,24 @@ struct_c__SA_sim_data._fields_ = [
     ('mhd_data', struct_c__SA_mhd_data),
     ('asigma_data', struct_c__SA_asigma_data),
     ('diag_data', diag_data),
-    ('random_data', ctypes.POINTER(None)),
+    ('random_data', struct_c__SA_random_data),
     ('mccc_data', struct_c__SA_mccc_data),
     ('sim_mode', ctypes.c_int32),
     ('enable_ada', ctypes.c_int32),
     ('record_mode', ctypes.c_int32),
+    ('convergence_target', ctypes.c_int32),
+    ('convergence_relerr', ctypes.c_double),
+    ('convergence_batch', ctypes.c_int32),
     ('fix_usrdef_use', ctypes.c_int32),
     ('fix_usrdef_val', ctypes.c_double),
     ('fix_gyrodef_nstep', ctypes.c_int32),
-    ('PADDING_0', ctypes.c_ubyte * 4),
+    ('fix_conserve_invariants', ctypes.c_int32),
     ('ada_tol_orbfol', ctypes.c_double),
     ('ada_tol_clmbcol', ctypes.c_double),
     ('ada_max_drho', ctypes.c_double),
     ('ada_max_dphi', ctypes.c_double),
+    ('ada_orbfol_method', ctypes.c_int32),
+    ('enable_simdgrouping', ctypes.c_int32),
     ('enable_orbfol', ctypes.c_int32),
     ('enable_clmbcol', ctypes.c_int32),
     ('enable_mhd', ctypes.c_int32),
@@ -2195,6 +2451,14 @@ struct_c__SA_sim_data._fields_ = [
     ('disable_energyccoll', ctypes.c_int32),
     ('disable_pitchccoll', ctypes.c_int32),
     ('disable_gcdiffccoll', ctypes.c_int32),
+    ('enable_tabulatedccoll', ctypes.c_int32),
+    ('enable_ccollcache', ctypes.c_int32),
+    ('ccollcache_drho', ctypes.c_double),
+    ('ccollcache_dekin', ctypes.c_double),
+    ('ccollcache_dt', ctypes.c_double),
+    ('enable_ccollsubcycle', ctypes.c_int32),
+    ('enable_orbitavgccoll', ctypes.c_int32),
+    ('orbitavgccoll_maxchange', ctypes.c_double),
     ('reverse_time', ctypes.c_int32),
     ('endcond_active', ctypes.c_int32),
     ('endcond_lim_simtime', ctypes.c_double),
@@ -2207,7 +2471,7 @@ struct_c__SA_sim_data._fields_ = [
     ('endcond_max_tororb', ctypes.c_double),
     ('endcond_max_polorb', ctypes.c_double),
     ('endcond_torandpol', ctypes.c_int32),
-    ('PADDING_1', ctypes.c_ubyte * 4),
+    ('PADDING_0', ctypes.c_ubyte * 4),
 ]
 
 sim_data = struct_c__SA_sim_data
@@ -2264,6 +2528,9 @@ hdf5_generate_qid.argtypes = [ctypes.POINTER(ctypes.c_char)]
 mpi_interface_init = _libraries['libascot.so'].mpi_interface_init
 mpi_interface_init.restype = None
 mpi_interface_init.argtypes = [ctypes.c_int32, ctypes.POINTER(ctypes.POINTER(ctypes.c_char)), ctypes.POINTER(struct_c__SA_sim_offload_data), ctypes.POINTER(ctypes.c_int32), ctypes.POINTER(ctypes.c_int32), ctypes.POINTER(ctypes.c_int32)]
+mpi_interface_barrier = _libraries['libascot.so'].mpi_interface_barrier
+mpi_interface_barrier.restype = None
+mpi_interface_barrier.argtypes = []
 mpi_interface_finalize = _libraries['libascot.so'].mpi_interface_finalize
 mpi_interface_finalize.restype = None
 mpi_interface_finalize.argtypes = []
@@ -2274,7 +2541,7 @@ mpi_gather_particlestate = _libraries['libascot.so'].mpi_gather_particlestate
 mpi_gather_particlestate.restype = None
 mpi_gather_particlestate.argtypes = [ctypes.POINTER(struct_c__SA_particle_state), ctypes.POINTER(ctypes.POINTER(struct_c__SA_particle_state)), ctypes.POINTER(ctypes.c_int32), ctypes.c_int32, ctypes.c_int32, ctypes.c_int32, ctypes.c_int32]
 mpi_gather_diag = _libraries['libascot.so'].mpi_gather_diag
-mpi_gather_diag.restype = None
+mpi_gather_diag.restype = ctypes.c_int32
 mpi_gather_diag.argtypes = [ctypes.POINTER(struct_c__SA_diag_offload_data), ctypes.POINTER(ctypes.c_double), ctypes.c_int32, ctypes.c_int32, ctypes.c_int32, ctypes.c_int32]
 pack_offload_array = _libraries['libascot.so'].pack_offload_array
 pack_offload_array.restype = ctypes.c_int32
@@ -2427,7 +2694,7 @@ __all__ = \
     'diag_free', 'diag_free_offload', 'diag_init',
     'diag_init_offload', 'diag_offload_data',
     'diag_orb_check_plane_crossing', 'diag_orb_check_radial_crossing',
-    'diag_orb_data', 'diag_orb_free', 'diag_orb_init',
+    'diag_orb_data', 'diag_orb_free', 'diag_orb_init', 'diag_orb_stream',
     'diag_orb_offload_data', 'diag_orb_update_fo',
     'diag_orb_update_gc', 'diag_orb_update_ml', 'diag_sum',
     'diag_update_fo', 'diag_update_gc', 'diag_update_ml',
@@ -2453,7 +2720,8 @@ __all__ = \
     'libascot_allocate_particle_states', 'libascot_allocate_reals',
     'libascot_deallocate', 'mhd_type', 'mhd_type_nonstat',
     'mhd_type_stat', 'mpi_gather_diag', 'mpi_gather_particlestate',
-    'mpi_interface_finalize', 'mpi_interface_init',
+    'mpi_interface_barrier', 'mpi_interface_finalize',
+    'mpi_interface_init',
     'mpi_my_particles', 'neutral_type', 'neutral_type_1D',
     'neutral_type_3D', 'offload_and_simulate', 'offload_free_offload',
     'offload_init_offload', 'offload_pack', 'offload_package',
@@ -2489,13 +2757,23 @@ __all__ = \
     'struct_c__SA_asigma_offload_data', 'struct_c__SA_boozer_data',
     'struct_c__SA_boozer_offload_data', 'struct_c__SA_diag_data',
     'struct_c__SA_diag_offload_data', 'struct_c__SA_diag_orb_data',
-    'struct_c__SA_diag_orb_offload_data',
+    'struct_c__SA_diag_orb_offload_data', 'struct_c__SA_diag_orb_stream',
     'struct_c__SA_diag_transcoef_data',
+    'struct_c__SA_diag_transcoef_marker',
+    'struct_c__SA_diag_transcoef_sums',
     'struct_c__SA_diag_transcoef_offload_data',
+    'struct_c__SA_diag_wallload_buffer',
+    'struct_c__SA_diag_wallload_data',
+    'struct_c__SA_diag_wallload_offload_data',
+    'struct_c__SA_dist_accum_buffer', 'struct_c__SA_dist_accum_data',
+    'struct_c__SA_dist_accum_offload_data',
     'struct_c__SA_dist_5D_data', 'struct_c__SA_dist_5D_offload_data',
     'struct_c__SA_dist_6D_data', 'struct_c__SA_dist_6D_offload_data',
+    'struct_c__SA_dist_sparse',
     'struct_c__SA_dist_COM_data',
     'struct_c__SA_dist_COM_offload_data',
+    'struct_c__SA_dist_moments_data',
+    'struct_c__SA_dist_moments_offload_data',
     'struct_c__SA_dist_rho5D_data',
     'struct_c__SA_dist_rho5D_offload_data',
     'struct_c__SA_dist_rho6D_data',
@@ -2524,7 +2802,7 @@ __all__ = \
     'struct_c__SA_wall_2d_data', 'struct_c__SA_wall_2d_offload_data',
     'struct_c__SA_wall_3d_data', 'struct_c__SA_wall_3d_offload_data',
     'struct_c__SA_wall_data', 'struct_c__SA_wall_offload_data',
-    'struct_diag_transcoef_link', 'union_c__SA_input_particle_0',
+    'union_c__SA_input_particle_0',
     'wall_data', 'wall_free_offload', 'wall_hit_wall', 'wall_init',
     'wall_init_offload', 'wall_offload_data', 'wall_type',
     'wall_type_2D', 'wall_type_3D', 'write_output', 'write_rungroup']
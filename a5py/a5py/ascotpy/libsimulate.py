@@ -41,15 +41,21 @@ class LibSimulate():
         self._sim.sim_mode    = int(opt["SIM_MODE"]);
         self._sim.enable_ada  = int(opt["ENABLE_ADAPTIVE"])
         self._sim.record_mode = int(opt["RECORD_MODE"])
+        self._sim.convergence_target = \
+            int(opt["CONVERGENCE_TARGET"]) * 0 # Not impl.
 
         # Time step
         self._sim.fix_usrdef_use    = int(opt["FIXEDSTEP_USE_USERDEFINED"])
         self._sim.fix_usrdef_val    = opt["FIXEDSTEP_USERDEFINED"]
         self._sim.fix_gyrodef_nstep = int(opt["FIXEDSTEP_GYRODEFINED"])
+        self._sim.fix_conserve_invariants = int(
+            opt["FIXEDSTEP_CONSERVE_INVARIANTS"])
         self._sim.ada_tol_orbfol    = opt["ADAPTIVE_TOL_ORBIT"]
         self._sim.ada_tol_clmbcol   = opt["ADAPTIVE_TOL_CCOL"]
         self._sim.ada_max_drho      = opt["ADAPTIVE_MAX_DRHO"]
         self._sim.ada_max_dphi      = opt["ADAPTIVE_MAX_DPHI"]
+        self._sim.ada_orbfol_method = int(opt["ADAPTIVE_ORBIT_METHOD"])
+        self._sim.enable_simdgrouping = int(opt["ENABLE_SIMD_GROUPING"])
 
         # Physics
         self._sim.enable_orbfol       = int(opt["ENABLE_ORBIT_FOLLOWING"])
@@ -60,6 +66,14 @@ class LibSimulate():
         self._sim.disable_energyccoll = int(opt["DISABLE_ENERGY_CCOLL"])
         self._sim.disable_pitchccoll  = int(opt["DISABLE_PITCH_CCOLL"])
         self._sim.disable_gcdiffccoll = int(opt["DISABLE_GCDIFF_CCOLL"])
+        self._sim.enable_tabulatedccoll = int(opt["ENABLE_TABULATED_CCOLL"])
+        self._sim.enable_ccollcache   = int(opt["ENABLE_CCOLL_CACHE"])
+        self._sim.ccollcache_drho     = opt["CCOLL_CACHE_DRHO"]
+        self._sim.ccollcache_dekin    = opt["CCOLL_CACHE_DEKIN"]
+        self._sim.ccollcache_dt       = opt["CCOLL_CACHE_DT"]
+        self._sim.enable_ccollsubcycle = int(opt["ENABLE_CCOLL_SUBCYCLE"])
+        self._sim.enable_orbitavgccoll = int(opt["ENABLE_ORBITAVG_CCOLL"])
+        self._sim.orbitavgccoll_maxchange = opt["ORBITAVG_CCOLL_MAXCHANGE"]
         self._sim.reverse_time        = int(opt["REVERSE_TIME"])
 
         # Which end conditions are active
@@ -115,6 +129,9 @@ class LibSimulate():
         diag.distrho6D_collect = int(opt["ENABLE_DIST_RHO6D"]) * 0 # Not impl.
         diag.dist5D_collect    = int(opt["ENABLE_DIST_COM"]) * 0   # Not impl.
         diag.diagtrcof_collect = int(opt["ENABLE_TRANSCOEF"]) * 0  # Not impl.
+        diag.diagwall_collect  = int(opt["ENABLE_WALLLOAD"]) * 0   # Not impl.
+        diag.distmom_collect   = int(opt["ENABLE_DIST_MOMENTS"]) * 0 # Not impl.
+        diag.variance_collect  = int(opt["ENABLE_VARIANCE"]) * 0   # Not impl.
         diag.diagorb_collect   = int(opt["ENABLE_ORBITWRITE"])
 
         diagorb = diag.diagorb
@@ -462,6 +462,10 @@ class RunMixin():
         of them receive no loads) but only those that are affected and their
         IDs.
 
+        If the wall loads were collected during the simulation
+        (ENABLE_WALLLOAD = 1), those are used when ``weights`` is True.
+        Otherwise the loads are evaluated from the endstate.
+
         Parameters
         ----------
         weights : bool, optional
@@ -482,8 +486,20 @@ class RunMixin():
         pdepo : array_like
             Particle/flux deposition per tile.
         iangle : array_like
-            Angle of incidence (TODO).
+            Mean angle of incidence per tile.
+
+            Only available if wall loads were collected during the simulation
+            and zero otherwise.
         """
+        if weights and hasattr(self, "_wallload"):
+            flux, power, angle, edges = self._wallload.get()
+            wetted = np.nonzero(flux)[0] + 1
+            area   = self.wall.area()[wetted-1]
+            centers = 0.5 * ( edges[1:] + edges[:-1] )
+            iangle  = np.sum(angle[wetted-1,:] * centers, axis=1) \
+                / np.sum(angle[wetted-1,:], axis=1)
+            return wetted, area, power[wetted-1], flux[wetted-1], iangle
+
         self._require("_endstate")
         ids, energy, weight = self.getstate("walltile", "ekin", "weight",
                                             state="end", endcond="wall")
@@ -667,6 +683,13 @@ class RunMixin():
         ----------
         dist : str or :class:`DistData`
             Distribution from which moments are calculated.
+
+            If ``dist`` is "moments", the moments are taken from the profiles
+            that were collected during the simulation instead. Those are
+            averaged over the toroidal angle and summed over time, and only
+            "density", "chargedensity", "energydensity", "pressure",
+            "parallelcurrent", "toroidalcurrent", and "powerdep" are
+            available.
         *moments : str
             Moments to be calculated.
         volmethod : {"mc", "prism"}, optional
@@ -680,6 +703,12 @@ class RunMixin():
         out : :class:`DistMoment`
             Distribution object containing moments as ordinates.
         """
+        if isinstance(dist, str):
+            if dist != "moments":
+                raise ValueError("Unknown distribution")
+            return self._getdist_collectedmoments(*moments,
+                                                  volmethod=volmethod)
+
         # Initialize the moment object and evaluate the volume.
         if all([x in dist.abscissae for x in ["rho", "theta", "phi"]]):
             rhodist = True
@@ -740,6 +769,44 @@ class RunMixin():
             Dist.canMomentTorque(dist, out)
         return out
 
+    def _getdist_collectedmoments(self, *moments, volmethod="prism"):
+        """Return moments collected during the simulation.
+
+        Parameters
+        ----------
+        *moments : str
+            Moments to be returned.
+        volmethod : {"mc", "prism"}, optional
+            Method used to calculate the volume.
+
+        Returns
+        -------
+        out : :class:`DistMoment`
+            Distribution object containing moments as ordinates.
+        """
+        self._require("_distmoments")
+        collected, edges = self._distmoments.get()
+        rho, theta = edges["rho"], edges["theta"]
+        volume, area, r, phi, z = self._root._ascot.input_rhovolume(
+            method=volmethod, tol=1e-2, nrho=rho.size, ntheta=theta.size,
+            nphi=2, return_area=True, return_coords=True)
+        volume[volume == 0] = 1e-8 # To avoid division by zero
+        out = DistMoment(rho, theta, np.array([0, 360]) * unyt.deg, r, phi, z,
+                         area, volume, True)
+
+        units = {"density" : "particles/m**3", "chargedensity" : "C/m**3",
+                 "energydensity" : "J/m**3", "pressure" : "Pa",
+                 "parallelcurrent" : "A/m**2", "toroidalcurrent" : "A/m**2",
+                 "powerdep" : "W/m**3"}
+        for moment in moments:
+            if moment not in collected:
+                raise ValueError(
+                    "Moment %s was not collected during the simulation"
+                    % moment)
+            val = np.sum(collected[moment], axis=2, keepdims=True) / volume
+            out.add_ordinates(**{moment : val.to(units[moment])})
+        return out
+
     def getdist_list(self, show=True):
         """List all available distributions and moments.
 
@@ -762,6 +829,7 @@ class RunMixin():
         if hasattr(self, "_dist6d"):    dists.append("6d")
         if hasattr(self, "_distrho6d"): dists.append("rho6d")
         if hasattr(self, "_distcom"):   dists.append("com")
+        if hasattr(self, "_distmoments"): dists.append("moments")
 
         moms = []
         if "5d" not in dists and "rho5d" not in dists:
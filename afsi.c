@@ -5,6 +5,7 @@
 #define _XOPEN_SOURCE 500 /**< rand48 requires POSIX 1995 standard */
 
 #include <math.h>
+#include <stdlib.h>
 #include "ascot5.h"
 #include "afsi.h"
 #include "consts.h"
@@ -12,20 +13,20 @@
 #include "boschhale.h"
 #include "diag/dist_5D.h"
 
-random_data rdata;
-
 void afsi_sample_reactant_velocities(
     afsi_data* react1, afsi_data* react2, real m1, real m2, int n,
-    int iR, int iphi, int iz, real* v1x, real* v1y,
+    int iR, int iphi, int iz, random_data* rdata, real* v1x, real* v1y,
     real* v1z, real* v2x, real* v2y, real* v2z);
 void afsi_compute_product_momenta(
     int i, real m1, real m2, real mprod1, real mprod2, real Q,
+    random_data* rdata,
     real* v1x, real* v1y, real* v1z, real* v2x, real* v2y, real* v2z,
     real* ppara1, real* pperp1, real* ppara2, real* pperp2);
 void afsi_sample_5D(dist_5D_data* dist, int n, int iR, int iphi, int iz,
-                    real* ppara, real* pperp);
+                    random_data* rdata, real* ppara, real* pperp);
 void afsi_sample_thermal(afsi_thermal_data* data, real mass, int n, int iR,
-                         int iphi, int iz, real* ppara, real* pperp);
+                         int iphi, int iz, random_data* rdata, real* ppara,
+                         real* pperp);
 real afsi_get_density(afsi_data* dist, int iR, int iphi, int iz);
 real afsi_get_volume(afsi_data* dist, int iR);
 
@@ -43,6 +44,10 @@ real afsi_get_volume(afsi_data* dist, int iR);
  * Inputs and outputs are expected to have same physical (R, phi, z)
  * dimensions.
  *
+ * Each (R, phi, z) cell draws its random numbers from a stream keyed with the
+ * cell index, so that the threads do not share generator state and the result
+ * does not depend on how the cells are divided between threads.
+ *
  * @param reaction fusion reaction type, see the description.
  * @param n number of Monte Carlo samples to be used.
  * @param react1 reactant 1 distribution data.
@@ -53,7 +58,8 @@ real afsi_get_volume(afsi_data* dist, int iR);
 void afsi_run(int reaction, int n, afsi_data* react1, afsi_data* react2,
               dist_5D_data* prod1, dist_5D_data* prod2) {
 
-    random_init(rdata, time((NULL)));
+    random_data rdata;
+    random_init(&rdata, time((NULL)));
 
     real m1=0, m2=0, mprod1=0, mprod2=0, Q=0;
     switch(reaction) {
@@ -118,8 +124,13 @@ void afsi_run(int reaction, int n, afsi_data* react1, afsi_data* react2,
                 real density1 = afsi_get_density(react1, iR, iphi, iz);
                 real density2 = afsi_get_density(react2, iR, iphi, iz);
                 if(density1 > 0 && density2 > 0) {
+                    random_data rcell = rdata;
+                    random_set_stream(&rcell, 0,
+                                      ( (integer)iR * n_phi + iphi ) * n_z + iz,
+                                      RANDOM_STREAM_AFSI);
+
                     afsi_sample_reactant_velocities(
-                        react1, react2, m1, m2, n, iR, iphi, iz,
+                        react1, react2, m1, m2, n, iR, iphi, iz, &rcell,
                         v1x, v1y, v1z, v2x, v2y, v2z);
                     for(int i = 0; i < n; i++) {
                         real vcom2 =   (v1x[i] - v2x[i]) * (v1x[i] - v2x[i])
@@ -133,7 +144,7 @@ void afsi_run(int reaction, int n, afsi_data* react1, afsi_data* react2,
                             * boschhale_sigma(reaction, E_keV)/n*vol;
 
                         afsi_compute_product_momenta(
-                            i, m1, m2, mprod1, mprod2, Q,
+                            i, m1, m2, mprod1, mprod2, Q, &rcell,
                             v1x, v1y, v1z, v2x, v2y, v2z,
                             ppara1, pperp1, ppara2, pperp2);
 
@@ -189,6 +200,7 @@ void afsi_run(int reaction, int n, afsi_data* react1, afsi_data* react2,
  * @param iR R index of the distribution cell where sampling is done.
  * @param iphi phi index of the distribution cell where sampling is done.
  * @param iz z index of the distribution cell where sampling is done.
+ * @param rdata random number generator data.
  * @param v1x array where first velocity components of react1 will be stored.
  * @param v1y array where second velocity components of react1 will be stored.
  * @param v1z array where third velocity components of react1 will be stored.
@@ -198,27 +210,31 @@ void afsi_run(int reaction, int n, afsi_data* react1, afsi_data* react2,
  */
 void afsi_sample_reactant_velocities(
     afsi_data* react1, afsi_data* react2, real m1, real m2, int n, int iR,
-    int iphi, int iz, real* v1x, real* v1y, real* v1z, real* v2x, real* v2y,
-    real* v2z) {
+    int iphi, int iz, random_data* rdata, real* v1x, real* v1y, real* v1z,
+    real* v2x, real* v2y, real* v2z) {
     real* ppara1 = (real*) malloc(n*sizeof(real));
     real* pperp1 = (real*) malloc(n*sizeof(real));
     real* ppara2 = (real*) malloc(n*sizeof(real));
     real* pperp2 = (real*) malloc(n*sizeof(real));
 
     if(react1->type == 1) {
-        afsi_sample_5D(react1->dist_5D, n, iR, iphi, iz, ppara1, pperp1);
+        afsi_sample_5D(react1->dist_5D, n, iR, iphi, iz, rdata,
+                       ppara1, pperp1);
     }
     else if(react1->type == 2) {
         afsi_sample_thermal(
-            react1->dist_thermal, m1, n, iR, iphi, iz, ppara1, pperp1);
+            react1->dist_thermal, m1, n, iR, iphi, iz, rdata,
+            ppara1, pperp1);
     }
 
     if(react2->type == 1) {
-        afsi_sample_5D(react2->dist_5D, n, iR, iphi, iz, ppara2, pperp2);
+        afsi_sample_5D(react2->dist_5D, n, iR, iphi, iz, rdata,
+                       ppara2, pperp2);
     }
     else if(react2->type == 2) {
         afsi_sample_thermal(
-            react2->dist_thermal, m2, n, iR, iphi, iz, ppara2, pperp2);
+            react2->dist_thermal, m2, n, iR, iphi, iz, rdata,
+            ppara2, pperp2);
     }
     for(int i = 0; i < n; i++) {
         real rx = 2*round(random_uniform(rdata))-1;
@@ -250,6 +266,7 @@ void afsi_sample_reactant_velocities(
  * @param mprod1 mass of product 1 [kg].
  * @param mprod2 mass of product 2 [kg].
  * @param Q energy released in the reaction [eV].
+ * @param rdata random number generator data.
  * @param v1x reactant 1 velocity x components.
  * @param v1y reactant 1 velocity y components.
  * @param v1z reactant 1 velocity z components.
@@ -263,6 +280,7 @@ void afsi_sample_reactant_velocities(
  */
 void afsi_compute_product_momenta(
     int i, real m1, real m2, real mprod1, real mprod2, real Q,
+    random_data* rdata,
     real* v1x, real* v1y, real* v1z, real* v2x, real* v2y, real* v2z,
     real* ppara1, real* pperp1, real* ppara2, real* pperp2) {
 
@@ -317,11 +335,12 @@ void afsi_compute_product_momenta(
  * @param iR R index where sampling is done.
  * @param iphi phi index where sampling is done.
  * @param iz z index where sampling is done.
+ * @param rdata random number generator data.
  * @param ppara pointer to array where sampled parallel momenta are stored.
  * @param pperp pointer to array where sampled perpedicular momenta are stored.
  */
 void afsi_sample_5D(dist_5D_data* dist, int n, int iR, int iphi, int iz,
-                    real* ppara, real* pperp) {
+                    random_data* rdata, real* ppara, real* pperp) {
     real* cumdist = (real*) malloc(dist->n_ppara*dist->n_pperp*sizeof(real));
 
     for(int ippara = 0; ippara < dist->n_ppara; ippara++) {
@@ -370,11 +389,13 @@ void afsi_sample_5D(dist_5D_data* dist, int n, int iR, int iphi, int iz,
  * @param iR R index where sampling is done.
  * @param iphi phi index where sampling is done.
  * @param iz z index where sampling is done.
+ * @param rdata random number generator data.
  * @param ppara pointer to array where sampled parallel momenta are stored.
  * @param pperp pointer to array where sampled perpedicular momenta are stored.
  */
 void afsi_sample_thermal(afsi_thermal_data* data, real mass, int n, int iR,
-                         int iphi, int iz, real* ppara, real* pperp) {
+                         int iphi, int iz, random_data* rdata, real* ppara,
+                         real* pperp) {
     int ind = iR * (data->n_phi * data->n_z) + iphi * data->n_z + iz;
     real temp = data->temperature[ind];
 
@@ -522,7 +543,10 @@ void afsi_test_thermal() {
     real* ppara = (real*) malloc(n*sizeof(real));
     real* pperp = (real*) malloc(n*sizeof(real));
 
-    afsi_sample_thermal(&data, 3.343e-27, n, 0, 0, 0, ppara, pperp);
+    random_data rdata;
+    random_init(&rdata, time((NULL)));
+    random_set_stream(&rdata, 0, 0, RANDOM_STREAM_AFSI);
+    afsi_sample_thermal(&data, 3.343e-27, n, 0, 0, 0, &rdata, ppara, pperp);
 
     for(int i = 0; i < n; i++) {
         printf("%le %le\n", ppara[i], pperp[i]);
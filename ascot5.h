@@ -112,7 +112,15 @@ typedef double real;  /**< Double precision float   */
  *  with an explicit (1) or compact (0) way */
 #define INTERP_SPL_EXPL 0
 
-/** @brief Choose whether to use tabulated values for collision coefficients */
-#define A5_CCOL_USE_TABULATED 0
+/** @brief Choose whether tabulated values for collision coefficients are
+ *  available; the table is enabled at runtime with ENABLE_TABULATED_CCOLL */
+#define A5_CCOL_USE_TABULATED 1
+
+/** @brief Choose implementation of exp, log, erf, sin, cos and atan2 in the
+ *  vectorized kernels: libm (0), in-tree with double precision accuracy (1),
+ *  or in-tree with reduced accuracy (2); see vecmath.h */
+#ifndef A5_VECMATH
+#define A5_VECMATH 1
+#endif
 
 #endif
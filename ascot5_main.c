@@ -181,6 +181,19 @@ int main(int argc, char** argv) {
         return 1;
     };
 
+    /* Store the wall octree in the input so that later runs can reuse it.
+     * The root writes only after every MPI process has read its input, and
+     * processes launched separately without MPI never modify the input since
+     * the others may still be reading it. */
+    int write_wall_tree = mpi_rank == mpi_root;
+#ifndef MPI
+    write_wall_tree = write_wall_tree && mpi_size == 1;
+#endif
+    mpi_interface_barrier();
+    if(write_wall_tree) {
+        hdf5_interface_write_wall_tree(&sim, wall_int_offload_array);
+    }
+
     /* Initialize marker states array ps and free marker input p */
     int nprts; /* Number of markers allocated for this MPI process */
     particle_state* ps;
@@ -211,9 +224,12 @@ int main(int argc, char** argv) {
      * diag_offload_array and pout contains end states from all processes. */
     real* diag_offload_array;
     particle_state* pout;
-    offload_and_simulate(
-        &sim, mpi_size, mpi_rank, mpi_root, n_tot, nprts, ps, &offload_data,
-        offload_array, int_offload_array, &pout, &diag_offload_array);
+    if( offload_and_simulate(
+            &sim, mpi_size, mpi_rank, mpi_root, n_tot, nprts, ps,
+            &offload_data, offload_array, int_offload_array, &pout,
+            &diag_offload_array) ) {
+        goto CLEANUP_FAILURE;
+    }
 
     /* Free input data */
     offload_free_offload(&offload_data, &offload_array, &int_offload_array);
@@ -463,8 +479,28 @@ int offload_and_simulate(
     real* offload_array, int* int_offload_array, particle_state** pout,
     real** diag_offload_array) {
 
-    /* Initialize diagnostics offload data */
-    diag_init_offload(&sim->diag_offload_data, diag_offload_array, n_tot);
+    /* Initialize diagnostics offload data. Wall loads are collected on the
+     * elements of the wall that is used in the simulation. */
+    sim->diag_offload_data.diagwall.nelement =
+        wall_get_n_elements(&sim->wall_offload_data);
+
+    /* Streamed orbits are written by a thread of the sections below, which
+     * is only guaranteed to run alongside the simulation if the thread count
+     * is not adjusted at runtime. */
+    diag_orb_offload_data* diagorb = &sim->diag_offload_data.diagorb;
+    if(sim->diag_offload_data.diagorb_collect && diagorb->stream
+       && ( omp_get_dynamic() || omp_get_thread_limit() < 2 ) ) {
+        print_out0(VERBOSE_MINIMAL, mpi_rank,
+                   "Note: Orbits cannot be streamed with the current OpenMP "
+                   "settings and are kept in memory instead.\n");
+        diagorb->stream = 0;
+    }
+    if( diag_init_offload(&sim->diag_offload_data, diag_offload_array,
+                          n_tot) ) {
+        print_err("Error: Failed to initialize diagnostics.\n");
+        *pout = NULL;
+        return 1;
+    }
 
     real diag_offload_array_size = sim->diag_offload_data.offload_array_length
         * sizeof(real) / (1024.0*1024.0);
@@ -523,6 +559,14 @@ int offload_and_simulate(
                 offload_array, int_offload_array, *diag_offload_array);
             host_end = omp_get_wtime();
         }
+
+        /* Write streamed orbits while the markers are simulated */
+        #pragma omp section
+        {
+            if(sim->diag_offload_data.diagorb_collect && diagorb->stream) {
+                hdf5_interface_stream_orbits(sim, mpi_rank, mpi_root);
+            }
+        }
 #endif
     }
 
@@ -536,8 +580,11 @@ int offload_and_simulate(
                              mpi_rank, mpi_size, mpi_root);
     free(pin);
 
-    mpi_gather_diag(&sim->diag_offload_data, *diag_offload_array, n_tot,
-                    mpi_rank, mpi_size, mpi_root);
+    if(mpi_gather_diag(&sim->diag_offload_data, *diag_offload_array, n_tot,
+                       mpi_rank, mpi_size, mpi_root)) {
+        print_err("Error: Failed to gather diagnostics.\n");
+        return 1;
+    }
 
     return 0;
 }
@@ -594,6 +641,19 @@ int write_output(
                    "Diagnostics written.\n");
     }
 
+#ifdef MPI
+    /* Orbits streamed by other processes are appended to the output */
+    if(mpi_rank == mpi_root && sim->diag_offload_data.diagorb_collect
+       && sim->diag_offload_data.diagorb.stream && sim->mpi_size > 1) {
+        if( hdf5_interface_merge_orbits(sim, mpi_rank, sim->mpi_size) ) {
+            print_out0(VERBOSE_MINIMAL, mpi_rank,
+                       "\nMerging orbits failed.\n"
+                       "See stderr for details.\n");
+            return 1;
+        }
+    }
+#endif
+
     return 0;
 }
 
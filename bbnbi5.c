@@ -25,6 +25,7 @@
 #include "plasma.h"
 #include "print.h"
 #include "random.h"
+#include "suzuki.h"
 #include "wall.h"
 
 int read_arguments(int argc, char** argv, sim_offload_data* sim, int* nprt, double* t1, double* t2);
@@ -66,6 +67,26 @@ int main(int argc, char** argv) {
     wall_data wall_data;
     wall_init(&wall_data, &sim.wall_offload_data, wall_offload_array, wall_int_offload_array);
 
+    /* Prepare the beam-stopping fit for this plasma composition */
+    int n_species = plasma_get_n_species(&plasma_data);
+    const real* pls_mass = plasma_get_species_mass(&plasma_data);
+    const real* pls_charge = plasma_get_species_charge(&plasma_data);
+    int pls_anum[MAX_SPECIES], pls_znum[MAX_SPECIES];
+    for(int i = 0; i < n_species; i++) {
+        pls_anum[i] = round(pls_mass[i] / CONST_U);
+        pls_znum[i] = round(pls_charge[i] / CONST_E);
+    }
+
+    suzuki_data suzuki_data;
+    if(suzuki_init_table(&suzuki_data, n_species-1, pls_anum+1, pls_znum+1)) {
+        print_err("Error: Failed to initialize beam-stopping table.\n");
+        return 1;
+    }
+    real err_max, err_mean;
+    suzuki_table_accuracy(&suzuki_data, pls_anum+1, 10000, &err_max, &err_mean);
+    printf("Beam-stopping table: max relative error %le, mean %le\n\n",
+           err_max, err_mean);
+
     random_data rng;
     random_init(&rng, time(NULL));
 
@@ -110,12 +131,14 @@ int main(int argc, char** argv) {
         }
 
         nbi_generate(nprt_inj, t1, t2, &p[nprt_generated], &inj[i], &B_data,
-                     &plasma_data, &wall_data, &rng);
+                     &plasma_data, &wall_data, &suzuki_data, &rng);
 
         nprt_generated += nprt_inj;
         printf("Generated %d markers for injector %d.\n", nprt_inj, i+1);
     }
 
+    suzuki_free_table(&suzuki_data);
+
     printf("\nWriting %d markers.\n", nprt_generated);
 
     /* Copy markers from particle structs into input_particle structs to be
@@ -8,11 +8,15 @@
  * it is enough that one add calls to that diagnostics routines here.
  *
  * One limitation for diagnostic data is that the size of the data must be known
- * before simulation begins so that offloading of that data is possible.
+ * before simulation begins so that offloading of that data is possible. The
+ * exceptions are 6D distributions stored sparsely, whose tiles are allocated in
+ * host memory during the simulation, and streamed orbits, which are written to
+ * the output file during the simulation.
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "ascot5.h"
 #include "simulate.h"
 #include "B_field.h"
@@ -23,7 +27,11 @@
 #include "diag/dist_rho5D.h"
 #include "diag/dist_rho6D.h"
 #include "diag/dist_com.h"
+#include "diag/dist_moments.h"
+#include "diag/dist_accum.h"
+#include "diag/dist_sparse.h"
 #include "diag/diag_transcoef.h"
+#include "diag/diag_wallload.h"
 #include "particle.h"
 
 void diag_arraysum(int start, int stop, real* array1, real* array2);
@@ -31,6 +39,14 @@ void diag_arraysum(int start, int stop, real* array1, real* array2);
 /**
  * @brief Initializes offload array from offload data
  *
+ * If 6D distributions are stored sparsely, they are given no space in the
+ * offload array and their sparse histograms are initialized instead. The same
+ * holds for orbits that are streamed, which are collected in a chunk pool.
+ *
+ * Second moments of the distributions, if collected, follow the distributions
+ * so that both are accumulated as a single region, and those of the wall
+ * loads follow the wall loads.
+ *
  * @param data diagnostics offload data
  * @param offload_array pointer to offload array  which is allocated here
  * @param Nmrk number of markers that will be simulated
@@ -40,6 +56,8 @@ void diag_arraysum(int start, int stop, real* array1, real* array2);
 int diag_init_offload(diag_offload_data* data, real** offload_array, int Nmrk){
     /* Determine how long array we need and allocate it */
     int n = 0;
+    *offload_array = NULL;
+    data->diagorb.chunks = NULL;
 
     if(data->dist5D_collect) {
         data->offload_dist5D_index = n;
@@ -48,7 +66,20 @@ int diag_init_offload(diag_offload_data* data, real** offload_array, int Nmrk){
             * data->dist5D.n_time * data->dist5D.n_q;
     }
 
-    if(data->dist6D_collect) {
+    data->dist6D.sparse.page    = NULL;
+    data->distrho6D.sparse.page = NULL;
+
+    if(data->dist6D_collect && data->dist_sparse) {
+        data->offload_dist6D_index = n;
+        int nbin[8] = {data->dist6D.n_r, data->dist6D.n_phi, data->dist6D.n_z,
+                       data->dist6D.n_pr, data->dist6D.n_pphi,
+                       data->dist6D.n_pz, data->dist6D.n_time,
+                       data->dist6D.n_q};
+        if(dist_sparse_init(&data->dist6D.sparse, 8, nbin)) {
+            return 1;
+        }
+    }
+    else if(data->dist6D_collect) {
         data->offload_dist6D_index = n;
         n += data->dist6D.n_r * data->dist6D.n_phi * data->dist6D.n_z
              * data->dist6D.n_pr * data->dist6D.n_pphi
@@ -63,7 +94,17 @@ int diag_init_offload(diag_offload_data* data, real** offload_array, int Nmrk){
             * data->distrho5D.n_time * data->distrho5D.n_q;
     }
 
-    if(data->distrho6D_collect) {
+    if(data->distrho6D_collect && data->dist_sparse) {
+        data->offload_distrho6D_index = n;
+        int nbin[8] = {data->distrho6D.n_rho, data->distrho6D.n_theta,
+                       data->distrho6D.n_phi, data->distrho6D.n_pr,
+                       data->distrho6D.n_pphi, data->distrho6D.n_pz,
+                       data->distrho6D.n_time, data->distrho6D.n_q};
+        if(dist_sparse_init(&data->distrho6D.sparse, 8, nbin)) {
+            return 1;
+        }
+    }
+    else if(data->distrho6D_collect) {
         data->offload_distrho6D_index = n;
         n += data->distrho6D.n_rho * data->distrho6D.n_theta
             * data->distrho6D.n_phi
@@ -78,6 +119,25 @@ int diag_init_offload(diag_offload_data* data, real** offload_array, int Nmrk){
             * data->distCOM.n_Ptor;
     }
 
+    if(data->distmom_collect) {
+        data->offload_distmom_index = n;
+        n += DIST_MOMENTS_N * data->distmom.n_rho * data->distmom.n_theta
+            * data->distmom.n_time;
+    }
+
+    data->distaccum.variance = data->variance_collect;
+    data->diagwall.variance  = data->variance_collect;
+    if(data->variance_collect) {
+        data->offload_distvar_index = n;
+        n += n;
+    }
+
+    if(data->diagwall_collect) {
+        data->offload_diagwall_index = n;
+        n += ( 2 + data->diagwall.nangle + 2 * data->diagwall.variance )
+            * data->diagwall.nelement;
+    }
+
     data->offload_dist_length = n;
 
     if(data->diagorb_collect) {
@@ -104,7 +164,12 @@ int diag_init_offload(diag_offload_data* data, real** offload_array, int Nmrk){
 
         }
 
-        if(data->diagorb.mode == DIAG_ORB_POINCARE) {
+        if(data->diagorb.stream) {
+            if( diag_orb_init_stream(&data->diagorb) ) {
+                return 1;
+            }
+        }
+        else if(data->diagorb.mode == DIAG_ORB_POINCARE) {
             n += (data->diagorb.Nfld+2)
                 * data->diagorb.Nmrk * data->diagorb.Npnt;
         }
@@ -132,12 +197,15 @@ int diag_init_offload(diag_offload_data* data, real** offload_array, int Nmrk){
 }
 
 /**
- * @brief Frees the offload array
+ * @brief Frees the offload array, sparse histograms, and orbit chunks
  *
  * @param data diagnostics offload data
  * @param offload_array offload array
  */
 void diag_free_offload(diag_offload_data* data, real** offload_array) {
+    dist_sparse_free(&data->dist6D.sparse);
+    dist_sparse_free(&data->distrho6D.sparse);
+    diag_orb_free_stream(&data->diagorb);
     free(*offload_array);
     *offload_array = NULL;
 }
@@ -158,6 +226,9 @@ void diag_init(diag_data* data, diag_offload_data* offload_data,
     data->distrho6D_collect = offload_data->distrho6D_collect;
     data->distCOM_collect   = offload_data->distCOM_collect;
     data->diagtrcof_collect = offload_data->diagtrcof_collect;
+    data->diagwall_collect  = offload_data->diagwall_collect;
+    data->distmom_collect   = offload_data->distmom_collect;
+    data->variance_collect  = offload_data->variance_collect;
 
     if(data->dist5D_collect) {
         dist_5D_init(&data->dist5D, &offload_data->dist5D,
@@ -184,6 +255,23 @@ void diag_init(diag_data* data, diag_offload_data* offload_data,
                         &offload_array[offload_data->offload_distCOM_index]);
     }
 
+    if(data->distmom_collect) {
+        dist_moments_init(&data->distmom, &offload_data->distmom,
+                          &offload_array[offload_data->offload_distmom_index]);
+    }
+
+    /* Distributions are at the beginning of the offload array, followed by
+     * their second moments and wall loads which are accumulated separately */
+    size_t dist_length = offload_data->offload_dist_length;
+    if(data->variance_collect) {
+        dist_length = offload_data->offload_distvar_index;
+    }
+    else if(data->diagwall_collect) {
+        dist_length = offload_data->offload_diagwall_index;
+    }
+    dist_accum_init(&data->distaccum, &offload_data->distaccum,
+                    offload_array, dist_length);
+
     if(data->diagorb_collect) {
         diag_orb_init(&data->diagorb, &offload_data->diagorb,
                       &offload_array[offload_data->offload_diagorb_index]);
@@ -194,6 +282,11 @@ void diag_init(diag_data* data, diag_offload_data* offload_data,
             &data->diagtrcof, &offload_data->diagtrcof,
             &offload_array[offload_data->offload_diagtrcof_index]);
     }
+
+    if(data->diagwall_collect) {
+        diag_wallload_init(&data->diagwall, &offload_data->diagwall,
+                           &offload_array[offload_data->offload_diagwall_index]);
+    }
 }
 
 /**
@@ -202,12 +295,31 @@ void diag_init(diag_data* data, diag_offload_data* offload_data,
  * @param data diagnostics data struct
  */
 void diag_free(diag_data* data) {
+    dist_accum_free(&data->distaccum);
     if(data->diagorb_collect) {
         diag_orb_free(&data->diagorb);
     }
     if(data->diagtrcof_collect) {
         diag_transcoef_free(&data->diagtrcof);
     }
+    if(data->diagwall_collect) {
+        diag_wallload_free(&data->diagwall);
+    }
+}
+
+/**
+ * @brief Add the accumulated distributions and wall loads to the offload array
+ *
+ * This makes the offload array up to date in the middle of a simulation and
+ * must not be called while markers are being simulated.
+ *
+ * @param data diagnostics data struct
+ */
+void diag_reduce(diag_data* data) {
+    dist_accum_reduce(&data->distaccum);
+    if(data->diagwall_collect) {
+        diag_wallload_reduce(&data->diagwall);
+    }
 }
 
 /**
@@ -227,28 +339,41 @@ void diag_update_fo(diag_data* data, B_field_data* Bdata, particle_simd_fo* p_f,
     }
 
     if(data->dist5D_collect) {
-        dist_5D_update_fo(&data->dist5D, p_f, p_i);
+        dist_5D_update_fo(&data->dist5D, &data->distaccum, p_f, p_i);
     }
 
     if(data->dist6D_collect) {
-        dist_6D_update_fo(&data->dist6D, p_f, p_i);
+        dist_6D_update_fo(&data->dist6D, &data->distaccum, p_f, p_i);
     }
 
     if(data->distrho5D_collect) {
-        dist_rho5D_update_fo(&data->distrho5D, p_f, p_i);
+        dist_rho5D_update_fo(&data->distrho5D, &data->distaccum, p_f, p_i);
     }
 
     if(data->distrho6D_collect) {
-        dist_rho6D_update_fo(&data->distrho6D, p_f, p_i);
+        dist_rho6D_update_fo(&data->distrho6D, &data->distaccum, p_f, p_i);
     }
 
     if(data->distCOM_collect){
-        dist_COM_update_fo(&data->distCOM, Bdata, p_f, p_i);
+        dist_COM_update_fo(&data->distCOM, &data->distaccum, Bdata, p_f,
+                           p_i);
+    }
+
+    if(data->distmom_collect) {
+        dist_moments_update_fo(&data->distmom, &data->distaccum, p_f, p_i);
     }
 
     if(data->diagtrcof_collect){
         diag_transcoef_update_fo(&data->diagtrcof, p_f, p_i);
     }
+
+    if(data->variance_collect) {
+        for(int i = 0; i < NSIMD; i++) {
+            if(p_i->running[i] && !p_f->running[i]) {
+                dist_accum_finish(&data->distaccum, i);
+            }
+        }
+    }
 }
 
 /**
@@ -268,28 +393,41 @@ void diag_update_gc(diag_data* data, B_field_data* Bdata, particle_simd_gc* p_f,
     }
 
     if(data->dist5D_collect){
-        dist_5D_update_gc(&data->dist5D, p_f, p_i);
+        dist_5D_update_gc(&data->dist5D, &data->distaccum, p_f, p_i);
     }
 
     if(data->dist6D_collect){
-        dist_6D_update_gc(&data->dist6D, p_f, p_i);
+        dist_6D_update_gc(&data->dist6D, &data->distaccum, p_f, p_i);
     }
 
     if(data->distrho5D_collect){
-        dist_rho5D_update_gc(&data->distrho5D, p_f, p_i);
+        dist_rho5D_update_gc(&data->distrho5D, &data->distaccum, p_f, p_i);
     }
 
     if(data->distrho6D_collect){
-        dist_rho6D_update_gc(&data->distrho6D, p_f, p_i);
+        dist_rho6D_update_gc(&data->distrho6D, &data->distaccum, p_f, p_i);
     }
 
     if(data->distCOM_collect){
-        dist_COM_update_gc(&data->distCOM, Bdata, p_f, p_i);
+        dist_COM_update_gc(&data->distCOM, &data->distaccum, Bdata, p_f,
+                           p_i);
+    }
+
+    if(data->distmom_collect) {
+        dist_moments_update_gc(&data->distmom, &data->distaccum, p_f, p_i);
     }
 
     if(data->diagtrcof_collect){
         diag_transcoef_update_gc(&data->diagtrcof, p_f, p_i);
     }
+
+    if(data->variance_collect) {
+        for(int i = 0; i < NSIMD; i++) {
+            if(p_i->running[i] && !p_f->running[i]) {
+                dist_accum_finish(&data->distaccum, i);
+            }
+        }
+    }
 }
 
 /**
@@ -314,6 +452,46 @@ void diag_update_ml(diag_data* data, particle_simd_ml* p_f,
     }
 }
 
+/**
+ * @brief Collects wall loads of particle markers that hit the wall
+ *
+ * This is called from the end condition check so that the markers that hit
+ * the wall during the current time-step can be recognized.
+ *
+ * @param data pointer to diagnostics data struct
+ * @param wdata pointer to wall data
+ * @param p_f pointer to SIMD struct storing marker states at the end of current
+ *        time-step
+ * @param p_i pointer to SIMD struct storing marker states at the beginning of
+ *        current time-step
+ */
+void diag_update_wallhit_fo(diag_data* data, wall_data* wdata,
+                            particle_simd_fo* p_f, particle_simd_fo* p_i) {
+    if(data->diagwall_collect) {
+        diag_wallload_update_fo(&data->diagwall, wdata, p_f, p_i);
+    }
+}
+
+/**
+ * @brief Collects wall loads of guiding centers that hit the wall
+ *
+ * This is called from the end condition check so that the markers that hit
+ * the wall during the current time-step can be recognized.
+ *
+ * @param data pointer to diagnostics data struct
+ * @param wdata pointer to wall data
+ * @param p_f pointer to SIMD struct storing marker states at the end of current
+ *        time-step
+ * @param p_i pointer to SIMD struct storing marker states at the beginning of
+ *        current time-step
+ */
+void diag_update_wallhit_gc(diag_data* data, wall_data* wdata,
+                            particle_simd_gc* p_f, particle_simd_gc* p_i) {
+    if(data->diagwall_collect) {
+        diag_wallload_update_gc(&data->diagwall, wdata, p_f, p_i);
+    }
+}
+
 /**
  * @brief Sum offload data arrays as one
  *
@@ -322,12 +500,15 @@ void diag_update_ml(diag_data* data, particle_simd_ml* p_f,
  * space for appending the orbit data from the second array, so we only need to
  * move those elements.
  *
+ * Sparse 6D distributions and streamed orbits are kept outside the arrays and
+ * are not summed here.
+ *
  * @param data pointer to diagnostics data struct
  * @param array1 the array to which array2 is summed
  * @param array2 the array which is to be summed
  */
 void diag_sum(diag_offload_data* data, real* array1, real* array2) {
-    if(data->diagorb_collect) {
+    if(data->diagorb_collect && !data->diagorb.stream) {
         int arr_start = data->offload_diagorb_index;
         int arr_length = data->diagorb.Nfld * data->diagorb.Nmrk
             * data->diagorb.Npnt;
@@ -348,13 +529,13 @@ void diag_sum(diag_offload_data* data, real* array1, real* array2) {
 
     if(data->dist5D_collect){
         int start = data->offload_dist5D_index;
-        int stop = start + data->dist5D.n_r * data->dist5D.n_z
-                   * data->dist5D.n_ppara * data->dist5D.n_pperp
+        int stop = start + data->dist5D.n_r * data->dist5D.n_phi
+                   * data->dist5D.n_z * data->dist5D.n_ppara * data->dist5D.n_pperp
                    * data->dist5D.n_time * data->dist5D.n_q;
         diag_arraysum(start, stop, array1, array2);
     }
 
-    if(data->dist6D_collect){
+    if(data->dist6D_collect && !data->dist_sparse){
         int start = data->offload_dist6D_index;
         int stop = start + data->dist6D.n_r * data->dist6D.n_phi
             * data->dist6D.n_z * data->dist6D.n_pr * data->dist6D.n_pphi
@@ -371,7 +552,7 @@ void diag_sum(diag_offload_data* data, real* array1, real* array2) {
         diag_arraysum(start, stop, array1, array2);
     }
 
-    if(data->distrho6D_collect){
+    if(data->distrho6D_collect && !data->dist_sparse){
         int start = data->offload_distrho6D_index;
         int stop = start + data->distrho6D.n_rho * data->distrho6D.n_theta
             * data->distrho6D.n_phi * data->distrho6D.n_pr
@@ -386,6 +567,172 @@ void diag_sum(diag_offload_data* data, real* array1, real* array2) {
             * data->distCOM.n_Ptor;
         diag_arraysum(start, stop, array1, array2);
     }
+
+    if(data->distmom_collect){
+        int start = data->offload_distmom_index;
+        int stop = start + DIST_MOMENTS_N * data->distmom.n_rho
+            * data->distmom.n_theta * data->distmom.n_time;
+        diag_arraysum(start, stop, array1, array2);
+    }
+
+    if(data->variance_collect){
+        int start = data->offload_distvar_index;
+        int stop = start + data->offload_distvar_index;
+        diag_arraysum(start, stop, array1, array2);
+    }
+
+    if(data->diagwall_collect){
+        int start = data->offload_diagwall_index;
+        int stop = start
+            + ( 2 + data->diagwall.nangle + 2 * data->diagwall.variance )
+            * data->diagwall.nelement;
+        diag_arraysum(start, stop, array1, array2);
+    }
+}
+
+/**
+ * @brief Relative statistical error of a target quantity
+ *
+ * The error of a sum over markers is estimated as the square root of the sum
+ * of the squared contributions of the markers. This neglects the square of
+ * the mean contribution and thus overestimates the error somewhat for
+ * quantities to which most markers contribute, but it does not depend on how
+ * many markers there are.
+ *
+ * For distributions the error is the average relative error of the bins,
+ * weighted by the bin contents, and the largest of these is taken over the
+ * collected distributions and moments. Sparse distributions are not included
+ * since their second moments are not collected.
+ *
+ * @param data diagnostics offload data
+ * @param offload_array offload array with the accumulated diagnostics
+ * @param target quantity whose error is evaluated, see diag_convergence_target
+ *
+ * @return relative error, or infinity if it cannot be evaluated
+ */
+real diag_relerr(diag_offload_data* data, real* offload_array, int target) {
+    real relerr = INFINITY;
+    if(!data->variance_collect) {
+        return relerr;
+    }
+
+    if(target == DIAG_CONVERGENCE_DIST) {
+        /* Start of each distribution in the order they lie in the array */
+        int start[5 + DIST_MOMENTS_N + 1];
+        int n = 0;
+        if(data->dist5D_collect) {
+            start[n++] = data->offload_dist5D_index;
+        }
+        if(data->dist6D_collect && !data->dist_sparse) {
+            start[n++] = data->offload_dist6D_index;
+        }
+        if(data->distrho5D_collect) {
+            start[n++] = data->offload_distrho5D_index;
+        }
+        if(data->distrho6D_collect && !data->dist_sparse) {
+            start[n++] = data->offload_distrho6D_index;
+        }
+        if(data->distCOM_collect) {
+            start[n++] = data->offload_distCOM_index;
+        }
+        if(data->distmom_collect) {
+            int nbin = data->distmom.n_rho * data->distmom.n_theta
+                * data->distmom.n_time;
+            for(int j = 0; j < DIST_MOMENTS_N; j++) {
+                start[n++] = data->offload_distmom_index + j * nbin;
+            }
+        }
+        start[n] = data->offload_distvar_index;
+
+        real* var = &offload_array[data->offload_distvar_index];
+        relerr = n > 0 ? 0 : relerr;
+        for(int k = 0; k < n; k++) {
+            real sum = 0, err = 0;
+            for(int j = start[k]; j < start[k+1]; j++) {
+                sum += fabs(offload_array[j]);
+                err += sqrt(var[j]);
+            }
+            relerr = fmax(relerr, sum > 0 ? err / sum : INFINITY);
+        }
+    }
+    else if(data->diagwall_collect
+            && ( target == DIAG_CONVERGENCE_WALLPOWER
+                 || target == DIAG_CONVERGENCE_WALLPEAK ) ) {
+        int nel = data->diagwall.nelement;
+        real* power  = &offload_array[data->offload_diagwall_index + nel];
+        real* power2 = &offload_array[data->offload_diagwall_index
+                                      + ( 3 + data->diagwall.nangle ) * nel];
+        real sum = 0, sum2 = 0;
+        if(target == DIAG_CONVERGENCE_WALLPOWER) {
+            for(int i = 0; i < nel; i++) {
+                sum  += power[i];
+                sum2 += power2[i];
+            }
+        }
+        else {
+            for(int i = 0; i < nel; i++) {
+                if(power[i] > sum) {
+                    sum  = power[i];
+                    sum2 = power2[i];
+                }
+            }
+        }
+        if(sum > 0) {
+            relerr = sqrt(sum2) / sum;
+        }
+    }
+
+    return relerr;
+}
+
+/**
+ * @brief Multiply the weighted diagnostics with a factor
+ *
+ * This is used to normalize the results when only a part of the markers were
+ * simulated. Distributions, including sparse ones, and wall loads are
+ * multiplied with the factor and their second moments with its square.
+ *
+ * @param data diagnostics offload data
+ * @param offload_array offload array with the accumulated diagnostics
+ * @param factor factor the diagnostics are multiplied with
+ */
+void diag_scale(diag_offload_data* data, real* offload_array, real factor) {
+    int nbin = data->offload_dist_length;
+    if(data->variance_collect) {
+        nbin = data->offload_distvar_index;
+    }
+    else if(data->diagwall_collect) {
+        nbin = data->offload_diagwall_index;
+    }
+    for(int j = 0; j < nbin; j++) {
+        offload_array[j] *= factor;
+    }
+    if(data->variance_collect) {
+        for(int j = nbin; j < 2 * nbin; j++) {
+            offload_array[j] *= factor * factor;
+        }
+    }
+
+    if(data->dist6D_collect && data->dist_sparse) {
+        dist_sparse_scale(&data->dist6D.sparse, factor);
+    }
+    if(data->distrho6D_collect && data->dist_sparse) {
+        dist_sparse_scale(&data->distrho6D.sparse, factor);
+    }
+
+    if(data->diagwall_collect) {
+        int nel = data->diagwall.nelement;
+        int n   = ( 2 + data->diagwall.nangle ) * nel;
+        real* wall = &offload_array[data->offload_diagwall_index];
+        for(int j = 0; j < n; j++) {
+            wall[j] *= factor;
+        }
+        if(data->diagwall.variance) {
+            for(int j = n; j < n + 2 * nel; j++) {
+                wall[j] *= factor * factor;
+            }
+        }
+    }
 }
 
 /**
@@ -400,6 +747,7 @@ void diag_sum(diag_offload_data* data, real* array1, real* array2) {
  * @param array2 pointer to array which is to be summed
  */
 void diag_arraysum(int start, int stop, real* array1, real* array2) {
+    #pragma omp parallel for
     for(int i = start; i < stop; i++) {
         array1[i] += array2[i];
     }
@@ -12,8 +12,23 @@
 #include "diag/dist_rho5D.h"
 #include "diag/dist_rho6D.h"
 #include "diag/dist_com.h"
+#include "diag/dist_moments.h"
+#include "diag/dist_accum.h"
 #include "diag/diag_orb.h"
 #include "diag/diag_transcoef.h"
+#include "diag/diag_wallload.h"
+#include "wall.h"
+
+/**
+ * @brief Quantities whose statistical error can end the simulation
+ */
+typedef enum diag_convergence_target {
+    DIAG_CONVERGENCE_NONE      = 0, /**< All markers are simulated            */
+    DIAG_CONVERGENCE_DIST      = 1, /**< Error of the distributions           */
+    DIAG_CONVERGENCE_WALLPOWER = 2, /**< Error of the total wall power        */
+    DIAG_CONVERGENCE_WALLPEAK  = 3  /**< Error of the power on the element
+                                         that receives the most power         */
+} diag_convergence_target;
 
 /**
  * @brief Diagnostics offload data struct
@@ -26,6 +41,9 @@ typedef struct {
     int distrho6D_collect; /**< Flag for collecting 6D rho distribution      */
     int distCOM_collect;    /**< Flag for collecting COM distribution        */
     int diagtrcof_collect; /**< Flag for collecting transport coefficients   */
+    int diagwall_collect;  /**< Flag for collecting wall loads               */
+    int distmom_collect;   /**< Flag for collecting moment profiles         */
+    int variance_collect;  /**< Flag for collecting second moments          */
 
     diag_orb_offload_data diagorb;     /**< Orbit offload data               */
     dist_5D_offload_data dist5D;       /**< 5D distribution offload data     */
@@ -33,15 +51,23 @@ typedef struct {
     dist_rho5D_offload_data distrho5D; /**< 5D rho distribution offload data */
     dist_rho6D_offload_data distrho6D; /**< 6D rho distribution offload data */
     dist_COM_offload_data distCOM;     /**< COM distribution offload data    */
+    dist_moments_offload_data distmom; /**< Moment profile offload data      */
     diag_transcoef_offload_data diagtrcof; /**< Transp. Coef. offload data   */
+    diag_wallload_offload_data diagwall;   /**< Wall load offload data       */
+    dist_accum_offload_data distaccum;     /**< Histogram accumulation data  */
+    int dist_sparse;       /**< Flag for storing 6D distributions sparsely   */
 
     int offload_dist5D_index;    /**< Index for 5D dist in offload array     */
     int offload_dist6D_index;    /**< Index for 5D dist in offload array     */
     int offload_distrho5D_index; /**< Index for 5D dist in offload array     */
     int offload_distrho6D_index; /**< Index for 6D rho dist in offload array */
     int offload_distCOM_index;   /**< Index for COM dist in offload array    */
+    int offload_distmom_index;   /**< Index for moments in offload array     */
+    int offload_distvar_index;   /**< Index for second moments of the
+                                      distributions in offload array         */
     int offload_diagorb_index;   /**< Index for orbit data in offload array  */
     int offload_diagtrcof_index; /**< Index for trcoef data in offload array */
+    int offload_diagwall_index;  /**< Index for wall loads in offload array  */
 
     int offload_dist_length;     /**< Number of elements in distributions    */
     int offload_array_length;    /**< Number of elements in offload_array    */
@@ -59,6 +85,9 @@ typedef struct {
     int distrho6D_collect; /**< Flag for collecting 6D rho distribution      */
     int distCOM_collect;   /**< Flag for collecting COM distribution         */
     int diagtrcof_collect; /**< Flag for collecting transport coefficients   */
+    int diagwall_collect;  /**< Flag for collecting wall loads               */
+    int distmom_collect;   /**< Flag for collecting moment profiles          */
+    int variance_collect;  /**< Flag for collecting second moments           */
 
     diag_orb_data diagorb;     /**< Orbit diagnostics data                   */
     dist_5D_data dist5D;       /**< 5D distribution diagnostics data         */
@@ -66,7 +95,10 @@ typedef struct {
     dist_rho5D_data distrho5D; /**< 5D rho distribution diagnosticsd data    */
     dist_rho6D_data distrho6D; /**< 6D rho distribution diagnostics data     */
     dist_COM_data distCOM;     /**< COM distribution diagnostics data        */
+    dist_moments_data distmom; /**< Moment profile diagnostics data          */
     diag_transcoef_data diagtrcof; /**< Transp. Coef. diagnostics data       */
+    diag_wallload_data diagwall;   /**< Wall load diagnostics data           */
+    dist_accum_data distaccum;     /**< Accumulation of distribution updates */
 
 } diag_data;
 
@@ -76,12 +108,18 @@ void diag_free_offload(diag_offload_data* data, real** offload_array);
 
 void diag_sum(diag_offload_data* data, real* array1, real* array2);
 
+real diag_relerr(diag_offload_data* data, real* offload_array, int target);
+
+void diag_scale(diag_offload_data* data, real* offload_array, real factor);
+
 #pragma omp declare target
 void diag_init(diag_data* data, diag_offload_data* offload_data,
                real* offload_array);
 
 void diag_free(diag_data* data);
 
+void diag_reduce(diag_data* data);
+
 void diag_update_fo(diag_data* data, B_field_data* Bdata, particle_simd_fo* p_f,
                     particle_simd_fo* p_i);
 
@@ -91,6 +129,12 @@ void diag_update_gc(diag_data* data, B_field_data* Bdata, particle_simd_gc* p_f,
 void diag_update_ml(diag_data* data, particle_simd_ml* p_f,
                     particle_simd_ml* p_i);
 
+void diag_update_wallhit_fo(diag_data* data, wall_data* wdata,
+                            particle_simd_fo* p_f, particle_simd_fo* p_i);
+
+void diag_update_wallhit_gc(diag_data* data, wall_data* wdata,
+                            particle_simd_gc* p_f, particle_simd_gc* p_i);
+
 #pragma omp end declare target
 
 #endif
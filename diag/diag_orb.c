@@ -14,6 +14,74 @@
 #include "../simulate.h"
 
 
+/**
+ * @brief Number of slots a marker needs for the records of a single update
+ *
+ * Slots are reserved per update only when the orbits are streamed. One slot
+ * more than the maximum number of records is reserved so that the index of
+ * the next point never wraps around within an update.
+ *
+ * @param offload_data orbit diagnostics offload data struct
+ *
+ * @return number of slots per marker
+ */
+int diag_orb_nslot(diag_orb_offload_data* offload_data) {
+    if(offload_data->mode == DIAG_ORB_POINCARE) {
+        return offload_data->ntoroidalplots + offload_data->npoloidalplots
+            + offload_data->nradialplots + 1;
+    }
+    /* First point and a regular point */
+    return 3;
+}
+
+/**
+ * @brief Initializes the chunk pool for streaming orbits
+ *
+ * Nothing is done if orbits are not streamed. Otherwise the records are
+ * collected in a chunk pool instead of the offload array, and they must be
+ * written by a thread that calls diag_orb_stream_next() while the markers are
+ * simulated.
+ *
+ * @param offload_data orbit diagnostics offload data struct with Nfld set
+ *
+ * @return zero if initialization succeeded
+ */
+int diag_orb_init_stream(diag_orb_offload_data* offload_data) {
+    offload_data->chunks = NULL;
+    if(!offload_data->stream) {
+        return 0;
+    }
+
+    int nfld = offload_data->Nfld;
+    if(offload_data->mode == DIAG_ORB_POINCARE) {
+        nfld += 2;
+    }
+    offload_data->chunks = malloc(sizeof(diag_orb_stream));
+    if(offload_data->chunks == NULL) {
+        return 1;
+    }
+    if( diag_orb_stream_init(offload_data->chunks, nfld,
+                             NSIMD * diag_orb_nslot(offload_data)) ) {
+        free(offload_data->chunks);
+        offload_data->chunks = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Free the chunk pool for streaming orbits
+ *
+ * @param offload_data orbit diagnostics offload data struct
+ */
+void diag_orb_free_stream(diag_orb_offload_data* offload_data) {
+    if(offload_data->chunks != NULL) {
+        diag_orb_stream_free(offload_data->chunks);
+        free(offload_data->chunks);
+        offload_data->chunks = NULL;
+    }
+}
+
 /**
  * @brief Initializes orbit diagnostics offload data.
  *
@@ -24,6 +92,9 @@
  * Note that not all markers fill all space assigned to them before their
  * simulation is terminated.
  *
+ * If orbits are streamed, the fields are instead located in the chunk pool,
+ * and Npnt is the number of slots a marker has in a single update.
+ *
  * @param data orbit diagnostics data struct
  * @param offload_data orbit diagnostics offload data struct
  * @param offload_array offload data array
@@ -35,7 +106,14 @@ void diag_orb_init(diag_orb_data* data, diag_orb_offload_data* offload_data,
     data->Nmrk = offload_data->Nmrk;
     data->Npnt = offload_data->Npnt;
 
-    int step = data->Nmrk*data->Npnt;
+    size_t step = (size_t)data->Nmrk*data->Npnt;
+
+    data->chunks = offload_data->chunks;
+    if(data->chunks != NULL) {
+        data->Npnt    = diag_orb_nslot(offload_data);
+        step          = (size_t)data->chunks->nchunk * data->chunks->nrec;
+        offload_array = data->chunks->pool;
+    }
 
     if(data->mode == DIAG_ORB_INTERVAL) {
         data->writeInterval = offload_data->writeInterval;
@@ -145,11 +223,16 @@ void diag_orb_init(diag_orb_data* data, diag_orb_offload_data* offload_data,
 /**
  * @brief Free orbit diagnostics data
  *
+ * Streamed records that are still in the chunks are passed to the writer.
+ *
  * @param data orbit diagnostics data struct
  */
 void diag_orb_free(diag_orb_data* data){
     free(data->mrk_pnt);
     free(data->mrk_recorded);
+    if(data->chunks != NULL) {
+        diag_orb_stream_finish(data->chunks);
+    }
 }
 
 /**
@@ -164,6 +247,12 @@ void diag_orb_free(diag_orb_data* data){
 void diag_orb_update_fo(diag_orb_data* data, particle_simd_fo* p_f,
                         particle_simd_fo* p_i) {
 
+    /* Reserve slots for the records if they are streamed */
+    integer base = 0;
+    if(data->chunks != NULL) {
+        base = diag_orb_stream_reserve(data->chunks, NSIMD * data->Npnt);
+    }
+
     if(data->mode == DIAG_ORB_INTERVAL) {
 
         #pragma omp simd
@@ -174,10 +263,17 @@ void diag_orb_update_fo(diag_orb_data* data, particle_simd_fo* p_f,
 
                 integer imrk   = p_f->index[i];
                 integer ipoint = data->mrk_pnt[imrk];
-                integer idx    = imrk * data->Npnt + ipoint;
+                integer ibase  = imrk * data->Npnt;
+                if(data->chunks != NULL) {
+                    /* Streamed records go to the slots of this marker */
+                    ipoint = 0;
+                    ibase  = base + i * data->Npnt;
+                }
+                integer idx    = ibase + ipoint;
 
                 /* If this is the first time-step, record marker position. */
-                if( data->id[imrk * data->Npnt] == 0 ) {
+                if( data->chunks == NULL ? data->id[ibase] == 0
+                                         : data->mrk_pnt[imrk] == 0 ) {
                     data->id[idx]     = (real)p_i->id[i];
                     data->mileage[idx]= p_i->mileage[i];
                     data->r[idx]      = p_i->r[i];
@@ -208,7 +304,7 @@ void diag_orb_update_fo(diag_orb_data* data, particle_simd_fo* p_f,
                 real dt = data->mrk_recorded[imrk] + data->writeInterval
                     - p_f->mileage[i];
                 if( dt <= 0 || p_f->endcond[i] > 0 ) {
-                    idx = imrk * data->Npnt + ipoint;
+                    idx = ibase + ipoint;
 
                     data->id[idx]     = (real)p_f->id[i];
                     data->mileage[idx]= p_f->mileage[i];
@@ -247,7 +343,13 @@ void diag_orb_update_fo(diag_orb_data* data, particle_simd_fo* p_f,
                 real k;
                 integer imrk   = p_f->index[i];
                 integer ipoint = data->mrk_pnt[imrk];
-                integer idx    = imrk * data->Npnt + ipoint;
+                integer ibase  = imrk * data->Npnt;
+                if(data->chunks != NULL) {
+                    /* Streamed records go to the slots of this marker */
+                    ipoint = 0;
+                    ibase  = base + i * data->Npnt;
+                }
+                integer idx    = ibase + ipoint;
 
                 /* Check and store toroidal crossings. */
                 for(int j=0; j < data->ntoroidalplots; j++) {
@@ -255,7 +357,7 @@ void diag_orb_update_fo(diag_orb_data* data, particle_simd_fo* p_f,
                                                       data->toroidalangles[j]);
                     if(k) {
                         real d = 1-k;
-                        idx = imrk * data->Npnt + ipoint;
+                        idx = ibase + ipoint;
                         data->id[idx]     = (real)p_f->id[i];
                         data->mileage[idx]= k*p_f->mileage[i]+ d*p_i->mileage[i];
                         data->r[idx]      = k*p_f->r[i]      + d*p_i->r[i];
@@ -291,7 +393,7 @@ void diag_orb_update_fo(diag_orb_data* data, particle_simd_fo* p_f,
                                                       data->poloidalangles[j]);
                     if(k) {
                         real d = 1-k;
-                        idx = imrk * data->Npnt + ipoint;
+                        idx = ibase + ipoint;
                         data->id[idx]     = (real)p_f->id[i];
                         data->mileage[idx]= k*p_f->mileage[i]+ d*p_i->mileage[i];
                         data->r[idx]      = k*p_f->r[i]      + d*p_i->r[i];
@@ -327,7 +429,7 @@ void diag_orb_update_fo(diag_orb_data* data, particle_simd_fo* p_f,
                     if(k) {
                         real d = k;
                         k = 1-d;
-                        idx = imrk * data->Npnt + ipoint;
+                        idx = ibase + ipoint;
                         data->id[idx]     = (real)p_f->id[i];
                         data->mileage[idx]= k*p_f->mileage[i]+ d*p_i->mileage[i];
                         data->r[idx]      = k*p_f->r[i]      + d*p_i->r[i];
@@ -356,6 +458,10 @@ void diag_orb_update_fo(diag_orb_data* data, particle_simd_fo* p_f,
             }
         }
     }
+
+    if(data->chunks != NULL) {
+        diag_orb_stream_commit(data->chunks, base, NSIMD * data->Npnt);
+    }
 }
 
 /**
@@ -370,6 +476,12 @@ void diag_orb_update_fo(diag_orb_data* data, particle_simd_fo* p_f,
 void diag_orb_update_gc(diag_orb_data* data, particle_simd_gc* p_f,
                         particle_simd_gc* p_i) {
 
+    /* Reserve slots for the records if they are streamed */
+    integer base = 0;
+    if(data->chunks != NULL) {
+        base = diag_orb_stream_reserve(data->chunks, NSIMD * data->Npnt);
+    }
+
     if(data->mode == DIAG_ORB_INTERVAL) {
         #pragma omp simd
         for(int i= 0; i < NSIMD; i++) {
@@ -378,10 +490,17 @@ void diag_orb_update_gc(diag_orb_data* data, particle_simd_gc* p_f,
             if(p_f->id[i] > 0) {
                 integer imrk   = p_f->index[i];
                 integer ipoint = data->mrk_pnt[imrk];
-                integer idx    = imrk * data->Npnt + ipoint;
+                integer ibase  = imrk * data->Npnt;
+                if(data->chunks != NULL) {
+                    /* Streamed records go to the slots of this marker */
+                    ipoint = 0;
+                    ibase  = base + i * data->Npnt;
+                }
+                integer idx    = ibase + ipoint;
 
                 /* If this is the first time-step, record marker position. */
-                if( data->id[imrk * data->Npnt] == 0 ) {
+                if( data->chunks == NULL ? data->id[ibase] == 0
+                                         : data->mrk_pnt[imrk] == 0 ) {
                     data->id[idx]     = (real)(p_i->id[i]);
                     data->mileage[idx]= p_i->mileage[i];
                     data->r[idx]      = p_i->r[i];
@@ -413,7 +532,7 @@ void diag_orb_update_gc(diag_orb_data* data, particle_simd_gc* p_f,
                     - p_f->mileage[i];
 
                 if( dt <= 0 || p_f->endcond[i] > 0 ) {
-                                    idx = imrk * data->Npnt + ipoint;
+                                    idx = ibase + ipoint;
 
                     data->id[idx]     = (real)p_f->id[i];
                     data->mileage[idx]= p_f->mileage[i];
@@ -451,7 +570,13 @@ void diag_orb_update_gc(diag_orb_data* data, particle_simd_gc* p_f,
                 real k;
                 integer imrk   = p_f->index[i];
                 integer ipoint = data->mrk_pnt[imrk];
-                integer idx    = imrk * data->Npnt + ipoint;
+                integer ibase  = imrk * data->Npnt;
+                if(data->chunks != NULL) {
+                    /* Streamed records go to the slots of this marker */
+                    ipoint = 0;
+                    ibase  = base + i * data->Npnt;
+                }
+                integer idx    = ibase + ipoint;
 
                 /* Check and store toroidal crossings. */
                 for(int j=0; j < data->ntoroidalplots; j++) {
@@ -459,7 +584,7 @@ void diag_orb_update_gc(diag_orb_data* data, particle_simd_gc* p_f,
                                                       data->toroidalangles[j]);
                     if(k) {
                         real d = 1-k;
-                        idx = imrk * data->Npnt + ipoint;
+                        idx = ibase + ipoint;
                         data->id[idx]     = (real)p_f->id[i];
                         data->mileage[idx]= k*p_f->mileage[i]+ d*p_i->mileage[i];
                         data->r[idx]      = k*p_f->r[i]      + d*p_i->r[i];
@@ -495,7 +620,7 @@ void diag_orb_update_gc(diag_orb_data* data, particle_simd_gc* p_f,
                                                       data->poloidalangles[j]);
                     if(k) {
                         real d = 1-k;
-                        idx = imrk * data->Npnt + ipoint;
+                        idx = ibase + ipoint;
                         data->id[idx]     = (real)p_f->id[i];
                         data->mileage[idx]= k*p_f->mileage[i]+ d*p_i->mileage[i];
                         data->r[idx]      = k*p_f->r[i]      + d*p_i->r[i];
@@ -532,7 +657,7 @@ void diag_orb_update_gc(diag_orb_data* data, particle_simd_gc* p_f,
                                                       data->radialdistances[j]);
                     if(k) {
                         real d = 1-k;
-                        idx = imrk * data->Npnt + ipoint;
+                        idx = ibase + ipoint;
                         data->id[idx]     = (real)p_f->id[i];
                         data->mileage[idx]= k*p_f->mileage[i]+ d*p_i->mileage[i];
                         data->r[idx]      = k*p_f->r[i]      + d*p_i->r[i];
@@ -563,6 +688,10 @@ void diag_orb_update_gc(diag_orb_data* data, particle_simd_gc* p_f,
             }
         }
     }
+
+    if(data->chunks != NULL) {
+        diag_orb_stream_commit(data->chunks, base, NSIMD * data->Npnt);
+    }
 }
 
 /**
@@ -577,6 +706,12 @@ void diag_orb_update_gc(diag_orb_data* data, particle_simd_gc* p_f,
 void diag_orb_update_ml(diag_orb_data* data, particle_simd_ml* p_f,
                         particle_simd_ml* p_i) {
 
+    /* Reserve slots for the records if they are streamed */
+    integer base = 0;
+    if(data->chunks != NULL) {
+        base = diag_orb_stream_reserve(data->chunks, NSIMD * data->Npnt);
+    }
+
     if(data->mode == DIAG_ORB_INTERVAL) {
 
         #pragma omp simd
@@ -586,10 +721,17 @@ void diag_orb_update_ml(diag_orb_data* data, particle_simd_ml* p_f,
             if(p_f->id[i] > 0) {
                 integer imrk   = p_f->index[i];
                 integer ipoint = data->mrk_pnt[imrk];
-                integer idx    = imrk * data->Npnt + ipoint;
+                integer ibase  = imrk * data->Npnt;
+                if(data->chunks != NULL) {
+                    /* Streamed records go to the slots of this marker */
+                    ipoint = 0;
+                    ibase  = base + i * data->Npnt;
+                }
+                integer idx    = ibase + ipoint;
 
                 /* If this is the first time-step, record marker position. */
-                if( data->id[imrk * data->Npnt] == 0 ) {
+                if( data->chunks == NULL ? data->id[ibase] == 0
+                                         : data->mrk_pnt[imrk] == 0 ) {
                     data->id[idx]      = (real)p_i->id[i];
                     data->mileage[idx] = p_i->mileage[i];
                     data->r[idx]       = p_i->r[i];
@@ -615,7 +757,7 @@ void diag_orb_update_ml(diag_orb_data* data, particle_simd_ml* p_f,
                 real dt = data->mrk_recorded[imrk] + data->writeInterval
                     - p_f->mileage[i];
                 if( dt <= 0 || p_f->endcond[i] > 0 ) {
-                    idx = imrk * data->Npnt + ipoint;
+                    idx = ibase + ipoint;
                     data->id[idx]      = (real)p_f->id[i];
                     data->mileage[idx] = p_f->mileage[i];
                     data->r[idx]       = p_f->r[i];
@@ -647,7 +789,13 @@ void diag_orb_update_ml(diag_orb_data* data, particle_simd_ml* p_f,
                 real k;
                 integer imrk   = p_f->index[i];
                 integer ipoint = data->mrk_pnt[imrk];
-                integer idx    = imrk * data->Npnt + ipoint;
+                integer ibase  = imrk * data->Npnt;
+                if(data->chunks != NULL) {
+                    /* Streamed records go to the slots of this marker */
+                    ipoint = 0;
+                    ibase  = base + i * data->Npnt;
+                }
+                integer idx    = ibase + ipoint;
 
                 /* Check and store toroidal crossings. */
                 for(int j=0; j < data->ntoroidalplots; j++) {
@@ -655,7 +803,7 @@ void diag_orb_update_ml(diag_orb_data* data, particle_simd_ml* p_f,
                                                       data->toroidalangles[j]);
                     if(k) {
                         real d = 1-k;
-                        idx = imrk * data->Npnt + ipoint;
+                        idx = ibase + ipoint;
                         data->id[idx]     = (real)p_f->id[i];
                         data->mileage[idx]= k*p_f->mileage[i]+ d*p_i->mileage[i];
                         data->r[idx]      = k*p_f->r[i]      + d*p_i->r[i];
@@ -686,7 +834,7 @@ void diag_orb_update_ml(diag_orb_data* data, particle_simd_ml* p_f,
                                                       data->poloidalangles[j]);
                     if(k) {
                         real d = 1-k;
-                        idx = imrk * data->Npnt + ipoint;
+                        idx = ibase + ipoint;
                         data->id[idx]     = (real)p_f->id[i];
                         data->mileage[idx]= k*p_f->mileage[i] + d*p_i->mileage[i];
                         data->r[idx]      = k*p_f->r[i]       + d*p_i->r[i];
@@ -717,7 +865,7 @@ void diag_orb_update_ml(diag_orb_data* data, particle_simd_ml* p_f,
                                                       data->radialdistances[j]);
                     if(k) {
                         real d = 1-k;
-                        idx = imrk * data->Npnt + ipoint;
+                        idx = ibase + ipoint;
                         data->id[idx]     = (real)p_f->id[i];
                         data->mileage[idx]= k*p_f->mileage[i] + d*p_i->mileage[i];
                         data->r[idx]      = k*p_f->r[i]       + d*p_i->r[i];
@@ -743,6 +891,10 @@ void diag_orb_update_ml(diag_orb_data* data, particle_simd_ml* p_f,
             }
         }
     }
+
+    if(data->chunks != NULL) {
+        diag_orb_stream_commit(data->chunks, base, NSIMD * data->Npnt);
+    }
 }
 
 
@@ -9,6 +9,7 @@
 
 #include <stdio.h>
 #include "../particle.h"
+#include "diag_orb_stream.h"
 
 #define DIAG_ORB_POINCARE 0      /**< Poincare mode flag                 */
 #define DIAG_ORB_INTERVAL 1      /**< Interval mode flag                 */
@@ -40,13 +41,17 @@ typedef struct{
     int Npnt;           /**< Maximum number of points to keep recorded     */
     int Nmrk;           /**< Number of markers to record                   */
     int Nfld;           /**< Number of fields the record contains          */
+    int stream;         /**< Write records to file during the simulation   */
     real writeInterval; /**< Interval at which markers are recorded        */
     int ntoroidalplots; /**< Number of toroidal Poincare planes            */
     int npoloidalplots; /**< Number of toroidal Poincare planes            */
     int nradialplots;   /**< Number of radial Poincare planes              */
+    int compact;        /**< How compactly the records are written         */
     real toroidalangles[DIAG_ORB_MAXPOINCARES]; /**< Toroidal plane angles */
     real poloidalangles[DIAG_ORB_MAXPOINCARES]; /**< Poloidal plane angles */
     real radialdistances[DIAG_ORB_MAXPOINCARES];   /**< Radial plane angles*/
+    diag_orb_stream* chunks; /**< Chunks of streamed records, NULL if the
+                                  records are kept in the offload array    */
 }diag_orb_offload_data;
 
 /**
@@ -59,6 +64,9 @@ typedef struct{
  * offload array. The chuncks are in no particular order. Once chunk is
  * filled and the marker is still recording, new points replace the old
  * ones from the start.
+ *
+ * When orbits are streamed, the pointers are assigned to the chunk pool
+ * instead and all recorded points are written to the output file.
  */
 typedef struct{
 
@@ -97,9 +105,15 @@ typedef struct{
     real toroidalangles[DIAG_ORB_MAXPOINCARES]; /**< Toroidal plane angles  */
     real poloidalangles[DIAG_ORB_MAXPOINCARES]; /**< Poloidal plane angles  */
     real radialdistances[DIAG_ORB_MAXPOINCARES];   /**< Radial plane angles */
+    diag_orb_stream* chunks; /**< Chunks of streamed records or NULL        */
 }diag_orb_data;
 
+int diag_orb_init_stream(diag_orb_offload_data* offload_data);
+void diag_orb_free_stream(diag_orb_offload_data* offload_data);
+
 #pragma omp declare target
+int diag_orb_nslot(diag_orb_offload_data* offload_data);
+
 void diag_orb_init(diag_orb_data* data, diag_orb_offload_data* offload_data,
                    real* offload_array);
 
@@ -0,0 +1,283 @@
+/**
+ * @file diag_orb_stream.c
+ * @brief Chunk buffers for streaming orbit records to the output file.
+ *
+ * Keeping every recorded point of every marker in memory until the end of the
+ * simulation requires space for the maximum number of points of all markers,
+ * most of which is never used. When orbits are streamed, each thread instead
+ * appends its records to a chunk, and full chunks are queued for a writer
+ * thread that writes them to the output file while the simulation goes on.
+ * The memory needed is then set by the number of threads and not by the
+ * number of markers.
+ *
+ * A thread first reserves space for the records it can at most produce in a
+ * single update so that the markers in a SIMD vector can be recorded
+ * independently, and afterwards the records are packed to the start of the
+ * reserved space. Unused slots in a chunk always have zero ID.
+ *
+ * When there are no empty chunks the threads wait until the writer has
+ * caught up, so the simulation is never faster than the output can be
+ * written.
+ */
+#define _XOPEN_SOURCE 500 /**< usleep requires POSIX 1995 standard */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <omp.h>
+#include "../ascot5.h"
+#include "diag_orb_stream.h"
+
+#pragma omp declare target
+void diag_orb_stream_submit(diag_orb_stream* stream, int ichunk);
+int diag_orb_stream_take(diag_orb_stream* stream);
+#pragma omp end declare target
+
+/**
+ * @brief Initializes the chunk pool
+ *
+ * Each thread gets DIAG_ORB_STREAM_NCHUNK chunks in the pool so that the
+ * writer can fall behind by one chunk per thread before anyone waits.
+ *
+ * @param stream pointer to chunk pool
+ * @param nfld number of fields in a record
+ * @param nreserve maximum number of records reserved at once
+ *
+ * @return zero if initialization succeeded
+ */
+int diag_orb_stream_init(diag_orb_stream* stream, int nfld, int nreserve) {
+    stream->nfld    = nfld;
+    stream->nrec    = DIAG_ORB_STREAM_NREC;
+    if(nreserve > stream->nrec) {
+        stream->nrec = nreserve;
+    }
+    stream->nthread = omp_get_max_threads();
+    stream->nchunk  = DIAG_ORB_STREAM_NCHUNK * stream->nthread;
+
+    stream->pool    = calloc((size_t)nfld * stream->nchunk * stream->nrec,
+                             sizeof(real));
+    stream->count   = calloc(stream->nchunk, sizeof(int));
+    stream->filling = malloc(stream->nthread * sizeof(int));
+    stream->full    = malloc(stream->nchunk * sizeof(int));
+    stream->empty   = malloc(stream->nchunk * sizeof(int));
+    if(stream->pool == NULL || stream->count == NULL
+       || stream->filling == NULL || stream->full == NULL
+       || stream->empty == NULL) {
+        diag_orb_stream_free(stream);
+        return 1;
+    }
+
+    for(int t = 0; t < stream->nthread; t++) {
+        stream->filling[t] = -1;
+    }
+    for(int i = 0; i < stream->nchunk; i++) {
+        stream->empty[i] = stream->nchunk - 1 - i;
+    }
+    stream->nempty = stream->nchunk;
+    stream->nfull  = 0;
+    stream->first  = 0;
+    stream->done   = 0;
+    return 0;
+}
+
+/**
+ * @brief Free the chunk pool
+ *
+ * @param stream pointer to chunk pool
+ */
+void diag_orb_stream_free(diag_orb_stream* stream) {
+    free(stream->pool);
+    free(stream->count);
+    free(stream->filling);
+    free(stream->full);
+    free(stream->empty);
+    stream->pool    = NULL;
+    stream->count   = NULL;
+    stream->filling = NULL;
+    stream->full    = NULL;
+    stream->empty   = NULL;
+}
+
+/**
+ * @brief Pass the partially filled chunks to the writer
+ *
+ * Called once all markers have been simulated, after which the writer stops
+ * when the queue is empty.
+ *
+ * @param stream pointer to chunk pool
+ */
+void diag_orb_stream_finish(diag_orb_stream* stream) {
+    #pragma omp critical(diag_orb_stream)
+    {
+        for(int t = 0; t < stream->nthread; t++) {
+            if(stream->filling[t] >= 0) {
+                int pos = ( stream->first + stream->nfull ) % stream->nchunk;
+                stream->full[pos] = stream->filling[t];
+                stream->nfull++;
+                stream->filling[t] = -1;
+            }
+        }
+        stream->done = 1;
+    }
+}
+
+/**
+ * @brief Get the next chunk to be written
+ *
+ * Waits until a chunk is available.
+ *
+ * @param stream pointer to chunk pool
+ *
+ * @return index of the chunk or -1 if all chunks have been written
+ */
+int diag_orb_stream_next(diag_orb_stream* stream) {
+    while(1) {
+        int ichunk = -1, done;
+        #pragma omp critical(diag_orb_stream)
+        {
+            if(stream->nfull > 0) {
+                ichunk = stream->full[stream->first];
+                stream->first = ( stream->first + 1 ) % stream->nchunk;
+                stream->nfull--;
+            }
+            done = stream->done;
+        }
+        if(ichunk >= 0) {
+            return ichunk;
+        }
+        if(done) {
+            return -1;
+        }
+        usleep(DIAG_ORB_STREAM_WAIT);
+    }
+}
+
+/**
+ * @brief Return a written chunk to the pool
+ *
+ * The records are cleared so that the chunk can be filled again.
+ *
+ * @param stream pointer to chunk pool
+ * @param ichunk index of the chunk
+ */
+void diag_orb_stream_release(diag_orb_stream* stream, int ichunk) {
+    size_t step = (size_t)stream->nchunk * stream->nrec;
+    for(int ifld = 0; ifld < stream->nfld; ifld++) {
+        memset(&stream->pool[ifld*step + (size_t)ichunk*stream->nrec], 0,
+               stream->count[ichunk] * sizeof(real));
+    }
+    stream->count[ichunk] = 0;
+
+    #pragma omp critical(diag_orb_stream)
+    {
+        stream->empty[stream->nempty] = ichunk;
+        stream->nempty++;
+    }
+}
+
+/**
+ * @brief Reserve slots for records in the chunk of this thread
+ *
+ * If the chunk does not have room, it is passed to the writer and an empty
+ * chunk is taken in its place. Threads outside the expected team take a chunk
+ * for each reservation and pass it on when the records are committed.
+ *
+ * @param stream pointer to chunk pool
+ * @param n number of slots to reserve
+ *
+ * @return index of the first reserved slot in the field arrays
+ */
+integer diag_orb_stream_reserve(diag_orb_stream* stream, int n) {
+    int t = omp_get_thread_num();
+    int ichunk = -1;
+    if(t < stream->nthread) {
+        ichunk = stream->filling[t];
+    }
+
+    if(ichunk >= 0 && stream->count[ichunk] + n > stream->nrec) {
+        diag_orb_stream_submit(stream, ichunk);
+        ichunk = -1;
+    }
+    if(ichunk < 0) {
+        ichunk = diag_orb_stream_take(stream);
+        if(t < stream->nthread) {
+            stream->filling[t] = ichunk;
+        }
+    }
+    return (integer)ichunk * stream->nrec + stream->count[ichunk];
+}
+
+/**
+ * @brief Pack the records written to the reserved slots
+ *
+ * Slots with zero ID were not used and the records after them are moved
+ * forward.
+ *
+ * @param stream pointer to chunk pool
+ * @param base index of the first reserved slot
+ * @param n number of reserved slots
+ */
+void diag_orb_stream_commit(diag_orb_stream* stream, integer base, int n) {
+    size_t step = (size_t)stream->nchunk * stream->nrec;
+    real* pool = stream->pool;
+    int ichunk = base / stream->nrec;
+
+    integer next = base;
+    for(integer i = base; i < base + n; i++) {
+        if(pool[i] == 0) {
+            continue;
+        }
+        if(i != next) {
+            for(int ifld = 0; ifld < stream->nfld; ifld++) {
+                pool[ifld*step + next] = pool[ifld*step + i];
+                pool[ifld*step + i]    = 0;
+            }
+        }
+        next++;
+    }
+    stream->count[ichunk] += next - base;
+
+    if(omp_get_thread_num() >= stream->nthread) {
+        diag_orb_stream_submit(stream, ichunk);
+    }
+}
+
+/**
+ * @brief Queue a chunk to be written
+ *
+ * @param stream pointer to chunk pool
+ * @param ichunk index of the chunk
+ */
+void diag_orb_stream_submit(diag_orb_stream* stream, int ichunk) {
+    #pragma omp critical(diag_orb_stream)
+    {
+        int pos = ( stream->first + stream->nfull ) % stream->nchunk;
+        stream->full[pos] = ichunk;
+        stream->nfull++;
+    }
+}
+
+/**
+ * @brief Take an empty chunk from the pool
+ *
+ * Waits until the writer has returned a chunk if there are none.
+ *
+ * @param stream pointer to chunk pool
+ *
+ * @return index of the chunk
+ */
+int diag_orb_stream_take(diag_orb_stream* stream) {
+    while(1) {
+        int ichunk = -1;
+        #pragma omp critical(diag_orb_stream)
+        {
+            if(stream->nempty > 0) {
+                stream->nempty--;
+                ichunk = stream->empty[stream->nempty];
+            }
+        }
+        if(ichunk >= 0) {
+            return ichunk;
+        }
+        usleep(DIAG_ORB_STREAM_WAIT);
+    }
+}
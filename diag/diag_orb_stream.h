@@ -0,0 +1,60 @@
+/**
+ * @file diag_orb_stream.h
+ * @brief Header file for diag_orb_stream.c
+ */
+#ifndef DIAG_ORB_STREAM_H
+#define DIAG_ORB_STREAM_H
+
+#include "../ascot5.h"
+
+/**
+ * @brief Number of records in a chunk
+ */
+#define DIAG_ORB_STREAM_NREC 4096
+
+/**
+ * @brief Number of chunks in the pool per thread
+ */
+#define DIAG_ORB_STREAM_NCHUNK 2
+
+/**
+ * @brief Time to wait before checking the chunk queues again [us]
+ */
+#define DIAG_ORB_STREAM_WAIT 1000
+
+/**
+ * @brief Pool of chunks where orbit records are collected before writing
+ *
+ * Each thread fills a chunk of its own and passes it to the writer when it is
+ * full. The writer returns the chunk to the pool once it has been written.
+ * The records are stored field by field so that all chunks share the same
+ * field arrays.
+ */
+typedef struct {
+    int nfld;     /**< Number of fields in a record                          */
+    int nrec;     /**< Number of records in a chunk                          */
+    int nchunk;   /**< Number of chunks in the pool                          */
+    int nthread;  /**< Number of threads that have a chunk of their own      */
+    real* pool;   /**< Records as pool[ifld*nchunk*nrec + ichunk*nrec + irec] */
+    int* count;   /**< Number of records in each chunk                       */
+    int* filling; /**< Chunk each thread is filling, -1 if none              */
+    int* full;    /**< Circular queue of chunks waiting to be written        */
+    int nfull;    /**< Number of chunks in the queue                         */
+    int first;    /**< Position of the first chunk in the queue              */
+    int* empty;   /**< Stack of chunks that can be filled                    */
+    int nempty;   /**< Number of chunks in the stack                         */
+    int done;     /**< Flag indicating no more chunks will be filled         */
+} diag_orb_stream;
+
+int diag_orb_stream_init(diag_orb_stream* stream, int nfld, int nreserve);
+void diag_orb_stream_free(diag_orb_stream* stream);
+int diag_orb_stream_next(diag_orb_stream* stream);
+void diag_orb_stream_release(diag_orb_stream* stream, int ichunk);
+
+#pragma omp declare target
+integer diag_orb_stream_reserve(diag_orb_stream* stream, int n);
+void diag_orb_stream_commit(diag_orb_stream* stream, integer base, int n);
+void diag_orb_stream_finish(diag_orb_stream* stream);
+#pragma omp end declare target
+
+#endif
@@ -1,6 +1,16 @@
 /**
  * @file diag_transcoef.c
  * @brief Transport coefficient diagnostics.
+ *
+ * The radial position and time of each marker are recorded when it crosses
+ * the outer mid-plane. The crossings are averaged in groups of Navg, and the
+ * drift and diffusion coefficients are evaluated from the changes between
+ * consecutive group averages. Only the crossings made with the pitch sign
+ * that the marker had most of the time are used.
+ *
+ * The crossings are not stored. Instead, each marker has running sums for
+ * both pitch signs that are updated whenever a group is completed, so that
+ * recording needs no memory beyond what is allocated at initialization.
  */
 #include <math.h>
 #include <stdlib.h>
@@ -22,6 +32,8 @@ void diag_transcoef_record(diag_transcoef_data* data, integer index,
                            real t_f, real t_i, real theta_f, real theta_i);
 void diag_transcoef_process_and_clean(diag_transcoef_data* data,
                                       integer index, integer id);
+#pragma omp declare simd
+void diag_transcoef_close_group(diag_transcoef_sums* sums);
 #pragma omp end declare target
 
 /**
@@ -42,17 +54,19 @@ void diag_transcoef_init(diag_transcoef_data* data,
     data->recordrho = offload_data->recordrho;
     data->Navg      = offload_data->Navg;
 
-    data->datapoints = malloc(
-        offload_data->Nmrk*sizeof(diag_transcoef_link*) );
+    data->markers = calloc(offload_data->Nmrk, sizeof(diag_transcoef_marker));
     for(int i = 0; i < offload_data->Nmrk; i++) {
         data->id[i] = -1;
-        data->datapoints[i] = NULL;
     }
 }
 
+/**
+ * @brief Free the running sums of the markers.
+ *
+ * @param data transport coefficient diagnostics data struct
+ */
 void diag_transcoef_free(diag_transcoef_data* data) {
-    free(data->datapoints);
-
+    free(data->markers);
 }
 
 /**
@@ -172,6 +186,7 @@ void diag_transcoef_record(diag_transcoef_data* data, integer index,
                            real t_f, real t_i, real theta_f, real theta_i) {
     /* Mask dummy markers */
     if( id > 0 ) {
+        diag_transcoef_marker* mrk = &data->markers[index];
 
         /* Check whether marker position should be recorded: *
          * - Time step was accepted t_f > t_i
@@ -181,164 +196,104 @@ void diag_transcoef_record(diag_transcoef_data* data, integer index,
          */
         real record = 0.0;
         if( t_f > t_i ) {
-            if( data->datapoints[index] == NULL ) {
+            if( mrk->sign[0].ncross + mrk->sign[1].ncross == 0 ) {
                 record = diag_transcoef_check_omp_crossing(theta_f, theta_i);
             }
-            else if( t_f - data->datapoints[index]->time > data->interval ) {
+            else if( t_f - mrk->time > data->interval ) {
                 record = diag_transcoef_check_omp_crossing(theta_f, theta_i);
             }
         }
 
         /* Record */
         if( record > 0) {
-            diag_transcoef_link* newlink =
-                malloc(sizeof(diag_transcoef_link));
-            newlink->time      = t_f;
-            newlink->pitchsign = pitchsign;
-
-            if(data->recordrho) {
-                newlink->rho   = rho;
-            }
-            else {
-                newlink->rho   = r;
-            }
-
-            /* Store the link or make a new chain if the marker is new */
-            if( data->datapoints[index] == NULL ) {
-                newlink->prevlink   = NULL;
-                data->datapoints[index] = newlink;
-            }
-            else {
-                newlink->prevlink   = data->datapoints[index];
-                data->datapoints[index] = newlink;
+            diag_transcoef_sums* sums = &mrk->sign[pitchsign > 0];
+            mrk->time   = t_f;
+            sums->rho  += data->recordrho ? rho : r;
+            sums->time += t_f;
+            sums->npnt++;
+            sums->ncross++;
+            if(sums->npnt == data->Navg) {
+                diag_transcoef_close_group(sums);
             }
         }
     }
 }
 
+/**
+ * @brief Complete the group being averaged and update the running sums.
+ *
+ * The drift over the interval between this group and the previous one is
+ * added to the sums. Its mean and the sum of squared deviations, both
+ * weighted by the interval length, are updated with West's algorithm so that
+ * the diffusion coefficient can be evaluated without cancellation.
+ *
+ * @param sums running sums for the pitch sign
+ */
+void diag_transcoef_close_group(diag_transcoef_sums* sums) {
+    real rho  = sums->rho  / sums->npnt;
+    real time = sums->time / sums->npnt;
+    if(sums->ngroup > 0) {
+        real dt = time - sums->prevtime;
+        real k  = ( rho - sums->prevrho ) / dt;
+        sums->sumk  += k;
+        sums->sumdt += dt;
+        real delta   = k - sums->meank;
+        sums->meank += delta * dt / sums->sumdt;
+        sums->m2    += delta * dt * ( k - sums->meank );
+    }
+    sums->prevrho  = rho;
+    sums->prevtime = time;
+    sums->ngroup++;
+    sums->rho  = 0;
+    sums->time = 0;
+    sums->npnt = 0;
+}
 
 /**
  * @brief Process recorded data to transport coefficients and clean.
  *
- * This function is called when marker simulation has ended.
+ * This function is called when marker simulation has ended. Any remaining
+ * crossings form the last group, which then has fewer than Navg crossings.
+ *
+ * With N group averages rho_j at times t_j, the coefficients are
+ *
+ * K = sum_j k_j / N and D = sum_j 0.5 (k_j - K)^2 dt_j / N,
+ *
+ * where dt_j = t_j+1 - t_j and k_j = (rho_j+1 - rho_j) / dt_j. The latter sum
+ * is obtained from the weighted mean and deviations of k_j as
+ * 0.5 ( m2 + sum_j dt_j (meank - K)^2 ) / N.
  *
  * @param data pointer to transport coefficient data.
  * @param index marker index in the marker queue.
  * @param id marker id.
- * @param rho.
- * @param r.
- * @param pitchsign.
- * @param t_i time (mileage) at the beginning of the time step.
- * @param t_f time (mileage) at the end of the time step.
- * @param theta_i poloidal angle at the beginning of the time step.
- * @param theta_f poloidal angle at the end of the time step.
  */
 void diag_transcoef_process_and_clean(diag_transcoef_data* data,
                                       integer index, integer id) {
+    diag_transcoef_marker* mrk = &data->markers[index];
 
-    /* Count number of positive and negative crossings */
-    int positive = 0, negative = 0;
-    diag_transcoef_link* link = data->datapoints[index];
-    while(link != NULL) {
-        if(link->pitchsign < 0) {
-            negative++;
-        }
-        else {
-            positive++;
-        }
-        link = link->prevlink;
-    }
-
-    /* Which ever there are more are stored */
-    int datasize, sign;
-    if(positive >= negative) {
-        datasize = positive;
-        sign     = 1;
-    }
-    else {
-        datasize = negative;
-        sign     = -1;
+    /* Which ever there are more crossings are used */
+    diag_transcoef_sums* sums = &mrk->sign[1];
+    if(mrk->sign[0].ncross > mrk->sign[1].ncross) {
+        sums = &mrk->sign[0];
     }
 
     /* If there are enough datapoints, process them to K and D */
-    if(datasize > data->Navg) {
-        /* How many points we have after averaging data */
-        int navgpnt = ceil(datasize/data->Navg);
-        real* rho  = malloc(navgpnt*sizeof(real));
-        real* time = malloc(navgpnt*sizeof(real));
-
-        /* The datasize is not necessarily multiple of navg. We take the
-           "extra" points from last points and average them separately   */
-        link = data->datapoints[index];
-        while(link->pitchsign * sign < 0) {
-            link = link->prevlink;
+    if(sums->ncross > data->Navg) {
+        if(sums->npnt > 0) {
+            diag_transcoef_close_group(sums);
         }
-        rho[navgpnt-1]  = link->rho;
-        time[navgpnt-1] = link->time;
 
-        int nextrapnts = datasize - navgpnt*data->Navg;
-        if(nextrapnts == 0) {
-            nextrapnts = data->Navg;
-        }
-        for(int k = 1; k < nextrapnts; k++) {
-            link = link->prevlink;
-            while(link->pitchsign * sign < 0) {
-                link = link->prevlink;
-            }
-            rho[navgpnt-1]  += link->rho;
-            time[navgpnt-1] += link->time;
-        }
-        rho[navgpnt-1]  /= nextrapnts;
-        time[navgpnt-1] /= nextrapnts;
-
-        /* Take the full averages */
-        for(int j = navgpnt-2; j > -1; j--) {
-            rho[j]  = 0;
-            time[j] = 0;
-            for(int k = 0; k < data->Navg; k++) {
-                link = link->prevlink;
-                while(link->pitchsign * sign < 0) {
-                    link = link->prevlink;
-                }
-                rho[j]  += link->rho;
-                time[j] += link->time;
-            }
-            rho[j]  /= data->Navg;
-            time[j] /= data->Navg;
-        }
+        real K = sums->sumk / sums->ngroup;
+        real a = sums->meank - K;
+        real D = 0.5 * ( sums->m2 + sums->sumdt * a * a ) / sums->ngroup;
 
-        /* Evaluate coefficients */
-        real K = 0;
-        for(int j = 0; j < navgpnt-1; j++) {
-            K += ( rho[j+1] - rho[j] ) / ( time[j+1] - time[j] );
-        }
-        K = K / navgpnt;
-
-        real D = 0;
-        for(int j = 0; j < navgpnt-1; j++) {
-            real a = rho[j+1] - rho[j] - K * ( time[j+1] - time[j] );
-            D += 0.5*a*a / ( time[j+1] - time[j] );
-        }
-        D = D / navgpnt;
-
-        /* Store and free resources */
-        free(rho);
-        free(time);
         data->id[index]    = (real)id;
         data->Kcoef[index] = K;
         data->Dcoef[index] = D;
     }
 
-    /* Clear temporary storage */
-    diag_transcoef_link* temp;
-    link = data->datapoints[index];
-    while(link != NULL) {
-        temp = link->prevlink;
-        free(link);
-        link = temp;
-    }
-    data->datapoints[index] = NULL;
-
+    /* Clear the sums */
+    memset(mrk, 0, sizeof(diag_transcoef_marker));
 }
 
 
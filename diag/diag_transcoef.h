@@ -11,14 +11,32 @@
 #include "../particle.h"
 
 /**
- * @brief Simple linked list link for storing data points.
+ * @brief Running sums of the crossings made with a given pitch sign.
+ *
+ * Crossings are averaged in groups of Navg, and the sums over the intervals
+ * between consecutive group averages are updated as each group is completed.
+ */
+typedef struct{
+    int ncross;    /**< Number of crossings                                   */
+    int npnt;      /**< Number of crossings in the group being averaged       */
+    int ngroup;    /**< Number of completed groups                            */
+    real rho;      /**< Sum of rho (or R) in the group being averaged         */
+    real time;     /**< Sum of time in the group being averaged               */
+    real prevrho;  /**< Average rho (or R) of the previous group              */
+    real prevtime; /**< Average time of the previous group                    */
+    real sumk;     /**< Sum of drifts over the intervals between groups       */
+    real sumdt;    /**< Sum of the interval lengths                           */
+    real meank;    /**< Mean drift weighted by interval length                */
+    real m2;       /**< Weighted sum of squared deviations from meank         */
+}diag_transcoef_sums;
+
+/**
+ * @brief Running sums of a marker for both pitch signs.
  */
-typedef struct diag_transcoef_link{
-    real rho;
-    real time;
-    int pitchsign;
-    struct diag_transcoef_link* prevlink;
-}diag_transcoef_link;
+typedef struct{
+    real time;                    /**< Time of the latest crossing          */
+    diag_transcoef_sums sign[2];  /**< Sums for negative and positive pitch   */
+}diag_transcoef_marker;
 
 /**
  * @brief Transport coefficient diagnostics offload data struct.
@@ -40,7 +58,7 @@ typedef struct{
                         taking average value and evaluating K and D           */
     int recordrho; /**< Flag for whether the spatial unit is rho or R.        */
     real interval; /**< Interval at which markers are recorded.               */
-    diag_transcoef_link** datapoints; /* Temporary data storage               */
+    diag_transcoef_marker* markers; /* Running sums of each marker          */
 
     real* id;    /* Marker ID whose data is stored at this index              */
     real* Kcoef; /* Calculated drift coefficients                             */
@@ -0,0 +1,238 @@
+/**
+ * @file diag_wallload.c
+ * @brief Wall load diagnostics.
+ *
+ * Accumulates, for each wall element, the particle flux and power carried by
+ * the markers that hit it, and a histogram of the particle flux in the angle
+ * of incidence, i.e. the angle between the marker's direction of motion and
+ * the element normal.
+ *
+ * Hits are first stored in buffers private to each thread so that recording
+ * them requires no synchronization. The buffers are summed to the histograms
+ * when the diagnostics are freed at the end of the simulation.
+ *
+ * A marker hits the wall at most once, so the statistical error of the loads
+ * follows from the sums of the squared flux and power of individual hits,
+ * which are collected on request.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <omp.h>
+#include "../ascot5.h"
+#include "../consts.h"
+#include "../math.h"
+#include "../physlib.h"
+#include "../endcond.h"
+#include "../particle.h"
+#include "../wall.h"
+#include "diag_wallload.h"
+
+#pragma omp declare target
+void diag_wallload_record(diag_wallload_data* data, wall_data* wdata,
+                          int tile, real phi, real dir[3], real flux,
+                          real power);
+#pragma omp end declare target
+
+/**
+ * @brief Initializes wall load diagnostics from offload data.
+ *
+ * Each thread that may run markers is given an empty hit buffer.
+ *
+ * @param data wall load diagnostics data struct
+ * @param offload_data wall load diagnostics offload data struct
+ * @param offload_array offload data array
+ */
+void diag_wallload_init(diag_wallload_data* data,
+                        diag_wallload_offload_data* offload_data,
+                        real* offload_array) {
+    data->nelement = offload_data->nelement;
+    data->nangle   = offload_data->nangle;
+
+    data->flux  = &(offload_array[0]);
+    data->power = &(offload_array[data->nelement]);
+    data->angle = &(offload_array[2*data->nelement]);
+
+    data->flux2  = NULL;
+    data->power2 = NULL;
+    if(offload_data->variance) {
+        int n = ( 2 + data->nangle ) * data->nelement;
+        data->flux2  = &(offload_array[n]);
+        data->power2 = &(offload_array[n + data->nelement]);
+    }
+
+    data->nbuffer = omp_get_max_threads();
+    data->buffer  = calloc(data->nbuffer, sizeof(diag_wallload_buffer));
+}
+
+/**
+ * @brief Sum the thread buffers to the histograms and free them.
+ *
+ * @param data wall load diagnostics data struct
+ */
+void diag_wallload_free(diag_wallload_data* data) {
+    diag_wallload_reduce(data);
+    for(int t = 0; t < data->nbuffer; t++) {
+        diag_wallload_buffer* buf = &data->buffer[t];
+        free(buf->element);
+        free(buf->bin);
+        free(buf->flux);
+        free(buf->power);
+    }
+    free(data->buffer);
+    data->buffer  = NULL;
+    data->nbuffer = 0;
+}
+
+/**
+ * @brief Sum the thread buffers to the histograms and empty them.
+ *
+ * This must not be called while markers are being simulated.
+ *
+ * @param data wall load diagnostics data struct
+ */
+void diag_wallload_reduce(diag_wallload_data* data) {
+    for(int t = 0; t < data->nbuffer; t++) {
+        diag_wallload_buffer* buf = &data->buffer[t];
+        for(int i = 0; i < buf->n; i++) {
+            int iel = buf->element[i];
+            data->flux[iel]  += buf->flux[i];
+            data->power[iel] += buf->power[i];
+            data->angle[iel * data->nangle + buf->bin[i]] += buf->flux[i];
+            if(data->flux2 != NULL) {
+                data->flux2[iel]  += buf->flux[i] * buf->flux[i];
+                data->power2[iel] += buf->power[i] * buf->power[i];
+            }
+        }
+        buf->n = 0;
+    }
+}
+
+/**
+ * @brief Record wall hits of particle markers.
+ *
+ * Markers that were running at the start of the time step and ended it with
+ * the wall end condition are recorded. The direction of motion is that of
+ * the momentum at the start of the time step.
+ *
+ * @param data wall load diagnostics data struct
+ * @param wdata pointer to wall data
+ * @param p_f pointer to SIMD struct storing marker states at the end of current
+ *        time-step
+ * @param p_i pointer to SIMD struct storing marker states at the beginning of
+ *        current time-step
+ */
+void diag_wallload_update_fo(diag_wallload_data* data, wall_data* wdata,
+                             particle_simd_fo* p_f, particle_simd_fo* p_i) {
+    for(int i = 0; i < NSIMD; i++) {
+        if(p_i->running[i] && (p_f->endcond[i] & endcond_wall)) {
+            real cosp = cos(p_i->phi[i]);
+            real sinp = sin(p_i->phi[i]);
+            real dir[3] = {p_i->p_r[i] * cosp - p_i->p_phi[i] * sinp,
+                           p_i->p_r[i] * sinp + p_i->p_phi[i] * cosp,
+                           p_i->p_z[i]};
+
+            real pnorm = math_normc(p_f->p_r[i], p_f->p_phi[i], p_f->p_z[i]);
+            real ekin  = physlib_Ekin_pnorm(p_f->mass[i], pnorm);
+            diag_wallload_record(data, wdata, p_f->walltile[i], p_f->phi[i],
+                                 dir, p_f->weight[i], p_f->weight[i] * ekin);
+        }
+    }
+}
+
+/**
+ * @brief Record wall hits of guiding center markers.
+ *
+ * Markers that were running at the start of the time step and ended it with
+ * the wall end condition are recorded. The direction of motion is that of
+ * the guiding center displacement during the time step.
+ *
+ * @param data wall load diagnostics data struct
+ * @param wdata pointer to wall data
+ * @param p_f pointer to SIMD struct storing marker states at the end of current
+ *        time-step
+ * @param p_i pointer to SIMD struct storing marker states at the beginning of
+ *        current time-step
+ */
+void diag_wallload_update_gc(diag_wallload_data* data, wall_data* wdata,
+                             particle_simd_gc* p_f, particle_simd_gc* p_i) {
+    for(int i = 0; i < NSIMD; i++) {
+        if(p_i->running[i] && (p_f->endcond[i] & endcond_wall)) {
+            real rpz_i[3] = {p_i->r[i], p_i->phi[i], p_i->z[i]};
+            real rpz_f[3] = {p_f->r[i], p_f->phi[i], p_f->z[i]};
+            real xyz_i[3], xyz_f[3], dir[3];
+            math_rpz2xyz(rpz_i, xyz_i);
+            math_rpz2xyz(rpz_f, xyz_f);
+            math_copy(dir, xyz_f);
+            dir[0] -= xyz_i[0];
+            dir[1] -= xyz_i[1];
+            dir[2] -= xyz_i[2];
+
+            real Bnorm = math_normc(p_f->B_r[i], p_f->B_phi[i], p_f->B_z[i]);
+            real ekin  = physlib_Ekin_ppar(p_f->mass[i], p_f->mu[i],
+                                           p_f->ppar[i], Bnorm);
+            diag_wallload_record(data, wdata, p_f->walltile[i], p_f->phi[i],
+                                 dir, p_f->weight[i], p_f->weight[i] * ekin);
+        }
+    }
+}
+
+/**
+ * @brief Store a single wall hit in the buffer of the calling thread.
+ *
+ * Hits from threads that have no buffer, e.g. because the team is larger
+ * than expected, are added directly to the histograms with atomic updates.
+ *
+ * @param data wall load diagnostics data struct
+ * @param wdata pointer to wall data
+ * @param tile ID of the wall element that was hit
+ * @param phi toroidal angle of the hit point [rad]
+ * @param dir direction of motion in cartesian coordinates
+ * @param flux particle flux carried by the marker [particles/s]
+ * @param power power carried by the marker [W]
+ */
+void diag_wallload_record(diag_wallload_data* data, wall_data* wdata,
+                          int tile, real phi, real dir[3], real flux,
+                          real power) {
+    int iel = tile - 1;
+    if(iel < 0 || iel >= data->nelement) {
+        return;
+    }
+
+    real normal[3];
+    wall_normal_vector(normal, phi, tile, wdata);
+    real cosa = fabs(math_dot(dir, normal)) / math_norm(dir);
+    real angle = acos(fmin(cosa, 1.0));
+    int bin = (int) floor( angle / ( ( CONST_PI / 2 ) / data->nangle ) );
+    bin = bin < data->nangle - 1 ? bin : data->nangle - 1;
+
+    int t = omp_get_thread_num();
+    if(t >= data->nbuffer) {
+        #pragma omp atomic
+        data->flux[iel] += flux;
+        #pragma omp atomic
+        data->power[iel] += power;
+        #pragma omp atomic
+        data->angle[iel * data->nangle + bin] += flux;
+        if(data->flux2 != NULL) {
+            #pragma omp atomic
+            data->flux2[iel] += flux * flux;
+            #pragma omp atomic
+            data->power2[iel] += power * power;
+        }
+        return;
+    }
+
+    diag_wallload_buffer* buf = &data->buffer[t];
+    if(buf->n == buf->size) {
+        buf->size    = buf->size > 0 ? 2 * buf->size : 64;
+        buf->element = realloc(buf->element, buf->size * sizeof(int));
+        buf->bin     = realloc(buf->bin,     buf->size * sizeof(int));
+        buf->flux    = realloc(buf->flux,    buf->size * sizeof(real));
+        buf->power   = realloc(buf->power,   buf->size * sizeof(real));
+    }
+    buf->element[buf->n] = iel;
+    buf->bin[buf->n]     = bin;
+    buf->flux[buf->n]    = flux;
+    buf->power[buf->n]   = power;
+    buf->n++;
+}
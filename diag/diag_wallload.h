@@ -0,0 +1,71 @@
+/**
+ * @file diag_wallload.h
+ * @brief Header file for diag_wallload.c.
+ *
+ * Contains definitions for wall load data structures.
+ */
+#ifndef DIAG_WALLLOAD_H
+#define DIAG_WALLLOAD_H
+
+#include "../ascot5.h"
+#include "../particle.h"
+#include "../wall.h"
+
+/**
+ * @brief Buffer of wall hits recorded by a single thread.
+ */
+typedef struct {
+    int n;         /**< Number of hits recorded                               */
+    int size;      /**< Number of hits that fit in the allocated arrays       */
+    int* element;  /**< Index of the wall element that was hit                */
+    int* bin;      /**< Index of the incidence angle bin                      */
+    real* flux;    /**< Particle flux carried by the marker [particles/s]     */
+    real* power;   /**< Power carried by the marker [W]                       */
+} diag_wallload_buffer;
+
+/**
+ * @brief Wall load diagnostics offload data struct.
+ */
+typedef struct {
+    int nelement; /**< Number of wall elements                                */
+    int nangle;   /**< Number of incidence angle bins between 0 and 90 deg    */
+    int variance; /**< Are sums of squared fluxes and powers collected        */
+} diag_wallload_offload_data;
+
+/**
+ * @brief Wall load diagnostics data struct.
+ */
+typedef struct {
+    int nelement; /**< Number of wall elements                                */
+    int nangle;   /**< Number of incidence angle bins between 0 and 90 deg    */
+
+    real* flux;   /**< Particle flux deposited on each element [particles/s]  */
+    real* power;  /**< Power deposited on each element [W]                    */
+    real* angle;  /**< Particle flux on each element histogrammed in incidence
+                       angle, nelement x nangle [particles/s]                 */
+    real* flux2;  /**< Sum of squared fluxes of the markers that hit each
+                       element, NULL if not collected [particles^2/s^2]       */
+    real* power2; /**< Sum of squared powers of the markers that hit each
+                       element, NULL if not collected [W^2]                   */
+
+    int nbuffer;                  /**< Number of thread buffers               */
+    diag_wallload_buffer* buffer; /**< Hits recorded by each thread           */
+} diag_wallload_data;
+
+#pragma omp declare target
+void diag_wallload_init(diag_wallload_data* data,
+                        diag_wallload_offload_data* offload_data,
+                        real* offload_array);
+
+void diag_wallload_free(diag_wallload_data* data);
+
+void diag_wallload_reduce(diag_wallload_data* data);
+
+void diag_wallload_update_fo(diag_wallload_data* data, wall_data* wdata,
+                             particle_simd_fo* p_f, particle_simd_fo* p_i);
+
+void diag_wallload_update_gc(diag_wallload_data* data, wall_data* wdata,
+                             particle_simd_gc* p_f, particle_simd_gc* p_i);
+#pragma omp end declare target
+
+#endif
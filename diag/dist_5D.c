@@ -96,15 +96,16 @@ void dist_5D_init(dist_5D_data* dist_data, dist_5D_offload_data* offload_data,
  * @brief Update the histogram from full-orbit particles
  *
  * This function updates the histogram from the particle data. Bins are
- * calculated as vector op and histogram is updates as an atomic operation to
+ * calculated as vector op and the histogram is updated via dist_accum_add() to
  * avoid race conditions.
  *
  * @param dist pointer to distribution parameter struct
+ * @param acc pointer to histogram accumulation data
  * @param p_f pointer to SIMD particle struct at the end of current time step
  * @param p_i pointer to SIMD particle struct at the start of current time step
  */
-void dist_5D_update_fo(dist_5D_data* dist, particle_simd_fo* p_f,
-                       particle_simd_fo* p_i) {
+void dist_5D_update_fo(dist_5D_data* dist, dist_accum_data* acc,
+                       particle_simd_fo* p_f, particle_simd_fo* p_i) {
     real phi[NSIMD];
     real ppara[NSIMD];
     real pperp[NSIMD];
@@ -183,8 +184,7 @@ void dist_5D_update_fo(dist_5D_data* dist, particle_simd_fo* p_f,
                                                 dist->n_phi, dist->n_z,
                                                 dist->n_ppara, dist->n_pperp,
                                                 dist->n_time, dist->n_q);
-            #pragma omp atomic
-            dist->histogram[index] += weight[i];
+            dist_accum_add(acc, i, &dist->histogram[index], weight[i]);
         }
     }
 }
@@ -193,15 +193,16 @@ void dist_5D_update_fo(dist_5D_data* dist, particle_simd_fo* p_f,
  * @brief Update the histogram from guiding center markers
  *
  * This function updates the histogram from the marker data. Bins are
- * calculated as vector op and histogram is updates as an atomic operation to
+ * calculated as vector op and the histogram is updated via dist_accum_add() to
  * avoid race conditions.
  *
  * @param dist pointer to distribution parameter struct
+ * @param acc pointer to histogram accumulation data
  * @param p_f pointer to SIMD gc struct at the end of current time step
  * @param p_i pointer to SIMD gc struct at the start of current time step
  */
-void dist_5D_update_gc(dist_5D_data* dist, particle_simd_gc* p_f,
-                       particle_simd_gc* p_i) {
+void dist_5D_update_gc(dist_5D_data* dist, dist_accum_data* acc,
+                       particle_simd_gc* p_f, particle_simd_gc* p_i) {
     real phi[NSIMD];
     real pperp[NSIMD];
 
@@ -273,8 +274,7 @@ void dist_5D_update_gc(dist_5D_data* dist, particle_simd_gc* p_f,
                                                 dist->n_ppara, dist->n_pperp,
                                                 dist->n_time, dist->n_q);
 
-            #pragma omp atomic
-            dist->histogram[index] += weight[i];
+            dist_accum_add(acc, i, &dist->histogram[index], weight[i]);
         }
     }
 }
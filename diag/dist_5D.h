@@ -7,6 +7,7 @@
 
 #include "../ascot5.h"
 #include "../particle.h"
+#include "dist_accum.h"
 
 /**
  * @brief Histogram parameters that will be offloaded to target
@@ -84,10 +85,10 @@ unsigned long dist_5D_index(int i_r, int i_phi, int i_z, int i_ppara,
 void dist_5D_init(dist_5D_data* dist_data,
                   dist_5D_offload_data* offload_data,
                   real* offload_array);
-void dist_5D_update_fo(dist_5D_data* dist, particle_simd_fo* p_f,
-                       particle_simd_fo* p_i);
-void dist_5D_update_gc(dist_5D_data* dist, particle_simd_gc* p_f,
-                       particle_simd_gc* p_i);
+void dist_5D_update_fo(dist_5D_data* dist, dist_accum_data* acc,
+                       particle_simd_fo* p_f, particle_simd_fo* p_i);
+void dist_5D_update_gc(dist_5D_data* dist, dist_accum_data* acc,
+                       particle_simd_gc* p_f, particle_simd_gc* p_i);
 #pragma omp end declare target
 
 #endif
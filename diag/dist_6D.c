@@ -19,14 +19,15 @@ unsigned long dist_6D_index(int i_r, int i_phi, int i_z, int i_pr, int i_pphi,
                             int i_pz, int i_time, int i_q, int n_phi, int n_z,
                             int n_pr, int n_pphi, int n_pz, int n_time,
                             int n_q) {
-    return i_r    * (n_phi * n_z * n_pr * n_pphi * n_pz * n_time * n_q)
-        + i_phi  * (n_z * n_pr * n_pphi * n_pz * n_time * n_q)
-        + i_z    * (n_pr * n_pphi * n_pz * n_time * n_q)
-        + i_pr   * (n_pphi * n_pz * n_time * n_q)
-        + i_pphi * (n_pz * n_time * n_q)
-        + i_pz   * (n_time * n_q)
-        + i_time * (n_q)
-        + i_q;
+    unsigned long index = i_r;
+    index = index * n_phi  + i_phi;
+    index = index * n_z    + i_z;
+    index = index * n_pr   + i_pr;
+    index = index * n_pphi + i_pphi;
+    index = index * n_pz   + i_pz;
+    index = index * n_time + i_time;
+    index = index * n_q    + i_q;
+    return index;
 }
 #pragma omp end declare target
 
@@ -92,21 +93,23 @@ void dist_6D_init(dist_6D_data* dist_data, dist_6D_offload_data* offload_data,
     dist_data->max_q    = offload_data->max_q;
 
     dist_data->histogram = &offload_array[0];
+    dist_data->sparse    = offload_data->sparse;
 }
 
 /**
  * @brief Update the histogram from full-orbit particles
  *
  * This function updates the histogram from the particle data. Bins are
- * calculated as vector op and histogram is updates as an atomic operation to
- * avoid race conditions.
+ * calculated as vector op and the histogram is updated via dist_accum_add(), or
+ * dist_sparse_add() if the histogram is sparse, to avoid race conditions.
  *
  * @param dist pointer to distribution parameter struct
+ * @param acc pointer to histogram accumulation data
  * @param p_i pointer to SIMD particle struct at the beginning of time step
  * @param p_f pointer to SIMD particle struct at the end of time step
  */
-void dist_6D_update_fo(dist_6D_data* dist, particle_simd_fo* p_f,
-                       particle_simd_fo* p_i) {
+void dist_6D_update_fo(dist_6D_data* dist, dist_accum_data* acc,
+                       particle_simd_fo* p_f, particle_simd_fo* p_i) {
     real phi[NSIMD];
 
     int i_r[NSIMD];
@@ -179,8 +182,12 @@ void dist_6D_update_fo(dist_6D_data* dist, particle_simd_fo* p_f,
                                                 dist->n_pr, dist->n_pphi,
                                                 dist->n_pz, dist->n_time,
                                                 dist->n_q);
-            #pragma omp atomic
-            dist->histogram[index] += weight[i];
+            if(dist->sparse.page != NULL) {
+                dist_sparse_add(&dist->sparse, index, weight[i]);
+            }
+            else {
+                dist_accum_add(acc, i, &dist->histogram[index], weight[i]);
+            }
         }
     }
 }
@@ -189,15 +196,16 @@ void dist_6D_update_fo(dist_6D_data* dist, particle_simd_fo* p_f,
  * @brief Update the histogram from guiding-center particles
  *
  * This function updates the histogram from the guiding center data. Bins are
- * calculated as vector op and histogram is updates as an atomic operation to
- * avoid race conditions.
+ * calculated as vector op and the histogram is updated via dist_accum_add(), or
+ * dist_sparse_add() if the histogram is sparse, to avoid race conditions.
  *
  * @param dist pointer to distribution parameter struct
+ * @param acc pointer to histogram accumulation data
  * @param p_i pointer to SIMD GC struct at the beginning of time step
  * @param p_f pointer to SIMD GC struct at the end of time step
  */
-void dist_6D_update_gc(dist_6D_data* dist, particle_simd_gc* p_f,
-                       particle_simd_gc* p_i) {
+void dist_6D_update_gc(dist_6D_data* dist, dist_accum_data* acc,
+                       particle_simd_gc* p_f, particle_simd_gc* p_i) {
     real phi[NSIMD];
 
     int i_r[NSIMD];
@@ -288,8 +296,12 @@ void dist_6D_update_gc(dist_6D_data* dist, particle_simd_gc* p_f,
                                                 dist->n_pr, dist->n_pphi,
                                                 dist->n_pz, dist->n_time,
                                                 dist->n_q);
-            #pragma omp atomic
-            dist->histogram[index] += weight[i];
+            if(dist->sparse.page != NULL) {
+                dist_sparse_add(&dist->sparse, index, weight[i]);
+            }
+            else {
+                dist_accum_add(acc, i, &dist->histogram[index], weight[i]);
+            }
         }
     }
 }
@@ -0,0 +1,332 @@
+/**
+ * @file dist_accum.c
+ * @brief Accumulation of distribution histogram updates.
+ *
+ * Distributions are updated for every marker at every time step, and with
+ * many threads the atomic updates of the shared histograms contend. To avoid
+ * this, each thread can accumulate its updates in a private copy of the
+ * histograms, which are summed together when the simulation is complete. If
+ * there is not enough memory for the copies, each thread instead buffers its
+ * updates and flushes them to the shared histograms when the buffer is full.
+ * Repeated updates of the same bin, which are common since markers move only
+ * a little during a time step, are summed in the buffer so that each flush
+ * needs only one atomic update per distinct bin.
+ *
+ * The statistical error of a bin follows from the second moment of the
+ * contributions of individual markers, i.e. the sum over markers of the square
+ * of all that the marker added to the bin. Since a marker updates the same bin
+ * on many consecutive steps, its contributions are tallied per SIMD lane, in
+ * a table like the update buffer, and the squares are added when the marker
+ * finishes. A marker that visits more bins than the table holds has its tally
+ * squared and cleared when the table is full, which leaves out the products
+ * of contributions on either side of the flush and thus underestimates the
+ * second moment slightly.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <omp.h>
+#include "../ascot5.h"
+#include "dist_accum.h"
+
+#pragma omp declare target
+void dist_accum_flush(dist_accum_data* data, dist_accum_buffer* buffer);
+void dist_accum_put(dist_accum_data* data, real* bin, real weight);
+int dist_accum_buffer_add(dist_accum_buffer* buffer, size_t index,
+                          real weight);
+#pragma omp end declare target
+
+/**
+ * @brief Initializes histogram accumulation
+ *
+ * In automatic mode private copies are used if the copies for all threads fit
+ * in the given memory, and buffers are used otherwise. Updates are atomic if
+ * there is only a single thread since nothing would be gained.
+ *
+ * The private copies are allocated here but, being zero-initialized, their
+ * pages are in practice only mapped when the owning thread first writes to
+ * them. They are therefore placed close to the thread that uses them.
+ *
+ * If second moments are collected, they are stored right after the given
+ * region and each SIMD lane of each thread is given an empty tally.
+ *
+ * @param data pointer to accumulation data struct
+ * @param offload_data pointer to accumulation offload data struct
+ * @param histogram pointer to the start of the shared histogram region
+ * @param nbin number of bins in the distributions
+ */
+void dist_accum_init(dist_accum_data* data,
+                     dist_accum_offload_data* offload_data,
+                     real* histogram, size_t nbin) {
+    data->variance  = offload_data->variance && nbin > 0;
+    data->histogram = histogram;
+    data->nbin      = nbin;
+    data->length    = data->variance ? 2 * nbin : nbin;
+    data->nthread   = omp_get_max_threads();
+    data->copy      = NULL;
+    data->buffer    = NULL;
+    data->tally     = NULL;
+
+    size_t length = data->length;
+
+    data->mode = offload_data->mode;
+    if(length == 0) {
+        data->mode = DIST_ACCUM_ATOMIC;
+    }
+    else if(data->mode == DIST_ACCUM_AUTO) {
+        real mem = data->nthread * length * sizeof(real) / (1024.0 * 1024.0);
+        if(data->nthread == 1) {
+            data->mode = DIST_ACCUM_ATOMIC;
+        }
+        else if(mem <= offload_data->maxmem) {
+            data->mode = DIST_ACCUM_PRIVATE;
+        }
+        else {
+            data->mode = DIST_ACCUM_BUFFERED;
+        }
+    }
+
+    if(data->mode == DIST_ACCUM_PRIVATE) {
+        data->copy = malloc(data->nthread * sizeof(real*));
+        for(int t = 0; t < data->nthread; t++) {
+            data->copy[t] = calloc(length, sizeof(real));
+            if(data->copy[t] == NULL) {
+                /* Not enough memory after all, fall back to buffers */
+                for(int j = 0; j < t; j++) {
+                    free(data->copy[j]);
+                }
+                free(data->copy);
+                data->copy = NULL;
+                data->mode = DIST_ACCUM_BUFFERED;
+                break;
+            }
+        }
+    }
+
+    if(data->mode == DIST_ACCUM_BUFFERED) {
+        data->buffer = malloc(data->nthread * sizeof(dist_accum_buffer*));
+        for(int t = 0; t < data->nthread; t++) {
+            data->buffer[t] = malloc(sizeof(dist_accum_buffer));
+            data->buffer[t]->n = 0;
+            for(int i = 0; i < DIST_ACCUM_NSLOT; i++) {
+                data->buffer[t]->index[i] = SIZE_MAX;
+            }
+        }
+    }
+
+    if(data->variance) {
+        int ntally = data->nthread * NSIMD;
+        data->tally = malloc(ntally * sizeof(dist_accum_buffer*));
+        for(int j = 0; j < ntally; j++) {
+            data->tally[j] = malloc(sizeof(dist_accum_buffer));
+            data->tally[j]->n = 0;
+            for(int i = 0; i < DIST_ACCUM_NSLOT; i++) {
+                data->tally[j]->index[i] = SIZE_MAX;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Add the accumulated updates to the histograms and free the data
+ *
+ * Tallies of markers that have not finished are added as they are.
+ *
+ * @param data pointer to accumulation data struct
+ */
+void dist_accum_free(dist_accum_data* data) {
+    if(data->variance) {
+        for(int t = 0; t < data->nthread; t++) {
+            for(int i = 0; i < NSIMD; i++) {
+                dist_accum_buffer* tally = data->tally[t*NSIMD + i];
+                for(int j = 0; j < DIST_ACCUM_NSLOT; j++) {
+                    if(tally->index[j] != SIZE_MAX) {
+                        real* bin = &data->histogram[data->nbin
+                                                     + tally->index[j]];
+                        *bin += tally->weight[j] * tally->weight[j];
+                    }
+                }
+                free(tally);
+            }
+        }
+        free(data->tally);
+        data->tally = NULL;
+    }
+
+    dist_accum_reduce(data);
+
+    if(data->mode == DIST_ACCUM_PRIVATE) {
+        for(int t = 0; t < data->nthread; t++) {
+            free(data->copy[t]);
+        }
+        free(data->copy);
+        data->copy = NULL;
+    }
+
+    if(data->mode == DIST_ACCUM_BUFFERED) {
+        for(int t = 0; t < data->nthread; t++) {
+            free(data->buffer[t]);
+        }
+        free(data->buffer);
+        data->buffer = NULL;
+    }
+}
+
+/**
+ * @brief Add the accumulated updates to the histograms
+ *
+ * Private copies are summed in parallel over the histogram bins and cleared,
+ * and buffers are flushed, so that the shared histograms are up to date and
+ * the accumulation can continue. This must not be called while markers are
+ * being simulated.
+ *
+ * @param data pointer to accumulation data struct
+ */
+void dist_accum_reduce(dist_accum_data* data) {
+    if(data->mode == DIST_ACCUM_PRIVATE) {
+        real* histogram = data->histogram;
+        real** copy = data->copy;
+        int nthread = data->nthread;
+        #pragma omp parallel for
+        for(size_t j = 0; j < data->length; j++) {
+            real sum = 0;
+            for(int t = 0; t < nthread; t++) {
+                sum += copy[t][j];
+                copy[t][j] = 0;
+            }
+            histogram[j] += sum;
+        }
+    }
+
+    if(data->mode == DIST_ACCUM_BUFFERED) {
+        for(int t = 0; t < data->nthread; t++) {
+            dist_accum_flush(data, data->buffer[t]);
+        }
+    }
+}
+
+/**
+ * @brief Add weight to a histogram bin
+ *
+ * If second moments are collected, the weight is also tallied for the marker
+ * in the given SIMD lane. Threads that have no tallies add the square of the
+ * weight directly.
+ *
+ * @param data pointer to accumulation data struct
+ * @param i index of the marker in the SIMD array
+ * @param bin pointer to the bin in the shared histogram region
+ * @param weight weight to be added
+ */
+void dist_accum_add(dist_accum_data* data, int i, real* bin, real weight) {
+    dist_accum_put(data, bin, weight);
+
+    if(data->variance) {
+        int t = omp_get_thread_num();
+        if(t < data->nthread) {
+            dist_accum_buffer* tally = data->tally[t*NSIMD + i];
+            if(dist_accum_buffer_add(tally, bin - data->histogram, weight)) {
+                dist_accum_finish(data, i);
+            }
+        }
+        else {
+            dist_accum_put(data, bin + data->nbin, weight * weight);
+        }
+    }
+}
+
+/**
+ * @brief Add the squared tally of a marker to the second moments
+ *
+ * This is called when the marker in the given SIMD lane finishes, and the
+ * tally is cleared for the next marker.
+ *
+ * @param data pointer to accumulation data struct
+ * @param i index of the marker in the SIMD array
+ */
+void dist_accum_finish(dist_accum_data* data, int i) {
+    int t = omp_get_thread_num();
+    if(!data->variance || t >= data->nthread) {
+        return;
+    }
+
+    dist_accum_buffer* tally = data->tally[t*NSIMD + i];
+    if(tally->n == 0) {
+        return;
+    }
+    for(int j = 0; j < DIST_ACCUM_NSLOT; j++) {
+        if(tally->index[j] != SIZE_MAX) {
+            dist_accum_put(data, &data->histogram[data->nbin + tally->index[j]],
+                           tally->weight[j] * tally->weight[j]);
+            tally->index[j] = SIZE_MAX;
+        }
+    }
+    tally->n = 0;
+}
+
+/**
+ * @brief Add weight to a bin in the accumulated region
+ *
+ * Threads that have no private data, e.g. because the team is larger than
+ * expected, update the shared histogram atomically.
+ *
+ * @param data pointer to accumulation data struct
+ * @param bin pointer to the bin in the shared histogram region
+ * @param weight weight to be added
+ */
+void dist_accum_put(dist_accum_data* data, real* bin, real weight) {
+    int t = omp_get_thread_num();
+    if(data->mode == DIST_ACCUM_PRIVATE && t < data->nthread) {
+        data->copy[t][bin - data->histogram] += weight;
+    }
+    else if(data->mode == DIST_ACCUM_BUFFERED && t < data->nthread) {
+        dist_accum_buffer* buffer = data->buffer[t];
+        if(dist_accum_buffer_add(buffer, bin - data->histogram, weight)) {
+            dist_accum_flush(data, buffer);
+        }
+    }
+    else {
+        #pragma omp atomic
+        *bin += weight;
+    }
+}
+
+/**
+ * @brief Add weight to a bin in a buffer
+ *
+ * @param buffer pointer to the buffer
+ * @param index index of the bin relative to the start of the region
+ * @param weight weight to be added
+ *
+ * @return one if the buffer is full and must be flushed, zero otherwise
+ */
+int dist_accum_buffer_add(dist_accum_buffer* buffer, size_t index,
+                          real weight) {
+    int slot = index & (DIST_ACCUM_NSLOT - 1);
+    while(buffer->index[slot] != index && buffer->index[slot] != SIZE_MAX) {
+        slot = (slot + 1) & (DIST_ACCUM_NSLOT - 1);
+    }
+    if(buffer->index[slot] == index) {
+        buffer->weight[slot] += weight;
+        return 0;
+    }
+    buffer->index[slot]  = index;
+    buffer->weight[slot] = weight;
+    buffer->n++;
+    return buffer->n == DIST_ACCUM_NBUFFER;
+}
+
+/**
+ * @brief Flush buffered updates to the shared histograms
+ *
+ * @param data pointer to accumulation data struct
+ * @param buffer pointer to the buffer to be flushed
+ */
+void dist_accum_flush(dist_accum_data* data, dist_accum_buffer* buffer) {
+    for(int i = 0; i < DIST_ACCUM_NSLOT; i++) {
+        if(buffer->index[i] != SIZE_MAX) {
+            #pragma omp atomic
+            data->histogram[buffer->index[i]] += buffer->weight[i];
+            buffer->index[i] = SIZE_MAX;
+        }
+    }
+    buffer->n = 0;
+}
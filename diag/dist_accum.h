@@ -0,0 +1,88 @@
+/**
+ * @file dist_accum.h
+ * @brief Header file for dist_accum.c
+ */
+#ifndef DIST_ACCUM_H
+#define DIST_ACCUM_H
+
+#include <stddef.h>
+#include "../ascot5.h"
+
+/**
+ * @brief Number of distinct bins a thread buffers before flushing them
+ */
+#define DIST_ACCUM_NBUFFER 1024
+
+/**
+ * @brief Number of slots in the buffer, a power of two
+ */
+#define DIST_ACCUM_NSLOT 2048
+
+/**
+ * @brief How histogram updates are accumulated
+ */
+typedef enum dist_accum_mode {
+    DIST_ACCUM_ATOMIC   = 0, /**< Atomic updates of the shared histograms   */
+    DIST_ACCUM_AUTO     = 1, /**< Private copies if they fit, else buffered */
+    DIST_ACCUM_BUFFERED = 2, /**< Buffered updates flushed in blocks        */
+    DIST_ACCUM_PRIVATE  = 3  /**< Thread-private copies of the histograms   */
+} dist_accum_mode;
+
+/**
+ * @brief Buffer of histogram updates made by a single thread
+ *
+ * The buffer is a hash table keyed by the bin index so that repeated updates
+ * of the same bin are summed in the buffer.
+ */
+typedef struct {
+    int n;                          /**< Number of occupied slots             */
+    size_t index[DIST_ACCUM_NSLOT]; /**< Bin index relative to the start of
+                                         the region, SIZE_MAX if empty        */
+    real weight[DIST_ACCUM_NSLOT];  /**< Weight accumulated to the bin        */
+} dist_accum_buffer;
+
+/**
+ * @brief Histogram accumulation offload data
+ */
+typedef struct {
+    int mode;     /**< Requested mode, see dist_accum_mode                    */
+    real maxmem;  /**< Memory allowed for thread-private copies [MB]          */
+    int variance; /**< Are second moments of the marker contributions
+                       collected                                              */
+} dist_accum_offload_data;
+
+/**
+ * @brief Histogram accumulation data
+ *
+ * All distributions lie in a single contiguous region of the diagnostics
+ * array. The updates to that region are accumulated either directly with
+ * atomics, in thread-private copies of the region, or in thread buffers.
+ *
+ * If second moments are collected, they lie in the region right after the
+ * distributions, and the contributions of the marker in each SIMD lane are
+ * tallied until the marker finishes.
+ */
+typedef struct {
+    int mode;                   /**< Mode that is in use                      */
+    int variance;               /**< Are second moments collected             */
+    int nthread;                /**< Number of threads that have private data */
+    size_t nbin;                /**< Number of bins in the distributions      */
+    size_t length;              /**< Length of the histogram region           */
+    real* histogram;            /**< Start of the shared histogram region     */
+    real** copy;                /**< Private copy of the region per thread    */
+    dist_accum_buffer** buffer; /**< Buffer of updates per thread             */
+    dist_accum_buffer** tally;  /**< Contributions of the current marker per
+                                     SIMD lane of each thread                 */
+} dist_accum_data;
+
+#pragma omp declare target
+void dist_accum_init(dist_accum_data* data,
+                     dist_accum_offload_data* offload_data,
+                     real* histogram, size_t nbin);
+void dist_accum_free(dist_accum_data* data);
+void dist_accum_reduce(dist_accum_data* data);
+void dist_accum_add(dist_accum_data* data, int i, real* bin, real weight);
+void dist_accum_finish(dist_accum_data* data, int i);
+#pragma omp end declare target
+
+#endif
@@ -67,7 +67,8 @@ void dist_COM_init(dist_COM_data* dist_data,
 /**
  * @brief Update the histogram from full-orbit markers
  */
-void dist_COM_update_fo(dist_COM_data* dist, B_field_data* Bdata,
+void dist_COM_update_fo(dist_COM_data* dist, dist_accum_data* acc,
+                        B_field_data* Bdata,
                         particle_simd_fo* p_f, particle_simd_fo* p_i) {
     real Ekin;
     real Ptor;
@@ -130,8 +131,7 @@ void dist_COM_update_fo(dist_COM_data* dist, B_field_data* Bdata,
                                                 dist->n_mu,  dist->n_Ekin,
                                                 dist->n_Ptor);
 
-            #pragma omp atomic
-            dist->histogram[index] += weight[i];
+            dist_accum_add(acc, i, &dist->histogram[index], weight[i]);
         }
     }
 }
@@ -140,14 +140,16 @@ void dist_COM_update_fo(dist_COM_data* dist, B_field_data* Bdata,
  * @brief Update the histogram from guiding center markers
  *
  * This function updates the histogram from the marker data. Bins are
- * calculated as vector op and histogram is updates as an atomic operation to
+ * calculated as vector op and the histogram is updated via dist_accum_add() to
  * avoid race conditions.
  *
  * @param dist pointer to distribution parameter struct
+ * @param acc pointer to histogram accumulation data
  * @param p_f pointer to SIMD gc struct at the end of current time step
  * @param p_i pointer to SIMD gc struct at the start of current time step
  */
-void dist_COM_update_gc(dist_COM_data* dist, B_field_data* Bdata,
+void dist_COM_update_gc(dist_COM_data* dist, dist_accum_data* acc,
+                        B_field_data* Bdata,
                         particle_simd_gc* p_f, particle_simd_gc* p_i) {
     real Ekin;
     real Ptor;
@@ -199,8 +201,7 @@ void dist_COM_update_gc(dist_COM_data* dist, B_field_data* Bdata,
                                                 dist->n_mu,  dist->n_Ekin,
                                                 dist->n_Ptor);
 
-            #pragma omp atomic
-            dist->histogram[index] += weight[i];
+            dist_accum_add(acc, i, &dist->histogram[index], weight[i]);
         }
     }
 }
@@ -7,6 +7,7 @@
 
 #include "../ascot5.h"
 #include "../particle.h"
+#include "dist_accum.h"
 #include "../B_field.h"
 
 /**
@@ -49,9 +50,11 @@ typedef struct {
 void dist_COM_init(dist_COM_data* dist_data,
                    dist_COM_offload_data* offload_data,
                    real* offload_array);
-void dist_COM_update_fo(dist_COM_data* dist, B_field_data*Bdata,
+void dist_COM_update_fo(dist_COM_data* dist, dist_accum_data* acc,
+                        B_field_data* Bdata,
                         particle_simd_fo* p_f, particle_simd_fo* p_i);
-void dist_COM_update_gc(dist_COM_data* dist, B_field_data* Bdata,
+void dist_COM_update_gc(dist_COM_data* dist, dist_accum_data* acc,
+                        B_field_data* Bdata,
                         particle_simd_gc* p_f, particle_simd_gc* p_i);
 #pragma omp end declare target
 
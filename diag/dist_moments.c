@@ -0,0 +1,222 @@
+/**
+ * @file dist_moments.c
+ * @brief Radial profiles of distribution moments
+ *
+ * Instead of recording the full distribution and integrating it over the
+ * momentum space afterwards, the moments are accumulated directly as the
+ * markers are simulated. Each time step adds weight * dt times the moment
+ * quantity to the (rho, theta, time) bin where the marker is at the end of
+ * the step, i.e. the histogram is normalized as the rho distributions, and
+ * dividing it by the bin volume gives the moment as a density.
+ *
+ * The power deposition is the kinetic energy the markers lose during the time
+ * step times their weight. In the absence of electric fields this equals the
+ * power transferred to the plasma by collisions.
+ *
+ * Unlike the distributions, the moments include the time step during which
+ * the marker met an end condition, so that all of the energy it lost is
+ * accounted for. Steps that ended in an error are not recorded.
+ *
+ * The histogram lies in the distribution part of the diagnostics array and is
+ * updated via dist_accum_add() like the distributions.
+ */
+#include <math.h>
+#include "../ascot5.h"
+#include "../consts.h"
+#include "../math.h"
+#include "../physlib.h"
+#include "../particle.h"
+#include "dist_moments.h"
+
+#pragma omp declare target
+#pragma omp declare simd uniform(dist)
+int dist_moments_index(dist_moments_data* dist, real rho, real theta,
+                       real time);
+#pragma omp end declare target
+
+/**
+ * @brief Initializes moment histogram from offload data
+ *
+ * @param dist_data pointer to moment histogram data struct
+ * @param offload_data pointer to moment histogram offload data struct
+ * @param offload_array offload array
+ */
+void dist_moments_init(dist_moments_data* dist_data,
+                       dist_moments_offload_data* offload_data,
+                       real* offload_array) {
+    dist_data->n_rho     = offload_data->n_rho;
+    dist_data->min_rho   = offload_data->min_rho;
+    dist_data->max_rho   = offload_data->max_rho;
+
+    dist_data->n_theta   = offload_data->n_theta;
+    dist_data->min_theta = offload_data->min_theta;
+    dist_data->max_theta = offload_data->max_theta;
+
+    dist_data->n_time    = offload_data->n_time;
+    dist_data->min_time  = offload_data->min_time;
+    dist_data->max_time  = offload_data->max_time;
+
+    dist_data->histogram = &offload_array[0];
+}
+
+/**
+ * @brief Update the moments from full-orbit particles
+ *
+ * The moments are calculated as vector op and the histogram is updated via
+ * dist_accum_add() to avoid race conditions.
+ *
+ * @param dist pointer to moment histogram data struct
+ * @param acc pointer to histogram accumulation data
+ * @param p_f pointer to SIMD particle struct at the end of current time step
+ * @param p_i pointer to SIMD particle struct at the start of current time step
+ */
+void dist_moments_update_fo(dist_moments_data* dist, dist_accum_data* acc,
+                            particle_simd_fo* p_f, particle_simd_fo* p_i) {
+    int index[NSIMD];
+    real moment[DIST_MOMENTS_N][NSIMD];
+
+    #pragma omp simd
+    for(int i = 0; i < NSIMD; i++) {
+        index[i] = -1;
+        if(p_i->running[i] && !p_f->err[i]) {
+            index[i] = dist_moments_index(dist, p_f->rho[i], p_f->theta[i],
+                                          p_f->time[i]);
+
+            real mass  = p_f->mass[i];
+            real Bnorm = math_normc(p_f->B_r[i], p_f->B_phi[i], p_f->B_z[i]);
+            real pnorm = math_normc(p_f->p_r[i], p_f->p_phi[i], p_f->p_z[i]);
+            real ppar  = (  p_f->p_r[i]   * p_f->B_r[i]
+                          + p_f->p_phi[i] * p_f->B_phi[i]
+                          + p_f->p_z[i]   * p_f->B_z[i] ) / Bnorm;
+            real gamma = physlib_gamma_pnorm(mass, pnorm);
+            real ekin  = physlib_Ekin_pnorm(mass, pnorm);
+
+            real pnorm_i = math_normc(p_i->p_r[i], p_i->p_phi[i],
+                                      p_i->p_z[i]);
+            real ekin_i  = physlib_Ekin_pnorm(mass, pnorm_i);
+
+            real w = p_f->weight[i] * (p_f->time[i] - p_i->time[i]);
+            moment[DIST_MOMENTS_DENSITY][i]         = w;
+            moment[DIST_MOMENTS_CHARGEDENSITY][i]   = w * p_f->charge[i];
+            moment[DIST_MOMENTS_ENERGYDENSITY][i]   = w * ekin;
+            moment[DIST_MOMENTS_PRESSURE][i]        =
+                w * pnorm * pnorm / ( 3 * gamma * mass );
+            moment[DIST_MOMENTS_PARALLELCURRENT][i] =
+                w * p_f->charge[i] * ppar / ( gamma * mass );
+            moment[DIST_MOMENTS_TOROIDALCURRENT][i] =
+                w * p_f->charge[i] * p_f->p_phi[i] / ( gamma * mass );
+            moment[DIST_MOMENTS_POWERDEP][i]        =
+                p_f->weight[i] * (ekin_i - ekin);
+        }
+    }
+
+    int n = dist->n_rho * dist->n_theta * dist->n_time;
+    for(int i = 0; i < NSIMD; i++) {
+        if(index[i] >= 0) {
+            for(int j = 0; j < DIST_MOMENTS_N; j++) {
+                dist_accum_add(acc, i, &dist->histogram[j*n + index[i]],
+                               moment[j][i]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Update the moments from guiding center markers
+ *
+ * The moments are calculated as vector op and the histogram is updated via
+ * dist_accum_add() to avoid race conditions. The toroidal current is that of
+ * the parallel motion, i.e. drifts are neglected.
+ *
+ * @param dist pointer to moment histogram data struct
+ * @param acc pointer to histogram accumulation data
+ * @param p_f pointer to SIMD gc struct at the end of current time step
+ * @param p_i pointer to SIMD gc struct at the start of current time step
+ */
+void dist_moments_update_gc(dist_moments_data* dist, dist_accum_data* acc,
+                            particle_simd_gc* p_f, particle_simd_gc* p_i) {
+    int index[NSIMD];
+    real moment[DIST_MOMENTS_N][NSIMD];
+
+    #pragma omp simd
+    for(int i = 0; i < NSIMD; i++) {
+        index[i] = -1;
+        if(p_i->running[i] && !p_f->err[i]) {
+            index[i] = dist_moments_index(dist, p_f->rho[i], p_f->theta[i],
+                                          p_f->time[i]);
+
+            real mass  = p_f->mass[i];
+            real mu    = p_f->mu[i];
+            real ppar  = p_f->ppar[i];
+            real Bnorm = math_normc(p_f->B_r[i], p_f->B_phi[i], p_f->B_z[i]);
+            real gamma = physlib_gamma_ppar(mass, mu, ppar, Bnorm);
+            real ekin  = physlib_Ekin_ppar(mass, mu, ppar, Bnorm);
+            real pnorm = physlib_gc_p(mass, mu, ppar, Bnorm);
+
+            real mu_i    = p_i->mu[i];
+            real ppar_i  = p_i->ppar[i];
+            real Bnorm_i = math_normc(p_i->B_r[i], p_i->B_phi[i],
+                                      p_i->B_z[i]);
+            real ekin_i  = physlib_Ekin_ppar(mass, mu_i, ppar_i, Bnorm_i);
+
+            real vpar = ppar / ( gamma * mass );
+            real w = p_f->weight[i] * (p_f->time[i] - p_i->time[i]);
+            moment[DIST_MOMENTS_DENSITY][i]         = w;
+            moment[DIST_MOMENTS_CHARGEDENSITY][i]   = w * p_f->charge[i];
+            moment[DIST_MOMENTS_ENERGYDENSITY][i]   = w * ekin;
+            moment[DIST_MOMENTS_PRESSURE][i]        =
+                w * pnorm * pnorm / ( 3 * gamma * mass );
+            moment[DIST_MOMENTS_PARALLELCURRENT][i] =
+                w * p_f->charge[i] * vpar;
+            moment[DIST_MOMENTS_TOROIDALCURRENT][i] =
+                w * p_f->charge[i] * vpar * p_f->B_phi[i] / Bnorm;
+            moment[DIST_MOMENTS_POWERDEP][i]        =
+                p_f->weight[i] * (ekin_i - ekin);
+        }
+    }
+
+    int n = dist->n_rho * dist->n_theta * dist->n_time;
+    for(int i = 0; i < NSIMD; i++) {
+        if(index[i] >= 0) {
+            for(int j = 0; j < DIST_MOMENTS_N; j++) {
+                dist_accum_add(acc, i, &dist->histogram[j*n + index[i]],
+                               moment[j][i]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Find the bin where the marker is
+ *
+ * The histogram is stored as moment x rho x theta x time.
+ *
+ * @param dist pointer to moment histogram data struct
+ * @param rho normalized poloidal flux coordinate
+ * @param theta poloidal angle [rad]
+ * @param time time [s]
+ *
+ * @return index of the bin within the moment, or -1 if outside the histogram
+ */
+int dist_moments_index(dist_moments_data* dist, real rho, real theta,
+                       real time) {
+    theta = fmod(theta, 2*CONST_PI);
+    if(theta < 0) {
+        theta = theta + 2*CONST_PI;
+    }
+
+    int i_rho   = floor((rho - dist->min_rho)
+                        / ((dist->max_rho - dist->min_rho) / dist->n_rho));
+    int i_theta = floor((theta - dist->min_theta)
+                        / ((dist->max_theta - dist->min_theta)
+                           / dist->n_theta));
+    int i_time  = floor((time - dist->min_time)
+                        / ((dist->max_time - dist->min_time) / dist->n_time));
+
+    if(i_rho   >= 0 && i_rho   <= dist->n_rho - 1   &&
+       i_theta >= 0 && i_theta <= dist->n_theta - 1 &&
+       i_time  >= 0 && i_time  <= dist->n_time - 1) {
+        return ( i_rho * dist->n_theta + i_theta ) * dist->n_time + i_time;
+    }
+    return -1;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file dist_moments.h
+ * @brief Header file for dist_moments.c
+ */
+#ifndef DIST_MOMENTS_H
+#define DIST_MOMENTS_H
+
+#include "../ascot5.h"
+#include "../particle.h"
+#include "dist_accum.h"
+
+/**
+ * @brief Number of moments that are collected
+ */
+#define DIST_MOMENTS_N 7
+
+/**
+ * @brief Moments that are collected and their order in the histogram
+ */
+typedef enum dist_moments_moment {
+    DIST_MOMENTS_DENSITY         = 0, /**< Number of particles [1]            */
+    DIST_MOMENTS_CHARGEDENSITY   = 1, /**< Charge [C]                         */
+    DIST_MOMENTS_ENERGYDENSITY   = 2, /**< Kinetic energy [J]                 */
+    DIST_MOMENTS_PRESSURE        = 3, /**< Pressure times volume [J]          */
+    DIST_MOMENTS_PARALLELCURRENT = 4, /**< Parallel current times length [Am] */
+    DIST_MOMENTS_TOROIDALCURRENT = 5, /**< Toroidal current times length [Am] */
+    DIST_MOMENTS_POWERDEP        = 6  /**< Power lost by the markers [W]      */
+} dist_moments_moment;
+
+/**
+ * @brief Moment histogram parameters that will be offloaded to target
+ */
+typedef struct {
+    int n_rho;        /**< number of rho bins                   */
+    real min_rho;     /**< value of lowest rho bin              */
+    real max_rho;     /**< value of highest rho bin             */
+
+    int n_theta;      /**< number of poloidal angle bins        */
+    real min_theta;   /**< value of lowest pol bin              */
+    real max_theta;   /**< value of highest pol bin             */
+
+    int n_time;       /**< number of time bins                  */
+    real min_time;    /**< value of lowest time bin             */
+    real max_time;    /**< value of highest time bin            */
+} dist_moments_offload_data;
+
+/**
+ * @brief Moment histogram parameters on target
+ */
+typedef struct {
+    int n_rho;        /**< number of rho bins                   */
+    real min_rho;     /**< value of lowest rho bin              */
+    real max_rho;     /**< value of highest rho bin             */
+
+    int n_theta;      /**< number of poloidal angle bins        */
+    real min_theta;   /**< value of lowest pol bin              */
+    real max_theta;   /**< value of highest pol bin             */
+
+    int n_time;       /**< number of time bins                  */
+    real min_time;    /**< value of lowest time bin             */
+    real max_time;    /**< value of highest time bin            */
+
+    real* histogram;  /**< pointer to start of histogram array */
+} dist_moments_data;
+
+#pragma omp declare target
+void dist_moments_init(dist_moments_data* dist_data,
+                       dist_moments_offload_data* offload_data,
+                       real* offload_array);
+void dist_moments_update_fo(dist_moments_data* dist, dist_accum_data* acc,
+                            particle_simd_fo* p_f, particle_simd_fo* p_i);
+void dist_moments_update_gc(dist_moments_data* dist, dist_accum_data* acc,
+                            particle_simd_gc* p_f, particle_simd_gc* p_i);
+#pragma omp end declare target
+
+#endif
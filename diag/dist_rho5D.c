@@ -98,15 +98,16 @@ void dist_rho5D_init(dist_rho5D_data* dist_data,
  * @brief Update the histogram from full-orbit particles
  *
  * This function updates the histogram from the particle data. Bins are
- * calculated as vector op and histogram is updates as an atomic operation to
+ * calculated as vector op and the histogram is updated via dist_accum_add() to
  * avoid race conditions.
  *
  * @param dist pointer to distribution parameter struct
+ * @param acc pointer to histogram accumulation data
  * @param p_f pointer to SIMD particle struct at the end of current time step
  * @param p_i pointer to SIMD particle struct at the start of current time step
  */
-void dist_rho5D_update_fo(dist_rho5D_data* dist, particle_simd_fo* p_f,
-                          particle_simd_fo* p_i) {
+void dist_rho5D_update_fo(dist_rho5D_data* dist, dist_accum_data* acc,
+                          particle_simd_fo* p_f, particle_simd_fo* p_i) {
     real phi[NSIMD];
     real theta[NSIMD];
     real ppara[NSIMD];
@@ -196,8 +197,7 @@ void dist_rho5D_update_fo(dist_rho5D_data* dist, particle_simd_fo* p_f,
                                                    dist->n_theta, dist->n_phi,
                                                    dist->n_ppara, dist->n_pperp,
                                                    dist->n_time, dist->n_q);
-            #pragma omp atomic
-            dist->histogram[index] += weight[i];
+            dist_accum_add(acc, i, &dist->histogram[index], weight[i]);
         }
     }
 }
@@ -206,15 +206,16 @@ void dist_rho5D_update_fo(dist_rho5D_data* dist, particle_simd_fo* p_f,
  * @brief Update the histogram from guiding center markers
  *
  * This function updates the histogram from the marker data. Bins are
- * calculated as vector op and histogram is updates as an atomic operation to
+ * calculated as vector op and the histogram is updated via dist_accum_add() to
  * avoid race conditions.
  *
  * @param dist pointer to distribution parameter struct
+ * @param acc pointer to histogram accumulation data
  * @param p_f pointer to SIMD gc struct at the end of current time step
  * @param p_i pointer to SIMD gc struct at the start of current time step
  */
-void dist_rho5D_update_gc(dist_rho5D_data* dist, particle_simd_gc* p_f,
-                          particle_simd_gc* p_i) {
+void dist_rho5D_update_gc(dist_rho5D_data* dist, dist_accum_data* acc,
+                          particle_simd_gc* p_f, particle_simd_gc* p_i) {
     real phi[NSIMD];
     real theta[NSIMD];
     real pperp[NSIMD];
@@ -295,8 +296,7 @@ void dist_rho5D_update_gc(dist_rho5D_data* dist, particle_simd_gc* p_f,
                                                    dist->n_ppara, dist->n_pperp,
                                                    dist->n_time, dist->n_q);
 
-            #pragma omp atomic
-            dist->histogram[index] += weight[i];
+            dist_accum_add(acc, i, &dist->histogram[index], weight[i]);
         }
     }
 }
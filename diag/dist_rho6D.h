@@ -7,6 +7,8 @@
 
 #include "../ascot5.h"
 #include "../particle.h"
+#include "dist_accum.h"
+#include "dist_sparse.h"
 
 /**
  * @brief Histogram parameters that will be offloaded to target
@@ -43,6 +45,8 @@ typedef struct {
     int n_q;          /**< number of charge bins         */
     real min_q;       /**< value of lowest charge bin    */
     real max_q;       /**< value of highest charge bin   */
+
+    dist_sparse sparse; /**< sparse histogram, page is NULL if dense */
 } dist_rho6D_offload_data;
 
 /**
@@ -82,15 +86,16 @@ typedef struct {
     real max_q;       /**< value of highest charge bin   */
 
     real* histogram;  /**< pointer to start of histogram array */
+    dist_sparse sparse; /**< sparse histogram, page is NULL if dense */
 } dist_rho6D_data;
 
 #pragma omp declare target
 void dist_rho6D_init(dist_rho6D_data* dist_data, dist_rho6D_offload_data* offload_data,
                      real* offload_array);
-void dist_rho6D_update_fo(dist_rho6D_data* dist, particle_simd_fo* p_f,
-                          particle_simd_fo* p_i);
-void dist_rho6D_update_gc(dist_rho6D_data* dist, particle_simd_gc* p_f,
-                          particle_simd_gc* p_i);
+void dist_rho6D_update_fo(dist_rho6D_data* dist, dist_accum_data* acc,
+                          particle_simd_fo* p_f, particle_simd_fo* p_i);
+void dist_rho6D_update_gc(dist_rho6D_data* dist, dist_accum_data* acc,
+                          particle_simd_gc* p_f, particle_simd_gc* p_i);
 #pragma omp end declare target
 
 #endif
@@ -0,0 +1,200 @@
+/**
+ * @file dist_sparse.c
+ * @brief Sparse storage of distribution histograms.
+ *
+ * High-dimensional distributions have far more bins than markers ever visit,
+ * so storing them densely wastes memory and limits the resolution. Here the
+ * histogram is divided into tiles that each hold the bins of one cell in the
+ * leading dimensions, and a tile is allocated only when a marker first adds
+ * weight to it.
+ *
+ * The tile size is chosen as the product of as many trailing dimensions as
+ * fit in DIST_SPARSE_MAXTILE bins, so each tile is a contiguous block of the
+ * corresponding dense histogram and can be written as a part of the dense
+ * dataset. Small tiles waste little memory on bins that are never visited,
+ * but there are many of them, so the table of tiles is itself divided into
+ * pages that are allocated only when needed.
+ */
+#include <stdlib.h>
+#include "../ascot5.h"
+#include "dist_sparse.h"
+
+/**
+ * @brief Initializes a sparse histogram with no tiles allocated
+ *
+ * @param hist pointer to sparse histogram
+ * @param ndim number of dimensions
+ * @param nbin number of bins in each dimension, the last one varies fastest
+ *
+ * @return zero if initialization succeeded
+ */
+int dist_sparse_init(dist_sparse* hist, int ndim, int* nbin) {
+    hist->length = 1;
+    for(int i = 0; i < ndim; i++) {
+        hist->length *= nbin[i];
+    }
+
+    /* Cover the trailing dimensions in a tile while they fit */
+    hist->tilesize = nbin[ndim-1];
+    for(int i = ndim - 2; i >= 0; i--) {
+        if(hist->tilesize * nbin[i] > DIST_SPARSE_MAXTILE) {
+            break;
+        }
+        hist->tilesize *= nbin[i];
+    }
+
+    hist->ntile = hist->length / hist->tilesize;
+    hist->npage = ( hist->ntile + DIST_SPARSE_NPAGE - 1 ) / DIST_SPARSE_NPAGE;
+    hist->page  = calloc(hist->npage, sizeof(real**));
+    if(hist->page == NULL) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Free the tiles of a sparse histogram
+ *
+ * @param hist pointer to sparse histogram
+ */
+void dist_sparse_free(dist_sparse* hist) {
+    if(hist->page == NULL) {
+        return;
+    }
+    for(size_t i = 0; i < hist->npage; i++) {
+        if(hist->page[i] != NULL) {
+            for(int j = 0; j < DIST_SPARSE_NPAGE; j++) {
+                free(hist->page[i][j]);
+            }
+            free(hist->page[i]);
+        }
+    }
+    free(hist->page);
+    hist->page = NULL;
+}
+
+/**
+ * @brief Count the tiles that have been allocated
+ *
+ * @param hist pointer to sparse histogram
+ *
+ * @return number of allocated tiles
+ */
+size_t dist_sparse_count(dist_sparse* hist) {
+    size_t n = 0;
+    for(size_t i = 0; i < hist->npage; i++) {
+        if(hist->page[i] != NULL) {
+            for(int j = 0; j < DIST_SPARSE_NPAGE; j++) {
+                n += hist->page[i][j] != NULL;
+            }
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Multiply all bins of a sparse histogram
+ *
+ * @param hist pointer to sparse histogram
+ * @param factor factor the bins are multiplied with
+ */
+void dist_sparse_scale(dist_sparse* hist, real factor) {
+    if(hist->page == NULL) {
+        return;
+    }
+    for(size_t i = 0; i < hist->npage; i++) {
+        if(hist->page[i] != NULL) {
+            for(int j = 0; j < DIST_SPARSE_NPAGE; j++) {
+                real* tile = hist->page[i][j];
+                if(tile != NULL) {
+                    for(size_t k = 0; k < hist->tilesize; k++) {
+                        tile[k] *= factor;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Find a tile without allocating it
+ *
+ * @param hist pointer to sparse histogram
+ * @param itile index of the tile
+ *
+ * @return pointer to the tile or NULL if it has not been allocated
+ */
+real* dist_sparse_find_tile(dist_sparse* hist, size_t itile) {
+    real** page = hist->page[itile / DIST_SPARSE_NPAGE];
+    if(page == NULL) {
+        return NULL;
+    }
+    return page[itile % DIST_SPARSE_NPAGE];
+}
+
+/**
+ * @brief Get a tile, allocating it if this is the first access
+ *
+ * Pages and tiles are allocated inside a critical region, and the checks
+ * before it keep the common case of an existing tile free of
+ * synchronization.
+ *
+ * @param hist pointer to sparse histogram
+ * @param itile index of the tile
+ *
+ * @return pointer to the tile or NULL if it could not be allocated
+ */
+real* dist_sparse_get_tile(dist_sparse* hist, size_t itile) {
+    size_t ipage = itile / DIST_SPARSE_NPAGE;
+    real** page;
+    #pragma omp atomic read
+    page = hist->page[ipage];
+
+    if(page == NULL) {
+        #pragma omp critical(dist_sparse_alloc)
+        {
+            page = hist->page[ipage];
+            if(page == NULL) {
+                page = calloc(DIST_SPARSE_NPAGE, sizeof(real*));
+                #pragma omp atomic write
+                hist->page[ipage] = page;
+            }
+        }
+        if(page == NULL) {
+            return NULL;
+        }
+    }
+
+    size_t islot = itile % DIST_SPARSE_NPAGE;
+    real* tile;
+    #pragma omp atomic read
+    tile = page[islot];
+
+    if(tile == NULL) {
+        #pragma omp critical(dist_sparse_alloc)
+        {
+            tile = page[islot];
+            if(tile == NULL) {
+                tile = calloc(hist->tilesize, sizeof(real));
+                #pragma omp atomic write
+                page[islot] = tile;
+            }
+        }
+    }
+    return tile;
+}
+
+/**
+ * @brief Add weight to a bin of a sparse histogram
+ *
+ * @param hist pointer to sparse histogram
+ * @param index index of the bin in the corresponding dense histogram
+ * @param weight weight to be added
+ */
+void dist_sparse_add(dist_sparse* hist, size_t index, real weight) {
+    real* tile = dist_sparse_get_tile(hist, index / hist->tilesize);
+    if(tile != NULL) {
+        #pragma omp atomic
+        tile[index % hist->tilesize] += weight;
+    }
+}
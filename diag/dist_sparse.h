@@ -0,0 +1,47 @@
+/**
+ * @file dist_sparse.h
+ * @brief Header file for dist_sparse.c
+ */
+#ifndef DIST_SPARSE_H
+#define DIST_SPARSE_H
+
+#include <stddef.h>
+#include "../ascot5.h"
+
+/**
+ * @brief Maximum number of bins in a tile
+ */
+#define DIST_SPARSE_MAXTILE 1024
+
+/**
+ * @brief Number of tiles in a page of the tile table
+ */
+#define DIST_SPARSE_NPAGE 1024
+
+/**
+ * @brief Histogram stored as tiles that are allocated when first updated
+ *
+ * The bins are ordered as in a dense histogram, and a tile consists of the
+ * bins that differ only in the trailing dimensions it covers. The tiles are
+ * found via a table whose pages are likewise allocated only when needed.
+ */
+typedef struct {
+    size_t length;   /**< Number of bins in the histogram                     */
+    size_t tilesize; /**< Number of bins in a tile                            */
+    size_t ntile;    /**< Number of tiles                                     */
+    size_t npage;    /**< Number of pages in the tile table                   */
+    real*** page;    /**< Pages of the tile table, NULL for empty pages       */
+} dist_sparse;
+
+int dist_sparse_init(dist_sparse* hist, int ndim, int* nbin);
+void dist_sparse_free(dist_sparse* hist);
+size_t dist_sparse_count(dist_sparse* hist);
+void dist_sparse_scale(dist_sparse* hist, real factor);
+real* dist_sparse_find_tile(dist_sparse* hist, size_t itile);
+
+#pragma omp declare target
+real* dist_sparse_get_tile(dist_sparse* hist, size_t itile);
+void dist_sparse_add(dist_sparse* hist, size_t index, real weight);
+#pragma omp end declare target
+
+#endif
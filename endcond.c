@@ -54,6 +54,7 @@
 #include "endcond.h"
 #include "particle.h"
 #include "simulate.h"
+#include "diag.h"
 #include "physlib.h"
 #include "consts.h"
 #include "math.h"
@@ -248,6 +249,11 @@ void endcond_check_fo(particle_simd_fo* p_f, particle_simd_fo* p_i,
             }
         }
     }
+    /* Wall loads are collected here where the markers that hit the wall
+       during this time step are known */
+    if(active_wall) {
+        diag_update_wallhit_fo(&sim->diag_data, &sim->wall_data, p_f, p_i);
+    }
 }
 
 /**
@@ -424,6 +430,11 @@ void endcond_check_gc(particle_simd_gc* p_f, particle_simd_gc* p_i,
             }
         }
     }
+    /* Wall loads are collected here where the markers that hit the wall
+       during this time step are known */
+    if(active_wall) {
+        diag_update_wallhit_gc(&sim->diag_data, &sim->wall_data, p_f, p_i);
+    }
 }
 
 /**
@@ -143,6 +143,10 @@ void error_parse2str(a5err err, char* msg, char* line, char* file) {
             sprintf(file, "step_gc_cashkarp.c");
             break;
 
+        case EF_STEP_GC_DOPRI:
+            sprintf(file, "step_gc_dopri.c");
+            break;
+
         case EF_PLASMA:
             sprintf(file, "plasma.c");
             break;
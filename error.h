@@ -48,7 +48,8 @@ typedef enum error_file {
     EF_MHD               =  24, /**< Error is from mhd.c                      */
     EF_ATOMIC            =  25, /**< Error is from atomic.c                   */
     EF_ASIGMA            =  26, /**< Error is from asigma.c                   */
-    EF_ASIGMA_LOC        =  27  /**< Error is from asigma_loc.c               */
+    EF_ASIGMA_LOC        =  27, /**< Error is from asigma_loc.c               */
+    EF_STEP_GC_DOPRI     =  28  /**< Error is from step_gc_dopri.c            */
 }error_file;
 
 /**
@@ -34,6 +34,7 @@
 #include <math.h>
 #include "ascot5.h"
 #include "math.h"
+#include "vecmath.h"
 #include "consts.h"
 #include "physlib.h"
 #include "gctransform.h"
@@ -228,7 +229,7 @@ void gctransform_particle2guidingcenter(
     /* Zeroth order gyroangle is directly defined from basis {e1, e2} and
        gyrovector as tan(zeta) = -rhohat dot e2 / rhohat dot e1 */
     real zeta0 =
-        atan2( -math_dot(rhohat, e2), math_dot(rhohat, e1) );
+        vecmath_atan2( -math_dot(rhohat, e2), math_dot(rhohat, e1) );
 
     /* First order momentum terms ppar, mu1, and zeta1 */
     real ppar1 = 0.0;
@@ -394,8 +395,8 @@ void gctransform_guidingcenter2particle(
     /* Gyrovector rhohat and pperphat*/
     real rhohat[3];
     real perphat[3];
-    real c = cos(zeta);
-    real s = sin(zeta);
+    real c = vecmath_cos(zeta);
+    real s = vecmath_sin(zeta);
 
     rhohat[0] = c * e1[0] - s * e2[0];
     rhohat[1] = c * e1[1] - s * e2[1];
@@ -498,8 +499,8 @@ void gctransform_guidingcenter2particle(
         mu = fabs(mu);
 
         /* Calculate new unit vector for position */
-        c = cos(zeta);
-        s = sin(zeta);
+        c = vecmath_cos(zeta);
+        s = vecmath_sin(zeta);
 
         rhohat[0] = c * e1[0] - s * e2[0];
         rhohat[1] = c * e1[1] - s * e2[1];
@@ -560,8 +561,8 @@ void gctransform_pparmuzeta2prpphipz(real mass, real charge, real* B_dB,
     math_cross(bhat, e1, e2);
 
     /* Perpendicular basis vector */
-    real c = cos(zeta);
-    real s = sin(zeta);
+    real c = vecmath_cos(zeta);
+    real s = vecmath_sin(zeta);
     real perphat[3];
     perphat[0] = -s * e1[0] - c * e2[0];
     perphat[1] = -s * e1[1] - c * e2[1];
@@ -32,6 +32,7 @@
 #include "hdf5io/hdf5_dist.h"
 #include "hdf5io/hdf5_orbit.h"
 #include "hdf5io/hdf5_transcoef.h"
+#include "hdf5io/hdf5_wallload.h"
 #include "hdf5io/hdf5_asigma.h"
 
 /**
@@ -604,7 +605,45 @@ int hdf5_interface_write_diagnostics(sim_offload_data* sim,
         }
     }
 
-    if(sim->diag_offload_data.diagorb_collect) {
+    if(sim->diag_offload_data.distmom_collect) {
+        print_out(VERBOSE_IO, "\nWriting moment profiles.\n");
+        int idx = sim->diag_offload_data.offload_distmom_index;
+        if( hdf5_dist_write_moments( f, qid, &sim->diag_offload_data.distmom,
+                                     &diag_offload_array[idx]) ) {
+            print_err("Warning: moment profiles could not be written.\n");
+        }
+    }
+
+    if(sim->diag_offload_data.variance_collect) {
+        print_out(VERBOSE_IO, "\nWriting second moments of distributions.\n");
+        diag_offload_data* diag = &sim->diag_offload_data;
+        int dense6D = !diag->dist_sparse;
+        int collect[6] = {
+            diag->dist5D_collect, diag->dist6D_collect && dense6D,
+            diag->distrho5D_collect, diag->distrho6D_collect && dense6D,
+            diag->distCOM_collect, diag->distmom_collect };
+        int index[6] = {
+            diag->offload_dist5D_index, diag->offload_dist6D_index,
+            diag->offload_distrho5D_index, diag->offload_distrho6D_index,
+            diag->offload_distCOM_index, diag->offload_distmom_index };
+        char* name[6] = { "dist5d", "dist6d", "distrho5d", "distrho6d",
+                          "distcom", "distmoments" };
+        for(int i = 0; i < 6; i++) {
+            int idx = diag->offload_distvar_index + index[i];
+            if( collect[i] && hdf5_dist_write_secondmoment(
+                    f, qid, name[i], &diag_offload_array[idx]) ) {
+                print_err("Warning: second moments of %s could not be "
+                          "written.\n", name[i]);
+            }
+        }
+    }
+
+    if(sim->diag_offload_data.diagorb_collect
+       && sim->diag_offload_data.diagorb.stream) {
+        print_out(VERBOSE_IO,
+                  "Orbit diagnostics were written during the simulation.\n");
+    }
+    else if(sim->diag_offload_data.diagorb_collect) {
         print_out(VERBOSE_IO, "Writing orbit diagnostics.\n");
 
         int idx = sim->diag_offload_data.offload_diagorb_index;
@@ -623,6 +662,15 @@ int hdf5_interface_write_diagnostics(sim_offload_data* sim,
         }
     }
 
+    if(sim->diag_offload_data.diagwall_collect) {
+        print_out(VERBOSE_IO, "Writing wall loads.\n");
+        int idx = sim->diag_offload_data.offload_diagwall_index;
+        if( hdf5_wallload_write(f, qid, &sim->diag_offload_data.diagwall,
+                                &diag_offload_array[idx]) ) {
+            print_err("Warning: Wall loads could not be written.\n");
+        }
+    }
+
     hdf5_close(f);
 
     print_out(VERBOSE_IO, "\nDiagnostics output written.\n");
@@ -630,6 +678,163 @@ int hdf5_interface_write_diagnostics(sim_offload_data* sim,
     return 0;
 }
 
+/**
+ * @brief Name of the file where a process streams its orbits
+ *
+ * @param sim pointer to simulation offload data
+ * @param mpi_rank rank of the MPI process
+ * @param fn array where the filename is stored
+ */
+void hdf5_interface_orbit_filename(sim_offload_data* sim, int mpi_rank,
+                                   char fn[256]) {
+    int len = strlen(sim->hdf5_out) - 3;
+    snprintf(fn, 256, "%.*s_orbit%d.h5", len, sim->hdf5_out, mpi_rank);
+}
+
+/**
+ * @brief Write orbit records to HDF5 output while the simulation runs
+ *
+ * Called by the thread that writes the streamed orbits. The root process
+ * writes to the results group of the output file, and the other processes to
+ * files of their own that are merged to the output afterwards. The chunks are
+ * drained even if writing fails so that the simulation does not stall.
+ *
+ * @param sim pointer to simulation offload data
+ * @param mpi_rank rank of this MPI process
+ * @param mpi_root rank of the root process
+ *
+ * @return Zero if the orbits were written succesfully
+ */
+int hdf5_interface_stream_orbits(sim_offload_data* sim, int mpi_rank,
+                                 int mpi_root) {
+    hid_t f;
+    char path[256];
+    if(mpi_rank == mpi_root) {
+        f = hdf5_open(sim->hdf5_out);
+        char qid[11];
+        if(f >= 0 && hdf5_get_active_qid(f, "/results/", qid) ) {
+            hdf5_close(f);
+            f = -1;
+        }
+        if(f >= 0) {
+            hdf5_generate_qid_path("/results/run_XXXXXXXXXX/", qid, path);
+            strcat(path, "orbit");
+        }
+    }
+    else {
+        char fn[256];
+        hdf5_interface_orbit_filename(sim, mpi_rank, fn);
+        remove(fn);
+        f = hdf5_create(fn);
+        strcpy(path, "/orbit");
+    }
+
+    int err = hdf5_orbit_stream(f, path, &sim->diag_offload_data.diagorb);
+    if(f >= 0) {
+        hdf5_close(f);
+    }
+    if(err) {
+        print_err("Warning: Orbit diagnostics could not be written.\n");
+    }
+    return err;
+}
+
+/**
+ * @brief Merge orbits streamed by other MPI processes to the output
+ *
+ * The files of the other processes are removed once merged.
+ *
+ * @param sim pointer to simulation offload data
+ * @param mpi_rank rank of this MPI process
+ * @param mpi_size number of MPI processes
+ *
+ * @return Zero if the orbits were merged succesfully
+ */
+int hdf5_interface_merge_orbits(sim_offload_data* sim, int mpi_rank,
+                                int mpi_size) {
+    hid_t f = hdf5_open(sim->hdf5_out);
+    if(f < 0) {
+        print_err("Error: File not found.\n");
+        return 1;
+    }
+
+    char qid[11];
+    if( hdf5_get_active_qid(f, "/results/", qid) ) {
+        print_err("Error: Active QID was not written to results group.\n");
+        hdf5_close(f);
+        return 1;
+    }
+
+    int err = 0;
+    for(int rank = 0; rank < mpi_size; rank++) {
+        if(rank == mpi_rank) {
+            continue;
+        }
+
+        char fn[256];
+        hdf5_interface_orbit_filename(sim, rank, fn);
+        hid_t fin = hdf5_open_ro(fn);
+        if(fin < 0 || hdf5_orbit_merge(f, qid, &sim->diag_offload_data.diagorb,
+                                       fin, "/orbit") ) {
+            print_err("Warning: Orbits in %s could not be merged.\n", fn);
+            err = 1;
+        }
+        if(fin >= 0) {
+            hdf5_close(fin);
+        }
+        if(!err) {
+            remove(fn);
+        }
+    }
+
+    hdf5_close(f);
+    return err;
+}
+
+/**
+ * @brief Store the 3D wall octree in the input file
+ *
+ * The octree array is written to the group of the wall that was used, so
+ * that subsequent runs with the same wall can skip constructing it. Nothing
+ * is done if the wall is not 3D or the octree is already stored. Failing to
+ * write is not an error since the octree can always be constructed again.
+ *
+ * @param sim pointer to simulation offload data
+ * @param wall_int_offload_array wall integer offload array
+ *
+ * @return Zero if the octree is stored in the input file
+ */
+int hdf5_interface_write_wall_tree(sim_offload_data* sim,
+                                   int* wall_int_offload_array) {
+    if(sim->wall_offload_data.type != wall_type_3D) {
+        return 0;
+    }
+
+    hid_t f = hdf5_open(sim->hdf5_in);
+    if(f < 0) {
+        print_out(VERBOSE_IO, "Note: Could not store the wall octree.\n");
+        return 1;
+    }
+
+    char qid[11];
+    if(sim->qid_wall[0] != '\0') {
+        strcpy(qid, sim->qid_wall);
+    }
+    else if( hdf5_get_active_qid(f, "/wall/", qid) ) {
+        hdf5_close(f);
+        return 1;
+    }
+
+    int err = hdf5_wall_write_3D_tree(f, &(sim->wall_offload_data.w3d),
+                                      wall_int_offload_array, qid);
+    if(err) {
+        print_out(VERBOSE_IO, "Note: Could not store the wall octree.\n");
+    }
+    hdf5_close(f);
+
+    return err;
+}
+
 /**
  * @brief Fetch active qid within the given group
  *
@@ -45,6 +45,15 @@ int hdf5_interface_write_state(char* fn, char* state, integer n,
 int hdf5_interface_write_diagnostics(sim_offload_data* sim,
                                      real* diag_offload_array, char* out);
 
+int hdf5_interface_stream_orbits(sim_offload_data* sim, int mpi_rank,
+                                 int mpi_root);
+
+int hdf5_interface_merge_orbits(sim_offload_data* sim, int mpi_rank,
+                                int mpi_size);
+
+int hdf5_interface_write_wall_tree(sim_offload_data* sim,
+                                   int* wall_int_offload_array);
+
 int hdf5_get_active_qid(hid_t f, const char* group, char qid[11]);
 
 void hdf5_generate_qid(char* qid);
@@ -3,13 +3,16 @@
  * @brief Distribution HDF5 IO
  */
 #include <stdlib.h>
+#include <string.h>
 #include <hdf5.h>
+#include <hdf5_hl.h>
 #include "../ascot5.h"
 #include "../diag/dist_5D.h"
 #include "../diag/dist_6D.h"
 #include "../diag/dist_rho5D.h"
 #include "../diag/dist_rho6D.h"
 #include "../diag/dist_com.h"
+#include "../diag/dist_moments.h"
 #include "../math.h"
 #include "../consts.h"
 #include "hdf5_histogram.h"
@@ -78,10 +81,12 @@ int hdf5_dist_write_5D(hid_t f, char* qid, dist_5D_offload_data* dist,
 /**
  * @brief Write 6D distribution to an existing result group
  *
+ * The histogram is written from its tiles if it is stored sparsely.
+ *
  * @param f HDF5 file id
  * @param qid run QID where distribution is written
  * @param dist pointer to distribution data struct
- * @param hist pointer to distribution data
+ * @param hist pointer to distribution data, not used if stored sparsely
  */
 int hdf5_dist_write_6D(hid_t f, char* qid, dist_6D_offload_data* dist,
                        real* hist) {
@@ -130,10 +135,19 @@ int hdf5_dist_write_6D(hid_t f, char* qid, dist_6D_offload_data* dist,
     char path[256];
     hdf5_generate_qid_path("/results/run_XXXXXXXXXX/dist6d", qid, path);
 
-    int retval = hdf5_histogram_write_uniform_double(
-        f, path, abscissa_dim, ordinate_dim, abscissa_n_slots, abscissa_min,
-        abscissa_max, abscissa_units, abscissa_names, ordinate_units,
-        ordinate_names, hist);
+    int retval;
+    if(dist->sparse.page != NULL) {
+        retval = hdf5_histogram_write_uniform_sparse(
+            f, path, abscissa_dim, ordinate_dim, abscissa_n_slots,
+            abscissa_min, abscissa_max, abscissa_units, abscissa_names,
+            ordinate_units, ordinate_names, &dist->sparse);
+    }
+    else {
+        retval = hdf5_histogram_write_uniform_double(
+            f, path, abscissa_dim, ordinate_dim, abscissa_n_slots,
+            abscissa_min, abscissa_max, abscissa_units, abscissa_names,
+            ordinate_units, ordinate_names, hist);
+    }
 
     return retval;
 }
@@ -201,10 +215,12 @@ int hdf5_dist_write_rho5D(hid_t f, char* qid, dist_rho5D_offload_data* dist,
 /**
  * @brief Write rho 6D distribution to an existing result group
  *
+ * The histogram is written from its tiles if it is stored sparsely.
+ *
  * @param f HDF5 file id
  * @param qid run QID where distribution is written
  * @param dist pointer to distribution data struct
- * @param hist pointer to distribution data
+ * @param hist pointer to distribution data, not used if stored sparsely
  */
 int hdf5_dist_write_rho6D(hid_t f, char* qid, dist_rho6D_offload_data* dist,
                           real* hist) {
@@ -253,10 +269,19 @@ int hdf5_dist_write_rho6D(hid_t f, char* qid, dist_rho6D_offload_data* dist,
     char path[256];
     hdf5_generate_qid_path("/results/run_XXXXXXXXXX/distrho6d", qid, path);
 
-    int retval = hdf5_histogram_write_uniform_double(
-        f, path, abscissa_dim, ordinate_dim, abscissa_n_slots, abscissa_min,
-        abscissa_max, abscissa_units, abscissa_names, ordinate_units,
-        ordinate_names, hist);
+    int retval;
+    if(dist->sparse.page != NULL) {
+        retval = hdf5_histogram_write_uniform_sparse(
+            f, path, abscissa_dim, ordinate_dim, abscissa_n_slots,
+            abscissa_min, abscissa_max, abscissa_units, abscissa_names,
+            ordinate_units, ordinate_names, &dist->sparse);
+    }
+    else {
+        retval = hdf5_histogram_write_uniform_double(
+            f, path, abscissa_dim, ordinate_dim, abscissa_n_slots,
+            abscissa_min, abscissa_max, abscissa_units, abscissa_names,
+            ordinate_units, ordinate_names, hist);
+    }
 
     return retval;
 }
@@ -306,3 +331,92 @@ int hdf5_dist_write_COM(hid_t f, char* qid, dist_COM_offload_data* dist,
 
     return retval;
 }
+
+/**
+ * @brief Write moment profiles to an existing result group
+ *
+ * The moments are written as a histogram with one ordinate per moment.
+ *
+ * @param f HDF5 file id
+ * @param qid run QID where the moments are written
+ * @param dist pointer to moment profile data struct
+ * @param hist pointer to moment profile data
+ */
+int hdf5_dist_write_moments(hid_t f, char* qid,
+                            dist_moments_offload_data* dist, real* hist) {
+
+    int abscissa_dim = 3;
+    int ordinate_dim = DIST_MOMENTS_N;
+
+    int abscissa_n_slots[3];
+    abscissa_n_slots[0] = dist->n_rho;
+    abscissa_n_slots[1] = dist->n_theta;
+    abscissa_n_slots[2] = dist->n_time;
+
+    double abscissa_min[3];
+    abscissa_min[0] = dist->min_rho;
+    abscissa_min[1] = math_rad2deg(dist->min_theta);
+    abscissa_min[2] = dist->min_time;
+
+    double abscissa_max[3];
+    abscissa_max[0] = dist->max_rho;
+    abscissa_max[1] = math_rad2deg(dist->max_theta);
+    abscissa_max[2] = dist->max_time;
+
+    char* abscissa_names[] = { "rho", "theta", "time" };
+    char* abscissa_units[] = { "1", "deg", "s" };
+    char* ordinate_names[] = { "density", "chargedensity", "energydensity",
+                               "pressure", "parallelcurrent",
+                               "toroidalcurrent", "powerdep" };
+    char* ordinate_units[] = { "particles", "C", "J", "J", "A*m", "A*m",
+                               "W" };
+
+    /* Create a group for the moments and write the data in it */
+    char path[256];
+    hdf5_generate_qid_path("/results/run_XXXXXXXXXX/distmoments", qid, path);
+
+    int retval = hdf5_histogram_write_uniform_double(
+        f, path, abscissa_dim, ordinate_dim, abscissa_n_slots, abscissa_min,
+        abscissa_max, abscissa_units, abscissa_names, ordinate_units,
+        ordinate_names, hist);
+
+    return retval;
+}
+
+/**
+ * @brief Write second moments of a distribution to its group
+ *
+ * The second moments, i.e. the sums of the squared contributions of the
+ * markers to each bin, are written as dataset "ordinate2" which has the same
+ * shape as the ordinate.
+ *
+ * @param f HDF5 file id
+ * @param qid run QID where the distribution is written
+ * @param name name of the distribution group, e.g. "dist5d"
+ * @param hist2 pointer to the second moments
+ */
+int hdf5_dist_write_secondmoment(hid_t f, char* qid, char* name,
+                                 real* hist2) {
+    char path[256];
+    hdf5_generate_qid_path("/results/run_XXXXXXXXXX/", qid, path);
+    strcat(path, name);
+
+    hid_t histogram = H5Gopen(f, path, H5P_DEFAULT);
+    if(histogram < 0) {
+        return 1;
+    }
+
+    int rank;
+    hsize_t dims[100];
+    herr_t err = H5LTget_dataset_ndims(histogram, "ordinate", &rank);
+    if(!err) {
+        err = H5LTget_dataset_info(histogram, "ordinate", dims, NULL, NULL);
+    }
+    if(!err) {
+        err = H5LTmake_dataset_double(histogram, "ordinate2", rank, dims,
+                                      hist2);
+    }
+    H5Gclose(histogram);
+
+    return err < 0;
+}
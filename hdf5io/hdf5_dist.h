@@ -12,6 +12,7 @@
 #include "../diag/dist_rho5D.h"
 #include "../diag/dist_rho6D.h"
 #include "../diag/dist_com.h"
+#include "../diag/dist_moments.h"
 
 int hdf5_dist_write_5D(hid_t f, char* qid, dist_5D_offload_data* dist,
                        real* hist);
@@ -23,5 +24,9 @@ int hdf5_dist_write_rho6D(hid_t f, char* qid, dist_rho6D_offload_data* dist,
                           real* hist);
 int hdf5_dist_write_COM(hid_t f, char* qid, dist_COM_offload_data* dist,
                         real* hist);
+int hdf5_dist_write_moments(hid_t f, char* qid,
+                            dist_moments_offload_data* dist, real* hist);
+int hdf5_dist_write_secondmoment(hid_t f, char* qid, char* name,
+                                 real* hist2);
 
 #endif
@@ -388,3 +388,78 @@ herr_t hdf5_write_extendible_dataset_int(hid_t group,
 
     return err;
 }
+
+/**
+ * @brief Append data to an extendible dataset, creating it if necessary.
+ *
+ * A dataset that does not exist is created with zero length, so calling this
+ * with no data creates an empty dataset. The chunks of a created dataset can
+ * be compressed, in which case the bytes are shuffled before deflating since
+ * neighbouring elements tend to share their leading bytes.
+ *
+ * @param group group where the dataset is located
+ * @param datasetname name of the dataset
+ * @param type datatype of the data both in memory and in the file
+ * @param chunk chunk size used if the dataset is created
+ * @param deflate deflate level used if the dataset is created, or negative if
+ *        the dataset is not compressed
+ * @param length number of elements to be appended
+ * @param data data to be appended
+ *
+ * @return zero on success
+ */
+herr_t hdf5_append_extendible_dataset(hid_t group, const char* datasetname,
+                                      hid_t type, hsize_t chunk, int deflate,
+                                      size_t length, const void* data) {
+    hid_t dataset;
+    if(H5Lexists(group, datasetname, H5P_DEFAULT) > 0) {
+        dataset = H5Dopen2(group, datasetname, H5P_DEFAULT);
+    }
+    else {
+        hsize_t dim[1]    = {0};
+        hsize_t maxdim[1] = {H5S_UNLIMITED};
+        hid_t dataspace   = H5Screate_simple(1, dim, maxdim);
+        hid_t prop        = H5Pcreate(H5P_DATASET_CREATE);
+        H5Pset_chunk(prop, 1, &chunk);
+        if(deflate >= 0 && H5Zfilter_avail(H5Z_FILTER_DEFLATE)) {
+            H5Pset_shuffle(prop);
+            H5Pset_deflate(prop, deflate);
+        }
+        dataset = H5Dcreate2(group, datasetname, type, dataspace,
+                             H5P_DEFAULT, prop, H5P_DEFAULT);
+        H5Pclose(prop);
+        H5Sclose(dataspace);
+    }
+    if(dataset < 0) {
+        return -1;
+    }
+
+    int err = 0;
+    if(length > 0) {
+        /* Extend the dataset and write to the new elements */
+        hid_t dataspace = H5Dget_space(dataset);
+        hsize_t start[1], count[1] = {length};
+        H5Sget_simple_extent_dims(dataspace, start, NULL);
+        H5Sclose(dataspace);
+
+        hsize_t dim[1] = {start[0] + length};
+        if(H5Dset_extent(dataset, dim) < 0) {
+            err = -1;
+        }
+        else {
+            hid_t filespace = H5Dget_space(dataset);
+            hid_t memspace  = H5Screate_simple(1, count, NULL);
+            H5Sselect_hyperslab(filespace, H5S_SELECT_SET, start, NULL,
+                                count, NULL);
+            if( H5Dwrite(dataset, type, memspace, filespace,
+                         H5P_DEFAULT, data) < 0 ) {
+                err = -1;
+            }
+            H5Sclose(memspace);
+            H5Sclose(filespace);
+        }
+    }
+    H5Dclose(dataset);
+
+    return err;
+}
@@ -34,5 +34,8 @@ herr_t hdf5_write_extendible_dataset_long(hid_t group,
 herr_t hdf5_write_extendible_dataset_int(hid_t group,
                                          const char* datasetname,
                                          int length, int* data);
+herr_t hdf5_append_extendible_dataset(hid_t group, const char* datasetname,
+                                      hid_t type, hsize_t chunk, int deflate,
+                                      size_t length, const void* data);
 
 #endif
@@ -8,6 +8,12 @@
 #include <hdf5_hl.h>
 #include "hdf5_histogram.h"
 
+int hdf5_histogram_write_axes(hid_t histogram, int abscissaDim,
+                              int ordinateDim, int *abscissaNslots,
+                              double *abscissaMin, double *abscissaMax,
+                              char **abscissaUnits, char **abscissaNames,
+                              char **ordinateUnits, char **ordinateNames);
+
 /**
  * @brief Write a histogram with uniform grid to HDF5 file
  *
@@ -50,8 +56,6 @@ int hdf5_histogram_write_uniform_double(hid_t f, const char *path,
                                         char **ordinateNames,
                                         double *ordinate) {
 
-    char temppath[256]; /* Helper variable */
-
     /* Create histogram group */
     hid_t histogram = H5Gcreate2(f, path, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
     if(histogram < 0) {
@@ -65,7 +69,7 @@ int hdf5_histogram_write_uniform_double(hid_t f, const char *path,
         dims[i+1] = abscissaNslots[i];
     }
 
-    /* Write ordinate including its names and units */
+    /* Write ordinate */
     herr_t err;
     err = H5LTmake_dataset_double(histogram , "ordinate", abscissaDim+1,
                                   dims, ordinate);
@@ -73,6 +77,191 @@ int hdf5_histogram_write_uniform_double(hid_t f, const char *path,
         H5Gclose(histogram);
         return err;
     }
+
+    err = hdf5_histogram_write_axes(histogram, abscissaDim, ordinateDim,
+                                    abscissaNslots, abscissaMin, abscissaMax,
+                                    abscissaUnits, abscissaNames,
+                                    ordinateUnits, ordinateNames);
+    H5Gclose(histogram);
+
+    return err;
+}
+
+/**
+ * @brief Write a histogram with uniform grid and sparse ordinate to HDF5 file
+ *
+ * The histogram is written as in hdf5_histogram_write_uniform_double(), but
+ * the ordinate is a sparse histogram whose tiles span its trailing
+ * dimensions. The ordinate dataset is chunked so that each chunk holds a
+ * number of whole tiles, and only the chunks that contain allocated tiles are
+ * written. Missing chunks take no space in the file and read as zeros, so the
+ * dataset reads as a regular dense ordinate.
+ *
+ * @param f HDF5 file id
+ * @param path full path including group name where histogram is stored
+ * @param abscissaDim number of abscissa dimensions
+ * @param ordinateDim number of ordinate dimensions
+ * @param abscissaNslots array with abscissa dimensions
+ * @param abscissaMin the lowest abscissa edge for each abscissa dimension
+ * @param abscissaMax the highest abscissa edge for each abscissa dimension
+ * @param abscissaUnits array with abscissa units
+ * @param abscissaNames array with abscissa names
+ * @param ordinateUnits array with ordinate units
+ * @param ordinateNames array with ordinate names
+ * @param ordinate sparse ordinate data
+ *
+ * @return zero on success
+ */
+int hdf5_histogram_write_uniform_sparse(hid_t f, const char *path,
+                                        int abscissaDim, int ordinateDim,
+                                        int *abscissaNslots,
+                                        double *abscissaMin,
+                                        double *abscissaMax,
+                                        char **abscissaUnits,
+                                        char **abscissaNames,
+                                        char **ordinateUnits,
+                                        char **ordinateNames,
+                                        dist_sparse *ordinate) {
+
+    /* Dimensions of ordinate data to be written */
+    int ndim = abscissaDim + 1;
+    hsize_t dims[100];
+    dims[0] = ordinateDim;
+    for (int i=0; i<abscissaDim; i++) {
+        dims[i+1] = abscissaNslots[i];
+    }
+
+    /* Tiles span the trailing dimensions starting from dimension ilead */
+    int ilead = ndim;
+    size_t chunksize = 1;
+    while(chunksize < ordinate->tilesize && ilead > 0) {
+        ilead--;
+        chunksize *= dims[ilead];
+    }
+    if(chunksize != ordinate->tilesize) {
+        return 1;
+    }
+
+    /* Chunks extend over the next dimensions while they are not too large */
+    while(ilead > 0 && chunksize * dims[ilead-1] <= HDF5_HISTOGRAM_MAXCHUNK) {
+        ilead--;
+        chunksize *= dims[ilead];
+    }
+    hsize_t chunk[100];
+    for(int i=0; i<ndim; i++) {
+        chunk[i] = i < ilead ? 1 : dims[i];
+    }
+    size_t tilesperchunk = chunksize / ordinate->tilesize;
+    size_t nchunk = ordinate->ntile / tilesperchunk;
+
+    /* Create histogram group */
+    hid_t histogram = H5Gcreate2(f, path, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    if(histogram < 0) {
+        return 1;
+    }
+
+    /* Create chunked ordinate that reads as zero where nothing is written */
+    double fill = 0;
+    hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(dcpl, ndim, chunk);
+    H5Pset_fill_value(dcpl, H5T_NATIVE_DOUBLE, &fill);
+    if(H5Zfilter_avail(H5Z_FILTER_DEFLATE)) {
+        H5Pset_deflate(dcpl, 1);
+    }
+    hid_t filespace = H5Screate_simple(ndim, dims, NULL);
+    hid_t dataset = H5Dcreate2(histogram, "ordinate", H5T_NATIVE_DOUBLE,
+                               filespace, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+    H5Pclose(dcpl);
+    if(dataset < 0) {
+        H5Sclose(filespace);
+        H5Gclose(histogram);
+        return 1;
+    }
+
+    /* Write each chunk that has allocated tiles */
+    herr_t err = 0;
+    hsize_t memsize[1] = {chunksize};
+    hid_t memspace = H5Screate_simple(1, memsize, NULL);
+    double* buffer = (double *) malloc(chunksize * sizeof(double));
+    for(size_t c = 0; c < nchunk && !err; c++) {
+        int empty = 1;
+        for(size_t t = 0; t < tilesperchunk; t++) {
+            double* tile = dist_sparse_find_tile(ordinate,
+                                                 c * tilesperchunk + t);
+            if(tile != NULL) {
+                memcpy(&buffer[t * ordinate->tilesize], tile,
+                       ordinate->tilesize * sizeof(double));
+                empty = 0;
+            }
+            else {
+                memset(&buffer[t * ordinate->tilesize], 0,
+                       ordinate->tilesize * sizeof(double));
+            }
+        }
+        if(empty) {
+            continue;
+        }
+
+        hsize_t start[100];
+        size_t rem = c;
+        for(int i=ndim-1; i>=0; i--) {
+            if(i < ilead) {
+                start[i] = rem % dims[i];
+                rem /= dims[i];
+            }
+            else {
+                start[i] = 0;
+            }
+        }
+        H5Sselect_hyperslab(filespace, H5S_SELECT_SET, start, NULL, chunk,
+                            NULL);
+        err = H5Dwrite(dataset, H5T_NATIVE_DOUBLE, memspace, filespace,
+                       H5P_DEFAULT, buffer);
+    }
+    free(buffer);
+    H5Sclose(memspace);
+    H5Sclose(filespace);
+    H5Dclose(dataset);
+    if(err){
+        H5Gclose(histogram);
+        return 1;
+    }
+
+    err = hdf5_histogram_write_axes(histogram, abscissaDim, ordinateDim,
+                                    abscissaNslots, abscissaMin, abscissaMax,
+                                    abscissaUnits, abscissaNames,
+                                    ordinateUnits, ordinateNames);
+    H5Gclose(histogram);
+
+    return err;
+}
+
+/**
+ * @brief Write the ordinate attributes and the abscissae of a histogram
+ *
+ * @param histogram HDF5 id of the histogram group where ordinate exists
+ * @param abscissaDim number of abscissa dimensions
+ * @param ordinateDim number of ordinate dimensions
+ * @param abscissaNslots array with abscissa dimensions
+ * @param abscissaMin the lowest abscissa edge for each abscissa dimension
+ * @param abscissaMax the highest abscissa edge for each abscissa dimension
+ * @param abscissaUnits array with abscissa units
+ * @param abscissaNames array with abscissa names
+ * @param ordinateUnits array with ordinate units
+ * @param ordinateNames array with ordinate names
+ *
+ * @return zero on success
+ */
+int hdf5_histogram_write_axes(hid_t histogram, int abscissaDim,
+                              int ordinateDim, int *abscissaNslots,
+                              double *abscissaMin, double *abscissaMax,
+                              char **abscissaUnits, char **abscissaNames,
+                              char **ordinateUnits, char **ordinateNames) {
+
+    char temppath[256]; /* Helper variable */
+    herr_t err;
+
+    /* Ordinate names and units */
     for(int i=0; i<ordinateDim; i++) {
         sprintf(temppath, "name_%02d", i);
         H5LTset_attribute_string(histogram, "ordinate", temppath,
@@ -88,21 +277,20 @@ int hdf5_histogram_write_uniform_double(hid_t f, const char *path,
     err = H5LTmake_dataset_int(histogram , "ordinate_ndim", 1, &dimsize,
                                &ordinateDim);
     if(err){
-        H5Gclose(histogram);
         return 1;
     }
     err = H5LTmake_dataset_int(histogram , "abscissa_ndim", 1, &dimsize,
                                &abscissaDim);
     if(err){
-        H5Gclose(histogram);
         return 1;
     }
 
     /* Write abscissae */
     for (int i=0; i<abscissaDim; i++) {
 
-        double* abscissavec = (double *) malloc( (dims[i+1]+1)*sizeof(double) );
-        for(int j=0; j<dims[i+1]+1; j++) {
+        double* abscissavec =
+            (double *) malloc( (abscissaNslots[i]+1)*sizeof(double) );
+        for(int j=0; j<abscissaNslots[i]+1; j++) {
             abscissavec[j] =
                 abscissaMin[i] + j * ( (abscissaMax[i] - abscissaMin[i])
                                        / abscissaNslots[i] );
@@ -116,7 +304,6 @@ int hdf5_histogram_write_uniform_double(hid_t f, const char *path,
                                       abscissavec);
         free(abscissavec);
         if(err){
-            H5Gclose(histogram);
             return 1;
         }
 
@@ -125,7 +312,6 @@ int hdf5_histogram_write_uniform_double(hid_t f, const char *path,
         err = H5LTmake_dataset_int(histogram, temppath, 1, &dimsize,
                                    &(abscissaNslots[i]));
         if(err){
-            H5Gclose(histogram);
             return 1;
         }
 
@@ -139,7 +325,5 @@ int hdf5_histogram_write_uniform_double(hid_t f, const char *path,
 
     }
 
-    H5Gclose(histogram);
-
     return 0;
 }
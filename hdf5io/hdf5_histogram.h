@@ -6,6 +6,12 @@
 #define HDF5_HISTOGRAM
 
 #include <hdf5.h>
+#include "../diag/dist_sparse.h"
+
+/**
+ * @brief Maximum number of elements in a chunk of a sparse ordinate
+ */
+#define HDF5_HISTOGRAM_MAXCHUNK 4096
 
 int hdf5_histogram_write_uniform_double(hid_t f, const char *path,
                                         int abscissaDim, int ordinateDim,
@@ -17,4 +23,15 @@ int hdf5_histogram_write_uniform_double(hid_t f, const char *path,
                                         char **ordinateUnits,
                                         char **ordinateNames,
                                         double *ordinate);
+
+int hdf5_histogram_write_uniform_sparse(hid_t f, const char *path,
+                                        int abscissaDim, int ordinateDim,
+                                        int *abscissaNslots,
+                                        double *abscissaMin,
+                                        double *abscissaMax,
+                                        char **abscissaUnits,
+                                        char **abscissaNames,
+                                        char **ordinateUnits,
+                                        char **ordinateNames,
+                                        dist_sparse *ordinate);
 #endif
@@ -14,9 +14,12 @@
 #include "../diag/dist_rho5D.h"
 #include "../diag/dist_rho6D.h"
 #include "../diag/dist_com.h"
+#include "../diag/dist_moments.h"
+#include "../diag/dist_accum.h"
 #include "../endcond.h"
 #include "../math.h"
 #include "../simulate.h"
+#include "../print.h"
 #include "hdf5_helpers.h"
 #include "hdf5_options.h"
 
@@ -32,11 +35,16 @@ int hdf5_options_read_distrho6D(hid_t file, dist_rho6D_offload_data* dist,
                                 char* qid);
 int hdf5_options_read_distCOM(hid_t file, dist_COM_offload_data* dist,
                               char* qid);
+int hdf5_options_read_distmoments(hid_t file,
+                                  dist_moments_offload_data* dist, char* qid);
 int hdf5_options_read_diagorb(hid_t file, diag_orb_offload_data* diagorb,
                               char* qid);
 int hdf5_options_read_diagtrcof(hid_t file,
                                 diag_transcoef_offload_data* diagtrcof,
                                 char* qid);
+int hdf5_options_read_diagwall(hid_t file,
+                               diag_wallload_offload_data* diagwall,
+                               char* qid);
 
 /**
  * @brief Read options and diagnostics settings from HDF5 file
@@ -78,6 +86,9 @@ int hdf5_options_read(hid_t file, sim_offload_data* sim, char* qid){
     if( hdf5_read_double(OPTPATH "FIXEDSTEP_GYRODEFINED", &tempfloat,
                          file, qid, __FILE__, __LINE__) ) {return 1;}
     sim->fix_gyrodef_nstep = (int)tempfloat;
+    if( hdf5_read_double(OPTPATH "FIXEDSTEP_CONSERVE_INVARIANTS", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    sim->fix_conserve_invariants = (int)tempfloat;
 
 
     if( hdf5_read_double(OPTPATH "ADAPTIVE_TOL_ORBIT", &sim->ada_tol_orbfol,
@@ -88,6 +99,12 @@ int hdf5_options_read(hid_t file, sim_offload_data* sim, char* qid){
                          file, qid, __FILE__, __LINE__) ) {return 1;}
     if( hdf5_read_double(OPTPATH "ADAPTIVE_MAX_DPHI", &sim->ada_max_dphi,
                          file, qid, __FILE__, __LINE__) ) {return 1;}
+    if( hdf5_read_double(OPTPATH "ADAPTIVE_ORBIT_METHOD", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    sim->ada_orbfol_method = (int)tempfloat;
+    if( hdf5_read_double(OPTPATH "ENABLE_SIMD_GROUPING", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    sim->enable_simdgrouping = (int)tempfloat;
 
 
     if( hdf5_read_double(OPTPATH "ENABLE_ORBIT_FOLLOWING", &tempfloat,
@@ -114,6 +131,27 @@ int hdf5_options_read(hid_t file, sim_offload_data* sim, char* qid){
     if( hdf5_read_double(OPTPATH "DISABLE_GCDIFF_CCOLL", &tempfloat,
                          file, qid, __FILE__, __LINE__) ) {return 1;}
     sim->disable_gcdiffccoll = (int)tempfloat;
+    if( hdf5_read_double(OPTPATH "ENABLE_TABULATED_CCOLL", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    sim->enable_tabulatedccoll = (int)tempfloat;
+    if( hdf5_read_double(OPTPATH "ENABLE_CCOLL_CACHE", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    sim->enable_ccollcache = (int)tempfloat;
+    if( hdf5_read_double(OPTPATH "CCOLL_CACHE_DRHO", &(sim->ccollcache_drho),
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    if( hdf5_read_double(OPTPATH "CCOLL_CACHE_DEKIN", &(sim->ccollcache_dekin),
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    if( hdf5_read_double(OPTPATH "CCOLL_CACHE_DT", &(sim->ccollcache_dt),
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    if( hdf5_read_double(OPTPATH "ENABLE_CCOLL_SUBCYCLE", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    sim->enable_ccollsubcycle = (int)tempfloat;
+    if( hdf5_read_double(OPTPATH "ENABLE_ORBITAVG_CCOLL", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    sim->enable_orbitavgccoll = (int)tempfloat;
+    if( hdf5_read_double(OPTPATH "ORBITAVG_CCOLL_MAXCHANGE",
+                         &(sim->orbitavgccoll_maxchange),
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
     if( hdf5_read_double(OPTPATH "REVERSE_TIME", &tempfloat,
                          file, qid, __FILE__, __LINE__) ) {return 1;}
     sim->reverse_time = (int)tempfloat;
@@ -216,12 +254,18 @@ int hdf5_options_read(hid_t file, sim_offload_data* sim, char* qid){
     if( hdf5_read_double(OPTPATH "ENABLE_DIST_COM", &tempfloat,
                          file, qid, __FILE__, __LINE__) ) {return 1;}
     diag->distCOM_collect = (int)tempfloat;
+    if( hdf5_read_double(OPTPATH "ENABLE_DIST_MOMENTS", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    diag->distmom_collect = (int)tempfloat;
     if( hdf5_read_double(OPTPATH "ENABLE_ORBITWRITE", &tempfloat,
                          file, qid, __FILE__, __LINE__) ) {return 1;}
     diag->diagorb_collect = (int)tempfloat;
     if( hdf5_read_double(OPTPATH "ENABLE_TRANSCOEF", &tempfloat,
                          file, qid, __FILE__, __LINE__) ) {return 1;}
     diag->diagtrcof_collect = (int)tempfloat;
+    if( hdf5_read_double(OPTPATH "ENABLE_WALLLOAD", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    diag->diagwall_collect = (int)tempfloat;
 
     /* Read individual diagnostics data */
     if(diag->dist5D_collect) {
@@ -249,6 +293,37 @@ int hdf5_options_read(hid_t file, sim_offload_data* sim, char* qid){
             return 1;
         }
     }
+    if(diag->distmom_collect) {
+        if( hdf5_options_read_distmoments(file, &diag->distmom, qid) ) {
+            return 1;
+        }
+    }
+
+    diag->distaccum.mode   = DIST_ACCUM_ATOMIC;
+    diag->distaccum.maxmem = 0;
+    if(diag->dist5D_collect || diag->dist6D_collect || diag->distrho5D_collect
+       || diag->distrho6D_collect || diag->distCOM_collect
+       || diag->distmom_collect) {
+        if( hdf5_read_double(OPTPATH "DIST_ACCUMULATION", &tempfloat,
+                             file, qid, __FILE__, __LINE__) ) {return 1;}
+        diag->distaccum.mode = (int)tempfloat;
+        if( hdf5_read_double(OPTPATH "DIST_PRIVATE_MAXMEM",
+                             &diag->distaccum.maxmem,
+                             file, qid, __FILE__, __LINE__) ) {return 1;}
+    }
+
+    diag->dist_sparse = 0;
+    if(diag->dist6D_collect || diag->distrho6D_collect) {
+        if( hdf5_read_double(OPTPATH "DIST_SPARSE", &tempfloat,
+                             file, qid, __FILE__, __LINE__) ) {return 1;}
+        diag->dist_sparse = (int)tempfloat;
+#ifdef TARGET
+        if(diag->dist_sparse) {
+            print_err("Error: DIST_SPARSE is not supported when offloading.\n");
+            return 1;
+        }
+#endif
+    }
     if(diag->diagorb_collect) {
         diag->diagorb.record_mode = sim->sim_mode;
         if(sim->record_mode && (sim->sim_mode == simulate_mode_fo ||
@@ -267,6 +342,54 @@ int hdf5_options_read(hid_t file, sim_offload_data* sim, char* qid){
         }
     }
 
+    if(diag->diagwall_collect) {
+        if( hdf5_options_read_diagwall(file, &diag->diagwall, qid) ) {
+            return 1;
+        }
+    }
+
+    if( hdf5_read_double(OPTPATH "ENABLE_VARIANCE", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    diag->variance_collect = (int)tempfloat;
+
+    if( hdf5_read_double(OPTPATH "CONVERGENCE_TARGET", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    sim->convergence_target = (int)tempfloat;
+    if(sim->convergence_target != DIAG_CONVERGENCE_NONE) {
+        if( hdf5_read_double(OPTPATH "CONVERGENCE_RELERR",
+                             &sim->convergence_relerr,
+                             file, qid, __FILE__, __LINE__) ) {return 1;}
+        if( hdf5_read_double(OPTPATH "CONVERGENCE_BATCH", &tempfloat,
+                             file, qid, __FILE__, __LINE__) ) {return 1;}
+        sim->convergence_batch = (int)tempfloat;
+
+        int dist = diag->dist5D_collect || diag->distrho5D_collect
+            || diag->distCOM_collect || diag->distmom_collect
+            || ( !diag->dist_sparse
+                 && (diag->dist6D_collect || diag->distrho6D_collect) );
+        if(sim->convergence_target == DIAG_CONVERGENCE_DIST && !dist) {
+            print_err("Error: CONVERGENCE_TARGET requires a distribution.\n");
+            return 1;
+        }
+        if( ( sim->convergence_target == DIAG_CONVERGENCE_WALLPOWER
+              || sim->convergence_target == DIAG_CONVERGENCE_WALLPEAK )
+            && !diag->diagwall_collect ) {
+            print_err("Error: CONVERGENCE_TARGET requires wall loads.\n");
+            return 1;
+        }
+        if(sim->convergence_target > DIAG_CONVERGENCE_WALLPEAK) {
+            print_err("Error: Unknown CONVERGENCE_TARGET.\n");
+            return 1;
+        }
+        if(sim->convergence_batch < 1) {
+            print_err("Error: CONVERGENCE_BATCH must be at least one.\n");
+            return 1;
+        }
+
+        /* The error is evaluated from the second moments */
+        diag->variance_collect = 1;
+    }
+
     return 0;
 }
 
@@ -640,6 +763,54 @@ int hdf5_options_read_distCOM(hid_t file, dist_COM_offload_data* dist,
     return 0;
 }
 
+/**
+ * @brief Helper function to read moment profile settings from HDF5 file
+ *
+ * The moments share the rho, theta, and time abscissae with the rho
+ * distributions.
+ *
+ * @param file the file where settings are read
+ * @param dist pointer to moment profile offload data
+ * @param qid QID of the options to be read
+ *
+ * @return zero if reading succeeded.
+ */
+int hdf5_options_read_distmoments(hid_t file,
+                                  dist_moments_offload_data* dist, char* qid) {
+    #undef OPTPATH
+    #define OPTPATH "/options/opt_XXXXXXXXXX/"
+
+    real tempfloat;
+
+    if( hdf5_read_double(OPTPATH "DIST_MIN_RHO", &dist->min_rho,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    if( hdf5_read_double(OPTPATH "DIST_MAX_RHO", &dist->max_rho,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    if( hdf5_read_double(OPTPATH "DIST_NBIN_RHO", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    dist->n_rho = (int)tempfloat;
+
+    if( hdf5_read_double(OPTPATH "DIST_MIN_THETA", &dist->min_theta,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    if( hdf5_read_double(OPTPATH "DIST_MAX_THETA", &dist->max_theta,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    if( hdf5_read_double(OPTPATH "DIST_NBIN_THETA", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    dist->n_theta = (int)tempfloat;
+    dist->min_theta = math_deg2rad(dist->min_theta);
+    dist->max_theta = math_deg2rad(dist->max_theta);
+
+    if( hdf5_read_double(OPTPATH "DIST_MIN_TIME", &dist->min_time,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    if( hdf5_read_double(OPTPATH "DIST_MAX_TIME", &dist->max_time,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    if( hdf5_read_double(OPTPATH "DIST_NBIN_TIME", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    dist->n_time = (int)tempfloat;
+
+    return 0;
+}
+
 /**
  * @brief Helper function to read orbit diagnostics settings from HDF5 file
  *
@@ -666,7 +837,18 @@ int hdf5_options_read_diagorb(hid_t file, diag_orb_offload_data* diagorb,
     if( hdf5_read_double(OPTPATH "ORBITWRITE_INTERVAL",
                          &(diagorb->writeInterval),
                          file, qid, __FILE__, __LINE__) ) {return 1;}
-
+    if( hdf5_read_double(OPTPATH "ORBITWRITE_COMPACT", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    diagorb->compact = (int)tempfloat;
+    if( hdf5_read_double(OPTPATH "ORBITWRITE_STREAM", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    diagorb->stream = (int)tempfloat;
+#ifdef TARGET
+    if(diagorb->stream) {
+        print_err("Error: ORBITWRITE_STREAM is not supported when offloading.\n");
+        return 1;
+    }
+#endif
 
 
     for(int i=0; i < DIAG_ORB_MAXPOINCARES; i++) {
@@ -752,3 +934,33 @@ int hdf5_options_read_diagtrcof(hid_t file,
     return 0;
 }
 
+/**
+ * @brief Helper function to read wall load diagnostics settings from HDF5 file
+ *
+ * The number of wall elements is not an option but is set from the wall
+ * input before the diagnostics are initialized.
+ *
+ * @param file the file where data is read
+ * @param diagwall pointer to wall load diagnostics offload data
+ * @param qid QID of the data that is read
+ *
+ * @return zero if reading succeeded
+ */
+int hdf5_options_read_diagwall(hid_t file,
+                               diag_wallload_offload_data* diagwall,
+                               char* qid) {
+    #undef OPTPATH
+    #define OPTPATH "/options/opt_XXXXXXXXXX/"
+
+    real tempfloat;
+    if( hdf5_read_double(OPTPATH "WALLLOAD_NANGLE", &tempfloat,
+                         file, qid, __FILE__, __LINE__) ) {return 1;}
+    diagwall->nangle = (int)tempfloat;
+    if(diagwall->nangle < 1) {
+        print_err("Error: WALLLOAD_NANGLE must be at least one.\n");
+        return 1;
+    }
+    diagwall->nelement = 0;
+
+    return 0;
+}
@@ -16,13 +16,137 @@
 #include "../consts.h"
 #include "hdf5_orbit.h"
 
-void hdf5_orbit_writeset(hid_t group,  const char* name, const char* unit,
-                         int type, int arraylength, real confac,
-                         integer* mask, integer size, real* data);
+/**
+ * @brief Deflate level of compactly written orbit datasets
+ */
+#define HDF5_ORBIT_DEFLATE 4
+
+/**
+ * @brief Orbit dataset name, unit, types, and unit conversion factor
+ *
+ * The type is double (0), int (1), integer (2), or float (3). The compact type
+ * is used when the orbits are written in single precision, and when they are
+ * written compactly but without loss of precision, unless it is float.
+ * Cumulative quantities, such as the mileage and angles, are kept in double
+ * precision as their values grow large compared with their increments.
+ */
+typedef struct {
+    const char* name; /**< Name of the dataset                               */
+    const char* unit; /**< Unit of the dataset                               */
+    int type;         /**< Type of the dataset                               */
+    int compact;      /**< Type of the dataset when written compactly        */
+    real confac;      /**< Factor the data is multiplied with before writing */
+} hdf5_orbit_field;
+
+/**
+ * @brief Marker ID and the index of its first recorded point
+ */
+typedef struct {
+    real id;       /**< Marker ID                                            */
+    integer index; /**< Index of the first point of the marker in the array  */
+} hdf5_orbit_key;
+
+/** @brief Datasets in the order of the fields in FO mode */
+const hdf5_orbit_field hdf5_orbit_fields_fo[DIAG_ORB_FOFIELDS] = {
+    {"ids",     "1",      1, 1, 1},
+    {"mileage", "s",      0, 0, 1},
+    {"r",       "m",      0, 3, 1},
+    {"phi",     "deg",    0, 0, 180.0/CONST_PI},
+    {"z",       "m",      0, 3, 1},
+    {"pr",      "kg*m/s", 0, 3, 1},
+    {"pphi",    "kg*m/s", 0, 3, 1},
+    {"pz",      "kg*m/s", 0, 3, 1},
+    {"weight",  "1",      0, 3, 1},
+    {"charge",  "e",      2, 1, 1.0/CONST_E},
+    {"rho",     "1",      0, 3, 1},
+    {"theta",   "deg",    0, 0, 180.0/CONST_PI},
+    {"br",      "T",      0, 3, 1},
+    {"bphi",    "T",      0, 3, 1},
+    {"bz",      "T",      0, 3, 1},
+    {"simmode", "1",      1, 1, 1}
+};
+
+/** @brief Datasets in the order of the fields in GC mode */
+const hdf5_orbit_field hdf5_orbit_fields_gc[DIAG_ORB_GCFIELDS] = {
+    {"ids",     "1",      1, 1, 1},
+    {"mileage", "s",      0, 0, 1},
+    {"r",       "m",      0, 3, 1},
+    {"phi",     "deg",    0, 0, 180.0/CONST_PI},
+    {"z",       "m",      0, 3, 1},
+    {"ppar",    "kg*m/s", 0, 3, 1},
+    {"mu",      "eV/T",   0, 3, 1.0/CONST_E},
+    {"zeta",    "rad",    0, 3, 1},
+    {"weight",  "1",      0, 3, 1},
+    {"charge",  "e",      2, 1, 1.0/CONST_E},
+    {"rho",     "1",      0, 3, 1},
+    {"theta",   "deg",    0, 0, 180.0/CONST_PI},
+    {"br",      "T",      0, 3, 1},
+    {"bphi",    "T",      0, 3, 1},
+    {"bz",      "T",      0, 3, 1},
+    {"simmode", "1",      1, 1, 1}
+};
+
+/** @brief Datasets in the order of the fields in ML mode */
+const hdf5_orbit_field hdf5_orbit_fields_ml[DIAG_ORB_MLFIELDS] = {
+    {"ids",     "1",      1, 1, 1},
+    {"mileage", "s",      0, 0, 1},
+    {"r",       "m",      0, 3, 1},
+    {"phi",     "deg",    0, 0, 180.0/CONST_PI},
+    {"z",       "m",      0, 3, 1},
+    {"rho",     "1",      0, 3, 1},
+    {"theta",   "deg",    0, 0, 180.0/CONST_PI},
+    {"br",      "T",      0, 3, 1},
+    {"bphi",    "T",      0, 3, 1},
+    {"bz",      "T",      0, 3, 1},
+    {"simmode", "1",      1, 1, 1}
+};
+
+/** @brief Datasets in the order of the fields in hybrid mode */
+const hdf5_orbit_field hdf5_orbit_fields_hybrid[DIAG_ORB_HYBRIDFIELDS] = {
+    {"ids",     "1",      1, 1, 1},
+    {"mileage", "s",      0, 0, 1},
+    {"r",       "m",      0, 3, 1},
+    {"phi",     "deg",    0, 0, 180.0/CONST_PI},
+    {"z",       "m",      0, 3, 1},
+    {"pr",      "kg*m/s", 0, 3, 1},
+    {"pphi",    "kg*m/s", 0, 3, 1},
+    {"pz",      "kg*m/s", 0, 3, 1},
+    {"ppar",    "kg*m/s", 0, 3, 1},
+    {"mu",      "eV/T",   0, 3, 1.0/CONST_E},
+    {"zeta",    "rad",    0, 3, 1},
+    {"weight",  "1",      0, 3, 1},
+    {"charge",  "e",      2, 1, 1.0/CONST_E},
+    {"rho",     "1",      0, 3, 1},
+    {"theta",   "deg",    0, 0, 180.0/CONST_PI},
+    {"br",      "T",      0, 3, 1},
+    {"bphi",    "T",      0, 3, 1},
+    {"bz",      "T",      0, 3, 1},
+    {"simmode", "1",      1, 1, 1}
+};
+
+/** @brief Datasets that follow the fields in Poincare mode */
+const hdf5_orbit_field hdf5_orbit_fields_poincare[2] = {
+    {"pncrid",  "1",      2, 1, 1},
+    {"pncrdi",  "1",      2, 1, 1}
+};
+
+int hdf5_orbit_nfld(diag_orb_offload_data* data);
+const hdf5_orbit_field* hdf5_orbit_field_at(diag_orb_offload_data* data,
+                                            int ifld);
+int hdf5_orbit_order(diag_orb_offload_data* data, real* orbits,
+                     integer* order);
+int hdf5_orbit_compare(const void* a, const void* b);
+int hdf5_orbit_appendset(hid_t group, const hdf5_orbit_field* field,
+                         int compact, hsize_t chunk, int size, real* orbits,
+                         void* buffer);
 
 /**
  * @brief Write orbit diagnostics data to a HDF5 file
  *
+ * When the orbits are written compactly, the records are grouped by marker
+ * and ordered by marker ID so that consecutive values in each dataset are
+ * close to each other and compress well.
+ *
  * @param f hdf5 file
  * @param qid qid of the results group
  * @param data orbit diagnostics offload data
@@ -44,237 +168,341 @@ int hdf5_orbit_write(hid_t f, char* qid, diag_orb_offload_data* data,
     }
 
     int arraylength = data->Nmrk*data->Npnt;
-    int datasize = 0;
-    integer* mask = malloc(arraylength*sizeof(real));
+    integer* order  = malloc(arraylength*sizeof(integer));
+    int datasize    = hdf5_orbit_order(data, orbits, order);
+    real* gathered  = malloc(datasize*sizeof(real));
+    real* buffer    = malloc(datasize*sizeof(real));
+    hsize_t chunk   = datasize < DIAG_ORB_STREAM_NREC ?
+        datasize : DIAG_ORB_STREAM_NREC;
+    if(chunk == 0) {
+        chunk = 1;
+    }
 
-    for(integer i=0; i < arraylength; i++) {
-        mask[i] = orbits[i] > 0;
-        if(mask[i]) {
-            datasize++;
+    int err = 0;
+    for(int i = 0; !err && i < hdf5_orbit_nfld(data); i++) {
+        for(integer j = 0; j < datasize; j++) {
+            gathered[j] = orbits[(integer)arraylength*i + order[j]];
         }
+        err = hdf5_orbit_appendset(group, hdf5_orbit_field_at(data, i),
+                                   data->compact, chunk, datasize, gathered,
+                                   buffer);
     }
 
-    int dtypef64 = 0;
-    int dtypei32 = 1;
-    int dtypei16 = 2;
-    if(data->record_mode == simulate_mode_fo) {
-
-        hdf5_orbit_writeset(group,  "ids", "1", dtypei32, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*0]);
-        hdf5_orbit_writeset(group,  "mileage", "s", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*1]);
-        hdf5_orbit_writeset(group,  "r", "m", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*2]);
-        hdf5_orbit_writeset(group,  "phi", "deg", dtypef64, arraylength,
-                            180.0/CONST_PI,
-                            mask, datasize, &orbits[arraylength*3]);
-        hdf5_orbit_writeset(group,  "z", "m", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*4]);
-        hdf5_orbit_writeset(group,  "pr", "kg*m/s", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*5]);
-        hdf5_orbit_writeset(group,  "pphi", "kg*m/s", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*6]);
-        hdf5_orbit_writeset(group,  "pz", "kg*m/s", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*7]);
-        hdf5_orbit_writeset(group,  "weight", "1", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*8]);
-        hdf5_orbit_writeset(group,  "charge", "e", dtypei16, arraylength,
-                            1.0/CONST_E,
-                            mask, datasize, &orbits[arraylength*9]);
-        hdf5_orbit_writeset(group,  "rho", "1", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*10]);
-        hdf5_orbit_writeset(group,  "theta", "deg", dtypef64, arraylength,
-                            180.0/CONST_PI,
-                            mask, datasize, &orbits[arraylength*11]);
-        hdf5_orbit_writeset(group,  "br", "T", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*12]);
-        hdf5_orbit_writeset(group,  "bphi", "T", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*13]);
-        hdf5_orbit_writeset(group,  "bz", "T", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*14]);
-        hdf5_orbit_writeset(group,  "simmode", "1", dtypei32, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*15]);
+    free(order);
+    free(gathered);
+    free(buffer);
+    H5Gclose (group);
+
+    return err;
+}
+
+/**
+ * @brief Write streamed orbit records to a HDF5 file as they come
+ *
+ * The orbit group and its datasets are created first, and each chunk of
+ * records that is completed during the simulation is then appended to the
+ * datasets. Returns when all markers have been simulated and the last chunk
+ * is written.
+ *
+ * Chunks must be written for the simulation to proceed, so if writing fails,
+ * the remaining records are discarded.
+ *
+ * @param f hdf5 file
+ * @param path path of the orbit group to be created
+ * @param data orbit diagnostics offload data with the chunk pool
+ *
+ * @return zero on success
+ */
+int hdf5_orbit_stream(hid_t f, const char* path, diag_orb_offload_data* data) {
+    diag_orb_stream* stream = data->chunks;
+    size_t step = (size_t)stream->nchunk * stream->nrec;
 
+    int err = 0;
+    hid_t group = H5Gcreate2(f, path, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    if(group < 0) {
+        err = 1;
+    }
+    for(int i = 0; !err && i < hdf5_orbit_nfld(data); i++) {
+        err = hdf5_orbit_appendset(group, hdf5_orbit_field_at(data, i),
+                                   data->compact, stream->nrec, 0, NULL, NULL);
     }
 
-    if(data->record_mode == simulate_mode_gc) {
-        hdf5_orbit_writeset(group,  "ids", "1", dtypei32, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*0]);
-        hdf5_orbit_writeset(group,  "mileage", "s", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*1]);
-        hdf5_orbit_writeset(group,  "r", "m", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*2]);
-        hdf5_orbit_writeset(group,  "phi", "deg", dtypef64, arraylength,
-                            180.0/CONST_PI,
-                            mask, datasize, &orbits[arraylength*3]);
-        hdf5_orbit_writeset(group,  "z", "m", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*4]);
-        hdf5_orbit_writeset(group,  "ppar", "kg*m/s", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*5]);
-        hdf5_orbit_writeset(group,  "mu", "eV/T", dtypef64, arraylength,
-                            1.0/CONST_E,
-                            mask, datasize, &orbits[arraylength*6]);
-        hdf5_orbit_writeset(group,  "zeta", "rad", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*7]);
-        hdf5_orbit_writeset(group,  "weight", "1", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*8]);
-        hdf5_orbit_writeset(group,  "charge", "e", dtypei16, arraylength,
-                            1.0/CONST_E,
-                            mask, datasize, &orbits[arraylength*9]);
-        hdf5_orbit_writeset(group,  "rho", "1", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*10]);
-        hdf5_orbit_writeset(group,  "theta", "deg", dtypef64, arraylength,
-                            180.0/CONST_PI,
-                            mask, datasize, &orbits[arraylength*11]);
-        hdf5_orbit_writeset(group,  "br", "T", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*12]);
-        hdf5_orbit_writeset(group,  "bphi", "T", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*13]);
-        hdf5_orbit_writeset(group,  "bz", "T", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*14]);
-        hdf5_orbit_writeset(group,  "simmode", "1", dtypei32, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*15]);
+    real* buffer = malloc(stream->nrec * sizeof(real));
+    int ichunk;
+    while( (ichunk = diag_orb_stream_next(stream)) >= 0 ) {
+        int n = stream->count[ichunk];
+        for(int i = 0; !err && n > 0 && i < hdf5_orbit_nfld(data); i++) {
+            err = hdf5_orbit_appendset(
+                group, hdf5_orbit_field_at(data, i), data->compact,
+                stream->nrec, n,
+                &stream->pool[i*step + (size_t)ichunk*stream->nrec], buffer);
+        }
+        diag_orb_stream_release(stream, ichunk);
     }
+    free(buffer);
 
-    if(data->record_mode == simulate_mode_ml) {
-        hdf5_orbit_writeset(group,  "ids", "1", dtypei32, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*0]);
-        hdf5_orbit_writeset(group,  "mileage", "s", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*1]);
-        hdf5_orbit_writeset(group,  "r", "m", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*2]);
-        hdf5_orbit_writeset(group,  "phi", "deg", dtypef64, arraylength,
-                            180.0/CONST_PI,
-                            mask, datasize, &orbits[arraylength*3]);
-        hdf5_orbit_writeset(group,  "z", "m", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*4]);
-        hdf5_orbit_writeset(group,  "rho", "1", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*5]);
-        hdf5_orbit_writeset(group,  "theta", "deg", dtypef64, arraylength,
-                            180.0/CONST_PI,
-                            mask, datasize, &orbits[arraylength*6]);
-        hdf5_orbit_writeset(group,  "br", "T", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*7]);
-        hdf5_orbit_writeset(group,  "bphi", "T", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*8]);
-        hdf5_orbit_writeset(group,  "bz", "T", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*9]);
-        hdf5_orbit_writeset(group,  "simmode", "1", dtypei32, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*10]);
+    if(group >= 0) {
+        H5Gclose(group);
     }
+    return err != 0;
+}
 
-    if(data->record_mode == simulate_mode_hybrid) {
-        hdf5_orbit_writeset(group,  "ids", "1", dtypei32, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*0]);
-        hdf5_orbit_writeset(group,  "mileage", "s", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*1]);
-        hdf5_orbit_writeset(group,  "r", "m", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*2]);
-        hdf5_orbit_writeset(group,  "phi", "deg", dtypef64, arraylength,
-                            180.0/CONST_PI,
-                            mask, datasize, &orbits[arraylength*3]);
-        hdf5_orbit_writeset(group,  "z", "m", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*4]);
-        hdf5_orbit_writeset(group,  "pr", "kg*m/s", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*5]);
-        hdf5_orbit_writeset(group,  "pphi", "kg*m/s", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*6]);
-        hdf5_orbit_writeset(group,  "pz", "kg*m/s", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*7]);
-        hdf5_orbit_writeset(group,  "ppar", "kg*m/s", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*8]);
-        hdf5_orbit_writeset(group,  "mu", "eV/T", dtypef64, arraylength,
-                            1.0/CONST_E,
-                            mask, datasize, &orbits[arraylength*9]);
-        hdf5_orbit_writeset(group,  "zeta", "rad", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*10]);
-        hdf5_orbit_writeset(group,  "weight", "1", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*11]);
-        hdf5_orbit_writeset(group,  "charge", "e", dtypei16, arraylength,
-                            1.0/CONST_E,
-                            mask, datasize, &orbits[arraylength*12]);
-        hdf5_orbit_writeset(group,  "rho", "1", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*13]);
-        hdf5_orbit_writeset(group,  "theta", "deg", dtypef64, arraylength,
-                            180.0/CONST_PI,
-                            mask, datasize, &orbits[arraylength*14]);
-        hdf5_orbit_writeset(group,  "br", "T", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*15]);
-        hdf5_orbit_writeset(group,  "bphi", "T", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*16]);
-        hdf5_orbit_writeset(group,  "bz", "T", dtypef64, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*17]);
-        hdf5_orbit_writeset(group,  "simmode", "1", dtypei32, arraylength, 1,
-                            mask, datasize, &orbits[arraylength*18]);
+/**
+ * @brief Append orbits streamed to another file to the results of this run
+ *
+ * The datasets are copied in blocks so that they need not fit in memory.
+ *
+ * @param f hdf5 file
+ * @param qid qid of the results group
+ * @param data orbit diagnostics offload data
+ * @param fin hdf5 file where the orbits were streamed
+ * @param path path of the orbit group in fin
+ *
+ * @return zero on success
+ */
+int hdf5_orbit_merge(hid_t f, char* qid, diag_orb_offload_data* data,
+                     hid_t fin, const char* path) {
+    char outpath[256];
+    hdf5_generate_qid_path("/results/run_XXXXXXXXXX/", qid, outpath);
+    strcat(outpath, "orbit");
 
+    hid_t group   = H5Gopen2(f, outpath, H5P_DEFAULT);
+    hid_t ingroup = H5Gopen2(fin, path, H5P_DEFAULT);
+    if(group < 0 || ingroup < 0) {
+        if(group >= 0) {
+            H5Gclose(group);
+        }
+        if(ingroup >= 0) {
+            H5Gclose(ingroup);
+        }
+        return 1;
     }
 
-    if(data->mode == DIAG_ORB_POINCARE) {
-        hdf5_orbit_writeset(group,  "pncrid", "1", dtypei16, arraylength, 1,
-                            mask, datasize, &orbits[arraylength * data->Nfld]);
-        hdf5_orbit_writeset(group,  "pncrdi", "1", dtypei16, arraylength, 1,
-                            mask, datasize, &orbits[arraylength * (data->Nfld+1)]);
+    /* No dataset type has more than eight bytes per element */
+    hsize_t block = DIAG_ORB_STREAM_NREC;
+    void* buffer = malloc(block * 8);
+
+    int err = 0;
+    for(int i = 0; !err && i < hdf5_orbit_nfld(data); i++) {
+        const char* name = hdf5_orbit_field_at(data, i)->name;
+        hid_t dataset = H5Dopen2(ingroup, name, H5P_DEFAULT);
+        if(dataset < 0) {
+            err = 1;
+            break;
+        }
+        hid_t type      = H5Dget_type(dataset);
+        hid_t filespace = H5Dget_space(dataset);
+        hsize_t length;
+        H5Sget_simple_extent_dims(filespace, &length, NULL);
+
+        for(hsize_t start = 0; !err && start < length; start += block) {
+            hsize_t count = length - start < block ? length - start : block;
+            hid_t memspace = H5Screate_simple(1, &count, NULL);
+            H5Sselect_hyperslab(filespace, H5S_SELECT_SET, &start, NULL,
+                                &count, NULL);
+            if( H5Dread(dataset, type, memspace, filespace, H5P_DEFAULT,
+                        buffer) < 0
+                || hdf5_append_extendible_dataset(
+                    group, name, type, block,
+                    data->compact ? HDF5_ORBIT_DEFLATE : -1, count, buffer) ) {
+                err = 1;
+            }
+            H5Sclose(memspace);
+        }
+
+        H5Sclose(filespace);
+        H5Tclose(type);
+        H5Dclose(dataset);
     }
 
-    free(mask);
-    H5Gclose (group);
+    free(buffer);
+    H5Gclose(ingroup);
+    H5Gclose(group);
+    return err;
+}
 
-    return 0;
+/**
+ * @brief Number of datasets in the orbit group
+ *
+ * @param data orbit diagnostics offload data
+ *
+ * @return number of datasets
+ */
+int hdf5_orbit_nfld(diag_orb_offload_data* data) {
+    if(data->mode == DIAG_ORB_POINCARE) {
+        return data->Nfld + 2;
+    }
+    return data->Nfld;
 }
 
 /**
- * @brief Helper function for writing orbit diagnostic datasets
+ * @brief Dataset that stores the given orbit field
  *
- * @param group HDF5 group where dataset is written
- * @param name name the data is wrote with
- * @param unit unit the the data is wrote with
- * @param type is data double (0), int (1), or integer (2)
- * @param arraylength length of the orbit data array
- * @param confac unit conversion factor orbits is multiplied before writing
- * @param mask flag array indicating which elements in orbits array contain data
- * @param size number of data elements
+ * @param data orbit diagnostics offload data
+ * @param ifld index of the field in the orbit data
+ *
+ * @return pointer to dataset name, unit, type, and conversion factor
+ */
+const hdf5_orbit_field* hdf5_orbit_field_at(diag_orb_offload_data* data,
+                                            int ifld) {
+    if(ifld >= data->Nfld) {
+        return &hdf5_orbit_fields_poincare[ifld - data->Nfld];
+    }
+    switch(data->record_mode) {
+        case simulate_mode_fo:
+            return &hdf5_orbit_fields_fo[ifld];
+        case simulate_mode_gc:
+            return &hdf5_orbit_fields_gc[ifld];
+        case simulate_mode_ml:
+            return &hdf5_orbit_fields_ml[ifld];
+        default:
+            return &hdf5_orbit_fields_hybrid[ifld];
+    }
+}
+
+/**
+ * @brief Order in which the recorded points are written
+ *
+ * The points of each marker are stored in a ring buffer, so by default they
+ * are written in the order they are found in the array. When written
+ * compactly, the markers are ordered by ID and the points of each marker in
+ * the order they were recorded, starting from the oldest point in the ring
+ * buffer.
+ *
+ * @param data orbit diagnostics offload data
  * @param orbits orbit data array
+ * @param order array where the indices of the recorded points are stored
+ *
+ * @return number of recorded points
  */
-void hdf5_orbit_writeset(hid_t group,  const char* name, const char* unit,
-                         int type, int arraylength, real confac,
-                         integer* mask, integer size, real* orbits) {
-    if(type == 0) {
-        real* data = (real*) malloc(size * sizeof(real));
-        integer j = 0;
-        for(integer i = 0; i < arraylength; i++) {
-            if(mask[i]) {
-                data[j] = confac*orbits[i];
-                j++;
+int hdf5_orbit_order(diag_orb_offload_data* data, real* orbits,
+                     integer* order) {
+    real* id      = orbits;
+    real* mileage = &orbits[(integer)data->Nmrk*data->Npnt];
+
+    int n = 0;
+    if(!data->compact) {
+        for(integer i = 0; i < (integer)data->Nmrk*data->Npnt; i++) {
+            if(id[i] > 0) {
+                order[n++] = i;
             }
         }
-        hdf5_write_extendible_dataset_double(group, name, size, data);
-        H5LTset_attribute_string(group, name, "unit", unit);
-        free(data);
+        return n;
     }
-    else if(type == 1) {
-        int* data = (int*) malloc(size * sizeof(int));
-        integer j = 0;
-        for(integer i = 0; i < arraylength; i++) {
-            if(mask[i]) {
-                data[j] = (int)(confac*orbits[i]);
-                j++;
+
+    /* Sort markers by ID */
+    hdf5_orbit_key* mrk = malloc(data->Nmrk*sizeof(hdf5_orbit_key));
+    int nmrk = 0;
+    for(integer imrk = 0; imrk < data->Nmrk; imrk++) {
+        for(integer i = imrk*data->Npnt; i < (imrk+1)*data->Npnt; i++) {
+            if(id[i] > 0) {
+                mrk[nmrk].id    = id[i];
+                mrk[nmrk].index = i;
+                nmrk++;
+                break;
             }
         }
-        hdf5_write_extendible_dataset_int(group, name, size, data);
-        H5LTset_attribute_string(group, name, "unit", unit);
-        free(data);
     }
-    else if(type == 2) {
-        integer* data = (integer*) malloc(size * sizeof(integer));
-        integer j = 0;
-        for(integer i = 0; i < arraylength; i++) {
-            if(mask[i]) {
-                data[j] = (integer)(confac*orbits[i]);
-                j++;
+    qsort(mrk, nmrk, sizeof(hdf5_orbit_key), hdf5_orbit_compare);
+
+    /* Points of each marker start from the one with the smallest mileage */
+    for(int k = 0; k < nmrk; k++) {
+        integer first = mrk[k].index;
+        integer base  = first - first % data->Npnt;
+        for(integer i = base; i < base + data->Npnt; i++) {
+            if(id[i] > 0 && mileage[i] < mileage[first]) {
+                first = i;
+            }
+        }
+        for(integer ipnt = 0; ipnt < data->Npnt; ipnt++) {
+            integer i = base + ( first - base + ipnt ) % data->Npnt;
+            if(id[i] > 0) {
+                order[n++] = i;
             }
         }
-        hdf5_write_extendible_dataset_long(group, name, size, data);
-        H5LTset_attribute_string(group, name, "unit", unit);
-        free(data);
     }
+    free(mrk);
+    return n;
+}
+
+/**
+ * @brief Compare markers by their ID for sorting
+ *
+ * @param a pointer to the first marker key
+ * @param b pointer to the second marker key
+ *
+ * @return negative, zero, or positive when the first ID is smaller, equal, or
+ *         larger
+ */
+int hdf5_orbit_compare(const void* a, const void* b) {
+    real ida = ((const hdf5_orbit_key*)a)->id;
+    real idb = ((const hdf5_orbit_key*)b)->id;
+    return (ida > idb) - (ida < idb);
+}
+
+/**
+ * @brief Helper function for appending to orbit diagnostic datasets
+ *
+ * The dataset is created, with the unit as an attribute, if it does not exist.
+ * When written compactly, the data is stored in the compact type of the
+ * dataset and compressed.
+ *
+ * @param group HDF5 group where dataset is written
+ * @param field dataset name, unit, types, and conversion factor
+ * @param compact lossless (1) or single precision (2) compact output, or zero
+ * @param chunk chunk size of the dataset if it is created
+ * @param size number of data elements
+ * @param orbits orbit data array
+ * @param buffer array of size elements for converting the data
+ *
+ * @return zero on success
+ */
+int hdf5_orbit_appendset(hid_t group, const hdf5_orbit_field* field,
+                         int compact, hsize_t chunk, int size, real* orbits,
+                         void* buffer) {
+    int exists = H5Lexists(group, field->name, H5P_DEFAULT) > 0;
+
+    int ftype = field->type;
+    if(compact == 2 || (compact == 1 && field->compact != 3)) {
+        ftype = field->compact;
+    }
+
+    hid_t type = H5T_IEEE_F64LE;
+    if(ftype == 0) {
+        real* data = buffer;
+        for(integer i = 0; i < size; i++) {
+            data[i] = field->confac*orbits[i];
+        }
+    }
+    else if(ftype == 1) {
+        type = H5T_STD_I32LE;
+        int* data = buffer;
+        for(integer i = 0; i < size; i++) {
+            data[i] = (int)(field->confac*orbits[i]);
+        }
+    }
+    else if(ftype == 2) {
+        type = H5T_STD_I64LE;
+        integer* data = buffer;
+        for(integer i = 0; i < size; i++) {
+            data[i] = (integer)(field->confac*orbits[i]);
+        }
+    }
+    else if(ftype == 3) {
+        type = H5T_IEEE_F32LE;
+        float* data = buffer;
+        for(integer i = 0; i < size; i++) {
+            data[i] = (float)(field->confac*orbits[i]);
+        }
+    }
+
+    if( hdf5_append_extendible_dataset(group, field->name, type, chunk,
+                                       compact ? HDF5_ORBIT_DEFLATE : -1,
+                                       size, buffer) ) {
+        return 1;
+    }
+    if(!exists) {
+        H5LTset_attribute_string(group, field->name, "unit", field->unit);
+    }
+    return 0;
 }
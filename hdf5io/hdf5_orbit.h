@@ -11,5 +11,8 @@
 
 int hdf5_orbit_write(hid_t f, char* qid, diag_orb_offload_data* diag,
                      real* orbits);
+int hdf5_orbit_stream(hid_t f, const char* path, diag_orb_offload_data* diag);
+int hdf5_orbit_merge(hid_t f, char* qid, diag_orb_offload_data* diag,
+                     hid_t fin, const char* path);
 
 #endif
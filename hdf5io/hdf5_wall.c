@@ -16,6 +16,7 @@
 #include "../wall/wall_3d.h"
 #include "hdf5_wall.h"
 #include "hdf5_helpers.h"
+#include "../print.h"
 
 #define WPATH /**< Macro that is used to store paths to data groups */
 
@@ -23,6 +24,8 @@ int hdf5_wall_read_2D(hid_t f, wall_2d_offload_data* offload_data,
                       real** offload_array, char* qid);
 int hdf5_wall_read_3D(hid_t f, wall_3d_offload_data* offload_data,
                       real** offload_array, char* qid);
+int hdf5_wall_read_3D_tree(hid_t f, wall_3d_offload_data* offload_data,
+                           real* offload_array, int** tree_array, char* qid);
 
 /**
  * @brief Read wall data from HDF5 file
@@ -31,6 +34,9 @@ int hdf5_wall_read_3D(hid_t f, wall_3d_offload_data* offload_data,
  * data and allocating and filling offload array. The file is opened and closed
  * outside this function.
  *
+ * If the 3D wall group contains an octree array stored by an earlier run, it
+ * is used instead of constructing the octree again.
+ *
  * @param f HDF5 file from which data is read
  * @param offload_data pointer to offload data
  * @param offload_array pointer to offload array
@@ -62,7 +68,19 @@ int hdf5_wall_init_offload(hid_t f, wall_offload_data* offload_data,
     }
 
     /* Initialize if data was read succesfully */
-    if(!err) {
+    if(!err && offload_data->type == wall_type_3D
+       && !hdf5_wall_read_3D_tree(f, &(offload_data->w3d), *offload_array,
+                                  int_offload_array, qid)) {
+        wall_3d_init_soa(&(offload_data->w3d), offload_array,
+                         *int_offload_array);
+        wall_3d_init_dist(&(offload_data->w3d), offload_array,
+                          *int_offload_array);
+        offload_data->offload_array_length =
+            offload_data->w3d.offload_array_length;
+        offload_data->int_offload_array_length =
+            offload_data->w3d.int_offload_array_length;
+    }
+    else if(!err) {
         err = wall_init_offload(offload_data, offload_array, int_offload_array);
     }
 
@@ -198,6 +216,91 @@ int hdf5_wall_read_3D(hid_t f, wall_3d_offload_data* offload_data,
 }
 
 
+/**
+ * @brief Read precomputed 3D wall octree from HDF5 file
+ *
+ * The octree array is stored in the wall group by hdf5_wall_write_3D_tree()
+ * so it belongs to the wall with the given QID. It is only used if it was
+ * constructed with the current octree depth WALL_OCTREE_DEPTH.
+ *
+ * @param f HDF5 file from which data is read
+ * @param offload_data pointer to offload data with the triangles already read
+ * @param offload_array offload array containing the triangles
+ * @param tree_array pointer to the octree array that is allocated here
+ * @param qid QID of the data
+ *
+ * @return Zero if the octree was found and read
+ */
+int hdf5_wall_read_3D_tree(hid_t f, wall_3d_offload_data* offload_data,
+                           real* offload_array, int** tree_array, char* qid) {
+    #undef WPATH
+    #define WPATH "/wall/wall_3D_XXXXXXXXXX/"
+
+    char path[256];
+    hdf5_gen_path(WPATH "tree_array", qid, path);
+    if(H5Lexists(f, path, H5P_DEFAULT) <= 0) {
+        return 1;
+    }
+
+    int depth;
+    hsize_t length;
+    if( H5LTget_attribute_int(f, path, "depth", &depth) < 0
+        || H5LTget_dataset_info(f, path, &length, NULL, NULL) < 0 ) {
+        return 1;
+    }
+
+    int ngrid = 1 << (WALL_OCTREE_DEPTH - 1);
+    if(depth != WALL_OCTREE_DEPTH || length < 2*ngrid*ngrid*ngrid) {
+        return 1;
+    }
+
+    *tree_array = (int*) malloc(length * sizeof(int));
+    if( H5LTread_dataset_int(f, path, *tree_array) < 0 ) {
+        free(*tree_array);
+        return 1;
+    }
+    wall_3d_init_grid(offload_data, offload_array);
+    offload_data->int_offload_array_length = length;
+    print_out(VERBOSE_IO, "Using the octree stored with the wall data.\n");
+
+    return 0;
+}
+
+/**
+ * @brief Write 3D wall octree to HDF5 file
+ *
+ * The octree array is stored in the group of the wall it was constructed
+ * for, so that later runs using the same wall can read it instead of
+ * constructing it. Nothing is written if the group already contains one.
+ *
+ * @param f HDF5 file to which data is written
+ * @param offload_data pointer to offload data
+ * @param tree_array octree array
+ * @param qid QID of the wall
+ *
+ * @return Zero if the octree is present in the file after the call
+ */
+int hdf5_wall_write_3D_tree(hid_t f, wall_3d_offload_data* offload_data,
+                            int* tree_array, char* qid) {
+    #undef WPATH
+    #define WPATH "/wall/wall_3D_XXXXXXXXXX/"
+
+    char path[256];
+    hdf5_gen_path(WPATH "tree_array", qid, path);
+    if(H5Lexists(f, path, H5P_DEFAULT) > 0) {
+        return 0;
+    }
+
+    hsize_t length = offload_data->int_offload_array_length;
+    if( H5LTmake_dataset_int(f, path, 1, &length, tree_array) < 0
+        || H5LTset_attribute_int(f, path, "depth", &offload_data->depth, 1)
+           < 0 ) {
+        return 1;
+    }
+
+    return 0;
+}
+
 /**
  * @brief Assign x1x2x3,y1y2y3,z1z2z3 to the offload array
  *
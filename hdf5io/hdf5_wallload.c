@@ -0,0 +1,76 @@
+/**
+ * @file hdf5_wallload.c
+ * @brief Module for writing wall loads to a HDF5 file
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <hdf5.h>
+#include <hdf5_hl.h>
+#include "hdf5_helpers.h"
+#include "../ascot5.h"
+#include "../diag/diag_wallload.h"
+#include "hdf5_wallload.h"
+
+/**
+ * @brief Write wall loads to a HDF5 file
+ *
+ * Fluxes and powers are written for every wall element, including those that
+ * received no load, so that the element index is the position in the array.
+ *
+ * @param f hdf5 file
+ * @param qid qid of the results group
+ * @param data wall load diagnostics offload data
+ * @param wallarr array storing the wall load data [flux, power, angle] and
+ *        the sums of squares [flux2, power2] if collected
+ *
+ * @return zero on success
+ */
+int hdf5_wallload_write(hid_t f, char* qid, diag_wallload_offload_data* data,
+                        real* wallarr) {
+    char path[256];
+    hdf5_generate_qid_path("/results/run_XXXXXXXXXX/", qid, path);
+    strcat(path, "wallload");
+
+    hid_t group = H5Gcreate2(f, path, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+
+    if(group < 0) {
+        return 1;
+    }
+
+    int nel = data->nelement;
+    hsize_t dims1d[1] = {nel};
+    hsize_t dims2d[2] = {nel, data->nangle};
+    hsize_t dimsedge[1] = {data->nangle + 1};
+
+    real* edges = (real*) malloc((data->nangle + 1) * sizeof(real));
+    for(int i = 0; i <= data->nangle; i++) {
+        edges[i] = i * 90.0 / data->nangle;
+    }
+
+    herr_t err = 0;
+    err |= H5LTmake_dataset_double(group, "flux", 1, dims1d, &wallarr[0]);
+    err |= H5LTmake_dataset_double(group, "power", 1, dims1d, &wallarr[nel]);
+    err |= H5LTmake_dataset_double(group, "angle", 2, dims2d,
+                                   &wallarr[2*nel]);
+    err |= H5LTmake_dataset_double(group, "angle_edges", 1, dimsedge, edges);
+    free(edges);
+    if(data->variance) {
+        int n = ( 2 + data->nangle ) * nel;
+        err |= H5LTmake_dataset_double(group, "flux2", 1, dims1d,
+                                       &wallarr[n]);
+        err |= H5LTmake_dataset_double(group, "power2", 1, dims1d,
+                                       &wallarr[n + nel]);
+        H5LTset_attribute_string(group, "flux2", "unit", "particles^2/s^2");
+        H5LTset_attribute_string(group, "power2", "unit", "W^2");
+    }
+
+    /* Write units */
+    H5LTset_attribute_string(group, "flux", "unit", "particles/s");
+    H5LTset_attribute_string(group, "power", "unit", "W");
+    H5LTset_attribute_string(group, "angle", "unit", "particles/s");
+    H5LTset_attribute_string(group, "angle_edges", "unit", "deg");
+
+    H5Gclose (group);
+
+    return err < 0;
+}
@@ -0,0 +1,16 @@
+/**
+ * @file hdf5_wallload.h
+ * @brief Header file for hdf5_wallload.c
+ */
+#ifndef HDF5_WALLLOAD_H
+#define HDF5_WALLLOAD_H
+
+#include <hdf5.h>
+#include "../ascot5.h"
+#include "../diag/diag_wallload.h"
+
+int hdf5_wallload_write(hid_t f, char* qid,
+                        diag_wallload_offload_data* data,
+                        real* wallarr);
+
+#endif
@@ -10,6 +10,7 @@
 #include "../spline/interp.h"
 #include "../B_field.h"
 #include "../math.h"
+#include "../vecmath.h"
 #include "../mhd.h"
 #include "mhd_stat.h"
 
@@ -212,8 +213,8 @@ a5err mhd_stat_eval(real mhd_dmhd[10], real r, real phi, real z, real t,
             - mhddata->mmode[i] * ptz[4]
             - mhddata->omega_nm[i] * t
             + mhddata->phase_nm[i];
-            real sinmhd = sin(mhdarg);
-            real cosmhd = cos(mhdarg);
+            real sinmhd = vecmath_sin(mhdarg);
+            real cosmhd = vecmath_cos(mhdarg);
 
             /* Sum over modes to get alpha, phi */
             mhd_dmhd[0] +=     a_da[0] * mhddata->amplitude_nm[i] * cosmhd;
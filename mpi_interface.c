@@ -9,11 +9,15 @@
 #endif
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include "ascot5.h"
 #include "diag.h"
 #include "mpi_interface.h"
 #include "particle.h"
 #include "simulate.h"
+#include "diag/dist_sparse.h"
+
+int mpi_gather_sparse(dist_sparse* hist, int mpi_rank, int mpi_size);
 
 /**
  * @brief Initialize MPI
@@ -54,6 +58,17 @@ void mpi_interface_init(int argc, char** argv, sim_offload_data* sim,
 #endif
 }
 
+/**
+ * @brief Wait until all MPI processes have reached this point
+ *
+ * Does nothing if compiled without MPI.
+ */
+void mpi_interface_barrier() {
+#ifdef MPI
+    MPI_Barrier(MPI_COMM_WORLD);
+#endif
+}
+
 /**
  * @brief Finalize MPI
  *
@@ -277,20 +292,23 @@ void mpi_gather_particlestate(particle_state* ps, particle_state** psgathered,
  *
  * This function gathers the distributions and orbits to the root process.
  * Distributions are summed and orbit data is appended to the root process
- * diagnostics array.
+ * diagnostics array. Sparse distributions are summed tile by tile.
  *
  * @param diag_offload_data diagnostics offload data
  * @param offload_array pointer to diagnostics offload array
  * @param ntotal total number of markers in the simulation
  * @param mpi_rank rank of this MPI process
  * @param mpi_size total number of MPI processes
+ * @param mpi_root rank of the root process
+ *
+ * @return zero if the diagnostics were gathered successfully
  */
-void mpi_gather_diag(diag_offload_data* data, real* offload_array, int ntotal,
-                     int mpi_rank, int mpi_size, int mpi_root) {
+int mpi_gather_diag(diag_offload_data* data, real* offload_array, int ntotal,
+                    int mpi_rank, int mpi_size, int mpi_root) {
+    int err = 0;
 #ifdef MPI
 
-    if(data->dist5D_collect || data->distrho5D_collect
-       || data->dist6D_collect || data->distrho6D_collect) {
+    if(data->offload_dist_length > 0) {
         if(mpi_rank == 0) {
             MPI_Reduce(MPI_IN_PLACE, offload_array,
                 data->offload_dist_length, mpi_type_real, MPI_SUM,
@@ -302,7 +320,21 @@ void mpi_gather_diag(diag_offload_data* data, real* offload_array, int ntotal,
         }
     }
 
-    if(data->diagorb_collect) {
+    if(data->dist6D_collect && data->dist_sparse) {
+        err += mpi_gather_sparse(&data->dist6D.sparse, mpi_rank, mpi_size);
+    }
+
+    if(data->distrho6D_collect && data->dist_sparse) {
+        err += mpi_gather_sparse(&data->distrho6D.sparse, mpi_rank,
+                                 mpi_size);
+    }
+
+    if(data->diagorb_collect && data->diagorb.stream) {
+        /* Streamed orbits are merged from the files of each process, which
+         * must be complete before the root process reads them */
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+    else if(data->diagorb_collect) {
         if(mpi_rank == 0) {
             for(int i = 1; i < mpi_size; i++) {
                 int start_index, n;
@@ -360,4 +392,110 @@ void mpi_gather_diag(diag_offload_data* data, real* offload_array, int ntotal,
     }
 
 #endif
+    return err;
+}
+
+/**
+ * @brief Sum a sparse histogram to the root process
+ *
+ * Each process sends the indices and contents of the tiles it has allocated,
+ * and the root process adds them to its own histogram. Tiles that were never
+ * updated are not sent. The tiles are sent at most a page of the tile table
+ * at a time, which keeps the buffers small and the message counts within the
+ * range of int.
+ *
+ * A process that cannot allocate its buffers sends an invalid tile count so
+ * that the root does not wait for its tiles, and the root tells the others
+ * not to send anything if its own allocation fails. The root keeps receiving from the
+ * other processes if it fails to add tiles so that they are not left waiting.
+ *
+ * @param hist pointer to sparse histogram
+ * @param mpi_rank rank of this MPI process
+ * @param mpi_size total number of MPI processes
+ *
+ * @return zero if the histogram was summed successfully
+ */
+int mpi_gather_sparse(dist_sparse* hist, int mpi_rank, int mpi_size) {
+    int err = 0;
+#ifdef MPI
+
+    const unsigned long failed = (unsigned long)-1;
+    size_t tilesize = hist->tilesize;
+    size_t nbatch   = DIST_SPARSE_NPAGE;
+    unsigned long* itile = malloc(nbatch * sizeof(unsigned long));
+    real* tiles = malloc(nbatch * tilesize * sizeof(real));
+
+    /* Nothing is sent if the root process has no buffers to receive into */
+    int rootok = itile != NULL && tiles != NULL;
+    MPI_Bcast(&rootok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if(!rootok) {
+        free(itile);
+        free(tiles);
+        return 1;
+    }
+
+    if(mpi_rank == 0) {
+        for(int i = 1; i < mpi_size; i++) {
+            unsigned long n;
+            MPI_Recv(&n, 1, MPI_UNSIGNED_LONG, i, 0, MPI_COMM_WORLD,
+                     MPI_STATUS_IGNORE);
+            if(n == failed) {
+                err = 1;
+                continue;
+            }
+
+            for(unsigned long j0 = 0; j0 < n; j0 += nbatch) {
+                size_t nb = n - j0 < nbatch ? n - j0 : nbatch;
+                MPI_Recv(itile, (int)nb, MPI_UNSIGNED_LONG, i, 0,
+                         MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                MPI_Recv(tiles, (int)(nb * tilesize), mpi_type_real, i, 0,
+                         MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+                for(size_t j = 0; j < nb && !err; j++) {
+                    real* tile = dist_sparse_get_tile(hist, itile[j]);
+                    if(tile == NULL) {
+                        err = 1;
+                        break;
+                    }
+                    for(size_t k = 0; k < tilesize; k++) {
+                        tile[k] += tiles[j * tilesize + k];
+                    }
+                }
+            }
+        }
+    }
+    else {
+        if(itile == NULL || tiles == NULL) {
+            MPI_Send(&failed, 1, MPI_UNSIGNED_LONG, 0, 0, MPI_COMM_WORLD);
+            free(itile);
+            free(tiles);
+            return 1;
+        }
+
+        unsigned long n = dist_sparse_count(hist);
+        MPI_Send(&n, 1, MPI_UNSIGNED_LONG, 0, 0, MPI_COMM_WORLD);
+
+        size_t nb = 0;
+        for(size_t i = 0; i < hist->ntile; i++) {
+            real* tile = dist_sparse_find_tile(hist, i);
+            if(tile != NULL) {
+                itile[nb] = i;
+                memcpy(&tiles[nb * tilesize], tile, tilesize * sizeof(real));
+                nb++;
+            }
+            if(nb == nbatch || ( nb > 0 && i == hist->ntile - 1 )) {
+                MPI_Send(itile, (int)nb, MPI_UNSIGNED_LONG, 0, 0,
+                         MPI_COMM_WORLD);
+                MPI_Send(tiles, (int)(nb * tilesize), mpi_type_real, 0, 0,
+                         MPI_COMM_WORLD);
+                nb = 0;
+            }
+        }
+    }
+
+    free(itile);
+    free(tiles);
+
+#endif
+    return err;
 }
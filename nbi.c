@@ -74,7 +74,7 @@ void nbi_inject(nbi_injector* n, real* x, real* y, real* z, real* vx, real* vy,
 
 void nbi_ionize(real* xyz, real* vxyz, real time, int* shinethrough, int anum, int znum,
                 B_field_data* Bdata, plasma_data* plsdata, wall_data* walldata,
-                random_data* rng) {
+                suzuki_data* suzukidata, random_data* rng) {
     a5err err;
 
     real absv = math_norm(vxyz);
@@ -88,17 +88,7 @@ void nbi_ionize(real* xyz, real* vxyz, real time, int* shinethrough, int anum, i
     real threshold = random_uniform(rng);
     real ds = 1e-3;
 
-    int n_species = plasma_get_n_species(plsdata);
-    const real* pls_mass = plasma_get_species_mass(plsdata);
-    const real* pls_charge = plasma_get_species_charge(plsdata);
-
     real pls_temp[MAX_SPECIES], pls_dens[MAX_SPECIES];
-    int pls_anum[MAX_SPECIES], pls_znum[MAX_SPECIES];
-
-    for(int i = 0; i < n_species; i++) {
-        pls_anum[i] = round(pls_mass[i] / CONST_U);
-        pls_znum[i] = round(pls_charge[i] / CONST_E);
-    }
 
     real s = 0.0;
     int entered_plasma = 0;
@@ -130,13 +120,9 @@ void nbi_ionize(real* xyz, real* vxyz, real time, int* shinethrough, int anum, i
                                           rpz[1], rpz[2], time, plsdata);
 
             if(!err) {
-                rate = pls_dens[0] * 1e-4*suzuki_sigmav(energy / anum,
-                                                        pls_dens[0],
-                                                        pls_temp[0] / CONST_E,
-                                                        n_species-1,
-                                                        pls_dens+1,
-                                                        pls_anum+1,
-                                                        pls_znum+1);
+                rate = pls_dens[0] * 1e-4*suzuki_sigmav_table(
+                    energy / anum, pls_dens[0], pls_temp[0] / CONST_E,
+                    pls_dens+1, suzukidata);
             }
             else {
                 rate = 0.0; /* outside the plasma */
@@ -178,7 +164,8 @@ void nbi_ionize(real* xyz, real* vxyz, real time, int* shinethrough, int anum, i
 
 void nbi_generate(int nprt, real t0, real t1, particle* p, nbi_injector* n,
                   B_field_data* Bdata, plasma_data* plsdata,
-                  wall_data* walldata, random_data* rng) {
+                  wall_data* walldata, suzuki_data* suzukidata,
+                  random_data* rng) {
 
     real totalShined = 0.0;
     real totalIonized = 0.0;
@@ -189,14 +176,20 @@ void nbi_generate(int nprt, real t0, real t1, particle* p, nbi_injector* n,
         int anum, znum;
         real mass;
 
-        real time = t0 + random_uniform(rng) * (t1-t0);
+        /* Each marker draws from its own stream so that the threads do not
+         * share the generator state */
+        random_data rngm = *rng;
+        random_set_stream(&rngm, 0, ((integer) n->id << 32) + i,
+                          RANDOM_STREAM_NBI);
+
+        real time = t0 + random_uniform(&rngm) * (t1-t0);
 
         int shinethrough = 1;
         do {
             nbi_inject(n, &xyz[0], &xyz[1], &xyz[2], &vxyz[0], &vxyz[1],
-                       &vxyz[2], &anum, &znum, &mass, rng);
+                       &vxyz[2], &anum, &znum, &mass, &rngm);
             nbi_ionize(xyz, vxyz, time, &shinethrough, anum, znum, Bdata,
-                   plsdata, walldata, rng);
+                       plsdata, walldata, suzukidata, &rngm);
 
             if(shinethrough == 1) {
                 #pragma omp atomic
@@ -10,6 +10,7 @@
 #include "particle.h"
 #include "plasma.h"
 #include "random.h"
+#include "suzuki.h"
 #include "wall.h"
 
 #define NBI_MAX_DISTANCE 100
@@ -43,9 +44,10 @@ void nbi_inject(nbi_injector* n, real* x, real* y, real* z, real* vx, real* vy,
                 real* vz, int* anum, int* znum, real* mass, random_data* rng);
 void nbi_ionize(real* xyz, real* vxyz, real time, int* shinethrough, int anum, int znum,
                 B_field_data* Bdata, plasma_data* plsdata, wall_data* walldata,
-                random_data* rng);
+                suzuki_data* suzukidata, random_data* rng);
 void nbi_generate(int nprt, real t0, real t1, particle* p, nbi_injector* n,
                   B_field_data* Bdata, plasma_data* plsdata,
-                  wall_data* walldata, random_data* rng);
+                  wall_data* walldata, suzuki_data* suzukidata,
+                  random_data* rng);
 
 #endif
@@ -470,6 +470,95 @@ int particle_cycle_ml(particle_queue* q, particle_simd_ml* p,
     return n_running;
 }
 
+/**
+ * @brief Sort key of a marker in particle_queue_sort()
+ */
+typedef struct {
+    int trapped;         /**< Is the marker trapped                          */
+    int vclass;          /**< Speed class, a factor of sqrt(2) per class     */
+    real rho;            /**< Initial rho                                    */
+    particle_state* p;   /**< The marker                                     */
+} particle_sortkey;
+
+/**
+ * @brief Compare two marker sort keys
+ */
+static int particle_sortkey_cmp(const void* a, const void* b) {
+    const particle_sortkey* ka = (const particle_sortkey*) a;
+    const particle_sortkey* kb = (const particle_sortkey*) b;
+    if(ka->trapped != kb->trapped) {
+        return ka->trapped - kb->trapped;
+    }
+    if(ka->vclass != kb->vclass) {
+        return ka->vclass - kb->vclass;
+    }
+    if(ka->rho != kb->rho) {
+        return ka->rho < kb->rho ? -1 : 1;
+    }
+    return ka->p->id < kb->p->id ? -1 : (ka->p->id > kb->p->id);
+}
+
+/**
+ * @brief Order the marker queue so that consecutive markers need similar steps
+ *
+ * Markers are taken from the queue in order, so markers next to each other in
+ * the queue end up in the same SIMD group. With the adaptive time step the
+ * group is advanced until all of its markers have finished, and markers whose
+ * steps are much shorter or more often rejected than those of the others in
+ * the group keep the rest of the lanes waiting. This function groups the
+ * markers by whether they are trapped, by speed and by rho, which together
+ * determine the step size and how often steps are rejected near bounce
+ * points.
+ *
+ * Whether a guiding center is trapped is estimated from the field at the
+ * high-field side of its flux surface assuming B ~ 1/R. Markers that have
+ * already an error are placed last.
+ *
+ * The markers themselves are not moved, only the pointers in the queue. With
+ * the random number backends whose streams are keyed by marker ID (see
+ * RANDOM_STREAMS in random.h) the simulation results do not depend on the
+ * order. With MKL and GSL, which share one generator, they do.
+ *
+ * @param q pointer to marker queue
+ * @param Bdata pointer to magnetic field data
+ */
+void particle_queue_sort(particle_queue* q, B_field_data* Bdata) {
+    particle_sortkey* keys = malloc(q->n * sizeof(particle_sortkey));
+    for(int i = 0; i < q->n; i++) {
+        particle_state* ps = q->p[i];
+        keys[i].p = ps;
+        keys[i].rho = ps->rho;
+        if(ps->err) {
+            keys[i].trapped = 2;
+            keys[i].vclass  = 0;
+            continue;
+        }
+
+        real B = math_normc(ps->B_r, ps->B_phi, ps->B_z);
+        real axisrz[2];
+        real Bmax = B;
+        if(!B_field_get_axis_rz(axisrz, Bdata, ps->phi)) {
+            real d = sqrt( (ps->r - axisrz[0]) * (ps->r - axisrz[0])
+                         + (ps->z - axisrz[1]) * (ps->z - axisrz[1]) );
+            if(axisrz[0] > d) {
+                Bmax = B * ps->r / (axisrz[0] - d);
+            }
+        }
+        real m2mu = 2 * ps->mass * ps->mu;
+        keys[i].trapped = ps->ppar * ps->ppar < m2mu * (Bmax - B);
+
+        real pnorm = sqrt(ps->ppar * ps->ppar + m2mu * B);
+        real vnorm = physlib_vnorm_pnorm(ps->mass, pnorm);
+        keys[i].vclass = vnorm > 0 ? (int)floor(2 * log2(vnorm)) : 0;
+    }
+
+    qsort(keys, q->n, sizeof(particle_sortkey), particle_sortkey_cmp);
+    for(int i = 0; i < q->n; i++) {
+        q->p[i] = keys[i].p;
+    }
+    free(keys);
+}
+
 /**
  * @brief Converts input marker to a marker state
  *
@@ -407,6 +407,7 @@ int particle_cycle_gc(particle_queue* q, particle_simd_gc* p,
                       B_field_data* Bdata, int* cycle);
 int particle_cycle_ml(particle_queue* q, particle_simd_ml* p,
                       B_field_data* Bdata, int* cycle);
+void particle_queue_sort(particle_queue* q, B_field_data* Bdata);
 
 void particle_input_to_state(input_particle* p, particle_state* ps,
                              B_field_data* Bdata);
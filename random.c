@@ -1,8 +1,38 @@
 /**
  * @file random.c
  * @brief Random number generator interface
+ *
+ * MKL and GSL generators are shared by all threads, and the draws are
+ * serialized with a critical section. The other backends have a generator per
+ * marker slot which random_set_stream() keys with the marker id.
  */
 
+#if defined(RANDOM_DRAND48)
+#define _XOPEN_SOURCE 500 /**< rand48 requires POSIX 1995 standard */
+#endif
+
+#if defined(RANDOM_LCG) || defined(RANDOM_DRAND48)
+
+#include <stdint.h>
+
+/**
+ * @brief Mix the bits of a 64-bit integer (SplitMix64 finalizer)
+ *
+ * Used to derive the initial state of a stream from the seed and the key.
+ *
+ * @param x integer to be mixed
+ *
+ * @return mixed integer
+ */
+static inline uint64_t random_mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+#endif
+
 #if defined(RANDOM_MKL)
 
 #include <mkl_vsl.h>
@@ -14,21 +44,25 @@ void random_mkl_init(random_data* rdata, int seed) {
 
 double random_mkl_uniform(random_data* rdata) {
     double r;
+    #pragma omp critical(random_mkl)
     vdRngUniform(VSL_RNG_METHOD_UNIFORM_STD, rdata->r, 1, &r, 0.0, 1.0);
     return r;
 }
 
 double random_mkl_normal(random_data* rdata) {
     double r;
+    #pragma omp critical(random_mkl)
     vdRngGaussian(VSL_RNG_METHOD_GAUSSIAN_BOXMULLER, rdata->r, 1, &r, 0.0, 1.0);
     return r;
 }
 
 void random_mkl_uniform_simd(random_data* rdata, int n, double* r) {
+    #pragma omp critical(random_mkl)
     vdRngUniform(VSL_RNG_METHOD_UNIFORM_STD, rdata->r, n, r, 0.0, 1.0);
 }
 
 void random_mkl_normal_simd(random_data* rdata, int n, double* r) {
+    #pragma omp critical(random_mkl)
     vdRngGaussian(VSL_RNG_METHOD_GAUSSIAN_BOXMULLER2, rdata->r, n, r, 0.0, 1.0);
 }
 
@@ -36,6 +70,7 @@ void random_mkl_normal_simd(random_data* rdata, int n, double* r) {
 #elif defined(RANDOM_GSL)
 
 #include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
 #include "random.h"
 
 void random_gsl_init(random_data* rdata, int seed) {
@@ -44,22 +79,28 @@ void random_gsl_init(random_data* rdata, int seed) {
 }
 
 double random_gsl_uniform(random_data* rdata) {
-    return gsl_rng_uniform(rdata->r);
+    double r;
+    #pragma omp critical(random_gsl)
+    r = gsl_rng_uniform(rdata->r);
+    return r;
 }
 
 double random_gsl_normal(random_data* rdata) {
-    return gsl_ran_gaussian(rdata->r, 1.0);
+    double r;
+    #pragma omp critical(random_gsl)
+    r = gsl_ran_gaussian(rdata->r, 1.0);
+    return r;
 }
 
 void random_gsl_uniform_simd(random_data* rdata, int n, double* r) {
-    #pragma omp simd
+    #pragma omp critical(random_gsl)
     for(int i = 0; i < n; i++) {
         r[i] = gsl_rng_uniform(rdata->r);
     }
 }
 
 void random_gsl_normal_simd(random_data* rdata, int n, double* r) {
-    #pragma omp simd
+    #pragma omp critical(random_gsl)
     for(int i = 0; i < n; i++) {
         r[i] = gsl_ran_gaussian(rdata->r, 1.0);
     }
@@ -73,150 +114,405 @@ void random_gsl_normal_simd(random_data* rdata, int n, double* r) {
 #include "consts.h"
 #include "random.h"
 
+/**
+ * @brief Initialize generator
+ *
+ * Slot i gets stream i until random_lcg_set_stream() is called.
+ *
+ * @param rdata pointer to generator data
+ * @param seed seed the streams are derived from
+ */
 void random_lcg_init(random_data* rdata, uint64_t seed) {
-    rdata->r = seed;
+    rdata->seed = seed;
+    for(int i = 0; i < NSIMD; i++) {
+        rdata->r[i] = random_mix64(seed ^ random_mix64(i));
+    }
 }
 
-uint64_t random_lcg_integer(random_data* rdata) {
+/**
+ * @brief Start stream of a new marker in a slot
+ *
+ * @param rdata pointer to generator data
+ * @param i slot index
+ * @param id marker id
+ * @param tag stream tag, e.g. RANDOM_STREAM_FO or RANDOM_STREAM_GC
+ */
+void random_lcg_set_stream(random_data* rdata, int i, integer id, int tag) {
+    uint64_t key = (uint64_t)id | ( (uint64_t)tag << 56 );
+    rdata->r[i] = random_mix64(rdata->seed ^ random_mix64(key));
+}
+
+/**
+ * @brief Advance the generator of slot i
+ */
+uint64_t random_lcg_integer(random_data* rdata, int i) {
     /* parameters from https://nuclear.llnl.gov/CNP/rng/rngman/node4.html */
     uint64_t a = 2862933555777941757;
     uint64_t b = 3037000493;
-    rdata->r = (a * rdata->r + b);
-    return rdata->r;
+    rdata->r[i] = (a * rdata->r[i] + b);
+    return rdata->r[i];
+}
+
+/**
+ * @brief Uniform random number in (0, 1) from the generator of slot i
+ */
+static inline double random_lcg_unit(random_data* rdata, int i) {
+    return ( (random_lcg_integer(rdata, i) >> 11) + 0.5 ) * 0x1.0p-53;
 }
 
+/**
+ * @brief Pair of normal random numbers from the generator of slot i
+ */
+static inline void random_lcg_pair(random_data* rdata, int i,
+                                   double* r1, double* r2) {
+#if A5_CCOL_USE_GEOBM == 1
+    /* The geometric form */
+    double x1, x2, w = 2.0;
+    while( w >= 1.0 ) {
+        x1 = 2*random_lcg_unit(rdata, i)-1;
+        x2 = 2*random_lcg_unit(rdata, i)-1;
+        w = x1*x1 + x2*x2;
+    }
+    w = sqrt( (-2 * log( w ) ) / w );
+    *r1 = x1 * w;
+    *r2 = x2 * w;
+#else
+    /* The common form */
+    double x1 = random_lcg_unit(rdata, i);
+    double x2 = random_lcg_unit(rdata, i);
+    double w = sqrt(-2*log(x1));
+    *r1 = w*cos(CONST_2PI*x2);
+    *r2 = w*sin(CONST_2PI*x2);
+#endif
+}
+
+/**
+ * @brief Draw uniform random number from the stream of slot 0
+ */
 double random_lcg_uniform(random_data* rdata) {
-    double r;
-    random_lcg_uniform_simd(rdata, 1, &r);
-    return r;
+    return random_lcg_unit(rdata, 0);
 }
 
+/**
+ * @brief Draw normal random number from the stream of slot 0
+ */
 double random_lcg_normal(random_data* rdata) {
-    double r;
-    random_lcg_normal_simd(rdata, 1, &r);
-    return r;
+    double r1, r2;
+    random_lcg_pair(rdata, 0, &r1, &r2);
+    return r1;
 }
 
+/**
+ * @brief Draw uniform random numbers to r[k*NSIMD + i] from slot i
+ */
 void random_lcg_uniform_simd(random_data* rdata, int n, double* r) {
-#ifdef SIMD
-    #pragma omp simd
-#endif
-    for(int i = 0; i < n; i++) {
-        r[i] = (double) random_lcg_integer(rdata) / UINT64_MAX;
+    for(int k = 0; k < n; k++) {
+        r[k] = random_lcg_unit(rdata, k % NSIMD);
     }
 }
 
+/**
+ * @brief Draw normal random numbers to r[k*NSIMD + i] from slot i
+ *
+ * Each slot gives numbers in pairs, the second one going to the next row.
+ * Slots whose numbers are not used in the last partial row do not advance
+ * their stream.
+ */
 void random_lcg_normal_simd(random_data* rdata, int n, double* r) {
-    double x1, x2, w; /* Helper variables */
-    int isEven = (n+1) % 2; /* Indicates if even number of random numbers are requested */
+    for(int k = 0; k < n; k += 2*NSIMD) {
+        int m = n - k;
+        for(int i = 0; i < NSIMD && i < m; i++) {
+            double r1, r2;
+            random_lcg_pair(rdata, i, &r1, &r2);
+            r[k + i] = r1;
+            if(NSIMD + i < m) {
+                r[k + NSIMD + i] = r2;
+            }
+        }
+    }
+}
+
+
+#elif defined(RANDOM_DRAND48)
+
+#include <stdlib.h>
+#include <math.h>
+#include "consts.h"
+#include "random.h"
+
+/**
+ * @brief Set the 48-bit state of slot i
+ */
+static inline void random_drand48_seed(random_data* rdata, int i,
+                                       uint64_t x) {
+    rdata->x[i][0] = (unsigned short)x;
+    rdata->x[i][1] = (unsigned short)(x >> 16);
+    rdata->x[i][2] = (unsigned short)(x >> 32);
+}
+
+/**
+ * @brief Initialize generator
+ *
+ * Slot i gets stream i until random_drand48_set_stream() is called.
+ *
+ * @param rdata pointer to generator data
+ * @param seed seed the streams are derived from
+ */
+void random_drand48_init(random_data* rdata, long seed) {
+    rdata->seed = seed;
+    for(int i = 0; i < NSIMD; i++) {
+        random_drand48_seed(rdata, i,
+                            random_mix64((uint64_t)seed ^ random_mix64(i)));
+    }
+}
 
+/**
+ * @brief Start stream of a new marker in a slot
+ *
+ * @param rdata pointer to generator data
+ * @param i slot index
+ * @param id marker id
+ * @param tag stream tag, e.g. RANDOM_STREAM_FO or RANDOM_STREAM_GC
+ */
+void random_drand48_set_stream(random_data* rdata, int i, integer id,
+                               int tag) {
+    uint64_t key = (uint64_t)id | ( (uint64_t)tag << 56 );
+    random_drand48_seed(rdata, i,
+                        random_mix64((uint64_t)rdata->seed ^ random_mix64(key)));
+}
+
+/**
+ * @brief Pair of normal random numbers from the generator of slot i
+ */
+static inline void random_drand48_pair(random_data* rdata, int i,
+                                       double* r1, double* r2) {
 #if A5_CCOL_USE_GEOBM == 1
     /* The geometric form */
-#ifdef SIMD
-    #pragma omp simd
-#endif
-    for(int i = 0; i < n; i=i+2) {
-        w = 2.0;
-        while( w >= 1.0 ) {
-            x1 = 2*random_lcg_uniform(rdata)-1;
-            x2 = 2*random_lcg_uniform(rdata)-1;
-            w = x1*x1 + x2*x2;
-        }
-
-        w = sqrt( (-2 * log( w ) ) / w );
-        r[i] = x1 * w;
-        if((i < n-2) || (isEven > 0)) {
-            r[i+1] = x2 * w;
-        }
+    double x1, x2, w = 2.0;
+    while( w >= 1.0 || w == 0.0 ) {
+        x1 = 2*erand48(rdata->x[i])-1;
+        x2 = 2*erand48(rdata->x[i])-1;
+        w = x1*x1 + x2*x2;
     }
+    w = sqrt( (-2 * log( w ) ) / w );
+    *r1 = x1 * w;
+    *r2 = x2 * w;
 #else
     /* The common form */
-    double s;
-#ifdef SIMD
-    #pragma omp simd
+    double x1 = 1.0 - erand48(rdata->x[i]);
+    double x2 = erand48(rdata->x[i]);
+    double w = sqrt(-2*log(x1));
+    *r1 = w*cos(CONST_2PI*x2);
+    *r2 = w*sin(CONST_2PI*x2);
 #endif
-    for(int i = 0; i < n; i=i+2) {
-        x1 = random_lcg_uniform(rdata);
-        x2 = random_lcg_uniform(rdata);
-        w = sqrt(-2*log(x1));
-        s = cos(CONST_2PI*x2);
-        r[i] = w*s;
-        if((i < n-2) || (isEven > 0) ) {
-            if(x2 < 0.5) {
-                r[i+1] = w*sqrt(1-s*s);
-            }
-            else {
-                r[i+1] = -w*sqrt(1-s*s);
+}
+
+/**
+ * @brief Draw uniform random number from the stream of slot 0
+ */
+double random_drand48_uniform(random_data* rdata) {
+    return erand48(rdata->x[0]);
+}
+
+/**
+ * @brief Draw normal random number from the stream of slot 0
+ */
+double random_drand48_normal(random_data* rdata) {
+    double r1, r2;
+    random_drand48_pair(rdata, 0, &r1, &r2);
+    return r1;
+}
+
+/**
+ * @brief Draw uniform random numbers to r[k*NSIMD + i] from slot i
+ */
+void random_drand48_uniform_simd(random_data* rdata, int n, double* r) {
+    for(int k = 0; k < n; k++) {
+        r[k] = erand48(rdata->x[k % NSIMD]);
+    }
+}
+
+/**
+ * @brief Draw normal random numbers to r[k*NSIMD + i] from slot i
+ *
+ * Each slot gives numbers in pairs, the second one going to the next row.
+ * Slots whose numbers are not used in the last partial row do not advance
+ * their stream.
+ */
+void random_drand48_normal_simd(random_data* rdata, int n, double* r) {
+    for(int k = 0; k < n; k += 2*NSIMD) {
+        int m = n - k;
+        for(int i = 0; i < NSIMD && i < m; i++) {
+            double r1, r2;
+            random_drand48_pair(rdata, i, &r1, &r2);
+            r[k + i] = r1;
+            if(NSIMD + i < m) {
+                r[k + NSIMD + i] = r2;
             }
         }
     }
-#endif
 }
 
 
-#else /* No RNG lib defined, use drand48 */
+#else /* No RNG lib defined, use Philox4x32-10 */
 
-#define _XOPEN_SOURCE 500 /**< rand48 requires POSIX 1995 standard */
-
-#include <stdlib.h>
+#include <stdint.h>
 #include <math.h>
 #include "consts.h"
+#include "vecmath.h"
 #include "random.h"
 
-double random_drand48_normal() {
-    double r;
-    random_drand48_normal_simd(1, &r);
-    return r;
+/** Philox4x32 multipliers and Weyl sequence constants for the key schedule */
+#define RANDOM_PHILOX_M0 0xD2511F53u
+#define RANDOM_PHILOX_M1 0xCD9E8D57u
+#define RANDOM_PHILOX_W0 0x9E3779B9u
+#define RANDOM_PHILOX_W1 0xBB67AE85u
+
+/** Bit pattern of 1.0 */
+#define RANDOM_PHILOX_ONE 0x3ff0000000000000ULL
+
+/**
+ * @brief Evaluate Philox4x32-10 block
+ *
+ * @param ctr block number within the stream
+ * @param stream stream id
+ * @param key generator key
+ * @param u1 first uniform random number in (0, 1]
+ * @param u2 second uniform random number in [0, 1)
+ */
+#pragma omp declare simd uniform(key)
+static inline void random_philox_block(uint64_t ctr, uint64_t stream, uint64_t key,
+                                double* u1, double* u2) {
+    uint32_t c0 = (uint32_t)ctr;
+    uint32_t c1 = (uint32_t)(ctr >> 32);
+    uint32_t c2 = (uint32_t)stream;
+    uint32_t c3 = (uint32_t)(stream >> 32);
+    uint32_t k0 = (uint32_t)key;
+    uint32_t k1 = (uint32_t)(key >> 32);
+
+    #pragma GCC unroll 10
+    for(int round = 0; round < 10; round++) {
+        uint64_t p0 = (uint64_t)RANDOM_PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t)RANDOM_PHILOX_M1 * c2;
+        c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t)p1;
+        c3 = (uint32_t)p0;
+        k0 += RANDOM_PHILOX_W0;
+        k1 += RANDOM_PHILOX_W1;
+    }
+
+    /* 52 random bits are placed in the mantissa of a number in [1, 2),
+     * which avoids integer to double conversions that lack vector
+     * instructions before AVX-512 */
+    union {uint64_t i; double d;} v1, v2;
+    v1.i = RANDOM_PHILOX_ONE | ( ( (uint64_t)c0 << 20 ) ^ ( c1 >> 12 ) );
+    v2.i = RANDOM_PHILOX_ONE | ( ( (uint64_t)c2 << 20 ) ^ ( c3 >> 12 ) );
+    *u1 = 2.0 - v1.d;
+    *u2 = v2.d - 1.0;
 }
 
-void random_drand48_uniform_simd(int n, double* r) {
-    #pragma omp simd
-    for(int i = 0; i < n; i++) {
-        r[i] = drand48();
+/**
+ * @brief Initialize generator
+ *
+ * Slot i gets stream i until random_philox_set_stream() is called.
+ *
+ * @param rdata pointer to generator data
+ * @param seed seed used as the key
+ */
+void random_philox_init(random_data* rdata, uint64_t seed) {
+    rdata->seed = seed;
+    for(int i = 0; i < NSIMD; i++) {
+        rdata->ctr[i]    = 0;
+        rdata->stream[i] = i;
     }
 }
 
-void random_drand48_normal_simd(int n, double* r) {
-    double x1, x2, w; /* Helper variables */
-    int isEven = (n+1) % 2; /* Indicates if even number of random numbers are requested */
+/**
+ * @brief Start stream of a new marker in a slot
+ *
+ * @param rdata pointer to generator data
+ * @param i slot index
+ * @param id marker id
+ * @param tag stream tag, RANDOM_STREAM_FO or RANDOM_STREAM_GC
+ */
+void random_philox_set_stream(random_data* rdata, int i, integer id, int tag) {
+    rdata->ctr[i]    = 0;
+    rdata->stream[i] = (uint64_t)id | ( (uint64_t)tag << 56 );
+}
+
+/**
+ * @brief Draw uniform random number from the stream of slot 0
+ */
+double random_philox_uniform(random_data* rdata) {
+    double u1, u2;
+    random_philox_block(rdata->ctr[0]++, rdata->stream[0], rdata->seed,
+                        &u1, &u2);
+    return u2;
+}
 
-#if A5_CCOL_USE_GEOBM == 1
-    /* The geometric form */
-    #pragma omp simd
-    for(int i = 0; i < n; i=i+2) {
-        w = 2.0;
-        while( w >= 1.0 ) {
-            x1 = 2*drand48()-1;
-            x2 = 2*drand48()-1;
-            w = x1*x1 + x2*x2;
-        }
+/**
+ * @brief Draw normal random number from the stream of slot 0
+ */
+double random_philox_normal(random_data* rdata) {
+    double r;
+    random_philox_normal_simd(rdata, 1, &r);
+    return r;
+}
 
-        w = sqrt( (-2 * log( w ) ) / w );
-        r[i] = x1 * w;
-        if((i < n-2) || (isEven > 0)) {
-            r[i+1] = x2 * w;
+/**
+ * @brief Draw uniform random numbers to r[k*NSIMD + i] from slot i
+ *
+ * Each block gives two numbers. Slots whose numbers are not used in the last
+ * partial row do not advance their stream.
+ */
+void random_philox_uniform_simd(random_data* rdata, int n, double* r) {
+    uint64_t key = rdata->seed;
+    double a[2*NSIMD];
+    for(int k = 0; k < n; k += 2*NSIMD) {
+        int m = n - k;
+        #pragma omp simd
+        for(int i = 0; i < NSIMD; i++) {
+            double u1, u2;
+            random_philox_block(rdata->ctr[i], rdata->stream[i], key,
+                                &u1, &u2);
+            rdata->ctr[i] += (i < m);
+            a[i]         = 1.0 - u1;
+            a[NSIMD + i] = u2;
+        }
+        for(int i = 0; i < 2*NSIMD && i < m; i++) {
+            r[k + i] = a[i];
         }
     }
-#else
-    /* The common form */
-    double s;
-    #pragma omp simd
-    for(int i = 0; i < n; i=i+2) {
-        x1 = drand48(rdata);
-        x2 = drand48(rdata);
-        w = sqrt(-2*log(x1));
-        s = cos(CONST_2PI*x2);
-        r[i] = w*s;
-        if((i < n-2) || (isEven > 0) ) {
-            if(x2 < 0.5) {
-                r[i+1] = w*sqrt(1-s*s);
-            }
-            else {
-                r[i+1] = -w*sqrt(1-s*s);
-            }
+}
+
+/**
+ * @brief Draw normal random numbers to r[k*NSIMD + i] from slot i
+ *
+ * Box-Muller transform in the common form; each block gives two numbers.
+ * Slots whose numbers are not used in the last partial row do not advance
+ * their stream.
+ */
+void random_philox_normal_simd(random_data* rdata, int n, double* r) {
+    uint64_t key = rdata->seed;
+    double a[2*NSIMD];
+    for(int k = 0; k < n; k += 2*NSIMD) {
+        int m = n - k;
+        #pragma omp simd
+        for(int i = 0; i < NSIMD; i++) {
+            double u1, u2, s, c;
+            random_philox_block(rdata->ctr[i], rdata->stream[i], key,
+                                &u1, &u2);
+            rdata->ctr[i] += (i < m);
+            double w = sqrt( -2.0 * vecmath_log(u1) );
+            vecmath_sincos(CONST_2PI * u2, &s, &c);
+            a[i]         = w * c;
+            a[NSIMD + i] = w * s;
+        }
+        for(int i = 0; i < 2*NSIMD && i < m; i++) {
+            r[k + i] = a[i];
         }
     }
-#endif
 }
 
 #endif
@@ -5,6 +5,15 @@
 #ifndef RANDOM_H
 #define RANDOM_H
 
+#include "ascot5.h"
+
+/** @brief Stream tags that keep the streams of the same marker independent
+ *  when it is simulated in different loops (e.g. in hybrid mode) */
+#define RANDOM_STREAM_FO 1
+#define RANDOM_STREAM_GC 2
+#define RANDOM_STREAM_NBI 3
+#define RANDOM_STREAM_AFSI 4
+
 #if defined(RANDOM_MKL)
 
 #include <mkl_vsl.h>
@@ -29,6 +38,9 @@ void random_mkl_normal_simd(random_data* rdata, int n, double* r);
 #define random_normal(data) random_mkl_normal(data)
 #define random_uniform_simd(data, n, r) random_mkl_uniform_simd(data, n, r)
 #define random_normal_simd(data, n, r) random_mkl_normal_simd(data, n, r)
+/* All threads draw from the same MKL stream, one at a time, so the streams
+ * are not keyed by marker */
+#define random_set_stream(data, i, id, tag) ((void)0)
 
 
 #elif defined(RANDOM_GSL)
@@ -50,19 +62,34 @@ void random_gsl_normal_simd(random_data* rdata, int n, double* r);
 #define random_normal(data) random_gsl_normal(data)
 #define random_uniform_simd(data, n, r) random_gsl_uniform_simd(data, n, r)
 #define random_normal_simd(data, n, r) random_gsl_normal_simd(data, n, r)
+/* All threads draw from the same GSL generator, one at a time, so the streams
+ * are not keyed by marker */
+#define random_set_stream(data, i, id, tag) ((void)0)
 
 
 #elif defined(RANDOM_LCG)
 
+#define RANDOM_STREAMS /**< Streams can be keyed with random_set_stream() */
+
 #include <stdint.h>
 
+/**
+ * @brief Linear congruential generators, one per marker slot
+ *
+ * random_set_stream() seeds the generator of a slot from the seed, the marker
+ * id and the tag, so that a marker draws the same numbers regardless of the
+ * thread or slot that simulates it. The *_simd functions fill r[k*NSIMD + i]
+ * from the generator of slot i.
+ */
 #pragma omp declare target
 typedef struct {
-    uint64_t r;
+    uint64_t seed;       /**< Seed the streams are derived from   */
+    uint64_t r[NSIMD];   /**< State of the generator of each slot */
 } random_data;
 
 void random_lcg_init(random_data* rdata, uint64_t seed);
-uint64_t random_lcg_integer(random_data* rdata);
+void random_lcg_set_stream(random_data* rdata, int i, integer id, int tag);
+uint64_t random_lcg_integer(random_data* rdata, int i);
 double random_lcg_uniform(random_data* rdata);
 double random_lcg_normal(random_data* rdata);
 void random_lcg_uniform_simd(random_data* rdata, int n, double* r);
@@ -73,26 +100,90 @@ void random_lcg_normal_simd(random_data* rdata, int n, double* r);
 #define random_normal(data) random_lcg_normal(data)
 #define random_uniform_simd(data, n, r) random_lcg_uniform_simd(data, n, r)
 #define random_normal_simd(data, n, r) random_lcg_normal_simd(data, n, r)
+#define random_set_stream(data, i, id, tag) \
+    random_lcg_set_stream(data, i, id, tag)
 
 #pragma omp end declare target
 
 
-#else /* No RNG lib defined, use drand48 */
+#elif defined(RANDOM_DRAND48)
+
+#define RANDOM_STREAMS /**< Streams can be keyed with random_set_stream() */
 
 //#define _XOPEN_SOURCE 500
 #include <stdlib.h>
 
-typedef void* random_data;
+/**
+ * @brief rand48 generators, one per marker slot
+ *
+ * The generators are advanced with erand48() so that each slot has a state of
+ * its own; otherwise as with the LCG backend.
+ */
+typedef struct {
+    long seed;                  /**< Seed the streams are derived from   */
+    unsigned short x[NSIMD][3]; /**< State of the generator of each slot */
+} random_data;
+
+void random_drand48_init(random_data* rdata, long seed);
+void random_drand48_set_stream(random_data* rdata, int i, integer id, int tag);
+double random_drand48_uniform(random_data* rdata);
+double random_drand48_normal(random_data* rdata);
+void random_drand48_uniform_simd(random_data* rdata, int n, double* r);
+void random_drand48_normal_simd(random_data* rdata, int n, double* r);
+
+#define random_init(data, seed) random_drand48_init(data, seed)
+#define random_uniform(data) random_drand48_uniform(data)
+#define random_normal(data) random_drand48_normal(data)
+#define random_uniform_simd(data, n, r) random_drand48_uniform_simd(data, n, r)
+#define random_normal_simd(data, n, r) random_drand48_normal_simd(data, n, r)
+#define random_set_stream(data, i, id, tag) \
+    random_drand48_set_stream(data, i, id, tag)
 
-double random_drand48_normal();
-void random_drand48_uniform_simd(int n, double* r);
-void random_drand48_normal_simd(int n, double* r);
 
-#define random_init(data, seed) srand48(seed)
-#define random_uniform(data) drand48()
-#define random_normal(data) random_drand_normal()
-#define random_uniform_simd(data, n, r) random_drand48_uniform_simd(n, r)
-#define random_normal_simd(data, n, r) random_drand48_normal_simd(n, r)
+#else /* No RNG lib defined, use Philox4x32-10 */
+
+#define RANDOM_PHILOX /**< Philox4x32-10 is used                          */
+#define RANDOM_STREAMS /**< Streams can be keyed with random_set_stream() */
+
+#include <stdint.h>
+
+/**
+ * @brief Counter-based random number streams
+ *
+ * Philox4x32-10 (Salmon et al., SC11) maps a 128-bit counter and a 64-bit
+ * key to 128 random bits. The key is the seed and the counter consists of
+ * a stream id and the number of blocks drawn from that stream. There is one
+ * stream per marker slot, and random_set_stream() keys the stream with the
+ * marker id. The random numbers of a marker therefore do not depend on which
+ * thread or process simulates it, or on the order in which the markers are
+ * simulated, and threads do not share any generator state.
+ *
+ * The *_simd functions fill r[k*NSIMD + i] from the stream of slot i.
+ */
+#pragma omp declare target
+typedef struct {
+    uint64_t seed;          /**< Key of the generator                        */
+    uint64_t ctr[NSIMD];    /**< Number of blocks drawn from each stream    */
+    uint64_t stream[NSIMD]; /**< Stream id of each slot                     */
+} random_data;
+
+void random_philox_init(random_data* rdata, uint64_t seed);
+#pragma omp declare simd uniform(rdata)
+void random_philox_set_stream(random_data* rdata, int i, integer id, int tag);
+double random_philox_uniform(random_data* rdata);
+double random_philox_normal(random_data* rdata);
+void random_philox_uniform_simd(random_data* rdata, int n, double* r);
+void random_philox_normal_simd(random_data* rdata, int n, double* r);
+
+#define random_init(data, seed) random_philox_init(data, seed)
+#define random_uniform(data) random_philox_uniform(data)
+#define random_normal(data) random_philox_normal(data)
+#define random_uniform_simd(data, n, r) random_philox_uniform_simd(data, n, r)
+#define random_normal_simd(data, n, r) random_philox_normal_simd(data, n, r)
+#define random_set_stream(data, i, id, tag) \
+    random_philox_set_stream(data, i, id, tag)
+
+#pragma omp end declare target
 
 #endif
 
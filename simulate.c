@@ -12,6 +12,8 @@
  * marker and diagnostic data.
  */
 #define _XOPEN_SOURCE
+#include <math.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include "endcond.h"
@@ -23,14 +25,20 @@
 #include "print.h"
 #include "simulate/simulate_ml_adaptive.h"
 #include "simulate/simulate_gc_adaptive.h"
+#include "simulate/simulate_gc_orbitavg.h"
 #include "simulate/simulate_gc_fixed.h"
 #include "simulate/simulate_fo_fixed.h"
+#include "simulate/simulate_fo_adaptive.h"
 #include "simulate/mccc/mccc.h"
 #include "gctransform.h"
 
 #pragma omp declare target
 void sim_init(sim_data* sim, sim_offload_data* offload_data);
 void sim_monitor(char* filename, volatile int* n, volatile int* finished);
+void sim_run(particle_queue* pq, sim_data* sim);
+void sim_run_converge(particle_queue* pq, sim_data* sim,
+                      sim_offload_data* sim_offload, real* diag_offload_array,
+                      char* targetname, volatile int* n_monitor);
 #pragma omp end declare target
 
 /**
@@ -52,15 +60,16 @@ void sim_monitor(char* filename, volatile int* n, volatile int* finished);
  *    monitoring is active.
  *
  * 5. Other threads execute marker simulation using the mode the user has
- *    chosen.
+ *    chosen. If the simulation is to end once the target quantity has
+ *    converged, markers are simulated in batches until it has.
  *
  * -  Process continues once all markers have been simulated and each thread has
  *    finished. Monitoring is also terminated.
  *
  * 6. (If hybrid mode is active) Markers with hybrid end condition active are
  *    placed on a new queue, and they have their end condition deactivated and
- *    they are simulated with simulate_fo_fixed.c until they have met some other
- *    end condition. Threads are spawned and progress is monitored as
+ *    they are simulated with simulate_fo_fixed.c (or simulate_fo_adaptive.c)
+ *    until they have met some other end condition. Threads are spawned and progress is monitored as
  *    previously.
  *
  * 7. Simulation data is deallocated except for data that is mapped back to
@@ -175,6 +184,13 @@ void simulate(
     }
     pq.next = 0;
 
+    /* When simulating until convergence, the markers are sorted batch by
+     * batch once they have been shuffled */
+    if(sim.enable_simdgrouping && !sim.convergence_target) {
+        particle_queue_sort(&pq, &sim.B_data);
+    }
+    volatile int n_monitor = pq.n;
+
     random_init(&sim.random_data, 0);
 
     print_out(VERBOSE_NORMAL,"%s: All fields initialized. Simulation begins, %d threads.\n",
@@ -194,26 +210,12 @@ void simulate(
             /*    user has chosen.                                            */
             /*                                                                */
             /******************************************************************/
-            if(pq.n > 0 && (sim.sim_mode == simulate_mode_gc
-                        || sim.sim_mode == simulate_mode_hybrid)) {
-                if(sim.enable_ada) {
-                    #pragma omp parallel
-                    simulate_gc_adaptive(&pq, &sim);
-                }
-                else {
-                    #pragma omp parallel
-                    simulate_gc_fixed(&pq, &sim);
-                }
+            if(pq.n > 0 && sim.convergence_target) {
+                sim_run_converge(&pq, &sim, sim_offload, diag_offload_array,
+                                 targetname, &n_monitor);
             }
-            else if(pq.n > 0 && sim.sim_mode == simulate_mode_fo) {
-
-                #pragma omp parallel
-                simulate_fo_fixed(&pq, &sim);
-            }
-            else if(pq.n > 0 && sim.sim_mode == simulate_mode_ml) {
-
-                #pragma omp parallel
-                simulate_ml_adaptive(&pq, &sim);
+            else if(pq.n > 0) {
+                sim_run(&pq, &sim);
             }
         }
 
@@ -227,7 +229,7 @@ void simulate(
                 strcpy(outfn, sim_offload->hdf5_out);
                 outfn[strlen(outfn)-3] = '\0';
                 sprintf(filename, "%s_%s.stdout", outfn, sim_offload->qid);
-                sim_monitor(filename, &pq.n, &pq.finished);
+                sim_monitor(filename, &n_monitor, &pq.finished);
             }
 #endif
         }
@@ -281,8 +283,14 @@ void simulate(
         {
             #pragma omp section
             {
-                #pragma omp parallel
-                simulate_fo_fixed(&pq, &sim);
+                if(sim.enable_ada == 2) {
+                    #pragma omp parallel
+                    simulate_fo_adaptive(&pq, &sim);
+                }
+                else {
+                    #pragma omp parallel
+                    simulate_fo_fixed(&pq, &sim);
+                }
             }
 
             #pragma omp section
@@ -301,6 +309,11 @@ void simulate(
         }
     }
 
+    /* Collision cache statistics of all threads and both passes */
+    if(sim.enable_clmbcol) {
+        mccc_cache_print(&sim.mccc_data);
+    }
+
     /**************************************************************************/
     /* 7. Simulation data is deallocated except for data that is mapped back  */
     /*    to host.                                                            */
@@ -316,6 +329,127 @@ void simulate(
     print_out(VERBOSE_NORMAL, "%s: Simulation complete.\n", targetname);
 }
 
+/**
+ * @brief Simulate the markers in the queue using the chosen mode
+ *
+ * @param pq pointer to the marker queue
+ * @param sim pointer to simulation data
+ */
+void sim_run(particle_queue* pq, sim_data* sim) {
+    if(sim->sim_mode == simulate_mode_gc
+       || sim->sim_mode == simulate_mode_hybrid) {
+        if(sim->enable_ada && sim->enable_clmbcol
+           && sim->enable_orbitavgccoll) {
+            #pragma omp parallel
+            simulate_gc_orbitavg(pq, sim);
+        }
+        else if(sim->enable_ada) {
+            #pragma omp parallel
+            simulate_gc_adaptive(pq, sim);
+        }
+        else {
+            #pragma omp parallel
+            simulate_gc_fixed(pq, sim);
+        }
+    }
+    else if(sim->sim_mode == simulate_mode_fo) {
+        if(sim->enable_ada == 2) {
+            #pragma omp parallel
+            simulate_fo_adaptive(pq, sim);
+        }
+        else {
+            #pragma omp parallel
+            simulate_fo_fixed(pq, sim);
+        }
+    }
+    else if(sim->sim_mode == simulate_mode_ml) {
+
+        #pragma omp parallel
+        simulate_ml_adaptive(pq, sim);
+    }
+}
+
+/**
+ * @brief Simulate markers in batches until the target quantity has converged
+ *
+ * Markers are taken from the queue in batches, and after each batch the
+ * diagnostics are brought up to date and the relative statistical error of
+ * the target quantity is evaluated. No more markers are taken once the error
+ * is below the requested value or the queue is exhausted. With several MPI
+ * processes each process simulates its own markers independently, and since
+ * the error of their combined result is smaller by the square root of the
+ * number of processes, each process stops at an error that much larger.
+ *
+ * The queue is shuffled first, with a fixed seed, so that each batch is a
+ * random sample of the markers even if the input is ordered e.g. by injector.
+ * Markers within a batch are sorted for SIMD grouping if requested.
+ *
+ * The simulated markers represent all markers in the queue, so the weighted
+ * diagnostics and the weights of the simulated markers are multiplied with
+ * the ratio of all markers to the simulated ones. The markers that were not
+ * simulated are left as they were, with no end condition, but their weight is
+ * set to zero.
+ *
+ * In hybrid mode the convergence is evaluated for the guiding center part of
+ * the simulation.
+ *
+ * @param pq pointer to the marker queue
+ * @param sim pointer to simulation data
+ * @param sim_offload pointer to simulation offload data
+ * @param diag_offload_array pointer to diagnostics offload array
+ * @param targetname name of the target for progress messages
+ * @param n_monitor number of markers the progress monitor waits to finish,
+ *        which is set to the number of simulated markers at the end
+ */
+void sim_run_converge(particle_queue* pq, sim_data* sim,
+                      sim_offload_data* sim_offload, real* diag_offload_array,
+                      char* targetname, volatile int* n_monitor) {
+    int n_total = pq->n;
+    unsigned short seed[3] = {0x330E, 0xABCD, 0x1234};
+    for(int i = n_total - 1; i > 0; i--) {
+        int j = (int) ( erand48(seed) * (i + 1) );
+        particle_state* ps = pq->p[i];
+        pq->p[i] = pq->p[j];
+        pq->p[j] = ps;
+    }
+
+    int n_proc = sim_offload->mpi_size > 1 ? sim_offload->mpi_size : 1;
+    real relerr_target = sim->convergence_relerr * sqrt(n_proc);
+    real relerr = INFINITY;
+
+    pq->n = 0;
+    while(pq->n < n_total && !(relerr <= relerr_target)) {
+        int start = pq->n;
+        pq->n = n_total - start > sim->convergence_batch ?
+            start + sim->convergence_batch : n_total;
+        pq->next = start;
+
+        if(sim->enable_simdgrouping) {
+            particle_queue batch;
+            batch.n = pq->n - start;
+            batch.p = &pq->p[start];
+            particle_queue_sort(&batch, &sim->B_data);
+        }
+
+        sim_run(pq, sim);
+
+        diag_reduce(&sim->diag_data);
+        relerr = diag_relerr(&sim_offload->diag_offload_data,
+                             diag_offload_array, sim->convergence_target);
+        print_out(VERBOSE_NORMAL,
+                  "%s: %d/%d markers simulated, relative error %.3g.\n",
+                  targetname, pq->n, n_total, relerr);
+    }
+
+    real factor = (real) n_total / pq->n;
+    diag_scale(&sim_offload->diag_offload_data, diag_offload_array, factor);
+    for(int i = 0; i < n_total; i++) {
+        pq->p[i]->weight *= i < pq->n ? factor : 0;
+    }
+
+    *n_monitor = pq->n;
+}
+
 /**
  * @brief Initializes simulation settings
  *
@@ -344,15 +478,21 @@ void sim_init(sim_data* sim, sim_offload_data* offload_data) {
     sim->sim_mode             = offload_data->sim_mode;
     sim->enable_ada           = offload_data->enable_ada;
     sim->record_mode          = offload_data->record_mode;
+    sim->convergence_target   = offload_data->convergence_target;
+    sim->convergence_relerr   = offload_data->convergence_relerr;
+    sim->convergence_batch    = offload_data->convergence_batch;
 
     sim->fix_usrdef_use       = offload_data->fix_usrdef_use;
     sim->fix_usrdef_val       = offload_data->fix_usrdef_val;
     sim->fix_gyrodef_nstep    = offload_data->fix_gyrodef_nstep;
+    sim->fix_conserve_invariants = offload_data->fix_conserve_invariants;
 
     sim->ada_tol_orbfol       = offload_data->ada_tol_orbfol;
     sim->ada_tol_clmbcol      = offload_data->ada_tol_clmbcol;
     sim->ada_max_drho         = offload_data->ada_max_drho;
     sim->ada_max_dphi         = offload_data->ada_max_dphi;
+    sim->ada_orbfol_method    = offload_data->ada_orbfol_method;
+    sim->enable_simdgrouping  = offload_data->enable_simdgrouping;
 
     sim->enable_orbfol        = offload_data->enable_orbfol;
     sim->enable_clmbcol       = offload_data->enable_clmbcol;
@@ -362,6 +502,14 @@ void sim_init(sim_data* sim, sim_offload_data* offload_data) {
     sim->disable_energyccoll  = offload_data->disable_energyccoll;
     sim->disable_pitchccoll   = offload_data->disable_pitchccoll;
     sim->disable_gcdiffccoll  = offload_data->disable_gcdiffccoll;
+    sim->enable_tabulatedccoll = offload_data->enable_tabulatedccoll;
+    sim->enable_ccollcache    = offload_data->enable_ccollcache;
+    sim->ccollcache_drho      = offload_data->ccollcache_drho;
+    sim->ccollcache_dekin     = offload_data->ccollcache_dekin;
+    sim->ccollcache_dt        = offload_data->ccollcache_dt;
+    sim->enable_ccollsubcycle = offload_data->enable_ccollsubcycle;
+    sim->enable_orbitavgccoll = offload_data->enable_orbitavgccoll;
+    sim->orbitavgccoll_maxchange = offload_data->orbitavgccoll_maxchange;
     sim->reverse_time         = offload_data->reverse_time;
 
     sim->endcond_active       = offload_data->endcond_active;
@@ -377,7 +525,10 @@ void sim_init(sim_data* sim, sim_offload_data* offload_data) {
     sim->endcond_torandpol    = offload_data->endcond_torandpol;
 
     mccc_init(&sim->mccc_data, !sim->disable_energyccoll,
-              !sim->disable_pitchccoll, !sim->disable_gcdiffccoll);
+              !sim->disable_pitchccoll, !sim->disable_gcdiffccoll,
+              sim->enable_tabulatedccoll, sim->enable_ccollcache,
+              sim->ccollcache_drho, sim->ccollcache_dekin,
+              sim->ccollcache_dt);
 
 }
 
@@ -29,7 +29,7 @@
  */
 enum {
     /** Models markers as particles using particle_simd_fo struct and
-        simulate_fo_fixed.c simulation loop                                 */
+        simulate_fo_fixed.c or simulate_fo_adaptive.c simulation loops      */
     simulate_mode_fo = 1,
     /** Models markers as guiding centers using particle_simd_gc struct and
         simulate_gc_fixed.c or simulate_gc_adaptive.c simulation loops      */
@@ -65,14 +65,20 @@ typedef struct {
 
     /* Options - general */
     int sim_mode;        /**< Which simulation mode is used                   */
-    int enable_ada;      /**< Is adaptive time-step used                      */
+    int enable_ada;      /**< Is adaptive time-step used (2 also for FO)      */
     int record_mode;     /**< Which record mode is used                       */
+    int convergence_target;  /**< Quantity whose statistical error ends the
+                                  simulation, see diag_convergence_target */
+    real convergence_relerr; /**< Relative error that ends the simulation */
+    int convergence_batch;   /**< Markers simulated between error checks  */
 
     /* Options - fixed time-step */
     int fix_usrdef_use;    /**< Use user defined value for (initial) time-step*/
     real fix_usrdef_val;   /**< User defined time-step value                  */
     int fix_gyrodef_nstep; /**< Time-step = gyrotime/fix_gyrodef_nstep if not
                                 explicitly user defined                       */
+    int fix_conserve_invariants; /**< Project orbit steps back onto energy
+                                      and canonical toroidal momentum     */
 
     /* Options - adaptive time-step */
     real ada_tol_orbfol;       /**< Tolerance for relative error in
@@ -83,6 +89,10 @@ typedef struct {
                                     travel during single adaptive time-step   */
     real ada_max_dphi;         /**< Maximum phi distance marker is allowed to
                                     travel during single adaptive time-step   */
+    int ada_orbfol_method;     /**< Orbit-following integrator: Cash-Karp (0)
+                                    or Dormand-Prince (1)                     */
+    int enable_simdgrouping;   /**< Order markers so that SIMD groups need
+                                    similar time steps                        */
 
     /* Options - physics */
     int enable_orbfol;         /**< Is orbit-following enabled                */
@@ -98,6 +108,21 @@ typedef struct {
                                     collisions */
     int disable_gcdiffccoll;   /**< Disables guiding center spatial diffusion
                                     from Coulomb collisions */
+    int enable_tabulatedccoll; /**< Number of intervals in the tabulated
+                                    collision special functions or zero   */
+    int enable_ccollcache;     /**< Reuse collision background quantities
+                                    (1) or validate the reuse (2)         */
+    real ccollcache_drho;      /**< Collision cache refresh rho change    */
+    real ccollcache_dekin;     /**< Collision cache refresh relative
+                                    energy change                         */
+    real ccollcache_dt;        /**< Collision cache refresh time change   */
+    int enable_ccollsubcycle;  /**< Maximum number of orbit steps per
+                                    collision step, zero to disable
+                                    sub-cycling                           */
+    int enable_orbitavgccoll;  /**< Apply orbit-averaged collisions once
+                                    per transit                           */
+    real orbitavgccoll_maxchange; /**< Maximum relative change of speed or
+                                       pitch per orbit-averaged kick      */
     int reverse_time;          /**< Set time running backwards in simulation  */
 
     /* Options - end conditions */
@@ -166,14 +191,20 @@ typedef struct {
 
     /* Options - general */
     int sim_mode;        /**< Which simulation mode is used                   */
-    int enable_ada;      /**< Is adaptive time-step used                      */
+    int enable_ada;      /**< Is adaptive time-step used (2 also for FO)      */
     int record_mode;     /**< Which record mode is used                       */
+    int convergence_target;  /**< Quantity whose statistical error ends the
+                                  simulation, see diag_convergence_target */
+    real convergence_relerr; /**< Relative error that ends the simulation */
+    int convergence_batch;   /**< Markers simulated between error checks  */
 
     /* Options - fixed time-step */
     int fix_usrdef_use;    /**< Use user defined value for (initial) time-step*/
     real fix_usrdef_val;   /**< User defined time-step value                  */
     int fix_gyrodef_nstep; /**< Time-step = gyrotime/fix_stepsPerGO if not
                                 explicitly user defined                       */
+    int fix_conserve_invariants; /**< Project orbit steps back onto energy
+                                      and canonical toroidal momentum     */
 
     /* Options - adaptive time-step */
     real ada_tol_orbfol;       /**< Tolerance for relative error in
@@ -184,6 +215,10 @@ typedef struct {
                                     travel during single adaptive time-step   */
     real ada_max_dphi;         /**< Maximum phi distance marker is allowed to
                                     travel during single adaptive time-step   */
+    int ada_orbfol_method;     /**< Orbit-following integrator: Cash-Karp (0)
+                                    or Dormand-Prince (1)                     */
+    int enable_simdgrouping;   /**< Order markers so that SIMD groups need
+                                    similar time steps                        */
 
     /* Options - physics */
     int enable_orbfol;         /**< Is orbit-following enabled                */
@@ -198,6 +233,21 @@ typedef struct {
                                     collisions */
     int disable_gcdiffccoll;   /**< Disables guiding center spatial diffusion
                                     from Coulomb collisions */
+    int enable_tabulatedccoll; /**< Number of intervals in the tabulated
+                                    collision special functions or zero   */
+    int enable_ccollcache;     /**< Reuse collision background quantities
+                                    (1) or validate the reuse (2)         */
+    real ccollcache_drho;      /**< Collision cache refresh rho change    */
+    real ccollcache_dekin;     /**< Collision cache refresh relative
+                                    energy change                         */
+    real ccollcache_dt;        /**< Collision cache refresh time change   */
+    int enable_ccollsubcycle;  /**< Maximum number of orbit steps per
+                                    collision step, zero to disable
+                                    sub-cycling                           */
+    int enable_orbitavgccoll;  /**< Apply orbit-averaged collisions once
+                                    per transit                           */
+    real orbitavgccoll_maxchange; /**< Maximum relative change of speed or
+                                       pitch per orbit-averaged kick      */
     int reverse_time;          /**< Set time running backwards in simulation  */
 
     /* Options - end conditions */
@@ -4,21 +4,278 @@
  */
 #include <stdlib.h>
 #include <math.h>
+#include "../../consts.h"
+#include "../../print.h"
 #include "mccc.h"
+#include "mccc_coefs.h"
+
+/**
+ * @brief Evaluate special functions and their derivatives for tabulation
+ *
+ * Evaluates mu0, mu1 and mu0' (see mccc_coefs_mufun()) to f[0], f[1], f[2]
+ * and their derivatives to f[3], f[4], f[5]. At x = 0 the limits are used.
+ *
+ * @param f array where the values are stored
+ * @param x argument for the special functions
+ */
+static void mccc_table_eval(real f[6], real x) {
+    if(x == 0) {
+        f[0] = 0;
+        f[1] = 0;
+        f[2] = 4 / ( 3 * CONST_SQRTPI );
+        f[3] = f[2];
+        f[4] = 4 / ( 3 * CONST_SQRTPI );
+        f[5] = 0;
+        return;
+    }
+    real expm2x = exp(-x*x);
+    real erfx   = erf(x);
+
+    f[0] = ( erfx - 2 * x * expm2x / CONST_SQRTPI ) / (x*x);
+    f[1] = erfx - 0.5 * f[0];
+    f[2] = 4 * expm2x / CONST_SQRTPI - 2 * f[0] / x;
+    f[3] = f[2];
+    f[4] = 2 * expm2x / CONST_SQRTPI - 0.5 * f[2];
+    f[5] = -8 * x * expm2x / CONST_SQRTPI - 2 * f[2] / x + 2 * f[0] / (x*x);
+}
 
 /**
  * @brief Set collision operator data.
  *
+ * If tabulated special functions are requested, the table is constructed here
+ * using cubic Hermite interpolation between the grid points. The interpolation
+ * error scales as the fourth power of the interval width; the functions are of
+ * order unity and the error is about 1e-6 with 100 intervals and 1e-9 with 500
+ * intervals.
+ *
  * @param mdata pointer to collision operator data struct
  * @param include_energy can collisions change marker energy, either 0 or 1
  * @param include_pitch  can collisions change marker pitch, either 0 or 1
  * @param include_gcdiff can collisions change GC position, either 0 or 1
+ * @param usetabulated number of intervals in the special function table or
+ *        zero if special functions are evaluated directly; values above
+ *        MCCC_TABLE_MAXSIZE are truncated
+ * @param usecache reuse background quantities between steps (1), do so but
+ *        validate against exact evaluation (2), or evaluate every step (0)
+ * @param cache_drho rho change after which the cache is refreshed
+ * @param cache_dekin relative energy change after which the cache is refreshed
+ * @param cache_dt time change after which the cache is refreshed [s]
  */
 void mccc_init(mccc_data* mdata, int include_energy, int include_pitch,
-               int include_gcdiff) {
+               int include_gcdiff, int usetabulated, int usecache,
+               real cache_drho, real cache_dekin, real cache_dt) {
     mdata->include_energy = include_energy;
     mdata->include_pitch  = include_pitch;
     mdata->include_gcdiff = include_gcdiff;
 
-    mdata->usetabulated = 0;
+    mdata->usecache    = usecache;
+    mdata->cache_drho  = cache_drho;
+    mdata->cache_dekin = cache_dekin;
+    mdata->cache_dt    = cache_dt;
+
+    mdata->cache_neval    = 0;
+    mdata->cache_nrefresh = 0;
+    mdata->cache_maxdev   = 0;
+
+    mdata->usetabulated = A5_CCOL_USE_TABULATED && usetabulated > 0;
+    if(!mdata->usetabulated) {
+        mdata->tab_n = 0;
+        return;
+    }
+
+    int n = usetabulated < MCCC_TABLE_MAXSIZE ?
+        usetabulated : MCCC_TABLE_MAXSIZE;
+    real dx = MCCC_TABLE_XMAX / n;
+    mdata->tab_n     = n;
+    mdata->tab_invdx = 1.0 / dx;
+
+    /* In terms of t = (x - x_i) / dx, the Hermite polynomial matching values
+     * f0, f1 and derivatives d0, d1 at the interval ends is
+     * f0 + d0 t + (3(f1 - f0) - 2 d0 - d1) t^2 + (2(f0 - f1) + d0 + d1) t^3 */
+    real f0[6], f1[6];
+    mccc_table_eval(f1, 0.0);
+    for(int i = 0; i < n; i++) {
+        for(int k = 0; k < 6; k++) {
+            f0[k] = f1[k];
+        }
+        mccc_table_eval(f1, (i + 1) * dx);
+
+        real* c = &mdata->tab_c[i*12];
+        for(int k = 0; k < 3; k++) {
+            real d0 = f0[k+3] * dx;
+            real d1 = f1[k+3] * dx;
+            c[k*4 + 0] = f0[k];
+            c[k*4 + 1] = d0;
+            c[k*4 + 2] = 3 * ( f1[k] - f0[k] ) - 2 * d0 - d1;
+            c[k*4 + 3] = 2 * ( f0[k] - f1[k] ) + d0 + d1;
+        }
+    }
+}
+
+/**
+ * @brief Initialize background quantity cache
+ *
+ * All slots are marked invalid and the counters are zeroed.
+ *
+ * @param cache pointer to the cache
+ */
+void mccc_cache_init(mccc_cache* cache) {
+    for(int i = 0; i < NSIMD; i++) {
+        cache->valid[i]    = 0;
+        cache->neval[i]    = 0;
+        cache->nrefresh[i] = 0;
+        cache->maxdev[i]   = 0;
+    }
+}
+
+/**
+ * @brief Invalidate the cached data of a single marker slot
+ *
+ * @param cache pointer to the cache
+ * @param i index of the slot
+ */
+void mccc_cache_reset(mccc_cache* cache, int i) {
+    cache->valid[i] = 0;
+}
+
+/**
+ * @brief Evaluate background densities, temperatures and Coulomb logarithms
+ *
+ * Without the cache this is plasma_eval_densandtemp() followed by
+ * mccc_coefs_clog(). With the cache the stored values are returned unless the
+ * slot is invalid or the marker has moved past one of the thresholds, in
+ * which case the values are evaluated and stored. In validation mode the
+ * exact values are always evaluated and returned, and the deviation of the
+ * values the cache would have given is recorded.
+ *
+ * @param nb array where background densities are stored [m^-3]
+ * @param Tb array where background temperatures are stored [J]
+ * @param clogab array where Coulomb logarithms are stored
+ * @param rho marker rho coordinate
+ * @param r marker R coordinate [m]
+ * @param phi marker phi coordinate [rad]
+ * @param z marker z coordinate [m]
+ * @param t marker time [s]
+ * @param ma marker mass [kg]
+ * @param qa marker charge [C]
+ * @param va marker speed [m/s]
+ * @param pdata pointer to plasma data
+ * @param mdata pointer to collision data struct
+ * @param cache pointer to the cache
+ * @param i index of the marker slot in the cache
+ *
+ * @return zero on success, non-zero if plasma evaluation failed
+ */
+a5err mccc_eval_background(real* nb, real* Tb, real* clogab, real rho, real r,
+                           real phi, real z, real t, real ma, real qa,
+                           real va, plasma_data* pdata, mccc_data* mdata,
+                           mccc_cache* cache, int i) {
+    int n_species  = plasma_get_n_species(pdata);
+    const real* qb = plasma_get_species_charge(pdata);
+    const real* mb = plasma_get_species_mass(pdata);
+
+    int refresh = 1;
+    if(mdata->usecache) {
+        cache->neval[i]++;
+        refresh = !cache->valid[i]
+            || fabs(rho - cache->rho[i]) > mdata->cache_drho
+            || fabs(va*va / cache->va2[i] - 1.0) > mdata->cache_dekin
+            || fabs(t - cache->time[i]) > mdata->cache_dt;
+    }
+
+    if(!refresh && mdata->usecache == 1) {
+        for(int j = 0; j < n_species; j++) {
+            nb[j]     = cache->nb[j*NSIMD + i];
+            Tb[j]     = cache->Tb[j*NSIMD + i];
+            clogab[j] = cache->clogab[j*NSIMD + i];
+        }
+        return 0;
+    }
+
+    a5err err = plasma_eval_densandtemp(nb, Tb, rho, r, phi, z, t, pdata);
+    mccc_coefs_clog(clogab, ma, qa, va, n_species, mb, qb, nb, Tb);
+    if(err || !mdata->usecache) {
+        return err;
+    }
+
+    if(!refresh) {
+        /* Validation mode: compare against what the cache would have given */
+        real dev = 0;
+        for(int j = 0; j < n_species; j++) {
+            real d1 = fabs(cache->nb[j*NSIMD + i] / nb[j] - 1.0);
+            real d2 = fabs(cache->Tb[j*NSIMD + i] / Tb[j] - 1.0);
+            real d3 = fabs(cache->clogab[j*NSIMD + i] / clogab[j] - 1.0);
+            dev = d1 > dev ? d1 : dev;
+            dev = d2 > dev ? d2 : dev;
+            dev = d3 > dev ? d3 : dev;
+        }
+        cache->maxdev[i] = dev > cache->maxdev[i] ? dev : cache->maxdev[i];
+        return 0;
+    }
+
+    cache->nrefresh[i]++;
+    cache->valid[i] = 1;
+    cache->rho[i]   = rho;
+    cache->va2[i]   = va*va;
+    cache->time[i]  = t;
+    for(int j = 0; j < n_species; j++) {
+        cache->nb[j*NSIMD + i]     = nb[j];
+        cache->Tb[j*NSIMD + i]     = Tb[j];
+        cache->clogab[j*NSIMD + i] = clogab[j];
+    }
+    return 0;
+}
+
+/**
+ * @brief Add cache statistics of a thread to the totals
+ *
+ * Called by each thread once it has finished simulating, so that the
+ * statistics can be printed once with mccc_cache_print().
+ *
+ * @param cache pointer to the cache of this thread
+ * @param mdata pointer to collision data struct shared by the threads
+ */
+void mccc_cache_collect(mccc_cache* cache, mccc_data* mdata) {
+    long neval = 0, nrefresh = 0;
+    real maxdev = 0;
+    for(int i = 0; i < NSIMD; i++) {
+        neval    += cache->neval[i];
+        nrefresh += cache->nrefresh[i];
+        maxdev    = cache->maxdev[i] > maxdev ? cache->maxdev[i] : maxdev;
+    }
+
+    #pragma omp critical(mccc_cache_collect)
+    {
+        mdata->cache_neval    += neval;
+        mdata->cache_nrefresh += nrefresh;
+        mdata->cache_maxdev    = maxdev > mdata->cache_maxdev ?
+            maxdev : mdata->cache_maxdev;
+    }
+}
+
+/**
+ * @brief Print cache statistics summed over all threads
+ *
+ * The statistics are printed on debug verbosity, or on normal verbosity in
+ * validation mode. To be called outside the parallel region once all threads
+ * have called mccc_cache_collect().
+ *
+ * @param mdata pointer to collision data struct
+ */
+void mccc_cache_print(mccc_data* mdata) {
+    if(!mdata->usecache) {
+        return;
+    }
+    if(mdata->usecache == 2) {
+        print_out(VERBOSE_NORMAL,
+                  "Collision cache: %ld of %ld lookups refreshed, largest "
+                  "relative deviation of cached values %le\n",
+                  mdata->cache_nrefresh, mdata->cache_neval,
+                  mdata->cache_maxdev);
+    }
+    else {
+        print_out(VERBOSE_DEBUG,
+                  "Collision cache: %ld of %ld lookups refreshed\n",
+                  mdata->cache_nrefresh, mdata->cache_neval);
+    }
 }
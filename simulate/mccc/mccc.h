@@ -21,27 +21,134 @@
  */
 #define MCCC_CUTOFF 0.1
 
+/**
+ * @brief Upper limit of the tabulated special functions
+ *
+ * Above this value of x, erf(x) = 1 and exp(-x^2) = 0 to double precision and
+ * the special functions are evaluated from their asymptotic forms.
+ */
+#define MCCC_TABLE_XMAX 6.0
+
+/** @brief Maximum number of intervals in the special function table */
+#define MCCC_TABLE_MAXSIZE 512
+
 /**
  * @brief Parameters and data required to evaluate Coulomb collisions
+ *
+ * The special function table consists of cubic polynomials in each interval
+ * of a uniform grid in [0, MCCC_TABLE_XMAX]. The coefficients of an interval
+ * are stored contiguously: first the four coefficients (in ascending order) for
+ * mu0, then for mu1 and then for mu0'.
  */
 typedef struct {
     int usetabulated;   /**< Use tabulated values for special functions    */
     int include_energy; /**< Let collisions change energy                  */
     int include_pitch;  /**< Let collisions change pitch                   */
     int include_gcdiff; /**< Let collisions change guiding center position */
+    int usecache;       /**< Reuse background quantities between steps,
+                             1 to use the cache, 2 to validate it          */
+    real cache_drho;    /**< Cache refresh threshold for rho change        */
+    real cache_dekin;   /**< Cache refresh threshold for relative energy
+                             change                                        */
+    real cache_dt;      /**< Cache refresh threshold for time change [s]   */
+    long cache_neval;   /**< Cache lookups summed over all threads         */
+    long cache_nrefresh;/**< Exact evaluations summed over all threads     */
+    real cache_maxdev;  /**< Largest relative deviation over all threads   */
+    int tab_n;          /**< Number of intervals in the table              */
+    real tab_invdx;     /**< Inverse of the interval width                 */
+    real tab_c[MCCC_TABLE_MAXSIZE*12]; /**< Table polynomial coefficients  */
 } mccc_data;
 
+/**
+ * @brief Background plasma quantities cached for NSIMD markers
+ *
+ * The density, temperature and Coulomb logarithm of each background species
+ * change slowly compared to the time step, so they are stored here and
+ * re-evaluated only when the marker rho, energy or time has changed more
+ * than the thresholds in mccc_data since the last evaluation. Each simulation
+ * loop has its own cache, and a slot must be reset with mccc_cache_reset()
+ * whenever a new marker is placed in it.
+ *
+ * The counters are kept per slot so that the SIMD loops do not need
+ * reductions. Each thread adds them to the totals in mccc_data with
+ * mccc_cache_collect() once it has finished simulating. In validation mode the exact values are always used and the
+ * largest relative deviation of the cached values is recorded.
+ */
+typedef struct {
+    int valid[NSIMD] __memalign__;    /**< Is cached data valid            */
+    real rho[NSIMD] __memalign__;     /**< rho at last evaluation          */
+    real va2[NSIMD] __memalign__;     /**< Velocity squared at last eval.  */
+    real time[NSIMD] __memalign__;    /**< Time at last evaluation [s]     */
+    real nb[MAX_SPECIES*NSIMD] __memalign__;     /**< Densities [m^-3]     */
+    real Tb[MAX_SPECIES*NSIMD] __memalign__;     /**< Temperatures [J]     */
+    real clogab[MAX_SPECIES*NSIMD] __memalign__; /**< Coulomb logarithms   */
+    long neval[NSIMD] __memalign__;   /**< Number of lookups               */
+    long nrefresh[NSIMD] __memalign__;/**< Number of exact evaluations     */
+    real maxdev[NSIMD] __memalign__;  /**< Largest relative deviation      */
+} mccc_cache;
+
+/**
+ * @brief Orbit-integrated collision coefficients for NSIMD markers
+ *
+ * The drift and diffusion coefficients of speed and of the pitch invariant
+ * lambda = (1 - xi^2) / B are integrated along the orbit while the marker
+ * completes a transit. Dividing by the accumulated orbit time gives the
+ * orbit-averaged coefficients. A slot must be reset with
+ * mccc_orbitavg_reset() whenever a new marker is placed in it and after each
+ * collision kick.
+ */
+typedef struct {
+    real t[NSIMD] __memalign__;    /**< Accumulated orbit time [s]         */
+    real K[NSIMD] __memalign__;    /**< Integral of speed drift [m/s]      */
+    real Dv[NSIMD] __memalign__;   /**< Integral of speed diffusion
+                                        [m^2/s^2]                          */
+    real Alam[NSIMD] __memalign__; /**< Integral of lambda drift [1/T]     */
+    real Dlam[NSIMD] __memalign__; /**< Integral of lambda diffusion
+                                        [1/T^2]                            */
+    real nu[NSIMD] __memalign__;   /**< Integral of pitch collision
+                                        frequency                          */
+    real vcut[NSIMD] __memalign__; /**< Integral of cutoff speed [m]       */
+} mccc_orbitavg;
+
 #pragma omp declare target
 
 void mccc_init(mccc_data* mdata, int include_energy, int include_pitch,
-               int include_gcdiff);
+               int include_gcdiff, int usetabulated, int usecache,
+               real cache_drho, real cache_dekin, real cache_dt);
+void mccc_cache_init(mccc_cache* cache);
+#pragma omp declare simd uniform(cache)
+void mccc_cache_reset(mccc_cache* cache, int i);
+#pragma omp declare simd uniform(pdata, mdata, cache)
+a5err mccc_eval_background(real* nb, real* Tb, real* clogab, real rho, real r,
+                           real phi, real z, real t, real ma, real qa,
+                           real va, plasma_data* pdata, mccc_data* mdata,
+                           mccc_cache* cache, int i);
+void mccc_cache_collect(mccc_cache* cache, mccc_data* mdata);
+void mccc_cache_print(mccc_data* mdata);
 void mccc_fo_euler(particle_simd_fo* p, real* h,  plasma_data* pdata,
-                   random_data* rdata, mccc_data* mdata);
+                   random_data* rdata, mccc_data* mdata, mccc_cache* cache);
+void mccc_fo_euler_adaptive(particle_simd_fo* p, real* hin, real* hout,
+                            real tol, mccc_wienarr* wienarr,
+                            plasma_data* pdata, random_data* rdata,
+                            mccc_data* mdata, mccc_cache* cache);
 void mccc_gc_euler(particle_simd_gc* p, real* h, B_field_data* Bdata,
-                   plasma_data* pdata, random_data* rdata, mccc_data* mdata);
+                   plasma_data* pdata, random_data* rdata, mccc_data* mdata,
+                   mccc_cache* cache);
 void mccc_gc_milstein(particle_simd_gc* p, real* hin, real* hout, real tol,
                       mccc_wienarr* wienarr, B_field_data* Bdata,
-                      plasma_data* pdata, random_data* rdata, mccc_data* mdata);
+                      plasma_data* pdata, random_data* rdata, mccc_data* mdata,
+                      mccc_cache* cache);
+#pragma omp declare simd uniform(p, tol, pdata, mdata)
+real mccc_gc_milstein_inidt(particle_simd_gc* p, int i, real tol,
+                            plasma_data* pdata, mccc_data* mdata);
+#pragma omp declare simd uniform(avg)
+void mccc_orbitavg_reset(mccc_orbitavg* avg, int i);
+void mccc_gc_orbitavg_accumulate(particle_simd_gc* p, real* h,
+                                 mccc_orbitavg* avg, plasma_data* pdata,
+                                 mccc_data* mdata, mccc_cache* cache);
+void mccc_gc_orbitavg_kick(particle_simd_gc* p, int* kick, real* dt,
+                           real* tcol, mccc_orbitavg* avg,
+                           random_data* rdata, mccc_data* mdata);
 #pragma omp end declare target
 
 #endif
@@ -8,6 +8,7 @@
 #include <math.h>
 #include "../../ascot5.h"
 #include "../../consts.h"
+#include "../../vecmath.h"
 #include "mccc.h"
 
 /**
@@ -218,9 +219,9 @@
  * @param Tb plasma species temperatures [J]
  */
 #pragma omp declare simd uniform(nspec, mb, qb, nb, Tb)
-static void mccc_coefs_clog(real* clogab, real ma, real qa, real va, int nspec,
-                            const real* mb, const real* qb, const real* nb,
-                            const real* Tb) {
+static inline void mccc_coefs_clog(real* clogab, real ma, real qa, real va,
+                                   int nspec, const real* mb, const real* qb,
+                                   const real* nb, const real* Tb) {
 
     /* Evaluate Debye length */
     real sum = 0;
@@ -237,12 +238,8 @@ static void mccc_coefs_clog(real* clogab, real ma, real qa, real va, int nspec,
         real bcl  = fabs( qa * qb[i] / ( 4*CONST_PI*CONST_E0 * mr * vbar ) );
         real bqm  = fabs( CONST_HBAR / ( 2 * mr * sqrt( vbar ) ) );
 
-        if(bcl > bqm){
-            clogab[i] = log( debyeLength / bcl );
-        }
-        else{
-            clogab[i] = log( debyeLength / bqm );
-        }
+        real bmin = bcl > bqm ? bcl : bqm;
+        clogab[i] = vecmath_log( debyeLength / bmin );
     }
 }
 
@@ -264,18 +261,33 @@ static void mccc_coefs_clog(real* clogab, real ma, real qa, real va, int nspec,
  * @param mdata pointer to mccc data
  */
 #pragma omp declare simd uniform(mdata)
-static void mccc_coefs_mufun(real mufun[3], real x, mccc_data* mdata) {
+static inline void mccc_coefs_mufun(real mufun[3], real x,
+                                    mccc_data* mdata) {
 
     if(!mdata->usetabulated && x!= 0) {
-        real expm2x = exp(-x*x);
-        real erfx   = erf(x);
+        real expm2x = vecmath_exp(-x*x);
+        real erfx   = vecmath_erf(x);
 
         mufun[0] = ( erfx - 2 * x * expm2x / CONST_SQRTPI ) / (x*x);
         mufun[1] = erfx - 0.5 * mufun[0];
         mufun[2] = 4 * expm2x / CONST_SQRTPI - 2 * mufun[0] / x;
     }
-    else if(mdata->usetabulated && x != 0) {
-        // TODO implement me
+    else if(mdata->usetabulated) {
+        /* Index is clamped so that the lookup is valid for all x and the
+         * asymptotic form is chosen afterwards without branching */
+        real xt = x * mdata->tab_invdx;
+        int i   = xt < mdata->tab_n ? (int)xt : mdata->tab_n - 1;
+        real t  = xt - i;
+        real* c = &mdata->tab_c[i*12];
+
+        real ix = 1.0 / x;
+        int asym = x >= MCCC_TABLE_XMAX;
+        mufun[0] = asym ? ix*ix :
+            c[0] + t * ( c[1] + t * ( c[2]  + t * c[3]  ) );
+        mufun[1] = asym ? 1 - 0.5*ix*ix :
+            c[4] + t * ( c[5] + t * ( c[6]  + t * c[7]  ) );
+        mufun[2] = asym ? -2*ix*ix*ix :
+            c[8] + t * ( c[9] + t * ( c[10] + t * c[11] ) );
     }
     else {
         mufun[0] = 0;
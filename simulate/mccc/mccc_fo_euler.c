@@ -3,9 +3,11 @@
  * @brief Euler-Maruyama integrator for collision operator in FO picture.
  */
 #include <math.h>
+#include <float.h>
 #include "../../ascot5.h"
 #include "../../consts.h"
 #include "../../math.h"
+#include "../../vecmath.h"
 #include "../../error.h"
 #include "../../physlib.h"
 #include "../../particle.h"
@@ -22,9 +24,10 @@
  * @param pdata pointer to plasma data
  * @param rdata pointer to random-generator data
  * @param mdata pointer collision data struct
+ * @param cache pointer to background quantity cache
  */
 void mccc_fo_euler(particle_simd_fo* p, real* h, plasma_data* pdata,
-                   random_data* rdata, mccc_data* mdata) {
+                   random_data* rdata, mccc_data* mdata, mccc_cache* cache) {
 
     /* Generate random numbers and get plasma information before going to the *
      * SIMD loop                                                              */
@@ -42,8 +45,8 @@ void mccc_fo_euler(particle_simd_fo* p, real* h, plasma_data* pdata,
 
             /* These are needed twice to transform velocity to cartesian and *
              * back to cylindrical coordinates. Position does not change     */
-            real sinphi = sin(p->phi[i]);
-            real cosphi = cos(p->phi[i]);
+            real sinphi = vecmath_sin(p->phi[i]);
+            real cosphi = vecmath_cos(p->phi[i]);
 
             real pnorm = sqrt( p->p_r[i] * p->p_r[i] + p->p_phi[i] * p->p_phi[i]
                                + p->p_z[i] * p->p_z[i] );
@@ -57,19 +60,17 @@ void mccc_fo_euler(particle_simd_fo* p, real* h, plasma_data* pdata,
             vin_xyz[2] = p->p_z[i] / ( gamma * p->mass[i] );
             real vin   = math_norm(vin_xyz);
 
-            /* Evaluate plasma density and temperature */
-            real nb[MAX_SPECIES], Tb[MAX_SPECIES];
+            /* Evaluate plasma density and temperature, and Coulomb
+             * logarithm, possibly from the cache */
+            real nb[MAX_SPECIES], Tb[MAX_SPECIES], clogab[MAX_SPECIES];
             if(!errflag) {
-                errflag = plasma_eval_densandtemp(nb, Tb, p->rho[i],
-                                                  p->r[i], p->phi[i], p->z[i],
-                                                  p->time[i], pdata);
+                errflag = mccc_eval_background(nb, Tb, clogab, p->rho[i],
+                                               p->r[i], p->phi[i], p->z[i],
+                                               p->time[i], p->mass[i],
+                                               p->charge[i], vin, pdata,
+                                               mdata, cache, i);
             }
 
-            /* Coulomb logarithm */
-            real clogab[MAX_SPECIES];
-            mccc_coefs_clog(clogab, p->mass[i], p->charge[i], vin,
-                            n_species, mb, qb, nb, Tb);
-
             /* Evaluate collision coefficients and sum them for each *
              * species                                               */
             real F = 0, Dpara = 0, Dperp = 0;
@@ -130,3 +131,184 @@ void mccc_fo_euler(particle_simd_fo* p, real* h, plasma_data* pdata,
         }
     }
 }
+
+/**
+ * @brief Integrate collisions for one adaptive time-step
+ *
+ * Same as mccc_fo_euler() but the Wiener increments are taken from the
+ * marker's Wiener process so that a rejected step can be retaken with a
+ * shorter time step consistently. Informs whether the time step was accepted
+ * and provides a suggestion for the next time step. The error estimates
+ * follow mccc_gc_milstein(): the drift error is estimated from the drift
+ * coefficient derivative, and the diffusion errors from the Milstein
+ * correction left out of the Euler-Maruyama step and from the spurious
+ * energy change caused by the perpendicular diffusion.
+ *
+ * @param p fo struct
+ * @param hin time-steps for NSIMD markers
+ * @param hout suggestions for the next time-steps for NSIMD markers
+ * @param tol relative error tolerance
+ * @param w array holding wiener structs for NSIMD markers
+ * @param pdata pointer to plasma data
+ * @param rdata pointer to random-generator data
+ * @param mdata pointer collision data struct
+ * @param cache pointer to background quantity cache
+ */
+void mccc_fo_euler_adaptive(particle_simd_fo* p, real* hin, real* hout,
+                            real tol, mccc_wienarr* w, plasma_data* pdata,
+                            random_data* rdata, mccc_data* mdata,
+                            mccc_cache* cache) {
+
+    /* Generate random numbers and get plasma information before going to the *
+     * SIMD loop                                                              */
+    real rnd[MCCC_NDIM*NSIMD];
+    random_normal_simd(rdata, MCCC_NDIM*NSIMD, rnd);
+
+    int n_species  = plasma_get_n_species(pdata);
+    const real* qb = plasma_get_species_charge(pdata);
+    const real* mb = plasma_get_species_mass(pdata);
+
+    #pragma omp simd
+    for(int i = 0; i < NSIMD; i++) {
+        if(p->running[i]) {
+            a5err errflag = 0;
+
+            /* These are needed twice to transform velocity to cartesian and *
+             * back to cylindrical coordinates. Position does not change     */
+            real sinphi = vecmath_sin(p->phi[i]);
+            real cosphi = vecmath_cos(p->phi[i]);
+
+            real pnorm = sqrt( p->p_r[i] * p->p_r[i] + p->p_phi[i] * p->p_phi[i]
+                               + p->p_z[i] * p->p_z[i] );
+            real gamma = physlib_gamma_pnorm(p->mass[i], pnorm);
+
+            real vin_xyz[3];
+            vin_xyz[0] = ( p->p_r[i] * cosphi - p->p_phi[i] * sinphi )
+                / ( gamma * p->mass[i] );
+            vin_xyz[1] = ( p->p_r[i] * sinphi + p->p_phi[i] * cosphi )
+                / ( gamma * p->mass[i] );
+            vin_xyz[2] = p->p_z[i] / ( gamma * p->mass[i] );
+            real vin   = math_norm(vin_xyz);
+
+            /* Evaluate plasma density and temperature, and Coulomb
+             * logarithm, possibly from the cache */
+            real nb[MAX_SPECIES], Tb[MAX_SPECIES], clogab[MAX_SPECIES];
+            if(!errflag) {
+                errflag = mccc_eval_background(nb, Tb, clogab, p->rho[i],
+                                               p->r[i], p->phi[i], p->z[i],
+                                               p->time[i], p->mass[i],
+                                               p->charge[i], vin, pdata,
+                                               mdata, cache, i);
+            }
+
+            /* Evaluate collision coefficients and sum them for each *
+             * species                                               */
+            real F = 0, dF = 0, Dpara = 0, dDpara = 0, Dperp = 0;
+            for(int j = 0; j < n_species; j++) {
+                real vb = sqrt( 2 * Tb[j] / mb[j] );
+                real x  = vin / vb;
+                real mufun[3];
+                mccc_coefs_mufun(mufun, x, mdata);
+
+                /* F = (1 + mb/ma) Q so its derivative follows from Q' */
+                F      += mccc_coefs_F(p->mass[i], p->charge[i], mb[j], qb[j],
+                                       nb[j], vb, clogab[j], mufun[0]);
+                dF     += ( 1 + mb[j] / p->mass[i] )
+                        * mccc_coefs_dQ(p->mass[i], p->charge[i], mb[j], qb[j],
+                                        nb[j], vb, clogab[j], mufun[2]);
+                Dpara  += mccc_coefs_Dpara(p->mass[i], p->charge[i], vin,
+                                           qb[j], nb[j], vb, clogab[j],
+                                           mufun[0]);
+                dDpara += mccc_coefs_dDpara(p->mass[i], p->charge[i], vin,
+                                            qb[j], nb[j], vb, clogab[j],
+                                            mufun[0], mufun[2]);
+                Dperp  += mccc_coefs_Dperp(p->mass[i], p->charge[i], vin,
+                                           qb[j], nb[j], vb, clogab[j],
+                                           mufun[1]);
+            }
+
+            /* Generate Wiener process for this step. Only the first three
+             * components are needed. */
+            int tindex;
+            real rnd5[MCCC_NDIM] = {rnd[0*NSIMD + i], rnd[1*NSIMD + i],
+                                    rnd[2*NSIMD + i], rnd[3*NSIMD + i],
+                                    rnd[4*NSIMD + i]};
+            if(!errflag) {
+                errflag = mccc_wiener_generate(&w[i], w[i].time[0]+hin[i],
+                                               &tindex, rnd5);
+            }
+            real dW[3] = {0, 0, 0};
+            if(!errflag) {
+                dW[0] = w[i].wiener[tindex*MCCC_NDIM + 0] - w[i].wiener[0];
+                dW[1] = w[i].wiener[tindex*MCCC_NDIM + 1] - w[i].wiener[1];
+                dW[2] = w[i].wiener[tindex*MCCC_NDIM + 2] - w[i].wiener[2];
+            }
+
+            /* Evaluate collisions */
+            real vhat[3];
+            math_unit(vin_xyz, vhat);
+
+            real t1 = math_dot(vhat, dW);
+            real k1 = F*hin[i];
+            real k2 = sqrt(2*Dpara)*t1;
+            real k3 = sqrt(2*Dperp);
+
+            real vout_xyz[3];
+            vout_xyz[0] = vin_xyz[0] + k1*vhat[0] + k2*vhat[0]
+                        + k3*(dW[0]  - t1*vhat[0]);
+            vout_xyz[1] = vin_xyz[1] + k1*vhat[1] + k2*vhat[1]
+                        + k3*(dW[1]  - t1*vhat[1]);
+            vout_xyz[2] = vin_xyz[2] + k1*vhat[2] + k2*vhat[2]
+                        + k3*(dW[2]  - t1*vhat[2]);
+
+            /* Compute error estimates for drift and diffusion limits */
+            real v0 = ( vin + fabs(F) * hin[i] + sqrt( 2*Dpara*hin[i] ) )
+                      + DBL_EPSILON;
+
+            // kappa_k is error due to drift
+            real kappa_k  = fabs( F*dF ) * hin[i]*hin[i] / (2*tol*v0);
+
+            // kappa_d is error due to parallel and perpendicular diffusion
+            real kappa_d0 = fabs( dDpara * ( t1*t1 - hin[i] ) ) / (2*tol*v0);
+            real kappa_d1 = Dperp * hin[i] / (tol*v0*v0);
+
+            /* Transform back to cylindrical coordinates.  */
+
+            real vnorm = math_norm(vout_xyz);
+            gamma = physlib_gamma_vnorm(vnorm);
+            if(!errflag) {
+                p->p_r[i]   = (  vout_xyz[0] * cosphi + vout_xyz[1] * sinphi )
+                    * gamma * p->mass[i];
+                p->p_phi[i] = ( -vout_xyz[0] * sinphi + vout_xyz[1] * cosphi )
+                               * gamma * p->mass[i];
+                p->p_z[i]   =    vout_xyz[2] * gamma * p->mass[i];
+            }
+
+            /* Check whether timestep was rejected and suggest next time step */
+            real kappa_d = fmax(kappa_d0, kappa_d1);
+            if( kappa_k >= kappa_d ) {
+                /* Drift error dominates */
+                hout[i] = 0.8 * hin[i] / sqrt( kappa_k );
+            }
+            else {
+                /* Diffusion error dominates */
+                hout[i] = 0.9 * hin[i] / kappa_d;
+            }
+
+            /* Negative value indicates time step was rejected*/
+            if( kappa_k > 1 || kappa_d > 1 ){
+                hout[i]   = -hout[i];
+            }
+            else if(hout[i] > 1.5*hin[i]) {
+                /* Make sure we don't increase time step too much */
+                hout[i] = 1.5*hin[i];
+            }
+
+            /* Error handling */
+            if(errflag) {
+                p->err[i]     = errflag;
+                p->running[i] = 0;
+            }
+        }
+    }
+}
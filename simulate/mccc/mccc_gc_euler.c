@@ -6,6 +6,7 @@
 #include "../../ascot5.h"
 #include "../../consts.h"
 #include "../../math.h"
+#include "../../vecmath.h"
 #include "../../physlib.h"
 #include "../../error.h"
 #include "../../particle.h"
@@ -24,9 +25,11 @@
  * @param pdata pointer to plasma data
  * @param rdata pointer to random-generator data
  * @param mdata pointer to collision data struct
+ * @param cache pointer to background quantity cache
  */
 void mccc_gc_euler(particle_simd_gc* p, real* h, B_field_data* Bdata,
-                   plasma_data* pdata, random_data* rdata, mccc_data* mdata) {
+                   plasma_data* pdata, random_data* rdata, mccc_data* mdata,
+                   mccc_cache* cache) {
 
     /* Generate random numbers and get plasma information before going to the *
      * SIMD loop                                                              */
@@ -55,23 +58,21 @@ void mccc_gc_euler(particle_simd_gc* p, real* h, B_field_data* Bdata,
             pin  = physlib_gc_p( p->mass[i], p->mu[i], p->ppar[i], Bnorm);
             xiin = physlib_gc_xi(p->mass[i], p->mu[i], p->ppar[i], Bnorm);
             vin  = physlib_vnorm_pnorm(p->mass[i], pin);
-            Xin_xyz[0] = p->r[i] * cos(p->phi[i]);
-            Xin_xyz[1] = p->r[i] * sin(p->phi[i]);
+            Xin_xyz[0] = p->r[i] * vecmath_cos(p->phi[i]);
+            Xin_xyz[1] = p->r[i] * vecmath_sin(p->phi[i]);
             Xin_xyz[2] = p->z[i];
 
-            /* Evaluate plasma density and temperature */
-            real nb[MAX_SPECIES], Tb[MAX_SPECIES];
+            /* Evaluate plasma density and temperature, and Coulomb
+             * logarithm, possibly from the cache */
+            real nb[MAX_SPECIES], Tb[MAX_SPECIES], clogab[MAX_SPECIES];
             if(!errflag) {
-                errflag = plasma_eval_densandtemp(nb, Tb, p->rho[i],
-                                                  p->r[i], p->phi[i], p->z[i],
-                                                  p->time[i], pdata);
+                errflag = mccc_eval_background(nb, Tb, clogab, p->rho[i],
+                                               p->r[i], p->phi[i], p->z[i],
+                                               p->time[i], p->mass[i],
+                                               p->charge[i], vin, pdata,
+                                               mdata, cache, i);
             }
 
-            /* Coulomb logarithm */
-            real clogab[MAX_SPECIES];
-            mccc_coefs_clog(clogab, p->mass[i], p->charge[i], vin,
-                            n_species, mb, qb, nb, Tb);
-
             /* Evaluate collision coefficients and sum them for each *
              * species                                               */
             real gyrofreq = phys_gyrofreq_pnorm(p->mass[i], p->charge[i],
@@ -199,11 +200,11 @@ void mccc_gc_euler(particle_simd_gc* p, real* h, B_field_data* Bdata,
                 /* Evaluate phi and theta angles so that they are cumulative */
                 real axisrz[2];
                 errflag = B_field_get_axis_rz(axisrz, Bdata, p->phi[i]);
-                p->theta[i] += atan2(   (R0-axisrz[0]) * (p->z[i]-axisrz[1])
+                p->theta[i] += vecmath_atan2(   (R0-axisrz[0]) * (p->z[i]-axisrz[1])
                                       - (z0-axisrz[1]) * (p->r[i]-axisrz[0]),
                                         (R0-axisrz[0]) * (p->r[i]-axisrz[0])
                                       + (z0-axisrz[1]) * (p->z[i]-axisrz[1]) );
-                p->phi[i] += atan2(   Xin_xyz[0] * Xout_xyz[1]
+                p->phi[i] += vecmath_atan2(   Xin_xyz[0] * Xout_xyz[1]
                                     - Xin_xyz[1] * Xout_xyz[0],
                                       Xin_xyz[0] * Xout_xyz[0]
                                     + Xin_xyz[1] * Xout_xyz[1] );
@@ -7,6 +7,7 @@
 #include "../../ascot5.h"
 #include "../../consts.h"
 #include "../../math.h"
+#include "../../vecmath.h"
 #include "../../physlib.h"
 #include "../../error.h"
 #include "../../particle.h"
@@ -29,11 +30,12 @@
  * @param pdata pointer to plasma data
  * @param rdata pointer to random-generator data
  * @param mdata pointer to collision data struct
+ * @param cache pointer to background quantity cache
  */
 void mccc_gc_milstein(particle_simd_gc* p, real* hin, real* hout, real tol,
                       mccc_wienarr* w, B_field_data* Bdata,
                       plasma_data* pdata, random_data* rdata,
-                      mccc_data* mdata) {
+                      mccc_data* mdata, mccc_cache* cache) {
 
     /* Generate random numbers and get plasma information before going to the *
      * SIMD loop                                                              */
@@ -62,23 +64,21 @@ void mccc_gc_milstein(particle_simd_gc* p, real* hin, real* hout, real tol,
             pin  = physlib_gc_p( p->mass[i], p->mu[i], p->ppar[i], Bnorm);
             xiin = physlib_gc_xi(p->mass[i], p->mu[i], p->ppar[i], Bnorm);
             vin  = physlib_vnorm_pnorm(p->mass[i], pin);
-            Xin_xyz[0] = p->r[i] * cos(p->phi[i]);
-            Xin_xyz[1] = p->r[i] * sin(p->phi[i]);
+            Xin_xyz[0] = p->r[i] * vecmath_cos(p->phi[i]);
+            Xin_xyz[1] = p->r[i] * vecmath_sin(p->phi[i]);
             Xin_xyz[2] = p->z[i];
 
-            /* Evaluate plasma density and temperature */
-            real nb[MAX_SPECIES], Tb[MAX_SPECIES];
+            /* Evaluate plasma density and temperature, and Coulomb
+             * logarithm, possibly from the cache */
+            real nb[MAX_SPECIES], Tb[MAX_SPECIES], clogab[MAX_SPECIES];
             if(!errflag) {
-                errflag = plasma_eval_densandtemp(nb, Tb, p->rho[i],
-                                                  p->r[i], p->phi[i], p->z[i],
-                                                  p->time[i], pdata);
+                errflag = mccc_eval_background(nb, Tb, clogab, p->rho[i],
+                                               p->r[i], p->phi[i], p->z[i],
+                                               p->time[i], p->mass[i],
+                                               p->charge[i], vin, pdata,
+                                               mdata, cache, i);
             }
 
-            /* Coulomb logarithm */
-            real clogab[MAX_SPECIES];
-            mccc_coefs_clog(clogab, p->mass[i], p->charge[i], vin,
-                            n_species, mb, qb, nb, Tb);
-
             /* Evaluate collision coefficients and sum them for each *
              * species                                               */
             real gyrofreq = phys_gyrofreq_pnorm(p->mass[i], p->charge[i], pin,
@@ -114,9 +114,12 @@ void mccc_gc_milstein(particle_simd_gc* p, real* hin, real* hout, real tol,
 
             /* Generate Wiener process for this step */
             int tindex;
+            real rnd5[5] = {rnd[0*NSIMD + i], rnd[1*NSIMD + i],
+                            rnd[2*NSIMD + i], rnd[3*NSIMD + i],
+                            rnd[4*NSIMD + i]};
             if(!errflag) {
                 errflag = mccc_wiener_generate(&w[i], w[i].time[0]+hin[i],
-                                               &tindex, &rnd[i*5]);
+                                               &tindex, rnd5);
             }
             real dW[5] = {0, 0, 0, 0, 0};
             if(!errflag) {
@@ -243,11 +246,11 @@ void mccc_gc_milstein(particle_simd_gc* p, real* hin, real* hout, real tol,
                 /* Evaluate phi and theta angles so that they are cumulative */
                 real axisrz[2];
                 errflag  = B_field_get_axis_rz(axisrz, Bdata, p->phi[i]);
-                p->theta[i] += atan2(   (R0-axisrz[0]) * (p->z[i]-axisrz[1])
+                p->theta[i] += vecmath_atan2(   (R0-axisrz[0]) * (p->z[i]-axisrz[1])
                                       - (z0-axisrz[1]) * (p->r[i]-axisrz[0]),
                                         (R0-axisrz[0]) * (p->r[i]-axisrz[0])
                                       + (z0-axisrz[1]) * (p->z[i]-axisrz[1]) );
-                p->phi[i] += atan2(   Xin_xyz[0] * Xout_xyz[1]
+                p->phi[i] += vecmath_atan2(   Xin_xyz[0] * Xout_xyz[1]
                                     - Xin_xyz[1] * Xout_xyz[0],
                                       Xin_xyz[0] * Xout_xyz[0]
                                     + Xin_xyz[1] * Xout_xyz[1] );
@@ -285,3 +288,83 @@ void mccc_gc_milstein(particle_simd_gc* p, real* hin, real* hout, real tol,
         }
     }
 }
+
+/**
+ * @brief Estimate the first time step of a marker
+ *
+ * Inverts the error estimates of mccc_gc_milstein() for the local collision
+ * coefficients, taking the Wiener increments at their typical size
+ * |dW| ~ sqrt(h), so that the first step is close to what the integrator
+ * would settle on instead of being found by repeated rejections.
+ *
+ * @param p pointer to gc simd struct
+ * @param i index of the marker
+ * @param tol relative error tolerance
+ * @param pdata pointer to plasma data
+ * @param mdata pointer to collision data struct
+ *
+ * @return estimated time step [s], or zero if it could not be evaluated
+ */
+real mccc_gc_milstein_inidt(particle_simd_gc* p, int i, real tol,
+                            plasma_data* pdata, mccc_data* mdata) {
+    int n_species  = plasma_get_n_species(pdata);
+    const real* qb = plasma_get_species_charge(pdata);
+    const real* mb = plasma_get_species_mass(pdata);
+
+    real Bnorm = math_normc(p->B_r[i], p->B_phi[i], p->B_z[i]);
+    real pin   = physlib_gc_p( p->mass[i], p->mu[i], p->ppar[i], Bnorm);
+    real xiin  = physlib_gc_xi(p->mass[i], p->mu[i], p->ppar[i], Bnorm);
+    real vin   = physlib_vnorm_pnorm(p->mass[i], pin);
+
+    real nb[MAX_SPECIES], Tb[MAX_SPECIES], clogab[MAX_SPECIES];
+    if( plasma_eval_densandtemp(nb, Tb, p->rho[i], p->r[i], p->phi[i],
+                                p->z[i], p->time[i], pdata) ) {
+        return 0;
+    }
+    mccc_coefs_clog(clogab, p->mass[i], p->charge[i], vin, n_species, mb, qb,
+                    nb, Tb);
+
+    real K = 0, Dpara = 0, dDpara = 0, dQ = 0, nu = 0;
+    for(int j = 0; j < n_species; j++) {
+        real vb = sqrt( 2 * Tb[j] / mb[j] );
+        real x  = vin / vb;
+        real mufun[3];
+        mccc_coefs_mufun(mufun, x, mdata);
+
+        real Qb      = mccc_coefs_Q(p->mass[i], p->charge[i], mb[j], qb[j],
+                                    nb[j], vb, clogab[j], mufun[0]);
+        real Dparab  = mccc_coefs_Dpara(p->mass[i], p->charge[i], vin, qb[j],
+                                       nb[j], vb, clogab[j], mufun[0]);
+        real Dperpb  = mccc_coefs_Dperp(p->mass[i], p->charge[i], vin, qb[j],
+                                       nb[j], vb, clogab[j], mufun[1]);
+        real dDparab = mccc_coefs_dDpara(p->mass[i], p->charge[i], vin, qb[j],
+                                         nb[j], vb, clogab[j], mufun[0],
+                                         mufun[2]);
+
+        K      += mccc_coefs_K(vin, Dparab, dDparab, Qb);
+        dQ     += mccc_coefs_dQ(p->mass[i], p->charge[i], mb[j], qb[j], nb[j],
+                                vb, clogab[j], mufun[2]);
+        Dpara  += Dparab;
+        dDpara += dDparab;
+        nu     += mccc_coefs_nu(vin, Dperpb);
+    }
+
+    /* Drift error kappa_k ~ h^2, diffusion errors kappa_d ~ h^(3/2) */
+    real verr  = fabs( K*dQ ) / (2*tol*vin);
+    real xierr = fabs( xiin*nu*nu ) / (2*tol);
+    real d0    = dDpara*dDpara / sqrt( Dpara ) / (6*tol*vin);
+    real d1    = sqrt( 1 - xiin*xiin ) * nu * sqrt( nu )
+               * ( 1 + 1 / sqrt(3.0) ) / (2*tol);
+
+    real h = DBL_MAX;
+    if(verr > 0 || xierr > 0) {
+        h = fmin( h, 1 / sqrt( fmax(verr, xierr) ) );
+    }
+    if(d0 > 0) {
+        h = fmin( h, pow( d0, -2.0/3.0 ) );
+    }
+    if(d1 > 0) {
+        h = fmin( h, pow( d1, -2.0/3.0 ) );
+    }
+    return h < DBL_MAX ? h : 0;
+}
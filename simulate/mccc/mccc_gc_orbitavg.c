@@ -0,0 +1,216 @@
+/**
+ * @file mccc_gc_orbitavg.c
+ * @brief Orbit-averaged collision operator in GC picture.
+ *
+ * When the collision time is much longer than the transit time, energy and
+ * pitch change little during a single poloidal transit. Instead of applying
+ * collisions at every orbit step, the drift and diffusion coefficients are
+ * integrated along the orbit while the marker completes a transit, and the
+ * orbit-averaged coefficients are then used to make a single jump in speed
+ * and in the pitch invariant lambda = (1 - xi^2) / B over a time interval
+ * that may span many transits.
+ *
+ * Since lambda is conserved along the collisionless orbit, the jump is
+ * meaningful at any point of the orbit; the pitch at the current position is
+ * recovered from the new lambda keeping the sign of the parallel velocity.
+ * Collisional spatial diffusion is not included.
+ */
+#include <math.h>
+#include <float.h>
+#include "../../ascot5.h"
+#include "../../consts.h"
+#include "../../math.h"
+#include "../../physlib.h"
+#include "../../error.h"
+#include "../../particle.h"
+#include "../../plasma.h"
+#include "../../random.h"
+#include "mccc_coefs.h"
+#include "mccc.h"
+
+/**
+ * @brief Reset the accumulated coefficients of a marker slot
+ *
+ * @param avg pointer to the accumulator struct
+ * @param i index of the slot
+ */
+void mccc_orbitavg_reset(mccc_orbitavg* avg, int i) {
+    avg->t[i]    = 0;
+    avg->K[i]    = 0;
+    avg->Dv[i]   = 0;
+    avg->Alam[i] = 0;
+    avg->Dlam[i] = 0;
+    avg->nu[i]   = 0;
+    avg->vcut[i] = 0;
+}
+
+/**
+ * @brief Accumulate collision coefficients along the orbit
+ *
+ * The coefficients are evaluated at the current marker position and weighted
+ * with the length of the orbit step that led there. Slots with zero step
+ * length are skipped.
+ *
+ * @param p pointer to gc simd struct
+ * @param h orbit time step of each marker, zero if the step is not counted
+ * @param avg pointer to the accumulator struct
+ * @param pdata pointer to plasma data
+ * @param mdata pointer to collision data struct
+ * @param cache pointer to background quantity cache
+ */
+void mccc_gc_orbitavg_accumulate(particle_simd_gc* p, real* h,
+                                 mccc_orbitavg* avg, plasma_data* pdata,
+                                 mccc_data* mdata, mccc_cache* cache) {
+
+    int n_species  = plasma_get_n_species(pdata);
+    const real* qb = plasma_get_species_charge(pdata);
+    const real* mb = plasma_get_species_mass(pdata);
+
+    #pragma omp simd
+    for(int i = 0; i < NSIMD; i++) {
+        if(p->running[i] && h[i] > 0) {
+            a5err errflag = 0;
+
+            real Bnorm = math_normc(p->B_r[i], p->B_phi[i], p->B_z[i]);
+            real pin   = physlib_gc_p( p->mass[i], p->mu[i], p->ppar[i], Bnorm);
+            real xiin  = physlib_gc_xi(p->mass[i], p->mu[i], p->ppar[i], Bnorm);
+            real vin   = physlib_vnorm_pnorm(p->mass[i], pin);
+
+            real nb[MAX_SPECIES], Tb[MAX_SPECIES], clogab[MAX_SPECIES];
+            errflag = mccc_eval_background(nb, Tb, clogab, p->rho[i],
+                                           p->r[i], p->phi[i], p->z[i],
+                                           p->time[i], p->mass[i],
+                                           p->charge[i], vin, pdata,
+                                           mdata, cache, i);
+
+            real K = 0, Dpara = 0, nu = 0;
+            for(int j = 0; j < n_species; j++) {
+                real vb = sqrt( 2 * Tb[j] / mb[j] );
+                real x  = vin / vb;
+                real mufun[3];
+                mccc_coefs_mufun(mufun, x, mdata);
+
+                real Qb      = mccc_coefs_Q(p->mass[i], p->charge[i], mb[j],
+                                            qb[j], nb[j], vb, clogab[j],
+                                            mufun[0]);
+                real Dparab  = mccc_coefs_Dpara(p->mass[i], p->charge[i], vin,
+                                               qb[j], nb[j], vb, clogab[j],
+                                               mufun[0]);
+                real Dperpb  = mccc_coefs_Dperp(p->mass[i], p->charge[i], vin,
+                                               qb[j], nb[j], vb, clogab[j],
+                                               mufun[1]);
+                real dDparab = mccc_coefs_dDpara(p->mass[i], p->charge[i], vin,
+                                                 qb[j], nb[j], vb, clogab[j],
+                                                 mufun[0], mufun[2]);
+
+                K     += mccc_coefs_K(vin, Dparab, dDparab, Qb);
+                Dpara += Dparab;
+                nu    += mccc_coefs_nu(vin, Dperpb);
+            }
+
+            if(!errflag) {
+                /* Ito drift and diffusion of lambda follow from those of xi:
+                 * dxi = -xi nu dt + sqrt((1-xi^2) nu) dW */
+                real xi2 = xiin * xiin;
+                avg->t[i]    += h[i];
+                avg->K[i]    += h[i] * K;
+                avg->Dv[i]   += h[i] * Dpara;
+                avg->Alam[i] += h[i] * nu * ( 3 * xi2 - 1 ) / Bnorm;
+                avg->Dlam[i] += h[i] * 4 * xi2 * ( 1 - xi2 ) * nu
+                              / ( Bnorm * Bnorm );
+                avg->nu[i]   += h[i] * nu;
+                avg->vcut[i] += h[i] * MCCC_CUTOFF * sqrt(Tb[0] / p->mass[i]);
+            }
+            else {
+                p->err[i]     = errflag;
+                p->running[i] = 0;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Apply orbit-averaged collisions
+ *
+ * Markers flagged in kick are given a jump in speed and lambda corresponding
+ * to the time interval dt using the orbit-averaged coefficients, after which
+ * their accumulators are reset. The collision time scale, i.e. the shortest
+ * of slowing-down, energy diffusion and pitch scattering times, is returned
+ * for all flagged markers so that the caller can choose the next interval.
+ *
+ * Random numbers are drawn for all slots on every call so that the stream of
+ * each marker does not depend on which other markers were kicked.
+ *
+ * @param p pointer to gc simd struct
+ * @param kick flag for each marker whether collisions are applied now
+ * @param dt time interval the collisions represent [s]
+ * @param tcol output array for the collision time scale [s]
+ * @param avg pointer to the accumulator struct
+ * @param rdata pointer to random-generator data
+ * @param mdata pointer to collision data struct
+ */
+void mccc_gc_orbitavg_kick(particle_simd_gc* p, int* kick, real* dt,
+                           real* tcol, mccc_orbitavg* avg,
+                           random_data* rdata, mccc_data* mdata) {
+
+    real rnd[2*NSIMD];
+    random_normal_simd(rdata, 2*NSIMD, rnd);
+
+    #pragma omp simd
+    for(int i = 0; i < NSIMD; i++) {
+        if(p->running[i] && kick[i] && avg->t[i] > 0) {
+            real Bnorm = math_normc(p->B_r[i], p->B_phi[i], p->B_z[i]);
+            real pin   = physlib_gc_p( p->mass[i], p->mu[i], p->ppar[i], Bnorm);
+            real xiin  = physlib_gc_xi(p->mass[i], p->mu[i], p->ppar[i], Bnorm);
+            real vin   = physlib_vnorm_pnorm(p->mass[i], pin);
+            real lamin = ( 1 - xiin * xiin ) / Bnorm;
+
+            /* Orbit-averaged coefficients */
+            real K      = avg->K[i]    / avg->t[i];
+            real Dv     = avg->Dv[i]   / avg->t[i];
+            real Alam   = avg->Alam[i] / avg->t[i];
+            real Dlam   = avg->Dlam[i] / avg->t[i];
+            real nu     = avg->nu[i]   / avg->t[i];
+            real cutoff = avg->vcut[i] / avg->t[i];
+
+            real vout   = vin + K * dt[i]
+                        + sqrt( 2 * Dv * dt[i] ) * rnd[0*NSIMD + i];
+            real lamout = lamin + Alam * dt[i]
+                        + sqrt( Dlam * dt[i] ) * rnd[1*NSIMD + i];
+
+            /* Enforce boundary conditions. A lambda beyond the value at
+             * which the marker would bounce here is mapped to xi = 0. */
+            if(vout < cutoff) {
+                vout = 2 * cutoff - vout;
+            }
+            if(lamout < 0) {
+                lamout = -lamout;
+            }
+            real xiout = copysign( sqrt( fmax( 1 - lamout * Bnorm, 0.0 ) ),
+                                   xiin );
+
+            if(!mdata->include_energy) {
+                vout = vin;
+            }
+            if(!mdata->include_pitch) {
+                xiout = xiin;
+            }
+            real pout = physlib_pnorm_vnorm(p->mass[i], vout);
+            p->ppar[i] = physlib_gc_ppar(pout, xiout);
+            p->mu[i]   = physlib_gc_mu(p->mass[i], pout, xiout, Bnorm);
+
+            /* Time scales on which speed and pitch change by order unity */
+            real t = DBL_MAX;
+            if(mdata->include_energy) {
+                t = fmin( t, vout / ( fabs(K) + DBL_MIN ) );
+                t = fmin( t, vout * vout / ( 2 * Dv + DBL_MIN ) );
+            }
+            if(mdata->include_pitch) {
+                t = fmin( t, 1 / ( nu + DBL_MIN ) );
+            }
+            tcol[i] = t;
+
+            mccc_orbitavg_reset(avg, i);
+        }
+    }
+}
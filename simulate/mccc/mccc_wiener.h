@@ -9,8 +9,9 @@
 #include "../../error.h"
 
 /**
- * Wiener process dimension. NDIM=5 because only guiding centers are simulated
- * with adaptive time step
+ * Wiener process dimension. NDIM=5 for guiding centers, whose position,
+ * velocity and pitch are diffused. Particles use only the first three
+ * components for the velocity vector.
  */
 #define MCCC_NDIM 5
 
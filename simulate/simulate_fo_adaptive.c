@@ -0,0 +1,343 @@
+/**
+ * @file simulate_fo_adaptive.c
+ * @brief Simulate particles using adaptive time-step
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <omp.h>
+#include <immintrin.h>
+#include <math.h>
+#include "../ascot5.h"
+#include "../physlib.h"
+#include "../simulate.h"
+#include "../particle.h"
+#include "../wall.h"
+#include "../diag.h"
+#include "../B_field.h"
+#include "../E_field.h"
+#include "../plasma.h"
+#include "../endcond.h"
+#include "../math.h"
+#include "../consts.h"
+#include "simulate_fo_adaptive.h"
+#include "step/step_fo_vpa.h"
+#include "mccc/mccc.h"
+#include "mccc/mccc_wiener.h"
+#include "atomic.h"
+
+#pragma omp declare target
+#pragma omp declare simd uniform(sim)
+real simulate_fo_adaptive_inidt(sim_data* sim, particle_simd_fo* p, int i);
+#pragma omp end declare target
+
+#define DUMMY_TIMESTEP_VAL 1.0 /**< Dummy time step value */
+
+/**
+ * @brief Simulates particles using adaptive time-step
+ *
+ * The simulation includes:
+ * - orbit-following with Volume-Preserving Algorithm
+ * - Coulomb collisions with Euler-Maruyama method
+ *
+ * The simulation is carried until all markers have met some
+ * end condition or are aborted/rejected. The final state of the
+ * markers is stored in the given marker array. Other output
+ * is stored in the diagnostic array.
+ *
+ * The adaptive time-step is determined by the estimated gyrophase error of
+ * the orbit step, the collision integrator error tolerance, and user-defined
+ * limits for how much marker state can change during a single time-step.
+ * The time-step is not adapted to MHD, which is included with the same step.
+ *
+ * @param pq particles to be simulated
+ * @param sim simulation data struct
+ */
+void simulate_fo_adaptive(particle_queue* pq, sim_data* sim) {
+
+    /* Wiener arrays needed for the adaptive time step */
+    mccc_wienarr wienarr[NSIMD];
+
+    /* Background plasma quantities reused between collision steps */
+    mccc_cache cache;
+    mccc_cache_init(&cache);
+
+    /* Random number streams of the markers in this group; the generator state
+     * is private to the thread */
+    random_data rdata = sim->random_data;
+
+    /* Current time step, suggestions for the next time step and next time
+     * step                                                                */
+    real hin[NSIMD]      __memalign__;
+    real hout_orb[NSIMD] __memalign__;
+    real hout_col[NSIMD] __memalign__;
+    real hnext[NSIMD]    __memalign__;
+
+    /* Flag indicateing whether a new marker was initialized */
+    int cycle[NSIMD]     __memalign__;
+
+    real tol_col = sim->ada_tol_clmbcol;
+    real tol_orb = sim->ada_tol_orbfol;
+
+    real cputime, cputime_last; // Global cpu time: recent and previous record
+
+    particle_simd_fo p;  // This array holds current states
+    particle_simd_fo p0; // This array stores previous states
+
+    for(int i=0; i< NSIMD; i++) {
+        p.id[i] = -1;
+        p.running[i] = 0;
+    }
+
+    /* Initialize running particles */
+    int n_running = particle_cycle_fo(pq, &p, &sim->B_data, cycle);
+
+    #pragma omp simd
+    for(int i = 0; i < NSIMD; i++) {
+        if(cycle[i] > 0) {
+            /* Determine initial time-step */
+            hin[i] = simulate_fo_adaptive_inidt(sim, &p, i);
+            random_set_stream(&rdata, i, p.id[i], RANDOM_STREAM_FO);
+            if(sim->enable_clmbcol) {
+                /* Allocate array storing the Wiener processes */
+                mccc_wiener_initialize(&(wienarr[i]), p.time[i]);
+                mccc_cache_reset(&cache, i);
+            }
+        }
+    }
+
+    cputime_last = A5_WTIME;
+
+    /* MAIN SIMULATION LOOP
+     * - Store current state
+     * - Integrate motion due to background EM-field (orbit-following)
+     * - Integrate scattering due to Coulomb collisions
+     * - Check whether time step was accepted
+     *   - NO:  revert to initial state and ignore the end of the loop
+     *   - YES: update particle time, clean redundant Wiener processes, and proceed
+     * - Check for end condition(s)
+     * - Update diagnostics
+     */
+    while(n_running > 0) {
+
+        /* Store marker states in case time step will be rejected */
+        #pragma omp simd
+        for(int i = 0; i < NSIMD; i++) {
+            particle_copy_fo(&p, i, &p0, i);
+            hout_orb[i] = DUMMY_TIMESTEP_VAL;
+            hout_col[i] = DUMMY_TIMESTEP_VAL;
+            hnext[i]    = DUMMY_TIMESTEP_VAL;
+        }
+
+        /*************************** Physics **********************************/
+
+        /* Set time-step negative if tracing backwards in time */
+        #pragma omp simd
+        for(int i = 0; i < NSIMD; i++) {
+            if(sim->reverse_time) {
+                hin[i]  = -hin[i];
+            }
+        }
+
+        /* Volume preserving algorithm for orbit-following */
+        if(sim->enable_orbfol) {
+            if(sim->enable_mhd) {
+                step_fo_vpa_mhd(&p, hin, &sim->B_data, &sim->E_data,
+                                &sim->boozer_data, &sim->mhd_data);
+            }
+            else {
+                step_fo_vpa_ada(&p, hin, hout_orb, tol_orb,
+                                &sim->B_data, &sim->E_data);
+            }
+        }
+
+        /* Check whether time step was rejected */
+        #pragma omp simd
+        for(int i = 0; i < NSIMD; i++) {
+            /* Switch sign of the time-step again if it was reverted earlier */
+            if(sim->reverse_time) {
+                hout_orb[i] = -hout_orb[i];
+                hin[i]      = -hin[i];
+            }
+            if(p.running[i] && hout_orb[i] < 0){
+                p.running[i] = 0;
+                hnext[i] = hout_orb[i];
+            }
+        }
+
+        /* Euler-Maruyama for Coulomb collisions */
+        if(sim->enable_clmbcol) {
+            mccc_fo_euler_adaptive(&p, hin, hout_col, tol_col, wienarr,
+                                   &sim->plasma_data, &rdata,
+                                   &sim->mccc_data, &cache);
+
+            /* Check whether time step was rejected */
+            #pragma omp simd
+            for(int i = 0; i < NSIMD; i++) {
+                if(p.running[i] && hout_col[i] < 0){
+                    p.running[i] = 0;
+                    hnext[i] = hout_col[i];
+                }
+            }
+        }
+
+        /* Atomic reactions */
+        if(sim->enable_atomic) {
+            atomic_fo(&p, hin, &sim->plasma_data, &sim->neutral_data,
+                      &rdata, &sim->asigma_data,
+                      &sim->enable_atomic);
+        }
+
+        /**********************************************************************/
+
+        cputime = A5_WTIME;
+        #pragma omp simd
+        for(int i = 0; i < NSIMD; i++) {
+            if(!p.err[i]) {
+                /* Check other time step limitations */
+                if(hnext[i] > 0) {
+                    real dphi = fabs(p0.phi[i]-p.phi[i]) / sim->ada_max_dphi;
+                    real drho = fabs(p0.rho[i]-p.rho[i]) / sim->ada_max_drho;
+
+                    if(dphi > 1 && dphi > drho) {
+                        hnext[i] = -hin[i]/dphi;
+                    }
+                    else if(drho > 1 && drho > dphi) {
+                        hnext[i] = -hin[i]/drho;
+                    }
+                }
+
+                /* Retrieve marker states in case time step was rejected */
+                if(hnext[i] < 0) {
+                    particle_copy_fo(&p0, i, &p, i);
+                }
+                if(p.running[i]){
+
+                    /* Advance time (if time step was accepted) and determine
+                       next time step */
+                    if(hnext[i] < 0){
+                        /* Time step was rejected, use the suggestion given by
+                           integrator */
+                        hin[i] = -hnext[i];
+                    }
+                    else {
+                        p.time[i]    += ( 1.0 - 2.0 * ( sim->reverse_time > 0 ) ) * hin[i];
+                        p.mileage[i] += hin[i];
+
+                        if(hnext[i] > hout_orb[i]) {
+                            /* Use time step suggested by the orbit-following
+                               integrator */
+                            hnext[i] = hout_orb[i];
+                        }
+                        if(hnext[i] > hout_col[i]) {
+                            /* Use time step suggested by the collision
+                               integrator */
+                            hnext[i] = hout_col[i];
+                        }
+                        if(hnext[i] == 1.0) {
+                            /* Time step is unchanged (happens when no physics
+                               are enabled) */
+                            hnext[i] = hin[i];
+                        }
+                        hin[i] = hnext[i];
+                        if(sim->enable_clmbcol) {
+                            /* Clear wiener processes */
+                            mccc_wiener_clean(&(wienarr[i]), p.time[i]);
+                        }
+                    }
+
+                    p.cputime[i] += cputime - cputime_last;
+                }
+            }
+        }
+        cputime_last = cputime;
+
+        /* Check possible end conditions */
+        endcond_check_fo(&p, &p0, sim);
+
+        /* Update diagnostics */
+        if(!(sim->record_mode)) {
+            /* Record particle coordinates */
+            diag_update_fo(&sim->diag_data, &sim->B_data, &p, &p0);
+        }
+        else {
+            /* Instead of particle coordinates we record guiding center */
+
+            // Dummy guiding centers
+            particle_simd_gc gc_f;
+            particle_simd_gc gc_i;
+
+            /* Particle to guiding center transformation */
+            #pragma omp simd
+            for(int i=0; i<NSIMD; i++) {
+                if(p.running[i]) {
+                    particle_fo_to_gc( &p, i, &gc_f, &sim->B_data);
+                    particle_fo_to_gc(&p0, i, &gc_i, &sim->B_data);
+                }
+                else {
+                    gc_f.id[i] = p.id[i];
+                    gc_i.id[i] = p.id[i];
+
+                    gc_f.running[i] = 0;
+                    gc_i.running[i] = 0;
+                }
+            }
+            diag_update_gc(&sim->diag_data, &sim->B_data, &gc_f, &gc_i);
+        }
+
+        /* Update running particles */
+        n_running = particle_cycle_fo(pq, &p, &sim->B_data, cycle);
+
+        /* Determine simulation time-step for new particles */
+        #pragma omp simd
+        for(int i = 0; i < NSIMD; i++) {
+            if(cycle[i] > 0) {
+                hin[i] = simulate_fo_adaptive_inidt(sim, &p, i);
+                random_set_stream(&rdata, i, p.id[i], RANDOM_STREAM_FO);
+                if(sim->enable_clmbcol) {
+                    /* Re-allocate array storing the Wiener processes */
+                    mccc_wiener_initialize(&(wienarr[i]), p.time[i]);
+                    mccc_cache_reset(&cache, i);
+                }
+            }
+        }
+    }
+
+    /* All markers simulated! */
+    if(sim->enable_clmbcol) {
+        mccc_cache_collect(&cache, &sim->mccc_data);
+    }
+}
+
+/**
+ * @brief Calculates initial time step value
+ *
+ * The initial time step is the one a fixed-step simulation would use: either
+ * the user-defined value or a user-defined fraction of gyrotime. The step is
+ * then adapted during the simulation.
+ *
+ * @param sim pointer to simulation data struct
+ * @param p SIMD array of markers
+ * @param i index of marker for which time step is assessed
+ *
+ * @return Calculated time step
+ */
+real simulate_fo_adaptive_inidt(sim_data* sim, particle_simd_fo* p, int i) {
+
+    real h;
+
+    /* Value defined directly by user */
+    if(sim->fix_usrdef_use) {
+        h = sim->fix_usrdef_val;
+    }
+    else {
+        /* Value calculated from gyrotime */
+        real Bnorm = math_normc( p->B_r[i], p->B_phi[i], p->B_z[i] );
+        real pnorm = math_normc( p->p_r[i], p->p_phi[i], p->p_z[i] );
+        real gyrotime = CONST_2PI/
+            phys_gyrofreq_pnorm(p->mass[i], p->charge[i], pnorm, Bnorm);
+        h = gyrotime/sim->fix_gyrodef_nstep;
+    }
+
+    return h;
+}
@@ -0,0 +1,16 @@
+/**
+ * @file simulate_fo_adaptive.h
+ * @brief Header file for simulate_fo_adaptive.c
+ */
+#ifndef SIMULATE_FO_ADAPTIVE_H
+#define SIMULATE_FO_ADAPTIVE_H
+
+#include "../ascot5.h"
+#include "../simulate.h"
+#include "../particle.h"
+
+#pragma omp declare target
+void simulate_fo_adaptive(particle_queue* pq, sim_data* sim);
+#pragma omp end declare target
+
+#endif
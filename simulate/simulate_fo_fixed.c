@@ -51,12 +51,19 @@ real simulate_fo_fixed_inidt(sim_data* sim, particle_simd_fo* p, int i);
 void simulate_fo_fixed(particle_queue* pq, sim_data* sim) {
     int cycle[NSIMD]  __memalign__; // Flag indigating whether a new marker was initialized
     real hin[NSIMD]  __memalign__;  // Time step
+    mccc_cache cache;               // Background quantities for collisions
 
     real cputime, cputime_last; // Global cpu time: recent and previous record
 
     particle_simd_fo p;  // This array holds current states
     particle_simd_fo p0; // This array stores previous states
 
+    mccc_cache_init(&cache);
+
+    /* Random number streams of the markers in this group; the generator state
+     * is private to the thread */
+    random_data rdata = sim->random_data;
+
     /* Init dummy markers */
     for(int i=0; i< NSIMD; i++) {
         p.id[i] = -1;
@@ -71,6 +78,8 @@ void simulate_fo_fixed(particle_queue* pq, sim_data* sim) {
     for(int i = 0; i < NSIMD; i++) {
         if(cycle[i] > 0) {
             hin[i] = simulate_fo_fixed_inidt(sim, &p, i);
+            mccc_cache_reset(&cache, i);
+            random_set_stream(&rdata, i, p.id[i], RANDOM_STREAM_FO);
 
         }
     }
@@ -124,14 +133,14 @@ void simulate_fo_fixed(particle_queue* pq, sim_data* sim) {
 
         /* Euler-Maruyama for Coulomb collisions */
         if(sim->enable_clmbcol) {
-            mccc_fo_euler(&p, hin, &sim->plasma_data, sim->random_data,
-                          &sim->mccc_data);
+            mccc_fo_euler(&p, hin, &sim->plasma_data, &rdata,
+                          &sim->mccc_data, &cache);
         }
 
         /* Atomic reactions */
         if(sim->enable_atomic) {
             atomic_fo(&p, hin, &sim->plasma_data, &sim->neutral_data,
-                      &sim->random_data, &sim->asigma_data,
+                      &rdata, &sim->asigma_data,
                       &sim->enable_atomic);
         }
 
@@ -191,12 +200,16 @@ void simulate_fo_fixed(particle_queue* pq, sim_data* sim) {
         for(int i = 0; i < NSIMD; i++) {
             if(cycle[i] > 0) {
                 hin[i] = simulate_fo_fixed_inidt(sim, &p, i);
+                mccc_cache_reset(&cache, i);
+                random_set_stream(&rdata, i, p.id[i], RANDOM_STREAM_FO);
             }
         }
     }
 
     /* All markers simulated! */
-
+    if(sim->enable_clmbcol) {
+        mccc_cache_collect(&cache, &sim->mccc_data);
+    }
 }
 
 /**
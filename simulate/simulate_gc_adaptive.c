@@ -25,23 +25,39 @@
 #include "../plasma.h"
 #include "simulate_gc_adaptive.h"
 #include "step/step_gc_cashkarp.h"
+#include "step/step_gc_dopri.h"
 #include "mccc/mccc.h"
 #include "mccc/mccc_wiener.h"
 
 #pragma omp declare target
 #pragma omp declare simd uniform(sim)
 real simulate_gc_adaptive_inidt(sim_data* sim, particle_simd_gc* p, int i);
+void simulate_gc_adaptive_ccoll(particle_simd_gc* p, real* hcol, real* tacc,
+                                real* horb, int* fsal_valid,
+                                mccc_wienarr* wienarr, mccc_cache* cache,
+                                random_data* rdata, sim_data* sim);
 #pragma omp end declare target
 
 #define DUMMY_TIMESTEP_VAL 1.0 /**< Dummy time step value */
 
+/** Initial orbit step is this times tol^(1/5) divided by the poloidal angular
+ *  frequency; calibrated against the steps Cash-Karp settles on */
+#define SIMULATE_GC_ADAPTIVE_ORBFOL_FRAC 3.0
+
 /**
  * @brief Simulates guiding centers using adaptive time-step
  *
  * The simulation includes:
- * - orbit-following with Cash-Karp method
+ * - orbit-following with Cash-Karp or Dormand-Prince method
  * - Coulomb collisions with Milstein method
  *
+ * Collisions are either applied at every orbit step, or, if collision
+ * sub-cycling is enabled, orbit-following takes its own steps until the
+ * accumulated time reaches the collision step and collisions are then
+ * applied over the whole interval (Lie splitting). The collision step is
+ * limited to a user-given number of orbit steps, since the collision
+ * coefficients are evaluated at a single point of the orbit.
+ *
  * The simulation is carried until all marker have met some
  * end condition or are aborted/rejected. The final state of the
  * markers is stored in the given marker array. Other output
@@ -60,6 +76,14 @@ void simulate_gc_adaptive(particle_queue* pq, sim_data* sim) {
     /* Wiener arrays needed for the adaptive time step */
     mccc_wienarr wienarr[NSIMD];
 
+    /* Background plasma quantities reused between collision steps */
+    mccc_cache cache;
+    mccc_cache_init(&cache);
+
+    /* Random number streams of the markers in this group; the generator state
+     * is private to the thread */
+    random_data rdata = sim->random_data;
+
     /* Current time step, suggestions for the next time step and next time
      * step                                                                */
     real hin[NSIMD]      __memalign__;
@@ -67,11 +91,24 @@ void simulate_gc_adaptive(particle_queue* pq, sim_data* sim) {
     real hout_col[NSIMD] __memalign__;
     real hnext[NSIMD]    __memalign__;
 
+    /* With sub-cycling: current collision step, orbit time accumulated
+     * since the last collision step, and the orbit step before it was
+     * shortened to end at the collision step */
+    real hcol[NSIMD]     __memalign__;
+    real tacc[NSIMD]     __memalign__;
+    real horb[NSIMD]     __memalign__;
+
     /* Flag indicateing whether a new marker was initialized */
     int cycle[NSIMD]     __memalign__;
 
+    /* Last stage of the Dormand-Prince step and whether it is valid as the
+     * first stage of the next step */
+    real fsal[6*NSIMD]    __memalign__;
+    int fsal_valid[NSIMD] __memalign__;
+
     real tol_col = sim->ada_tol_clmbcol;
     real tol_orb = sim->ada_tol_orbfol;
+    int subcycle = sim->enable_clmbcol && sim->enable_ccollsubcycle;
 
     real cputime, cputime_last; // Global cpu time: recent and previous record
 
@@ -81,6 +118,7 @@ void simulate_gc_adaptive(particle_queue* pq, sim_data* sim) {
     for(int i=0; i< NSIMD; i++) {
         p.id[i] = -1;
         p.running[i] = 0;
+        fsal_valid[i] = 0;
     }
 
     /* Initialize running particles */
@@ -91,9 +129,14 @@ void simulate_gc_adaptive(particle_queue* pq, sim_data* sim) {
         if(cycle[i] > 0) {
             /* Determine initial time-step */
             hin[i] = simulate_gc_adaptive_inidt(sim, &p, i);
+            hcol[i] = hin[i];
+            tacc[i] = 0;
+            fsal_valid[i] = 0;
             if(sim->enable_clmbcol) {
                 /* Allocate array storing the Wiener processes */
                 mccc_wiener_initialize(&(wienarr[i]), p.time[i]);
+                mccc_cache_reset(&cache, i);
+                random_set_stream(&rdata, i, p.id[i], RANDOM_STREAM_GC);
             }
         }
     }
@@ -120,6 +163,12 @@ void simulate_gc_adaptive(particle_queue* pq, sim_data* sim) {
             hout_orb[i] = DUMMY_TIMESTEP_VAL;
             hout_col[i] = DUMMY_TIMESTEP_VAL;
             hnext[i]    = DUMMY_TIMESTEP_VAL;
+
+            /* Orbit steps must not go past the end of the collision step */
+            horb[i] = hin[i];
+            if(subcycle && hin[i] > hcol[i] - tacc[i]) {
+                hin[i] = hcol[i] - tacc[i];
+            }
         }
 
         /*************************** Physics **********************************/
@@ -132,13 +181,17 @@ void simulate_gc_adaptive(particle_queue* pq, sim_data* sim) {
             }
         }
 
-        /* Cash-Karp method for orbit-following */
+        /* Cash-Karp or Dormand-Prince method for orbit-following */
         if(sim->enable_orbfol) {
             if(sim->enable_mhd) {
                 step_gc_cashkarp_mhd(&p, hin, hout_orb, tol_orb,
                                      &sim->B_data, &sim->E_data,
                                      &sim->boozer_data, &sim->mhd_data);
             }
+            else if(sim->ada_orbfol_method == 1) {
+                step_gc_dopri(&p, hin, hout_orb, tol_orb,
+                              &sim->B_data, &sim->E_data, fsal, fsal_valid);
+            }
             else {
                 step_gc_cashkarp(&p, hin, hout_orb, tol_orb,
                                  &sim->B_data, &sim->E_data);
@@ -159,14 +212,18 @@ void simulate_gc_adaptive(particle_queue* pq, sim_data* sim) {
         }
 
         /* Milstein method for collisions */
-        if(sim->enable_clmbcol) {
+        if(sim->enable_clmbcol && !subcycle) {
             mccc_gc_milstein(&p, hin, hout_col, tol_col, wienarr, &sim->B_data,
-                             &sim->plasma_data, &sim->random_data,
-                             &sim->mccc_data);
+                             &sim->plasma_data, &rdata,
+                             &sim->mccc_data, &cache);
 
-            /* Check whether time step was rejected */
+            /* Check whether time step was rejected. Markers that were
+             * scattered no longer match the stored Dormand-Prince stage. */
             #pragma omp simd
             for(int i = 0; i < NSIMD; i++) {
+                if(p.running[i]) {
+                    fsal_valid[i] = 0;
+                }
                 if(p.running[i] && hout_col[i] < 0){
                     p.running[i] = 0;
                     hnext[i] = hout_col[i];
@@ -196,6 +253,9 @@ void simulate_gc_adaptive(particle_queue* pq, sim_data* sim) {
                 /* Retrieve marker states in case time step was rejected */
                 if(hnext[i] < 0) {
                     particle_copy_gc(&p0, i, &p, i);
+                    if(hout_orb[i] > 0) {
+                        fsal_valid[i] = 0;
+                    }
 
                     hin[i] = -hnext[i];
                 }
@@ -227,11 +287,19 @@ void simulate_gc_adaptive(particle_queue* pq, sim_data* sim) {
                                are enabled) */
                             hnext[i] = hin[i];
                         }
-                        hin[i] = hnext[i];
-                        if(sim->enable_clmbcol) {
+                        if(subcycle) {
+                            /* A step that was shortened to meet the collision
+                             * step does not shorten the next orbit step */
+                            tacc[i] += hin[i];
+                            if(hnext[i] < horb[i] && hin[i] < horb[i]) {
+                                hnext[i] = horb[i];
+                            }
+                        }
+                        else if(sim->enable_clmbcol) {
                             /* Clear wiener processes */
                             mccc_wiener_clean(&(wienarr[i]), p.time[i]);
                         }
+                        hin[i] = hnext[i];
                     }
 
                     p.cputime[i] += cputime - cputime_last;
@@ -240,6 +308,13 @@ void simulate_gc_adaptive(particle_queue* pq, sim_data* sim) {
         }
         cputime_last = cputime;
 
+        /* Apply collisions to markers that reached the end of the collision
+         * step */
+        if(subcycle) {
+            simulate_gc_adaptive_ccoll(&p, hcol, tacc, hin, fsal_valid,
+                                       wienarr, &cache, &rdata, sim);
+        }
+
         /* Check possible end conditions */
         endcond_check_gc(&p, &p0, sim);
 
@@ -254,23 +329,128 @@ void simulate_gc_adaptive(particle_queue* pq, sim_data* sim) {
         for(int i = 0; i < NSIMD; i++) {
             if(cycle[i] > 0) {
                 hin[i] = simulate_gc_adaptive_inidt(sim, &p, i);
+                hcol[i] = hin[i];
+                tacc[i] = 0;
+                fsal_valid[i] = 0;
                 if(sim->enable_clmbcol) {
                     /* Re-allocate array storing the Wiener processes */
                     mccc_wiener_initialize(&(wienarr[i]), p.time[i]);
+                    mccc_cache_reset(&cache, i);
+                    random_set_stream(&rdata, i, p.id[i], RANDOM_STREAM_GC);
                 }
             }
         }
     }
 
     /* All markers simulated! */
+    if(sim->enable_clmbcol) {
+        mccc_cache_collect(&cache, &sim->mccc_data);
+    }
+}
 
+/**
+ * @brief Apply collisions over the accumulated orbit-following interval
+ *
+ * Markers whose accumulated orbit time tacc has reached the collision step
+ * hcol, or is so close to it that the remaining orbit step would be
+ * negligible, take Milstein steps at their current position until the whole
+ * interval is covered. Usually a single step suffices, but if the collision
+ * integrator rejects the step it is retried in shorter pieces, and the
+ * Brownian bridge keeps the Wiener process consistent with the parts already
+ * generated. The Wiener process has its own clock, so it is cleaned at the
+ * end of each collision step rather than at the marker time.
+ *
+ * On return hcol holds the next collision step of the markers that had
+ * collisions, limited to ENABLE_CCOLL_SUBCYCLE times the next orbit step,
+ * and their tacc is reset.
+ *
+ * @param p SIMD array of markers
+ * @param hcol collision step of each marker
+ * @param tacc orbit time accumulated since the last collision step
+ * @param horb next orbit step of each marker
+ * @param fsal_valid Dormand-Prince stage validity, cleared for scattered
+ *        markers
+ * @param wienarr Wiener arrays of the markers
+ * @param cache background quantity cache
+ * @param rdata random number generator data
+ * @param sim pointer to simulation data struct
+ */
+void simulate_gc_adaptive_ccoll(particle_simd_gc* p, real* hcol, real* tacc,
+                                real* horb, int* fsal_valid,
+                                mccc_wienarr* wienarr, mccc_cache* cache,
+                                random_data* rdata, sim_data* sim) {
+    int due[NSIMD]  __memalign__;
+    real hc[NSIMD]  __memalign__;
+    real hout[NSIMD] __memalign__;
+    real rem[NSIMD] __memalign__;
+    particle_simd_gc pc;
+
+    int ndue = 0;
+    for(int i = 0; i < NSIMD; i++) {
+        due[i] = p->running[i] && hcol[i] - tacc[i] <= 1e-3 * horb[i];
+        hc[i]  = tacc[i];
+        rem[i] = tacc[i];
+        ndue  += due[i];
+    }
+
+    while(ndue > 0) {
+        /* Store states in case the step is rejected and mask out markers
+         * that are not due */
+        #pragma omp simd
+        for(int i = 0; i < NSIMD; i++) {
+            particle_copy_gc(p, i, &pc, i);
+            p->running[i] = due[i];
+            hout[i] = DUMMY_TIMESTEP_VAL;
+        }
+
+        mccc_gc_milstein(p, hc, hout, sim->ada_tol_clmbcol, wienarr,
+                         &sim->B_data, &sim->plasma_data, rdata,
+                         &sim->mccc_data, cache);
+
+        ndue = 0;
+        for(int i = 0; i < NSIMD; i++) {
+            if(!due[i]) {
+                p->running[i] = pc.running[i];
+                continue;
+            }
+            if(!p->running[i]) {
+                /* Marker was aborted */
+                due[i] = 0;
+                continue;
+            }
+            if(hout[i] < 0) {
+                particle_copy_gc(&pc, i, p, i);
+                hc[i] = -hout[i];
+            }
+            else {
+                mccc_wiener_clean(&(wienarr[i]), wienarr[i].time[0] + hc[i]);
+                rem[i] -= hc[i];
+                hcol[i] = hout[i];
+                hc[i]   = fmin(hout[i], rem[i]);
+            }
+            if(rem[i] > 0) {
+                ndue++;
+            }
+            else {
+                due[i]        = 0;
+                tacc[i]       = 0;
+                fsal_valid[i] = 0;
+                hcol[i] = fmin(hcol[i], sim->enable_ccollsubcycle * horb[i]);
+            }
+        }
+    }
 }
 
 /**
  * @brief Calculates time step value
  *
- * The returned time step is either directly user-defined, 1/100th of collision
- * frequency or user-defined fraction of gyro-motion.
+ * The returned time step is either directly user-defined or estimated from
+ * the time scales of the enabled physics so that the first step is roughly
+ * what the integrators would settle on:
+ *
+ * - orbit-following: see simulate_gc_adaptive_inidt_orbfol(),
+ * - collisions: the Milstein error estimates evaluated with the local
+ *   collision coefficients.
  *
  * @param sim pointer to simulation data struct
  * @param p SIMD array of markers
@@ -279,33 +459,88 @@ void simulate_gc_adaptive(particle_queue* pq, sim_data* sim) {
  * @return Calculated time step
  */
 real simulate_gc_adaptive_inidt(sim_data* sim, particle_simd_gc* p, int i) {
-    /* Just use some large value if no physics are defined */
-    real h = DUMMY_TIMESTEP_VAL;
-
     /* Value defined directly by user */
     if(sim->fix_usrdef_use) {
-        h =  sim->fix_usrdef_val;
+        return sim->fix_usrdef_val;
     }
-    else {
-        /* Value calculated from gyrotime */
-        if(sim->enable_orbfol) {
-            real Bnorm = math_normc(p->B_r[i], p->B_phi[i], p->B_z[i]);
-            real gyrotime = CONST_2PI /
-                phys_gyrofreq_ppar(p->mass[i], p->charge[i], p->mu[i],
-                                   p->ppar[i], Bnorm);
-            if(h > gyrotime) {
-                h = gyrotime;
-            }
+
+    real h = simulate_gc_adaptive_inidt_orbfol(sim, p, i);
+
+    if(sim->enable_clmbcol) {
+        real hcol = mccc_gc_milstein_inidt(p, i, sim->ada_tol_clmbcol,
+                                           &sim->plasma_data,
+                                           &sim->mccc_data);
+        if(hcol > 0) {
+            h = fmin( h, hcol );
         }
+    }
+    return h;
+}
 
-        /* Value calculated from collision frequency */
-        if(sim->enable_clmbcol) {
-            real nu = 1;
-            //mccc_collfreq_gc(p, &sim->B_data, &sim->plasma_data, sim->coldata, &nu, i);
+/**
+ * @brief Estimate the time step of the orbit-following integrator
+ *
+ * The estimate is the smallest of a fraction of the poloidal transit time
+ * that depends on the integrator tolerance, the time to move
+ * ADAPTIVE_MAX_DPHI toroidally and the time for the drift to change rho by
+ * ADAPTIVE_MAX_DRHO. The gyro period is used if the local field does not
+ * allow the estimate. The orbit-averaged loop uses this for its first step
+ * as the collisions do not limit its orbit steps.
+ *
+ * @param sim pointer to simulation data struct
+ * @param p SIMD array of markers
+ * @param i index of marker for which time step is assessed
+ *
+ * @return Estimated time step or a large dummy value if orbit-following is
+ *         disabled
+ */
+real simulate_gc_adaptive_inidt_orbfol(sim_data* sim, particle_simd_gc* p,
+                                       int i) {
+    /* Just use some large value if no physics are defined */
+    real h = DUMMY_TIMESTEP_VAL;
 
-            /* Only small angle collisions so divide this by 100 */
-            real colltime = 1/(100*nu);
-            if(h > colltime) {h=colltime;}
+    if(sim->enable_orbfol) {
+        real Bnorm = math_normc(p->B_r[i], p->B_phi[i], p->B_z[i]);
+        real Bpol  = sqrt( p->B_r[i] * p->B_r[i] + p->B_z[i] * p->B_z[i] );
+        real pnorm = physlib_gc_p(p->mass[i], p->mu[i], p->ppar[i], Bnorm);
+        real xi    = physlib_gc_xi(p->mass[i], p->mu[i], p->ppar[i], Bnorm);
+        real v     = physlib_vnorm_pnorm(p->mass[i], pnorm);
+        real gyrofreq = phys_gyrofreq_pnorm(p->mass[i], p->charge[i], pnorm,
+                                            Bnorm);
+        real vpar  = fabs(xi) * v;
+
+        /* Curvature and gradient drift */
+        real vdrift = ( vpar * vpar + 0.5 * ( v * v - vpar * vpar ) )
+            / ( gyrofreq * p->r[i] );
+
+        real axisrz[2], rho_drho[4];
+        a5err err = B_field_get_axis_rz(axisrz, &sim->B_data, p->phi[i]);
+        if(!err) {
+            err = B_field_eval_rho_drho(rho_drho, p->r[i], p->phi[i], p->z[i],
+                                        &sim->B_data);
+        }
+        real d = sqrt( (p->r[i] - axisrz[0]) * (p->r[i] - axisrz[0])
+                     + (p->z[i] - axisrz[1]) * (p->z[i] - axisrz[1]) );
+
+        if(!err && d > 0) {
+            /* Poloidal transit, resolved by the integrator in steps that
+             * shrink with the tolerance as tol^(1/5) */
+            real omegapol = ( vpar * Bpol / Bnorm + vdrift ) / d;
+            h = fmin( h, SIMULATE_GC_ADAPTIVE_ORBFOL_FRAC
+                      * pow(sim->ada_tol_orbfol, 0.2) / omegapol );
+
+            /* Toroidal motion and radial drift */
+            real omegator = ( vpar * fabs(p->B_phi[i]) / Bnorm + vdrift )
+                / p->r[i];
+            h = fmin( h, sim->ada_max_dphi / omegator );
+            real gradrho = sqrt( rho_drho[1] * rho_drho[1]
+                               + rho_drho[3] * rho_drho[3] );
+            if(gradrho > 0) {
+                h = fmin( h, sim->ada_max_drho / ( vdrift * gradrho ) );
+            }
+        }
+        else {
+            h = fmin( h, CONST_2PI / gyrofreq );
         }
     }
     return h;
@@ -11,6 +11,9 @@
 
 #pragma omp declare target
 void simulate_gc_adaptive(particle_queue* pq, sim_data* sim);
+#pragma omp declare simd uniform(sim)
+real simulate_gc_adaptive_inidt_orbfol(sim_data* sim, particle_simd_gc* p,
+                                       int i);
 #pragma omp end declare target
 
 #endif
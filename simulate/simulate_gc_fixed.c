@@ -21,6 +21,7 @@
 #include "../plasma.h"
 #include "simulate_gc_fixed.h"
 #include "step/step_gc_rk4.h"
+#include "step/step_gc_invariants.h"
 #include "mccc/mccc.h"
 
 #pragma omp declare target
@@ -49,12 +50,31 @@ real simulate_gc_fixed_inidt(sim_data* sim, particle_simd_gc* p, int i);
 void simulate_gc_fixed(particle_queue* pq, sim_data* sim) {
     int cycle[NSIMD]  __memalign__; // Flag indigating whether a new marker was initialized
     real hin[NSIMD]  __memalign__;  // Time step
+    mccc_cache cache;               // Background quantities for collisions
 
     real cputime, cputime_last; // Global cpu time: recent and previous record
 
     particle_simd_gc p;  // This array holds current states
     particle_simd_gc p0; // This array stores previous states
 
+    mccc_cache_init(&cache);
+
+    /* Random number streams of the markers in this group; the generator state
+     * is private to the thread */
+    random_data rdata = sim->random_data;
+
+    /* Constants of motion before the orbit step if the step is projected
+     * back onto them. Energy is conserved only without electric field and
+     * canonical toroidal momentum only in an axisymmetric field. */
+    real psq[NSIMD]  __memalign__;
+    real ptor[NSIMD] __memalign__;
+    int project = sim->fix_conserve_invariants && !sim->enable_mhd
+        && sim->E_data.type == E_field_type_TC
+        && sim->E_data.ETC.Exyz[0] == 0 && sim->E_data.ETC.Exyz[1] == 0
+        && sim->E_data.ETC.Exyz[2] == 0;
+    int axisym = sim->B_data.type == B_field_type_2DS
+        || (sim->B_data.type == B_field_type_GS && sim->B_data.BGS.Nripple == 0);
+
     /* Init dummy markers */
     for(int i=0; i< NSIMD; i++) {
         p.id[i] = -1;
@@ -69,6 +89,8 @@ void simulate_gc_fixed(particle_queue* pq, sim_data* sim) {
     for(int i = 0; i < NSIMD; i++) {
         if(cycle[i] > 0) {
             hin[i] = simulate_gc_fixed_inidt(sim, &p, i);
+            mccc_cache_reset(&cache, i);
+            random_set_stream(&rdata, i, p.id[i], RANDOM_STREAM_GC);
         }
     }
 
@@ -106,6 +128,12 @@ void simulate_gc_fixed(particle_queue* pq, sim_data* sim) {
                 step_gc_rk4_mhd(&p, hin, &sim->B_data, &sim->E_data,
                                 &sim->boozer_data, &sim->mhd_data);
             }
+            else if(project) {
+                step_gc_invariants_eval(&p, psq, ptor, &sim->B_data);
+                step_gc_rk4(&p, hin, &sim->B_data, &sim->E_data);
+                step_gc_invariants_project(&p, hin, psq, ptor, axisym,
+                                           &sim->B_data);
+            }
             else {
                 step_gc_rk4(&p, hin, &sim->B_data, &sim->E_data);
             }
@@ -122,7 +150,7 @@ void simulate_gc_fixed(particle_queue* pq, sim_data* sim) {
         /* Euler-Maruyama method for collisions */
         if(sim->enable_clmbcol) {
             mccc_gc_euler(&p, hin, &sim->B_data, &sim->plasma_data,
-                          &sim->random_data, &sim->mccc_data);
+                          &rdata, &sim->mccc_data, &cache);
         }
 
         /**********************************************************************/
@@ -154,13 +182,17 @@ void simulate_gc_fixed(particle_queue* pq, sim_data* sim) {
         for(int i = 0; i < NSIMD; i++) {
             if(cycle[i] > 0) {
                 hin[i] = simulate_gc_fixed_inidt(sim, &p, i);
+                mccc_cache_reset(&cache, i);
+                random_set_stream(&rdata, i, p.id[i], RANDOM_STREAM_GC);
             }
         }
 
     }
 
     /* All markers simulated! */
-
+    if(sim->enable_clmbcol) {
+        mccc_cache_collect(&cache, &sim->mccc_data);
+    }
 }
 
 /**
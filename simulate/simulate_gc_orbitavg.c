@@ -0,0 +1,334 @@
+/**
+ * @file simulate_gc_orbitavg.c
+ * @brief Simulate guiding centers with orbit-averaged collisions
+ *
+ * For slowing-down problems the collision time is often thousands of
+ * transit times, and applying collisions at every orbit step makes the
+ * adaptive scheme take far more steps than the orbit itself needs. Here the
+ * orbit is followed collisionlessly with the adaptive integrator over one
+ * poloidal transit while the collision coefficients are integrated along it.
+ * At the end of the transit the orbit-averaged coefficients are used to give
+ * the marker a single jump in energy and pitch (see mccc_gc_orbitavg.c).
+ *
+ * Once the collision time is known, one followed transit is taken to
+ * represent many: marker time advances M times faster than the orbit time,
+ * where M is chosen so that speed or pitch changes at most by the fraction
+ * ORBITAVG_CCOLL_MAXCHANGE per jump. Since time and mileage advance by M
+ * times the orbit step, diagnostics weight each orbit point with the time it
+ * represents and the distributions remain comparable to those of the full
+ * simulation.
+ *
+ * A transit is complete when the poloidal angle has changed by 2 pi, or
+ * when it has returned to its initial value for the second time, which
+ * covers trapped orbits and passing orbits that do not encircle the
+ * magnetic axis. Collisions are applied also if the accumulated coefficients
+ * already amount to the maximum allowed change, so that markers that do not
+ * complete a transit, e.g. near the separatrix, are still collisional.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <float.h>
+#include <math.h>
+#include "../ascot5.h"
+#include "../endcond.h"
+#include "../math.h"
+#include "../consts.h"
+#include "../physlib.h"
+#include "../simulate.h"
+#include "../particle.h"
+#include "../wall.h"
+#include "../diag.h"
+#include "../B_field.h"
+#include "../E_field.h"
+#include "../boozer.h"
+#include "../mhd.h"
+#include "../plasma.h"
+#include "simulate_gc_orbitavg.h"
+#include "simulate_gc_adaptive.h"
+#include "step/step_gc_cashkarp.h"
+#include "step/step_gc_dopri.h"
+#include "mccc/mccc.h"
+
+#define DUMMY_TIMESTEP_VAL 1.0 /**< Dummy time step value */
+
+/**
+ * @brief Simulates guiding centers with orbit-averaged collisions
+ *
+ * The simulation includes:
+ * - orbit-following with Cash-Karp or Dormand-Prince method
+ * - orbit-averaged Coulomb collisions in energy and pitch
+ *
+ * The time step is controlled by the orbit-following integrator and by the
+ * user-defined limits for how much marker state can change during a single
+ * time step, as in simulate_gc_adaptive().
+ *
+ * @param pq particles to be simulated
+ * @param sim simulation data
+ */
+void simulate_gc_orbitavg(particle_queue* pq, sim_data* sim) {
+
+    /* Orbit-integrated collision coefficients */
+    mccc_orbitavg avg;
+
+    /* Background plasma quantities reused between evaluations */
+    mccc_cache cache;
+    mccc_cache_init(&cache);
+
+    /* Random number streams of the markers in this group */
+    random_data rdata = sim->random_data;
+
+    /* Current time step, suggestion for the next time step and the step that
+     * was accepted (zero if rejected) */
+    real hin[NSIMD]      __memalign__;
+    real hout_orb[NSIMD] __memalign__;
+    real hnext[NSIMD]    __memalign__;
+    real hacc[NSIMD]     __memalign__;
+
+    /* Transit bookkeeping: time dilation factor, poloidal angle at the start
+     * of the transit and the number of times it has been crossed since,
+     * collision time scale, and the collision interval and transit time of
+     * the markers that are given a collision kick */
+    real dil[NSIMD]    __memalign__;
+    real theta0[NSIMD] __memalign__;
+    int ncross[NSIMD]  __memalign__;
+    real tcol[NSIMD]   __memalign__;
+    real dtcol[NSIMD]  __memalign__;
+    real ttr[NSIMD]    __memalign__;
+    int kick[NSIMD]    __memalign__;
+
+    /* Flag indicateing whether a new marker was initialized */
+    int cycle[NSIMD]     __memalign__;
+
+    /* Last stage of the Dormand-Prince step and whether it is valid as the
+     * first stage of the next step */
+    real fsal[6*NSIMD]    __memalign__;
+    int fsal_valid[NSIMD] __memalign__;
+
+    real tol_orb   = sim->ada_tol_orbfol;
+    real maxchange = sim->orbitavgccoll_maxchange;
+    int include_energy = sim->mccc_data.include_energy;
+    int include_pitch  = sim->mccc_data.include_pitch;
+
+    real cputime, cputime_last;
+
+    particle_simd_gc p;  // This array holds current states
+    particle_simd_gc p0; // This array stores previous states
+
+    for(int i=0; i< NSIMD; i++) {
+        p.id[i] = -1;
+        p.running[i] = 0;
+        fsal_valid[i] = 0;
+    }
+
+    /* Initialize running particles */
+    int n_running = particle_cycle_gc(pq, &p, &sim->B_data, cycle);
+
+    #pragma omp simd
+    for(int i = 0; i < NSIMD; i++) {
+        if(cycle[i] > 0) {
+            hin[i] = sim->fix_usrdef_use ? sim->fix_usrdef_val :
+                simulate_gc_adaptive_inidt_orbfol(sim, &p, i);
+            fsal_valid[i] = 0;
+            dil[i]     = 1;
+            theta0[i]  = p.theta[i];
+            ncross[i]  = 0;
+            tcol[i]    = DBL_MAX;
+            mccc_orbitavg_reset(&avg, i);
+            mccc_cache_reset(&cache, i);
+            random_set_stream(&rdata, i, p.id[i], RANDOM_STREAM_GC);
+        }
+    }
+
+    cputime_last = A5_WTIME;
+
+    /* MAIN SIMULATION LOOP
+     * - Store current state
+     * - Integrate motion due to background EM-field (orbit-following)
+     * - Check whether time step was accepted
+     *   - NO:  revert to initial state
+     *   - YES: advance (dilated) time and accumulate collision coefficients
+     * - Apply collisions to markers that completed a transit
+     * - Check for end condition(s)
+     * - Update diagnostics
+     */
+    while(n_running > 0) {
+
+        #pragma omp simd
+        for(int i = 0; i < NSIMD; i++) {
+            particle_copy_gc(&p, i, &p0, i);
+            hout_orb[i] = DUMMY_TIMESTEP_VAL;
+            hnext[i]    = DUMMY_TIMESTEP_VAL;
+            hacc[i]     = 0;
+            kick[i]     = 0;
+        }
+
+        /*************************** Physics **********************************/
+
+        #pragma omp simd
+        for(int i = 0; i < NSIMD; i++) {
+            if(sim->reverse_time) {
+                hin[i]  = -hin[i];
+            }
+        }
+
+        if(sim->enable_orbfol) {
+            if(sim->enable_mhd) {
+                step_gc_cashkarp_mhd(&p, hin, hout_orb, tol_orb,
+                                     &sim->B_data, &sim->E_data,
+                                     &sim->boozer_data, &sim->mhd_data);
+            }
+            else if(sim->ada_orbfol_method == 1) {
+                step_gc_dopri(&p, hin, hout_orb, tol_orb,
+                              &sim->B_data, &sim->E_data, fsal, fsal_valid);
+            }
+            else {
+                step_gc_cashkarp(&p, hin, hout_orb, tol_orb,
+                                 &sim->B_data, &sim->E_data);
+            }
+            #pragma omp simd
+            for(int i = 0; i < NSIMD; i++) {
+                if(sim->reverse_time) {
+                    hout_orb[i] = -hout_orb[i];
+                    hin[i]      = -hin[i];
+                }
+                if(p.running[i] && hout_orb[i] < 0){
+                    p.running[i] = 0;
+                    hnext[i] = hout_orb[i];
+                }
+            }
+        }
+
+        /**********************************************************************/
+
+        cputime = A5_WTIME;
+        #pragma omp simd
+        for(int i = 0; i < NSIMD; i++) {
+            if(!p.err[i]) {
+                if(hnext[i] > 0) {
+                    real dphi = fabs(p0.phi[i]-p.phi[i]) / sim->ada_max_dphi;
+                    real drho = fabs(p0.rho[i]-p.rho[i]) / sim->ada_max_drho;
+
+                    if(dphi > 1 && dphi > drho) {
+                        hnext[i] = -hin[i]/dphi;
+                    }
+                    else if(drho > 1 && drho > dphi) {
+                        hnext[i] = -hin[i]/drho;
+                    }
+                }
+
+                if(hnext[i] < 0) {
+                    particle_copy_gc(&p0, i, &p, i);
+                    if(hout_orb[i] > 0) {
+                        fsal_valid[i] = 0;
+                    }
+                    hin[i] = -hnext[i];
+                }
+                if(p.running[i]){
+                    if(hnext[i] < 0){
+                        hin[i] = -hnext[i];
+                    }
+                    else {
+                        /* Each orbit step represents dil steps of time */
+                        hacc[i] = hin[i];
+                        p.time[i]    += ( 1.0 - 2.0 * ( sim->reverse_time > 0 ) )
+                                      * dil[i] * hin[i];
+                        p.mileage[i] += dil[i] * hin[i];
+
+                        if(hnext[i] > hout_orb[i]) {
+                            hnext[i] = hout_orb[i];
+                        }
+                        if(hnext[i] == 1.0) {
+                            hnext[i] = hin[i];
+                        }
+                        hin[i] = hnext[i];
+                    }
+
+                    p.cputime[i] += cputime - cputime_last;
+                }
+            }
+        }
+        cputime_last = cputime;
+
+        /* Integrate collision coefficients along the accepted steps */
+        mccc_gc_orbitavg_accumulate(&p, hacc, &avg, &sim->plasma_data,
+                                    &sim->mccc_data, &cache);
+
+        /* Find markers that completed a transit or whose accumulated
+         * collisions already exceed the allowed change */
+        #pragma omp simd
+        for(int i = 0; i < NSIMD; i++) {
+            if(p.running[i] && hacc[i] > 0) {
+                real dth  = p.theta[i]  - theta0[i];
+                real dth0 = p0.theta[i] - theta0[i];
+                if( (dth0 < 0 && dth >= 0) || (dth0 > 0 && dth <= 0) ) {
+                    ncross[i]++;
+                }
+
+                /* Relative change the accumulated coefficients would give */
+                real Bnorm = math_normc(p.B_r[i], p.B_phi[i], p.B_z[i]);
+                real vnorm = physlib_vnorm_pnorm(
+                    p.mass[i], physlib_gc_p(p.mass[i], p.mu[i], p.ppar[i],
+                                            Bnorm) );
+                real dv  = include_energy * dil[i]
+                         * fmax( fabs(avg.K[i]) / vnorm,
+                                 2 * avg.Dv[i] / ( vnorm * vnorm ) );
+                real dxi = include_pitch * dil[i] * avg.nu[i];
+
+                int circled  = fabs(dth) >= CONST_2PI;
+                int returned = ncross[i] >= 2;
+                int due      = dv >= maxchange || dxi >= maxchange;
+                kick[i]  = circled || returned || due;
+                ttr[i]   = avg.t[i];
+                dtcol[i] = dil[i] * avg.t[i];
+            }
+        }
+
+        mccc_gc_orbitavg_kick(&p, kick, dtcol, tcol, &avg, &rdata,
+                              &sim->mccc_data);
+
+        /* Start a new transit and stretch it according to the new
+         * collision time */
+        #pragma omp simd
+        for(int i = 0; i < NSIMD; i++) {
+            if(p.running[i] && kick[i]) {
+                fsal_valid[i] = 0;
+                theta0[i]     = p.theta[i];
+                ncross[i]     = 0;
+                dil[i] = 1;
+                if(tcol[i] < DBL_MAX && ttr[i] > 0) {
+                    dil[i] = fmax( 1.0, floor(maxchange * tcol[i] / ttr[i]) );
+                }
+            }
+        }
+
+        /* Check possible end conditions */
+        endcond_check_gc(&p, &p0, sim);
+
+        /* Update diagnostics */
+        diag_update_gc(&sim->diag_data, &sim->B_data, &p, &p0);
+
+        /* Update number of running particles */
+        n_running = particle_cycle_gc(pq, &p, &sim->B_data, cycle);
+
+        #pragma omp simd
+        for(int i = 0; i < NSIMD; i++) {
+            if(cycle[i] > 0) {
+                hin[i] = sim->fix_usrdef_use ? sim->fix_usrdef_val :
+                    simulate_gc_adaptive_inidt_orbfol(sim, &p, i);
+                fsal_valid[i] = 0;
+                dil[i]     = 1;
+                theta0[i]  = p.theta[i];
+                ncross[i]  = 0;
+                tcol[i]    = DBL_MAX;
+                mccc_orbitavg_reset(&avg, i);
+                mccc_cache_reset(&cache, i);
+                random_set_stream(&rdata, i, p.id[i], RANDOM_STREAM_GC);
+            }
+        }
+    }
+
+    /* All markers simulated! */
+    if(sim->enable_clmbcol) {
+        mccc_cache_collect(&cache, &sim->mccc_data);
+    }
+}
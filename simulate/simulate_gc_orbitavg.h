@@ -0,0 +1,16 @@
+/**
+ * @file simulate_gc_orbitavg.h
+ * @brief Header file for simulate_gc_orbitavg.c
+ */
+#ifndef SIMULATE_GC_ORBITAVG_H
+#define SIMULATE_GC_ORBITAVG_H
+
+#include "../ascot5.h"
+#include "../simulate.h"
+#include "../particle.h"
+
+#pragma omp declare target
+void simulate_gc_orbitavg(particle_queue* pq, sim_data* sim);
+#pragma omp end declare target
+
+#endif
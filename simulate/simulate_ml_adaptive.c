@@ -16,6 +16,7 @@
 #include "../E_field.h"
 #include "simulate_ml_adaptive.h"
 #include "step/step_ml_cashkarp.h"
+#include "step/step_ml_dopri.h"
 #include "../endcond.h"
 #include "../math.h"
 #include "../consts.h"
@@ -33,7 +34,7 @@ real simulate_ml_adaptive_inidt(sim_data* sim, particle_simd_ml* p, int i);
  * @brief Simulates magnetic field-lines using adaptive time-step
  *
  * The simulation includes:
- * - orbit-following with Cash-Karp method
+ * - orbit-following with Cash-Karp or Dormand-Prince method
  *
  * The simulation is carried until all markers have met some
  * end condition or are aborted/rejected. The final state of the
@@ -111,7 +112,7 @@ void simulate_ml_adaptive(particle_queue* pq, sim_data* sim) {
 
         /*************************** Physics **********************************/
 
-        /* Cash-Karp method for orbit-following */
+        /* Cash-Karp or Dormand-Prince method for orbit-following */
         if(sim->enable_orbfol) {
 
             /* Set time-step negative if tracing backwards in time */
@@ -126,6 +127,9 @@ void simulate_ml_adaptive(particle_queue* pq, sim_data* sim) {
                 step_ml_cashkarp_mhd(&p, hin, hout, tol, &sim->B_data,
                                      &sim->boozer_data, &sim->mhd_data);
             }
+            else if(sim->ada_orbfol_method == 1) {
+                step_ml_dopri(&p, hin, hout, tol, &sim->B_data);
+            }
             else {
                 step_ml_cashkarp(&p, hin, hout, tol, &sim->B_data);
             }
@@ -13,6 +13,8 @@
 #pragma omp declare target
 void step_fo_vpa(particle_simd_fo* p, real* h, B_field_data* Bdata,
                  E_field_data* Edata);
+void step_fo_vpa_ada(particle_simd_fo* p, real* h, real* hnext, real tol,
+                     B_field_data* Bdata, E_field_data* Edata);
 void step_fo_vpa_mhd(particle_simd_fo* p, real* h, B_field_data* Bdata,
                      E_field_data* Edata, boozer_data* boozer, mhd_data* mhd);
 #pragma omp end declare target
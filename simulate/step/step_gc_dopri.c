@@ -0,0 +1,358 @@
+/**
+ * @file step_gc_dopri.c
+ * @brief Guiding center integration with adaptive Dormand-Prince method
+ *
+ * Dormand-Prince 5(4) has seven stages of which the last one is evaluated at
+ * the new position ("first same as last", FSAL). The field at the new position
+ * is needed anyway for the marker struct, so the error estimate costs the same
+ * number of field evaluations as the Cash-Karp step (six per step), while the
+ * error constants are smaller and larger steps are accepted.
+ *
+ * The last stage is stored in a caller-provided buffer and used as the first
+ * stage of the next step. When a step is rejected, the marker is not modified
+ * and the first stage is stored instead so the retry does not re-evaluate it.
+ **/
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
+#include "../../ascot5.h"
+#include "../../B_field.h"
+#include "../../math.h"
+#include "../../consts.h"
+#include "../../particle.h"
+#include "../../error.h"
+#include "step_gc_dopri.h"
+#include "step_gceom.h"
+
+/**
+ * @brief Integrate a guiding center step for a struct of markers
+ *
+ * This function calculates a guiding center step for a struct of NSIMD
+ * markers with Dormand-Prince (adaptive RK5) simultaneously using SIMD
+ * instructions. Informs whether time step was accepted or rejected and
+ * provides a suggestion for the next time step. Rejected steps leave the
+ * marker untouched.
+ *
+ * The buffer fsal holds the equations of motion at the current position of
+ * the marker in slot i as fsal[j*NSIMD + i], j = 0..5, and it is used if
+ * fsal_valid[i] is set. The caller must clear fsal_valid[i] whenever the
+ * marker is modified outside this function (new marker, collisions, or the
+ * step being rejected for other reasons).
+ *
+ * @param p marker struct that will be updated
+ * @param h array containing time step lengths
+ * @param hnext suggestion for the next time step. Negative sign indicates
+ *        current step was rejected
+ * @param tol error tolerance
+ * @param Bdata pointer to magnetic field data
+ * @param Edata pointer to electric field data
+ * @param fsal first stage of the next step
+ * @param fsal_valid flag indicating whether fsal can be used
+ */
+void step_gc_dopri(particle_simd_gc* p, real* h, real* hnext, real tol,
+                   B_field_data* Bdata, E_field_data* Edata, real* fsal,
+                   int* fsal_valid) {
+
+    int i;
+    /* Following loop will be executed simultaneously for all i */
+#pragma omp simd aligned(h, hnext : 64)
+    for(i = 0; i < NSIMD; i++) {
+        if(p->running[i]) {
+            a5err errflag = 0;
+
+            real k1[6], k2[6], k3[6], k4[6], k5[6], k6[6], k7[6];
+            real tempy[6];
+            real yprev[6];
+
+            real mass   = p->mass[i];
+            real charge = p->charge[i];
+
+            real B_dB[15];
+            real E[3];
+
+            real R0 = p->r[i];
+            real z0 = p->z[i];
+            real t0 = p->time[i];
+
+            /* Coordinates are copied from the struct into an array to make
+             * passing parameters easier */
+            yprev[0] = p->r[i];
+            yprev[1] = p->phi[i];
+            yprev[2] = p->z[i];
+            yprev[3] = p->ppar[i];
+            yprev[4] = p->mu[i];
+            yprev[5] = p->zeta[i];
+
+            /* First stage is the last stage of the previous step, or it is
+             * evaluated from the magnetic field that is already known */
+            if(fsal_valid[i]) {
+                for(int j = 0; j < 6; j++) {
+                    k1[j] = fsal[j*NSIMD + i];
+                }
+            }
+            else {
+                B_dB[0]  = p->B_r[i];
+                B_dB[1]  = p->B_r_dr[i];
+                B_dB[2]  = p->B_r_dphi[i];
+                B_dB[3]  = p->B_r_dz[i];
+
+                B_dB[4]  = p->B_phi[i];
+                B_dB[5]  = p->B_phi_dr[i];
+                B_dB[6]  = p->B_phi_dphi[i];
+                B_dB[7]  = p->B_phi_dz[i];
+
+                B_dB[8]  = p->B_z[i];
+                B_dB[9]  = p->B_z_dr[i];
+                B_dB[10] = p->B_z_dphi[i];
+                B_dB[11] = p->B_z_dz[i];
+
+                errflag = E_field_eval_E(E, yprev[0], yprev[1], yprev[2],
+                                         t0, Edata, Bdata);
+                if(!errflag) {
+                    step_gceom(k1, yprev, mass, charge, B_dB, E);
+                }
+            }
+            for(int j = 0; j < 6; j++) {
+                tempy[j] = yprev[j]
+                    + h[i]*(
+                        (1.0/5) * k1[j] );
+            }
+
+
+            if(!errflag) {
+                errflag = B_field_eval_B_dB(B_dB, tempy[0], tempy[1], tempy[2],
+                                            t0 + (1.0/5)*h[i], Bdata);
+            }
+            if(!errflag) {
+                errflag = E_field_eval_E(E, tempy[0], tempy[1], tempy[2],
+                                         t0 + (1.0/5)*h[i], Edata, Bdata);
+            }
+            if(!errflag) {
+                step_gceom(k2, tempy, mass, charge, B_dB, E);
+            }
+            for(int j = 0; j < 6; j++) {
+                tempy[j] = yprev[j]
+                    + h[i]*(
+                          (3.0/40) * k1[j]
+                        + (9.0/40) * k2[j] );
+            }
+
+
+            if(!errflag) {
+                errflag = B_field_eval_B_dB(B_dB, tempy[0], tempy[1], tempy[2],
+                                            t0 + (3.0/10)*h[i], Bdata);
+            }
+            if(!errflag) {
+                errflag = E_field_eval_E(E, tempy[0], tempy[1], tempy[2],
+                                         t0 + (3.0/10)*h[i], Edata, Bdata);
+            }
+            if(!errflag) {
+                step_gceom(k3, tempy, mass, charge, B_dB, E);
+            }
+            for(int j = 0; j < 6; j++) {
+                tempy[j] = yprev[j]
+                    + h[i]*(
+                          ( 44.0/45) * k1[j]
+                        + (-56.0/15) * k2[j]
+                        + ( 32.0/9 ) * k3[j] );
+            }
+
+
+            if(!errflag) {
+                errflag = B_field_eval_B_dB(B_dB, tempy[0], tempy[1], tempy[2],
+                                            t0 + (4.0/5)*h[i], Bdata);
+            }
+            if(!errflag) {
+                errflag = E_field_eval_E(E, tempy[0], tempy[1], tempy[2],
+                                         t0 + (4.0/5)*h[i], Edata, Bdata);
+            }
+            if(!errflag) {
+                step_gceom(k4, tempy, mass, charge, B_dB, E);
+            }
+            for(int j = 0; j < 6; j++) {
+                tempy[j] = yprev[j]
+                    + h[i]*(
+                          ( 19372.0/6561) * k1[j]
+                        + (-25360.0/2187) * k2[j]
+                        + ( 64448.0/6561) * k3[j]
+                        + (  -212.0/729 ) * k4[j] );
+            }
+
+
+            if(!errflag) {
+                errflag = B_field_eval_B_dB(B_dB, tempy[0], tempy[1], tempy[2],
+                                            t0 + (8.0/9)*h[i], Bdata);
+            }
+            if(!errflag) {
+                errflag = E_field_eval_E(E, tempy[0], tempy[1], tempy[2],
+                                         t0 + (8.0/9)*h[i], Edata, Bdata);
+            }
+            if(!errflag) {
+                step_gceom(k5, tempy, mass, charge, B_dB, E);
+            }
+            for(int j = 0; j < 6; j++) {
+                tempy[j] = yprev[j]
+                    + h[i]*(
+                          (  9017.0/3168 ) * k1[j]
+                        + (  -355.0/33   ) * k2[j]
+                        + ( 46732.0/5247 ) * k3[j]
+                        + (    49.0/176  ) * k4[j]
+                        + ( -5103.0/18656) * k5[j] );
+            }
+
+
+            if(!errflag) {
+                errflag = B_field_eval_B_dB(B_dB, tempy[0], tempy[1], tempy[2],
+                                            t0 + h[i], Bdata);
+            }
+            if(!errflag) {
+                errflag = E_field_eval_E(E, tempy[0], tempy[1], tempy[2],
+                                         t0 + h[i], Edata, Bdata);
+            }
+            if(!errflag) {
+                step_gceom(k6, tempy, mass, charge, B_dB, E);
+            }
+
+            /* Fifth order solution which is also the last stage position */
+            real rk5[6];
+            for(int j = 0; j < 6; j++) {
+                rk5[j] = yprev[j]
+                    + h[i]*(
+                          (   35.0/384  ) * k1[j]
+                        + (  500.0/1113 ) * k3[j]
+                        + (  125.0/192  ) * k4[j]
+                        + (-2187.0/6784 ) * k5[j]
+                        + (   11.0/84   ) * k6[j] );
+            }
+
+            /* Test that results are physical */
+            if(!errflag && rk5[0] <= 0) {
+                errflag = error_raise(ERR_INTEGRATION, __LINE__,
+                                      EF_STEP_GC_DOPRI);
+            }
+            else if(!errflag && rk5[4] < 0) {
+                errflag = error_raise(ERR_INTEGRATION, __LINE__,
+                                      EF_STEP_GC_DOPRI);
+            }
+
+            /* Last stage. The field is stored in the marker if the step is
+             * accepted. */
+            if(!errflag) {
+                errflag = B_field_eval_B_dB(B_dB, rk5[0], rk5[1], rk5[2],
+                                            t0 + h[i], Bdata);
+            }
+            if(!errflag) {
+                errflag = E_field_eval_E(E, rk5[0], rk5[1], rk5[2],
+                                         t0 + h[i], Edata, Bdata);
+            }
+            if(!errflag) {
+                step_gceom(k7, rk5, mass, charge, B_dB, E);
+            }
+
+            /* Error estimate is a difference between the fifth and embedded
+             * fourth order solutions */
+            int accepted = 0;
+            if(!errflag) {
+                real err = 0.0;
+                for(int j = 0; j < 6; j++) {
+                    real yerr = fabs( h[i]*(
+                              (    71.0/57600 ) * k1[j]
+                            + (   -71.0/16695 ) * k3[j]
+                            + (    71.0/1920  ) * k4[j]
+                            + (-17253.0/339200) * k5[j]
+                            + (    22.0/525   ) * k6[j]
+                            + (    -1.0/40    ) * k7[j] ) );
+                    real ytol = fabs(yprev[j]) + fabs(k1[j]*h[i]) + DBL_EPSILON;
+                    err = fmax( err, yerr/ytol );
+                }
+
+                err = err/tol;
+                if(err <= 1){
+                    /* Time step accepted */
+                    accepted = 1;
+                    hnext[i] = 0.85*h[i]*pow(err,-0.2);
+
+                    /* Make sure we don't make a huge jump */
+                    if(hnext[i] > 1.5*h[i]) {
+                        hnext[i] = 1.5*h[i];
+                    }
+                }
+                else{
+                    /* Time step rejected */
+                    hnext[i] = -0.85*h[i]*pow(err,-0.25);
+                }
+
+                if(fabs(hnext[i]) < A5_EXTREMELY_SMALL_TIMESTEP) {
+                    errflag = error_raise(ERR_INVALID_TIMESTEP, __LINE__,
+                                          EF_STEP_GC_DOPRI);
+                }
+            }
+
+            /* Store the first stage of the next attempt */
+            if(!errflag) {
+                for(int j = 0; j < 6; j++) {
+                    fsal[j*NSIMD + i] = accepted ? k7[j] : k1[j];
+                }
+                fsal_valid[i] = 1;
+            }
+            else {
+                fsal_valid[i] = 0;
+            }
+
+            /* Update gc phase space position */
+            real psi[1];
+            real rho[2];
+            if(!errflag && accepted) {
+                errflag = B_field_eval_psi(psi, rk5[0], rk5[1], rk5[2],
+                                           t0 + h[i], Bdata);
+            }
+            if(!errflag && accepted) {
+                errflag = B_field_eval_rho(rho, psi[0], Bdata);
+            }
+            if(!errflag && accepted) {
+                p->r[i]     = rk5[0];
+                p->phi[i]   = rk5[1];
+                p->z[i]     = rk5[2];
+                p->ppar[i]  = rk5[3];
+                p->mu[i]    = rk5[4];
+                p->zeta[i]  = fmod( rk5[5], CONST_2PI );
+                if(p->zeta[i]<0) {
+                    p->zeta[i] = CONST_2PI + p->zeta[i];
+                }
+
+                p->B_r[i]        = B_dB[0];
+                p->B_r_dr[i]     = B_dB[1];
+                p->B_r_dphi[i]   = B_dB[2];
+                p->B_r_dz[i]     = B_dB[3];
+
+                p->B_phi[i]      = B_dB[4];
+                p->B_phi_dr[i]   = B_dB[5];
+                p->B_phi_dphi[i] = B_dB[6];
+                p->B_phi_dz[i]   = B_dB[7];
+
+                p->B_z[i]        = B_dB[8];
+                p->B_z_dr[i]     = B_dB[9];
+                p->B_z_dphi[i]   = B_dB[10];
+                p->B_z_dz[i]     = B_dB[11];
+                p->rho[i] = rho[0];
+
+                /* Evaluate theta angle so that it is cumulative */
+                real axisrz[2];
+                errflag = B_field_get_axis_rz(axisrz, Bdata, p->phi[i]);
+                p->theta[i] += atan2(   (R0-axisrz[0]) * (p->z[i]-axisrz[1])
+                                      - (z0-axisrz[1]) * (p->r[i]-axisrz[0]),
+                                        (R0-axisrz[0]) * (p->r[i]-axisrz[0])
+                                      + (z0-axisrz[1]) * (p->z[i]-axisrz[1]) );
+            }
+
+            /* Error handling */
+            if(errflag) {
+                p->err[i]     = errflag;
+                p->running[i] = 0;
+                hnext[i]      = h[i];
+                fsal_valid[i] = 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,18 @@
+/**
+ * @file step_gc_dopri.h
+ * @brief Header file for step_gc_dopri.c
+ */
+#ifndef STEP_GC_DOPRI_H
+#define STEP_GC_DOPRI_H
+
+#include "../../B_field.h"
+#include "../../E_field.h"
+#include "../../particle.h"
+
+#pragma omp declare target
+void step_gc_dopri(particle_simd_gc* p, real* h, real* hnext, real tol,
+                   B_field_data* Bdata, E_field_data* Edata, real* fsal,
+                   int* fsal_valid);
+#pragma omp end declare target
+
+#endif
@@ -0,0 +1,205 @@
+/**
+ * @file step_gc_invariants.c
+ * @brief Projection of guiding center steps onto the constants of motion
+ *
+ * In a static magnetic field without electric field, the guiding center
+ * momentum \f$p^2 = p_\parallel^2 + 2m\mu B\f$ (and hence energy) is conserved
+ * and, if the field is axisymmetric, so is the canonical toroidal momentum
+ * \f$P_\phi = p_\parallel R B_\phi/B + q\psi\f$. Together with the magnetic
+ * moment these fix the drift orbit, so an integrator that keeps them exactly
+ * can only accumulate phase errors along the orbit. This allows steps that
+ * are much longer than what an explicit integrator alone needs for the same
+ * long-time confinement result.
+ *
+ * The invariants are evaluated before the step with step_gc_invariants_eval()
+ * and restored afterwards with step_gc_invariants_project(), which moves the
+ * marker along the flux gradient to restore \f$P_\phi\f$ and rescales the
+ * parallel momentum to restore \f$p^2\f$.
+ */
+#include <math.h>
+#include "../../ascot5.h"
+#include "../../B_field.h"
+#include "../../math.h"
+#include "../../physlib.h"
+#include "../../particle.h"
+#include "step_gc_invariants.h"
+
+/** Number of iterations when restoring P_phi */
+#define STEP_GC_INVARIANTS_NITER 3
+
+/**
+ * @brief Evaluate constants of motion of a struct of markers
+ *
+ * @param p marker struct
+ * @param psq momentum squared [kg^2 m^2 / s^2]
+ * @param ptor canonical toroidal momentum [kg m^2 / s]
+ * @param Bdata pointer to magnetic field data
+ */
+void step_gc_invariants_eval(particle_simd_gc* p, real* psq, real* ptor,
+                             B_field_data* Bdata) {
+    #pragma omp simd
+    for(int i = 0; i < NSIMD; i++) {
+        if(p->running[i]) {
+            real B = math_normc(p->B_r[i], p->B_phi[i], p->B_z[i]);
+            psq[i] = p->ppar[i] * p->ppar[i] + 2 * p->mass[i] * p->mu[i] * B;
+
+            real psi[1];
+            a5err errflag = B_field_eval_psi(psi, p->r[i], p->phi[i],
+                                             p->z[i], p->time[i], Bdata);
+            ptor[i] = phys_ptoroid_gc(p->charge[i], p->r[i], p->ppar[i],
+                                      psi[0], B, p->B_phi[i]);
+            if(errflag) {
+                p->err[i]     = errflag;
+                p->running[i] = 0;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Project markers back onto the constants of motion
+ *
+ * The marker struct must hold the state after the step, including the
+ * magnetic field at the new position. The field, rho and the cumulative
+ * poloidal angle are updated at the corrected position.
+ *
+ * @param p marker struct
+ * @param h time step that was taken
+ * @param psq momentum squared before the step
+ * @param ptor canonical toroidal momentum before the step
+ * @param axisym flag whether the field is axisymmetric so that ptor is
+ *        conserved
+ * @param Bdata pointer to magnetic field data
+ */
+void step_gc_invariants_project(particle_simd_gc* p, real* h, real* psq,
+                                real* ptor, int axisym, B_field_data* Bdata) {
+    #pragma omp simd
+    for(int i = 0; i < NSIMD; i++) {
+        if(p->running[i]) {
+            a5err errflag = 0;
+
+            real t  = p->time[i] + h[i];
+            real r  = p->r[i];
+            real z  = p->z[i];
+            real r0 = r;
+            real z0 = z;
+            real ppar = p->ppar[i];
+            real m2mu = 2 * p->mass[i] * p->mu[i];
+
+            real Bv[3] = {p->B_r[i], p->B_phi[i], p->B_z[i]};
+            real B = math_normc(Bv[0], Bv[1], Bv[2]);
+
+            /* Rescale parallel momentum to restore p^2. Near the bounce
+             * point this may have no solution, in which case the step is
+             * not projected at all. */
+            real ppar2 = psq[i] - m2mu * B;
+            int valid = ppar2 > 0;
+            if(valid) {
+                ppar = copysign(sqrt(ppar2), ppar);
+            }
+
+            if(axisym && valid) {
+                /* Find the displacement s (in units of psi) along grad psi
+                 * that restores ptor when ppar follows p^2. The first
+                 * iterate neglects the change in the ppar term and the rest
+                 * are secant steps, since for energetic ions that term
+                 * is not small. */
+                real psi_dpsi[4];
+                errflag = B_field_eval_psi_dpsi(psi_dpsi, r0, p->phi[i], z0, t,
+                                                Bdata);
+                real gpsi2 = psi_dpsi[1] * psi_dpsi[1]
+                           + psi_dpsi[3] * psi_dpsi[3];
+                real dr = gpsi2 > 0 ? psi_dpsi[1] / gpsi2 : 0;
+                real dz = gpsi2 > 0 ? psi_dpsi[3] / gpsi2 : 0;
+
+                real s0 = 0;
+                real f0 = ( ptor[i] - phys_ptoroid_gc(p->charge[i], r0, ppar,
+                                                      psi_dpsi[0], B, Bv[1]) )
+                    / p->charge[i];
+                real s1 = f0;
+                for(int k = 0; k < STEP_GC_INVARIANTS_NITER; k++) {
+                    real psi[1];
+                    r = r0 + s1 * dr;
+                    z = z0 + s1 * dz;
+                    if(!errflag) {
+                        errflag = B_field_eval_psi(psi, r, p->phi[i], z, t,
+                                                   Bdata);
+                    }
+                    if(!errflag) {
+                        errflag = B_field_eval_B(Bv, r, p->phi[i], z, t,
+                                                 Bdata);
+                    }
+                    B = math_normc(Bv[0], Bv[1], Bv[2]);
+                    ppar2 = psq[i] - m2mu * B;
+                    valid = valid && ppar2 > 0;
+                    if(valid) {
+                        ppar = copysign(sqrt(ppar2), ppar);
+                    }
+
+                    real f1 = ( ptor[i] - phys_ptoroid_gc(p->charge[i], r,
+                                                          ppar, psi[0], B,
+                                                          Bv[1]) )
+                        / p->charge[i];
+                    real s2 = f1 != f0 ? s1 - f1 * (s1 - s0) / (f1 - f0) : s1;
+                    s0 = s1;
+                    f0 = f1;
+                    s1 = s2;
+                }
+            }
+            if(!valid) {
+                r    = r0;
+                z    = z0;
+                ppar = p->ppar[i];
+            }
+
+            /* Field, psi and rho at the corrected position */
+            real B_dB[15];
+            real psi[1];
+            real rho[2];
+            if(!errflag) {
+                errflag = B_field_eval_B_dB(B_dB, r, p->phi[i], z, t, Bdata);
+            }
+            if(!errflag) {
+                errflag = B_field_eval_psi(psi, r, p->phi[i], z, t, Bdata);
+            }
+            if(!errflag) {
+                errflag = B_field_eval_rho(rho, psi[0], Bdata);
+            }
+
+            if(!errflag) {
+                p->r[i]    = r;
+                p->z[i]    = z;
+                p->ppar[i] = ppar;
+
+                p->B_r[i]        = B_dB[0];
+                p->B_r_dr[i]     = B_dB[1];
+                p->B_r_dphi[i]   = B_dB[2];
+                p->B_r_dz[i]     = B_dB[3];
+
+                p->B_phi[i]      = B_dB[4];
+                p->B_phi_dr[i]   = B_dB[5];
+                p->B_phi_dphi[i] = B_dB[6];
+                p->B_phi_dz[i]   = B_dB[7];
+
+                p->B_z[i]        = B_dB[8];
+                p->B_z_dr[i]     = B_dB[9];
+                p->B_z_dphi[i]   = B_dB[10];
+                p->B_z_dz[i]     = B_dB[11];
+                p->rho[i] = rho[0];
+
+                /* Keep theta cumulative */
+                real axisrz[2];
+                errflag = B_field_get_axis_rz(axisrz, Bdata, p->phi[i]);
+                p->theta[i] += atan2(   (r0-axisrz[0]) * (z-axisrz[1])
+                                      - (z0-axisrz[1]) * (r-axisrz[0]),
+                                        (r0-axisrz[0]) * (r-axisrz[0])
+                                      + (z0-axisrz[1]) * (z-axisrz[1]) );
+            }
+
+            if(errflag) {
+                p->err[i]     = errflag;
+                p->running[i] = 0;
+            }
+        }
+    }
+}
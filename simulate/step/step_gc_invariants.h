@@ -0,0 +1,18 @@
+/**
+ * @file step_gc_invariants.h
+ * @brief Header file for step_gc_invariants.c
+ */
+#ifndef STEP_GC_INVARIANTS_H
+#define STEP_GC_INVARIANTS_H
+
+#include "../../B_field.h"
+#include "../../particle.h"
+
+#pragma omp declare target
+void step_gc_invariants_eval(particle_simd_gc* p, real* psq, real* ptor,
+                             B_field_data* Bdata);
+void step_gc_invariants_project(particle_simd_gc* p, real* h, real* psq,
+                                real* ptor, int axisym, B_field_data* Bdata);
+#pragma omp end declare target
+
+#endif
@@ -0,0 +1,263 @@
+/**
+ * @file step_ml_dopri.c
+ * @brief Field line integrator implemented with Dormand-Prince method.
+ *
+ * The last of the seven stages is the field at the new position, which is
+ * evaluated anyway to update the marker, and the first stage is the field at
+ * the current position that is already stored in the marker. Only five new
+ * field evaluations per step are needed for the stages in between.
+ **/
+#include <stdlib.h>
+#include <float.h>
+#include <math.h>
+#include "../../ascot5.h"
+#include "../../B_field.h"
+#include "../../math.h"
+#include "../../particle.h"
+#include "step_ml_dopri.h"
+
+/**
+ * @brief Integrate a magnetic field line step for a struct of markers
+ *
+ * This function calculates a magnetic field line step for a struct of NSIMD
+ * markers with Dormand-Prince (adaptive RK5) simultaneously using SIMD
+ * instructions. Informs whether time step was accepted or rejected and
+ * provides a suggestion for the next time step. Rejected steps leave the
+ * marker untouched.
+ *
+ * @param p marker struct that will be integrated
+ * @param h NSIMD length array containing time step lengths
+ * @param hnext suggestion for the next time step. Negative if rejected.
+ * @param tol error tolerance
+ * @param Bdata pointer to magnetic field data
+ */
+void step_ml_dopri(particle_simd_ml* p, real* h, real* hnext, real tol,
+                   B_field_data* Bdata) {
+
+    int i;
+    /* Following loop will be executed simultaneously for all i */
+    #pragma omp simd
+    for(i = 0; i < NSIMD; i++) {
+        if(p->running[i]) {
+            a5err errflag = 0;
+
+            real k1[3], k2[3], k3[3], k4[3], k5[3], k6[3], k7[3];
+            real tempy[3];
+            real yprev[3];
+
+            real normB;
+
+            real R0 = p->r[i];
+            real z0 = p->z[i];
+            real t0 = p->time[i];
+
+            /* Direction */
+            int direction = 1;
+            if(p->pitch[i] < 0) {
+                direction = -1;
+            }
+
+            /* Coordinates are copied from the struct into an array to make
+             * passing parameters easier */
+            yprev[0] = p->r[i];
+            yprev[1] = p->phi[i];
+            yprev[2] = p->z[i];
+
+            /* Magnetic field at initial position already known */
+            k1[0] = p->B_r[i];
+            k1[1] = p->B_phi[i];
+            k1[2] = p->B_z[i];
+
+            normB = (math_normc(k1[0], k1[1], k1[2])) * direction;
+            k1[0] /= normB;
+            k1[1] /= normB;
+            k1[2] /= normB;
+            k1[1] /= yprev[0];
+
+            for(int j = 0; j < 3; j++) {
+                tempy[j] = yprev[j]
+                    + h[i] * ( (1.0/5) * k1[j] );
+            }
+            if(!errflag) {
+                errflag = B_field_eval_B(k2, tempy[0], tempy[1], tempy[2],
+                                         t0 + (1.0/5)*h[i], Bdata);
+            }
+            normB = (math_normc(k2[0], k2[1], k2[2])) * direction;
+            k2[0] /= normB;
+            k2[1] /= normB;
+            k2[2] /= normB;
+            k2[1] /= tempy[0];
+
+            for(int j = 0; j < 3; j++) {
+                tempy[j] = yprev[j]
+                    + h[i] * (
+                          (3.0/40) * k1[j]
+                        + (9.0/40) * k2[j] );
+            }
+            if(!errflag) {
+                errflag = B_field_eval_B(k3, tempy[0], tempy[1], tempy[2],
+                                         t0 + (3.0/10)*h[i], Bdata);
+            }
+            normB = (math_normc(k3[0], k3[1], k3[2])) * direction;
+            k3[0] /= normB;
+            k3[1] /= normB;
+            k3[2] /= normB;
+            k3[1] /= tempy[0];
+
+            for(int j = 0; j < 3; j++) {
+                tempy[j] = yprev[j]
+                    + h[i] * (
+                          ( 44.0/45) * k1[j]
+                        + (-56.0/15) * k2[j]
+                        + ( 32.0/9 ) * k3[j] );
+            }
+            if(!errflag) {
+                errflag = B_field_eval_B(k4, tempy[0], tempy[1], tempy[2],
+                                         t0 + (4.0/5)*h[i], Bdata);
+            }
+            normB = (math_normc(k4[0], k4[1], k4[2])) * direction;
+            k4[0] /= normB;
+            k4[1] /= normB;
+            k4[2] /= normB;
+            k4[1] /= tempy[0];
+
+            for(int j = 0; j < 3; j++) {
+                tempy[j] = yprev[j]
+                    + h[i] * (
+                          ( 19372.0/6561) * k1[j]
+                        + (-25360.0/2187) * k2[j]
+                        + ( 64448.0/6561) * k3[j]
+                        + (  -212.0/729 ) * k4[j] );
+            }
+            if(!errflag) {
+                errflag = B_field_eval_B(k5, tempy[0], tempy[1], tempy[2],
+                                         t0 + (8.0/9)*h[i], Bdata);
+            }
+            normB = (math_normc(k5[0], k5[1], k5[2])) * direction;
+            k5[0] /= normB;
+            k5[1] /= normB;
+            k5[2] /= normB;
+            k5[1] /= tempy[0];
+
+            for(int j = 0; j < 3; j++) {
+                tempy[j] = yprev[j]
+                    + h[i] * (
+                          (  9017.0/3168 ) * k1[j]
+                        + (  -355.0/33   ) * k2[j]
+                        + ( 46732.0/5247 ) * k3[j]
+                        + (    49.0/176  ) * k4[j]
+                        + ( -5103.0/18656) * k5[j] );
+            }
+            if(!errflag) {
+                errflag = B_field_eval_B(k6, tempy[0], tempy[1], tempy[2],
+                                         t0 + h[i], Bdata);
+            }
+            normB = (math_normc(k6[0], k6[1], k6[2])) * direction;
+            k6[0] /= normB;
+            k6[1] /= normB;
+            k6[2] /= normB;
+            k6[1] /= tempy[0];
+
+            real rk5[3];
+            for(int j = 0; j < 3; j++) {
+                rk5[j] = yprev[j]
+                    + h[i] * (
+                          (   35.0/384  ) * k1[j]
+                        + (  500.0/1113 ) * k3[j]
+                        + (  125.0/192  ) * k4[j]
+                        + (-2187.0/6784 ) * k5[j]
+                        + (   11.0/84   ) * k6[j] );
+            }
+
+            /* Last stage is the field at the new position */
+            real B_dB[15];
+            if(!errflag) {
+                errflag = B_field_eval_B_dB(B_dB, rk5[0], rk5[1], rk5[2],
+                                            t0 + h[i], Bdata);
+            }
+            k7[0] = B_dB[0];
+            k7[1] = B_dB[4];
+            k7[2] = B_dB[8];
+            normB = (math_normc(k7[0], k7[1], k7[2])) * direction;
+            k7[0] /= normB;
+            k7[1] /= normB;
+            k7[2] /= normB;
+            k7[1] /= rk5[0];
+
+            /* Error estimate is a difference between the fifth and embedded
+             * fourth order solutions */
+            real err = 0.0;
+            for(int j = 0; j < 3; j++) {
+                real yerr = fabs( h[i] * (
+                          (    71.0/57600 ) * k1[j]
+                        + (   -71.0/16695 ) * k3[j]
+                        + (    71.0/1920  ) * k4[j]
+                        + (-17253.0/339200) * k5[j]
+                        + (    22.0/525   ) * k6[j]
+                        + (    -1.0/40    ) * k7[j] ) );
+                real ytol = fabs(yprev[j]) + fabs( k1[j] * h[i] ) + DBL_EPSILON;
+                err  = fmax( err, yerr/ytol );
+            }
+
+            err = err/tol;
+            int accepted = err <= 1;
+            if(accepted){
+                /* Time step accepted */
+                hnext[i] = 0.85*h[i]*pow(err,-0.2);
+            }
+            else{
+                /* Time step rejected */
+                hnext[i] = -0.85*h[i]*pow(err,-0.25);
+            }
+
+            /* Evaluate rho at new position */
+            real psi[1];
+            real rho[2];
+            if(!errflag && accepted) {
+                errflag = B_field_eval_psi(psi, rk5[0], rk5[1], rk5[2],
+                                           t0 + h[i], Bdata);
+            }
+            if(!errflag && accepted) {
+                errflag = B_field_eval_rho(rho, psi[0], Bdata);
+            }
+
+            if(!errflag && accepted) {
+                p->r[i]   = rk5[0];
+                p->phi[i] = rk5[1];
+                p->z[i]   = rk5[2];
+
+                p->B_r[i]        = B_dB[0];
+                p->B_r_dr[i]     = B_dB[1];
+                p->B_r_dphi[i]   = B_dB[2];
+                p->B_r_dz[i]     = B_dB[3];
+
+                p->B_phi[i]      = B_dB[4];
+                p->B_phi_dr[i]   = B_dB[5];
+                p->B_phi_dphi[i] = B_dB[6];
+                p->B_phi_dz[i]   = B_dB[7];
+
+                p->B_z[i]        = B_dB[8];
+                p->B_z_dr[i]     = B_dB[9];
+                p->B_z_dphi[i]   = B_dB[10];
+                p->B_z_dz[i]     = B_dB[11];
+
+                p->rho[i] = rho[0];
+
+                /* Evaluate theta angle so that it is cumulative */
+                real axisrz[2];
+                errflag  = B_field_get_axis_rz(axisrz, Bdata, p->phi[i]);
+                p->theta[i] += atan2(   (R0-axisrz[0]) * (p->z[i]-axisrz[1])
+                                      - (z0-axisrz[1]) * (p->r[i]-axisrz[0]),
+                                        (R0-axisrz[0]) * (p->r[i]-axisrz[0])
+                                      + (z0-axisrz[1]) * (p->z[i]-axisrz[1]) );
+            }
+
+            /* Error handling */
+            if(errflag) {
+                p->err[i]     = errflag;
+                p->running[i] = 0;
+                hnext[i]      = h[i];
+            }
+        }
+    }
+}
@@ -0,0 +1,16 @@
+/**
+ * @file step_ml_dopri.h
+ * @brief Header file for step_ml_dopri.c
+ */
+#ifndef STEP_ML_DOPRI_H
+#define STEP_ML_DOPRI_H
+
+#include "../../B_field.h"
+#include "../../particle.h"
+
+#pragma omp declare target
+void step_ml_dopri(particle_simd_ml* p, real* h, real* hnext,
+                   real tol, B_field_data* Bdata);
+#pragma omp end declare target
+
+#endif
@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include "ascot5.h"
 #include "suzuki.h"
+#include "spline/interp.h"
 
 /* Hydrogen fits (Anum=1,2,3) */
 /* Low energy 9-100 keV, high energy 100-10000 keV, 0-1e22 1/m^3 */
@@ -290,10 +291,78 @@ real B_lowE[9][12] = {
 }
 };
 
+/**
+ * @brief Evaluate the density dependence of the hydrogen fit (equation 28)
+ *
+ * @param A fit coefficients for the species' mass number
+ * @param N electron density in units of 1e19 m^-3
+ *
+ * @return density factor (1 - exp(-A_4 N))^A_5
+ */
+static real suzuki_dens_H(real* A, real N) {
+    return pow(1 - exp(-A[3]*N), A[4]);
+}
+
+/**
+ * @brief Evaluate the hydrogen fit (equation 28) for a single species
+ *
+ * @param A fit coefficients for the species' mass number
+ * @param E beam energy per amu [keV]
+ * @param logE logarithm of E
+ * @param dens density factor from suzuki_dens_H()
+ * @param U logarithm of electron temperature in keV
+ *
+ * @return beam-stopping cross section [cm^2]
+ */
+static real suzuki_fit_H(real* A, real E, real logE, real dens, real U) {
+    return A[0] * 1.e-16 / E
+        *(1 + A[1]*logE + A[2]*logE*logE)
+        *(1 + dens * (A[5] + A[6]*logE + A[7]*logE*logE))
+        *(1 + A[8]*U + A[9]*U*U);
+}
+
+/**
+ * @brief Evaluate the impurity fit (equations 26 & 27) for a single species
+ *
+ * @param B fit coefficients for the impurity class
+ * @param logE logarithm of beam energy per amu in keV
+ * @param logN logarithm of electron density in units of 1e19 m^-3
+ * @param U logarithm of electron temperature in keV
+ *
+ * @return impurity contribution without the density and charge factor
+ */
+static real suzuki_fit_Z(real* B, real logE, real logN, real U) {
+    return B[0]
+        + B[1] * U
+        + B[2] * logN
+        + B[3] * logN * U
+        + B[4] * logE
+        + B[5] * logE * U
+        + B[6] * logE * logN
+        + B[7] * logE * logN * U
+        + B[8] * logE * logE
+        + B[9] * logE * logE * U
+        + B[10] * logE * logE * logN
+        + B[11] * logE * logE * logN * U;
+}
+
+/**
+ * @brief Evaluate beam-stopping coefficient from the Suzuki fit
+ *
+ * @param E beam energy per amu [keV]
+ * @param ne electron density [m^-3]
+ * @param te electron temperature [eV]
+ * @param nion number of ion species
+ * @param ni ion densities [m^-3]
+ * @param Anum ion mass numbers
+ * @param Znum ion charge numbers
+ *
+ * @return beam-stopping coefficient [cm^2]
+ */
 real suzuki_sigmav(real E, real ne, real te, integer nion, real* ni,
                    int* Anum, int* Znum) {
-    int* ind_H = malloc(nion * sizeof(int));
-    int* ind_Z = malloc(nion * sizeof(int));
+    int ind_H[MAX_SPECIES];
+    int ind_Z[MAX_SPECIES];
 
     /* Separate ions into hydrogen species and impurities */
     int n_H = 0, n_Z = 0;
@@ -343,13 +412,8 @@ real suzuki_sigmav(real E, real ne, real te, integer nion, real* ni,
     real sigma_H = 0.0;
     for(int i = 0; i < n_H; i++) {
         int ind_A = Anum[ind_H[i]]-1;
-        sigma_H += ni[ind_H[i]] * (A[ind_A][0] * 1.e-16 / E
-                                *(1 + A[ind_A][1]*logE + A[ind_A][2]*logE*logE)
-                                *(1 + pow(1 - exp(-A[ind_A][3]*N),A[ind_A][4])
-                                  *(A[ind_A][5] + A[ind_A][6]*logE
-                                    + A[ind_A][7]*logE*logE))
-                                *(1 + A[ind_A][8]*U + A[ind_A][9]*U*U));
-
+        sigma_H += ni[ind_H[i]] * suzuki_fit_H(A[ind_A], E, logE,
+                                               suzuki_dens_H(A[ind_A], N), U);
     }
     sigma_H /= dens_H;
 
@@ -369,23 +433,278 @@ real suzuki_sigmav(real E, real ne, real te, integer nion, real* ni,
             break;
         }
         sigma_Z += ni[ind_Z[i]] / ne * Znum[ind_Z[i]]
-            * (B[ind_B][0]
-               + B[ind_B][1] * U
-               + B[ind_B][2] * logN
-               + B[ind_B][3] * logN * U
-               + B[ind_B][4] * logE
-               + B[ind_B][5] * logE * U
-               + B[ind_B][6] * logE * logN
-               + B[ind_B][7] * logE * logN * U
-               + B[ind_B][8] * logE * logE
-               + B[ind_B][9] * logE * logE * U
-               + B[ind_B][10] * logE * logE * logN
-               + B[ind_B][11] * logE * logE * logN * U);
+            * suzuki_fit_Z(B[ind_B], logE, logN, U);
+    }
+
+    /* Equation 24 */
+    return sigma_H * (1 + (Zeff - 1) * sigma_Z);
+}
+
+/**
+ * @brief Tabulate the Suzuki fit for the given plasma composition
+ *
+ * The fit is polynomial in log E, log N and U (the logarithms of the energy
+ * per amu, the electron density in units of 1e19 m^-3 and the electron
+ * temperature in keV), apart from the 1/E prefactor and the density factor
+ * (1 - exp(-A_4 N))^A_5 of the hydrogen fit. The polynomial parts are cheaper
+ * to evaluate directly than to interpolate, so only the density factor, which
+ * needs an exp and a pow for each hydrogen species, is tabulated as a cubic
+ * spline in log N. Everything that depends only on the composition (which fit
+ * each species uses in which Zeff class) is resolved here as well.
+ *
+ * @param data pointer to the table struct to be initialized
+ * @param nion number of ion species
+ * @param Anum ion mass numbers
+ * @param Znum ion charge numbers
+ *
+ * @return zero if initialization succeeded
+ */
+int suzuki_init_table(suzuki_data* data, integer nion, int* Anum, int* Znum) {
+    data->n_ion = nion;
+    int n_H = 0;
+    for(int i = 0; i < nion; i++) {
+        data->znum[i] = Znum[i];
+        for(int k = 0; k < SUZUKI_MAX_ZEFFCLASS; k++) {
+            data->fit[i][k] = -1;
+        }
+        if(Znum[i] == 1) {
+            if(Anum[i] < 1 || Anum[i] > 3) {
+                printf("No plasma fit for species %d\n", i);
+                return 1;
+            }
+            data->fit[i][0] = Anum[i] - 1;
+            n_H++;
+            continue;
+        }
+        int k = 0;
+        for(int j = 0; j < 9 && k < SUZUKI_MAX_ZEFFCLASS; j++) {
+            if(Z_imp[j] == Znum[i]) {
+                data->fit[i][k] = j;
+                data->zeffmin[i][k] = Zeffmin_imp[j];
+                data->zeffmax[i][k] = Zeffmax_imp[j];
+                k++;
+            }
+        }
+    }
+
+    int n_N = SUZUKI_TAB_N_NE;
+    real logN_min = log(SUZUKI_TAB_NEMIN * 1.0e-19);
+    real logN_max = log(SUZUKI_TAB_NEMAX * 1.0e-19);
+
+    data->c = malloc(2 * n_H * n_N * NSIZE_COMP1D * sizeof(real));
+    real* f = malloc(n_N * sizeof(real));
+    if( (data->c == NULL && n_H > 0) || f == NULL ) {
+        free(data->c);
+        free(f);
+        return 1;
+    }
+
+    real* c = data->c;
+    for(int i = 0; i < nion; i++) {
+        if(Znum[i] != 1) {
+            continue;
+        }
+        for(int e = 0; e < 2; e++) {
+            real* A = e == 0 ? A_lowE[data->fit[i][0]]
+                             : A_highE[data->fit[i][0]];
+            for(int iN = 0; iN < n_N; iN++) {
+                real logN = logN_min + iN * (logN_max - logN_min) / (n_N - 1);
+                f[iN] = suzuki_dens_H(A, exp(logN));
+            }
+
+            if( interp1Dcomp_init_coeff(c, f, n_N, NATURALBC,
+                                        logN_min, logN_max) ) {
+                free(data->c);
+                free(f);
+                return 1;
+            }
+            interp1Dcomp_init_spline(e == 0 ? &data->dens_lowE[i]
+                                            : &data->dens_highE[i],
+                                     c, n_N, NATURALBC, logN_min, logN_max);
+            c += n_N * NSIZE_COMP1D;
+        }
     }
 
-    free(ind_H);
-    free(ind_Z);
+    free(f);
+    return 0;
+}
+
+/**
+ * @brief Free the tabulated Suzuki fit
+ *
+ * @param data pointer to the table struct
+ */
+void suzuki_free_table(suzuki_data* data) {
+    free(data->c);
+    data->c = NULL;
+}
+
+/**
+ * @brief Evaluate beam-stopping coefficient using the tabulated Suzuki fit
+ *
+ * The arguments and the result are the same as in suzuki_sigmav(), except that
+ * the composition is the one the table was initialized with. Outside the
+ * tabulated density range the density factor is evaluated directly.
+ *
+ * @param E beam energy per amu [keV]
+ * @param ne electron density [m^-3]
+ * @param te electron temperature [eV]
+ * @param ni ion densities [m^-3]
+ * @param data pointer to the table struct
+ *
+ * @return beam-stopping coefficient [cm^2]
+ */
+real suzuki_sigmav_table(real E, real ne, real te, real* ni,
+                         suzuki_data* data) {
+    int* Znum = data->znum;
+    real dens_H = 0.0;
+    real Zeff_sum1 = 0.0, Zeff_sum2 = 0.0;
+    for(int i = 0; i < data->n_ion; i++) {
+        dens_H    += (Znum[i] == 1) * ni[i];
+        Zeff_sum1 += ni[i] * Znum[i] * Znum[i];
+        Zeff_sum2 += ni[i] * Znum[i];
+    }
+    real Zeff = Zeff_sum1 / Zeff_sum2;
+
+    if(dens_H == 0.0) {
+        printf("No hydrogen species in plasma\n");
+        return 0.0;
+    }
+
+    /* Select low- or high-energy coefficient tables */
+    real (*A)[10];
+    real (*B)[12];
+    interp1D_data* dens;
+    if(E >= 9.0 && E < 100.0) {
+        A = A_lowE;
+        B = B_lowE;
+        dens = data->dens_lowE;
+    } else if(E < 10000.0) {
+        A = A_highE;
+        B = B_highE;
+        dens = data->dens_highE;
+    } else {
+        printf("Invalid energy %le keV\n", E);
+        return 0.0;
+    }
+
+    real logE = log(E);
+    real N = ne * 1.0e-19;
+    real logN = log(N);
+    real U = log(te * 1.0e-3);
+
+    /* Equations 26 - 28 */
+    real sigma_H = 0.0, sigma_Z = 0.0;
+    for(int i = 0; i < data->n_ion; i++) {
+        if(Znum[i] == 1) {
+            real* A_i = A[data->fit[i][0]];
+            real g;
+            if( interp1Dcomp_eval_f(&g, &dens[i], logN) ) {
+                g = suzuki_dens_H(A_i, N);
+            }
+            sigma_H += ni[i] * suzuki_fit_H(A_i, E, logE, g, U);
+            continue;
+        }
+
+        int ind_B = -1;
+        for(int k = 0; k < SUZUKI_MAX_ZEFFCLASS && data->fit[i][k] >= 0; k++) {
+            if(Zeff > data->zeffmin[i][k] && Zeff < data->zeffmax[i][k]) {
+                ind_B = data->fit[i][k];
+                break;
+            }
+        }
+        if(ind_B < 0) {
+            printf("No plasma fit for species %d\n", i);
+            break;
+        }
+        sigma_Z += ni[i] / ne * Znum[i] * suzuki_fit_Z(B[ind_B], logE, logN, U);
+    }
+    sigma_H /= dens_H;
 
     /* Equation 24 */
     return sigma_H * (1 + (Zeff - 1) * sigma_Z);
 }
+
+/**
+ * @brief Estimate the accuracy of the tabulated Suzuki fit
+ *
+ * The tabulated beam-stopping coefficient is compared against the direct
+ * evaluation at quasi-random points (a fixed Halton sequence, so that the
+ * report is reproducible). The points are uniformly distributed in the
+ * logarithms of energy (9 keV/amu - 10 MeV/amu), electron density (tabulated
+ * range) and electron temperature (1 eV - 100 keV). The ion densities are
+ * drawn from [0.1, 1.1] relative to each other and scaled to quasi-neutrality,
+ * and points for which the resulting Zeff has no impurity fit are skipped.
+ *
+ * @param data pointer to the table struct
+ * @param Anum ion mass numbers
+ * @param nsample number of sample points
+ * @param err_max pointer where the maximum relative error is stored
+ * @param err_mean pointer where the mean relative error is stored
+ */
+void suzuki_table_accuracy(suzuki_data* data, int* Anum, int nsample,
+                           real* err_max, real* err_mean) {
+    const int base[3 + MAX_SPECIES] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31};
+    real logE_min = log(9.0);
+    real logE_max = log(10000.0);
+    real logN_min = log(SUZUKI_TAB_NEMIN);
+    real logN_max = log(SUZUKI_TAB_NEMAX);
+    real logT_min = log(1.0);
+    real logT_max = log(1.0e5);
+
+    *err_max  = 0.0;
+    *err_mean = 0.0;
+    int n = 0;
+
+    for(int s = 1; s <= nsample; s++) {
+        real q[3 + MAX_SPECIES];
+        for(int d = 0; d < 3 + data->n_ion; d++) {
+            real frac = 1.0;
+            q[d] = 0.0;
+            for(int m = s; m > 0; m /= base[d]) {
+                frac /= base[d];
+                q[d] += frac * (m % base[d]);
+            }
+        }
+        real E  = exp(logE_min + q[0] * (logE_max - logE_min));
+        real ne = exp(logN_min + q[1] * (logN_max - logN_min));
+        real te = exp(logT_min + q[2] * (logT_max - logT_min));
+
+        real ni[MAX_SPECIES], qn = 0.0;
+        for(int i = 0; i < data->n_ion; i++) {
+            ni[i] = 0.1 + q[3 + i];
+            qn += ni[i] * data->znum[i];
+        }
+        real Zeff_sum1 = 0.0, Zeff_sum2 = 0.0;
+        for(int i = 0; i < data->n_ion; i++) {
+            ni[i] *= ne / qn;
+            Zeff_sum1 += ni[i] * data->znum[i] * data->znum[i];
+            Zeff_sum2 += ni[i] * data->znum[i];
+        }
+        real Zeff = Zeff_sum1 / Zeff_sum2;
+
+        int has_fit = 1;
+        for(int i = 0; i < data->n_ion; i++) {
+            int found = data->znum[i] == 1;
+            for(int k = 0; k < SUZUKI_MAX_ZEFFCLASS && !found; k++) {
+                found = data->fit[i][k] >= 0 && Zeff > data->zeffmin[i][k]
+                    && Zeff < data->zeffmax[i][k];
+            }
+            has_fit = has_fit && found;
+        }
+        if(!has_fit) {
+            continue;
+        }
+
+        real exact = suzuki_sigmav(E, ne, te, data->n_ion, ni, Anum,
+                                   data->znum);
+        real tab = suzuki_sigmav_table(E, ne, te, ni, data);
+        real err = fabs(tab - exact) / fabs(exact);
+        *err_max   = err > *err_max ? err : *err_max;
+        *err_mean += err;
+        n++;
+    }
+    if(n > 0) {
+        *err_mean /= n;
+    }
+}
@@ -1,7 +1,51 @@
+/**
+ * @file suzuki.h
+ * @brief Header file for suzuki.c
+ */
 #ifndef SUZUKI_H
 #define SUZUKI_H
 
+#include "ascot5.h"
+#include "spline/interp.h"
+
+/** Number of electron density grid points in the tabulated fit */
+#define SUZUKI_TAB_N_NE 256
+
+/** Tabulated electron density range [m^-3] */
+#define SUZUKI_TAB_NEMIN 1.0e15
+#define SUZUKI_TAB_NEMAX 1.0e23
+
+/** Maximum number of Zeff classes with a separate fit for an impurity */
+#define SUZUKI_MAX_ZEFFCLASS 2
+
+/**
+ * @brief Suzuki fit prepared for a fixed plasma composition
+ *
+ * Holds the fit indices of each species and the tabulated density factor of
+ * the hydrogen fits, see suzuki_init_table().
+ */
+typedef struct {
+    int n_ion;                  /**< Number of ion species                  */
+    int znum[MAX_SPECIES];      /**< Ion charge numbers                     */
+    int fit[MAX_SPECIES][SUZUKI_MAX_ZEFFCLASS]; /**< Fit index or -1        */
+    real zeffmin[MAX_SPECIES][SUZUKI_MAX_ZEFFCLASS]; /**< Zeff class min    */
+    real zeffmax[MAX_SPECIES][SUZUKI_MAX_ZEFFCLASS]; /**< Zeff class max    */
+    interp1D_data dens_lowE[MAX_SPECIES];  /**< Density factor, 9-100 keV   */
+    interp1D_data dens_highE[MAX_SPECIES]; /**< Density factor, 100- keV    */
+    real* c;                    /**< Spline coefficients of all tables      */
+} suzuki_data;
+
 real suzuki_sigmav(real E, real ne, real te, integer nion, real* ni,
                    int* Anum, int* Znum);
 
+int suzuki_init_table(suzuki_data* data, integer nion, int* Anum, int* Znum);
+
+void suzuki_free_table(suzuki_data* data);
+
+real suzuki_sigmav_table(real E, real ne, real te, real* ni,
+                         suzuki_data* data);
+
+void suzuki_table_accuracy(suzuki_data* data, int* Anum, int nsample,
+                           real* err_max, real* err_mean);
+
 #endif
@@ -3,6 +3,7 @@
  * @brief Test program for random number generator
  */
 #include <stdio.h>
+#include <math.h>
 #include <omp.h>
 #include "../ascot5.h"
 #include "../random.h"
@@ -15,11 +16,11 @@
 int main(int argc, char** argv) {
     random_data rdata;
 
-    double r[N];
+    static double r[N];
 
     random_init(&rdata, 12345);
 
-    double t1, t2, t3;
+    double t1, t2, t3, t4;
     t1 = omp_get_wtime();
 
     for(int i = 0; i < N; i++) {
@@ -32,11 +33,39 @@ int main(int argc, char** argv) {
 
     t3 = omp_get_wtime();
 
-    printf("Serial %lf, SIMD %lf\n", t2-t1, t3-t2);
+    random_normal_simd(&rdata, N, r);
+
+    t4 = omp_get_wtime();
+
+    printf("Serial %lf, SIMD %lf, SIMD normal %lf\n", t2-t1, t3-t2, t4-t3);
+
+    /* Moments of the normal distribution */
+    double m1 = 0.0, m2 = 0.0;
+    for(int i = 0; i < N; i++) {
+        m1 += r[i];
+        m2 += r[i]*r[i];
+    }
+    m1 /= N;
+    m2 /= N;
+    printf("Normal mean %le, variance %le\n", m1, m2 - m1*m1);
+    int fail = fabs(m1) > 5e-3 || fabs(m2 - m1*m1 - 1.0) > 1e-2;
+
+#ifdef RANDOM_STREAMS
+    /* A marker gets the same numbers regardless of its slot or of how many
+     * numbers the other slots have drawn */
+    double a[2*NSIMD], b[2*NSIMD];
+    random_set_stream(&rdata, 3, 42, RANDOM_STREAM_GC);
+    random_normal_simd(&rdata, 2*NSIMD, a);
+    random_set_stream(&rdata, 5, 42, RANDOM_STREAM_GC);
+    random_set_stream(&rdata, 3, 43, RANDOM_STREAM_GC);
+    random_normal_simd(&rdata, 2*NSIMD, b);
+    fail = fail || a[3] != b[5] || a[NSIMD+3] != b[NSIMD+5] || a[3] == b[3];
+    printf("Marker streams %s\n", fail ? "FAILED" : "OK");
+#endif
 
 /*    for(int i = 0; i < N; i++) {
         printf("%le\n", r[i]);
     }*/
 
-    return 0;
+    return fail;
 }
@@ -0,0 +1,79 @@
+/**
+ * @file test_suzuki.c
+ * @brief Test program for the tabulated Suzuki beam-stopping coefficient
+ */
+#include <stdio.h>
+#include <math.h>
+#include <omp.h>
+#include "../ascot5.h"
+#include "../suzuki.h"
+
+#define N 1000000 /**< Number of evaluations in the timing test */
+
+/**
+ * Main function for the test program
+ */
+int main(int argc, char** argv) {
+    /* D-T plasma with carbon and beryllium impurities */
+    int nion = 4;
+    int anum[4] = {2, 3, 12, 9};
+    int znum[4] = {1, 1, 6, 4};
+
+    suzuki_data data;
+    if(suzuki_init_table(&data, nion, anum, znum)) {
+        printf("Table initialization failed\n");
+        return 1;
+    }
+
+    real err_max, err_mean;
+    suzuki_table_accuracy(&data, anum, 100000, &err_max, &err_mean);
+    printf("Random plasmas: max rel. error %le, mean rel. error %le\n",
+           err_max, err_mean);
+
+    /* Compare the combined coefficient along a density/temperature scan */
+    real max_err = 0.0;
+    real t_fit = 0.0, t_tab = 0.0, sum_fit = 0.0, sum_tab = 0.0;
+    for(int pass = 0; pass < 2; pass++) {
+        double t1 = omp_get_wtime();
+        for(int i = 0; i < N; i++) {
+            real x  = (i + 0.5) / N;
+            real E  = 10.0 * pow(900.0, x);
+            real ne = 1e18 * pow(1e3, fmod(7.0 * x, 1.0));
+            real te = 20.0 * pow(1e3, fmod(13.0 * x, 1.0));
+            real ni[4] = {0.45 * ne, 0.45 * ne, 0.01 * ne, 0.0125 * ne};
+
+            if(pass == 0) {
+                sum_fit += suzuki_sigmav(E, ne, te, nion, ni, anum, znum);
+            }
+            else {
+                real tab = suzuki_sigmav_table(E, ne, te, ni, &data);
+                real fit = suzuki_sigmav(E, ne, te, nion, ni, anum, znum);
+                real err = fabs(tab - fit) / fabs(fit);
+                max_err = err > max_err ? err : max_err;
+            }
+        }
+        double t2 = omp_get_wtime();
+        if(pass == 0) {
+            t_fit = t2 - t1;
+        }
+    }
+
+    double t1 = omp_get_wtime();
+    for(int i = 0; i < N; i++) {
+        real x  = (i + 0.5) / N;
+        real E  = 10.0 * pow(900.0, x);
+        real ne = 1e18 * pow(1e3, fmod(7.0 * x, 1.0));
+        real te = 20.0 * pow(1e3, fmod(13.0 * x, 1.0));
+        real ni[4] = {0.45 * ne, 0.45 * ne, 0.01 * ne, 0.0125 * ne};
+        sum_tab += suzuki_sigmav_table(E, ne, te, ni, &data);
+    }
+    t_tab = omp_get_wtime() - t1;
+
+    printf("Combined coefficient: max rel. error %le\n", max_err);
+    printf("Fit %lf s, table %lf s (checksums %le %le)\n",
+           t_fit, t_tab, sum_fit, sum_tab);
+
+    suzuki_free_table(&data);
+
+    return max_err > 1e-2;
+}
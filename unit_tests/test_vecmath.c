@@ -0,0 +1,98 @@
+/**
+ * @file test_vecmath.c
+ * @brief Test program for the vectorizable elementary functions
+ *
+ * Compares the in-tree functions against libm over the ranges relevant for
+ * the simulation and times both in an omp simd loop over marker-sized
+ * batches.
+ */
+#include <stdio.h>
+#include <math.h>
+#include <omp.h>
+#include "../ascot5.h"
+#include "../vecmath.h"
+
+#define N 4000000 /**< Number of evaluations per function */
+
+real x[NSIMD]; /**< Argument batch       */
+real y[NSIMD]; /**< Second argument batch */
+real f[NSIMD]; /**< Result batch          */
+
+/** Relative error tolerance depending on the chosen accuracy */
+#if A5_VECMATH == 2
+#define TOL 1e-7
+#else
+#define TOL 1e-14
+#endif
+
+/**
+ * @brief Fill the argument batch with values in [xmin, xmax]
+ */
+void fill(int n, real xmin, real xmax) {
+    for(int i = 0; i < NSIMD; i++) {
+        real u = fmod( (n * NSIMD + i) * 0.6180339887498949, 1.0 );
+        x[i] = xmin + (xmax - xmin) * u;
+        y[i] = xmin + (xmax - xmin) * fmod(u * 7.0, 1.0);
+    }
+}
+
+/**
+ * @brief Compute error and timing of one function
+ *
+ * The error is relative to max(|f|, floor), so functions with zero crossings
+ * are tested in absolute error near the crossing.
+ */
+#define TEST(name, vfun, lfun, xmin, xmax, floor) do {                  \
+        real maxerr = 0.0, sum = 0.0;                                   \
+        double tv = 0.0, tl = 0.0;                                      \
+        for(int n = 0; n < N / NSIMD; n++) {                            \
+            fill(n, xmin, xmax);                                        \
+            double t = omp_get_wtime();                                 \
+            _Pragma("omp simd")                                         \
+            for(int i = 0; i < NSIMD; i++) {                            \
+                f[i] = vfun;                                            \
+            }                                                           \
+            tv += omp_get_wtime() - t;                                  \
+            for(int i = 0; i < NSIMD; i++) {                            \
+                sum += f[i];                                            \
+            }                                                           \
+            real fv[NSIMD];                                             \
+            for(int i = 0; i < NSIMD; i++) {                            \
+                fv[i] = f[i];                                           \
+            }                                                           \
+            t = omp_get_wtime();                                        \
+            _Pragma("omp simd")                                         \
+            for(int i = 0; i < NSIMD; i++) {                            \
+                f[i] = lfun;                                            \
+            }                                                           \
+            tl += omp_get_wtime() - t;                                  \
+            for(int i = 0; i < NSIMD; i++) {                            \
+                real e = fabs(fv[i] - f[i])                             \
+                    / fmax(fabs(f[i]), floor);                          \
+                maxerr = e > maxerr ? e : maxerr;                       \
+            }                                                           \
+        }                                                               \
+        printf("%-6s max error %9.3le  libm %6.2lf ns  vecmath %6.2lf ns" \
+               "  (checksum %le)\n", name, maxerr, 1e9*tl/N, 1e9*tv/N, sum); \
+        fail = fail || !(maxerr < TOL);                                 \
+    } while(0)
+
+/**
+ * Main function for the test program
+ */
+int main(int argc, char** argv) {
+    int fail = 0;
+
+    TEST("exp",   vecmath_exp(x[i]), exp(x[i]), -700.0, 700.0, 0.0);
+    TEST("exp",   vecmath_exp(x[i]), exp(x[i]), -40.0, 0.0, 0.0);
+    TEST("log",   vecmath_log(x[i]), log(x[i]), 0.5, 2.0, 1.0);
+    TEST("log",   vecmath_log(x[i]), log(x[i]), 1e-300, 1e300, 1.0);
+    TEST("erf",   vecmath_erf(x[i]), erf(x[i]), -7.0, 7.0, 0.0);
+    TEST("erf",   vecmath_erf(x[i]), erf(x[i]), -1e-3, 1e-3, 0.0);
+    TEST("sin",   vecmath_sin(x[i]), sin(x[i]), -1e3, 1e3, 1.0);
+    TEST("cos",   vecmath_cos(x[i]), cos(x[i]), -1e3, 1e3, 1.0);
+    TEST("atan2", vecmath_atan2(y[i], x[i]), atan2(y[i], x[i]),
+         -10.0, 10.0, 1.0);
+
+    return fail;
+}
@@ -1,22 +1,57 @@
 /**
  * @file test_wall_2d.c
  * @brief Test program for 2D wall collision functions
+ *
+ * Prints "r, z, inside" for random points so that the result can be plotted,
+ * and checks along the way that the row-accelerated point-in-polygon test
+ * agrees with a test over all segments and that steps leaving the wall are
+ * reported with a collision point on the segment that was hit.
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include "../ascot5.h"
 #include "../wall/wall_2d.h"
 
+/**
+ * @brief Point-in-polygon test over all segments
+ */
+int inside_full(real r, real z, wall_2d_data* w) {
+    int hits = 0;
+    for(int i = 0; i < w->n - 1; i++) {
+        real wz1 = w->wall_z[i] - z;
+        real wz2 = w->wall_z[i+1] - z;
+        real wr1 = w->wall_r[i] - r;
+        real wr2 = w->wall_r[i+1] - r;
+        if(wz1 * wz2 < 0) {
+            real ri = wr1 + (wz1*(wr2-wr1)) / (wz1-wz2);
+            if(ri > 0) {
+                hits++;
+            }
+        }
+    }
+    return hits % 2;
+}
+
 int main(int argc, char** argv) {
     real wall_r[] = {4.7, 6.1, 6.1, 8.4, 8.4, 7.6, 6.1, 4.8, 4.0, 4.0, 4.7,
         4.7};
     real wall_z[] = {-4.25, -4.25, -3.5, -1.1, 1.75, 2.5, 3.6, 3.6, 2.4, -1.5,
         -3.25, -4.25};
 
+    wall_2d_offload_data offload_data;
+    offload_data.n = 12;
+    offload_data.offload_array_length = 2 * offload_data.n;
+    real* offload_array = (real*) malloc(2 * offload_data.n * sizeof(real));
+    int* int_offload_array;
+    memcpy(&offload_array[0], wall_r, offload_data.n * sizeof(real));
+    memcpy(&offload_array[offload_data.n], wall_z,
+           offload_data.n * sizeof(real));
+    wall_2d_init_offload(&offload_data, &offload_array, &int_offload_array);
+
     wall_2d_data wdata;
-    wdata.n = 12;
-    wdata.wall_r = wall_r;
-    wdata.wall_z = wall_z;
+    wall_2d_init(&wdata, &offload_data, offload_array, int_offload_array);
 
     srand(0);
 
@@ -25,13 +60,41 @@ int main(int argc, char** argv) {
     real zmin = -6;
     real zmax = 6;
 
+    int failed = 0;
     int i;
     for(i = 0; i < 1000; i++) {
         real r = ((real)rand()/(real)RAND_MAX)*(rmax-rmin) + rmin;
         real z = ((real)rand()/(real)RAND_MAX)*(zmax-zmin) + zmin;
         int inside = wall_2d_inside(r, z, &wdata);
         printf("%lf, %lf, %d\n", r, z, inside);
+
+        if(inside != inside_full(r, z, &wdata)) {
+            fprintf(stderr, "Inside test differs at (%lf, %lf)\n", r, z);
+            failed = 1;
+        }
+
+        /* Step from the polygon centre to the point */
+        real r0 = 6.2, z0 = 0.0, w_coll = -1;
+        int tile = wall_2d_hit_wall(r0, 0, z0, r, 0, z, &wdata, &w_coll);
+        if(!inside && tile == 0) {
+            fprintf(stderr, "Missed hit at (%lf, %lf)\n", r, z);
+            failed = 1;
+        }
+        if(tile > 0) {
+            /* Collision point must lie on the segment */
+            real rc = r0 + w_coll * (r - r0), zc = z0 + w_coll * (z - z0);
+            real er = wall_r[tile] - wall_r[tile-1];
+            real ez = wall_z[tile] - wall_z[tile-1];
+            real cross = (rc - wall_r[tile-1]) * ez - (zc - wall_z[tile-1]) * er;
+            if(w_coll < 0 || w_coll > 1
+               || fabs(cross) > 1e-9 * sqrt(er * er + ez * ez)) {
+                fprintf(stderr, "Collision point off segment %d\n", tile);
+                failed = 1;
+            }
+        }
     }
 
-    return 0;
+    wall_2d_free_offload(&offload_data, &offload_array, &int_offload_array);
+
+    return failed;
 }
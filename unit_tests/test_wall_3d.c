@@ -7,6 +7,7 @@
 #include <math.h>
 #include "../math.h"
 #include "../ascot5.h"
+#include "../consts.h"
 #include "../wall/wall_3d.h"
 
 #define N 10000 /**< Number of repetitions in each test */
@@ -16,6 +17,9 @@
 #define TRIQUEUE_N_BATCHES   10
 #define TRIQUEUE_Z_DISTANCE  1.0
 
+#define TORUS_N_PHI   36
+#define TORUS_N_THETA 64
+
 /**
  *  Generate a simple 3D wall to test against.
  *
@@ -147,6 +151,92 @@ void queue_wall(wall_3d_offload_data *offload_data,
     }
 }
 
+/**
+ *  Generate a toroidal wall with elliptical cross section.
+ *
+ *  Each of the TORUS_N_PHI x TORUS_N_THETA quads is split into two triangles.
+ */
+void torus_wall(wall_3d_offload_data *offload_data,
+                real **offload_array) {
+    const int nTri = 2 * TORUS_N_PHI * TORUS_N_THETA;
+    offload_data->n = nTri;
+    offload_data->offload_array_length = nTri*3*3;
+    *offload_array = (real*) malloc(9 * offload_data->n * sizeof(real));
+
+    int iTri = 0;
+    for(int i = 0; i < TORUS_N_PHI; i++) {
+        for(int j = 0; j < TORUS_N_THETA; j++) {
+            real p[4][3];
+            for(int k = 0; k < 4; k++) {
+                int ip = i + (k == 2 || k == 3);
+                int it = j + (k == 1 || k == 2);
+                real phi   = ip * CONST_2PI / TORUS_N_PHI;
+                real theta = it * CONST_2PI / TORUS_N_THETA;
+                real r = 6.2 + 2.6 * cos(theta);
+                p[k][0] = r * cos(phi);
+                p[k][1] = r * sin(phi);
+                p[k][2] = 0.6 + 4.2 * sin(theta);
+            }
+            int tris[2][3] = {{0, 1, 2}, {0, 2, 3}};
+            for(int t = 0; t < 2; t++) {
+                for(int k = 0; k < 3; k++) {
+                    (*offload_array)[iTri*9 + k*3 + 0] = p[tris[t][k]][0];
+                    (*offload_array)[iTri*9 + k*3 + 1] = p[tris[t][k]][1];
+                    (*offload_array)[iTri*9 + k*3 + 2] = p[tris[t][k]][2];
+                }
+                iTri++;
+            }
+        }
+    }
+}
+
+/**
+ * Check that the grid traversal finds the same first hit as testing all
+ * triangles for random segments ranging from short steps to ones that cross
+ * the whole device.
+ */
+int test_tree_against_full(wall_3d_data* wdata) {
+    srand(0);
+    int failed = 0;
+    int nhit = 0;
+    for(int i = 0; i < N; i++) {
+        real len = pow(10.0, -3.0 + 4.0 * (real)rand() / (real)RAND_MAX);
+        real r1   = 4.0 + 5.0 * (real)rand() / (real)RAND_MAX;
+        real phi1 = CONST_2PI * (real)rand() / (real)RAND_MAX;
+        real z1   = -4.0 + 9.0 * (real)rand() / (real)RAND_MAX;
+        real dir[3];
+        for(int k = 0; k < 3; k++) {
+            dir[k] = 2.0 * (real)rand() / (real)RAND_MAX - 1.0;
+        }
+        real rpz1[3] = {r1, phi1, z1}, q1[3], q2[3], rpz2[3];
+        math_rpz2xyz(rpz1, q1);
+        real norm = math_norm(dir);
+        for(int k = 0; k < 3; k++) {
+            q2[k] = q1[k] + len * dir[k] / norm;
+        }
+        math_xyz2rpz(q2, rpz2);
+
+        real w_tree, w_full;
+        int tile_tree = wall_3d_hit_wall(rpz1[0], rpz1[1], rpz1[2],
+                                         rpz2[0], rpz2[1], rpz2[2],
+                                         wdata, &w_tree);
+        int tile_full = wall_3d_hit_wall_full(rpz1[0], rpz1[1], rpz1[2],
+                                              rpz2[0], rpz2[1], rpz2[2],
+                                              wdata, &w_full);
+        nhit += tile_full > 0;
+        if( (tile_tree > 0) != (tile_full > 0)
+            || (tile_full > 0 && fabs(w_tree - w_full) > 1e-9) ) {
+            printf("Segment %d: tree hit %d (w=%g), full hit %d (w=%g)\n"
+                   " fail!\n", i, tile_tree, w_tree, tile_full, w_full);
+            failed++;
+        }
+    }
+    printf("Grid traversal agrees with all-triangle check for %d segments "
+           "(%d hits)", N - failed, nhit);
+    printf(failed ? "\n fail!\n" : " ... ok!\n");
+    return failed;
+}
+
 /**
  * Guess two random points and see if the line between them intersects a wall.
  */
@@ -557,5 +647,16 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    wall_3d_free_offload(&offload_data, &offload_array, &int_offload_array);
+
+    /* Compare grid traversal against checking all triangles */
+    torus_wall(&offload_data, &offload_array);
+    wall_3d_init_offload(&offload_data, &offload_array, &int_offload_array);
+    wall_3d_init(&wdata, &offload_data, offload_array, int_offload_array);
+
+    if (test_tree_against_full(&wdata)) {
+        return 1;
+    }
+
     return 0;
 }
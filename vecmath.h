@@ -0,0 +1,368 @@
+/**
+ * @file vecmath.h
+ * @brief Vectorizable elementary functions
+ *
+ * The particle loops call exp, log, erf, sin, cos and atan2. Whether a call
+ * to libm inside an omp simd loop is vectorized depends on the compiler and
+ * on the availability of a vector math library, and without one the call
+ * is a scalar function call with branches that also prevents the rest of
+ * the loop body from being vectorized. The functions here are branch-free
+ * polynomial approximations written in plain C so that the compiler can
+ * inline and vectorize them on any toolchain.
+ *
+ * The implementation is chosen at compile time with A5_VECMATH in ascot5.h:
+ *
+ * - 0 libm functions are used as such
+ * - 1 in-tree functions with double precision accuracy (a few ulp)
+ * - 2 in-tree functions with reduced accuracy (relative error ~1e-8)
+ *
+ * Only the double precision build uses the in-tree functions.
+ *
+ * Domain notes: vecmath_exp returns zero below -745.2 and infinity above
+ * 709.79, and the argument reduction of vecmath_sin and vecmath_cos is exact
+ * for |x| < 1.6e6. Larger arguments lose accuracy at the level of the ulp of
+ * the argument itself, which for the toroidal angle is the accuracy the
+ * angle is known to anyway.
+ */
+#ifndef VECMATH_H
+#define VECMATH_H
+
+#include <math.h>
+#include <stdint.h>
+#include "ascot5.h"
+
+#if A5_VECMATH == 0 || defined SINGLEPRECISION
+
+#pragma omp declare simd
+static inline real vecmath_exp(real x) { return exp(x); }
+#pragma omp declare simd
+static inline real vecmath_log(real x) { return log(x); }
+#pragma omp declare simd
+static inline real vecmath_erf(real x) { return erf(x); }
+#pragma omp declare simd
+static inline real vecmath_sin(real x) { return sin(x); }
+#pragma omp declare simd
+static inline real vecmath_cos(real x) { return cos(x); }
+#pragma omp declare simd
+static inline real vecmath_atan2(real y, real x) { return atan2(y, x); }
+#pragma omp declare simd linear(s, c)
+static inline void vecmath_sincos(real x, real* s, real* c) {
+    *s = sin(x);
+    *c = cos(x);
+}
+
+#else
+
+/** Adding and subtracting this rounds a double to the nearest integer and
+ *  leaves the integer in the low bits of the mantissa */
+#define VECMATH_SHIFTER 6755399441055744.0
+
+/** ln(2) split into a 32-bit leading part and the remainder */
+#define VECMATH_LN2HI 6.93147180369123816490e-01
+#define VECMATH_LN2LO 1.90821492927058770002e-10
+
+/** pi/2 split into three 33-bit parts for the argument reduction */
+#define VECMATH_PIO2_1 1.57079632673412561417e+00
+#define VECMATH_PIO2_2 6.07710050630396597660e-11
+#define VECMATH_PIO2_3 2.02226624871116645580e-21
+
+#define VECMATH_PI   3.14159265358979323846
+#define VECMATH_PIO2 1.57079632679489661923
+#define VECMATH_PIO4 0.78539816339744830962
+
+/** Bit pattern of sqrt(1/2), the lower limit of the mantissa in log */
+#define VECMATH_SQRTHALF_BITS 0x3fe6a09e667f3bcdULL
+
+/** Upper limit of the erfc fit; erf(x) = 1 in double precision above it */
+#define VECMATH_ERF_XMAX 6.0
+
+#if A5_VECMATH == 2
+#define VECMATH_EXP_N    8
+#define VECMATH_LOG_N    3
+#define VECMATH_SIN_N    4
+#define VECMATH_COS_N    5
+#define VECMATH_ATAN_N   5
+#define VECMATH_ERF_N    6
+#define VECMATH_ERFC_N  11
+#else
+#define VECMATH_EXP_N   14
+#define VECMATH_LOG_N    9
+#define VECMATH_SIN_N    7
+#define VECMATH_COS_N    8
+#define VECMATH_ATAN_N  10
+#define VECMATH_ERF_N   11
+#define VECMATH_ERFC_N  23
+#endif
+
+/** Taylor coefficients 1/k! of exp(r), |r| < ln(2)/2 */
+static const real vecmath_exp_c[14] = {
+    1.0, 1.0, 1.0/2, 1.0/6, 1.0/24, 1.0/120, 1.0/720, 1.0/5040, 1.0/40320,
+    1.0/362880, 1.0/3628800, 1.0/39916800, 1.0/479001600, 1.0/6227020800.0};
+
+/** Coefficients 1/(2k+3) of (atanh(f)/f - 1)/f^2 in f^2 */
+static const real vecmath_log_c[9] = {
+    1.0/3, 1.0/5, 1.0/7, 1.0/9, 1.0/11, 1.0/13, 1.0/15, 1.0/17, 1.0/19};
+
+/** Taylor coefficients of (sin(r)/r - 1)/r^2 in r^2, |r| < pi/4 */
+static const real vecmath_sin_c[7] = {
+    -1.0/6, 1.0/120, -1.0/5040, 1.0/362880, -1.0/39916800,
+    1.0/6227020800.0, -1.0/1307674368000.0};
+
+/** Taylor coefficients of (cos(r) - 1)/r^2 in r^2, |r| < pi/4 */
+static const real vecmath_cos_c[8] = {
+    -1.0/2, 1.0/24, -1.0/720, 1.0/40320, -1.0/3628800, 1.0/479001600.0,
+    -1.0/87178291200.0, 1.0/20922789888000.0};
+
+/** Fit of (atan(t)/t - 1)/t^2 in t^2, |t| < tan(pi/8) */
+#if A5_VECMATH == 2
+static const real vecmath_atan_c[5] = {
+    -0.3333333181341932, 0.1999955007591705, -0.14264232553093617,
+    0.10746298434670949, -0.06459376279024305};
+#else
+static const real vecmath_atan_c[10] = {
+    -0.3333333333333334, 0.19999999999928258, -0.1428571426923267,
+    0.11111109785283876, -0.09090856358033547, 0.07691111960751398,
+    -0.0665012494903733, 0.05739058777155688, -0.04491267252525746,
+    0.02284749382472627};
+#endif
+
+/** Fit of (erf(x)*sqrt(pi)/(2x) - 1)/x^2 in x^2, |x| < 1 */
+#if A5_VECMATH == 2
+static const real vecmath_erf_c[6] = {
+    -0.333333328785781, 0.09999966927141653, -0.023805610434714353,
+    0.004612573552706918, -0.0007234918228979713, 7.432533814905471e-05};
+#else
+static const real vecmath_erf_c[11] = {
+    -0.3333333333333353, 0.10000000000012825, -0.02380952381222113,
+    0.004629629655377924, -0.0007575758901631145, 0.0001068380035430234,
+    -1.3228208953454797e-05, 1.4595688384818364e-06, -1.452010966740032e-07,
+    1.2854303348083117e-08, -8.239948302035509e-10};
+#endif
+
+/** Fit of x*exp(x^2)*erfc(x) as a polynomial in u = (12/5)/x - 7/5, which
+ *  maps x in [1, 6] to u in [-1, 1] */
+#if A5_VECMATH == 2
+static const real vecmath_erfc_c[11] = {
+    0.496666486426878, -0.07128283975714324, -0.0019369806011154931,
+    0.006218984937704328, -0.0026682826118330978, 0.0006447138819972813,
+    -6.836345222256455e-06, -0.0001008587050149445, 6.757043594966799e-05,
+    -1.7919792214347697e-05, -4.6444901608458337e-07};
+#else
+static const real vecmath_erfc_c[23] = {
+    0.4966664851259388, -0.07128287792546606, -0.0019368880676988761,
+    0.00621971758686582, -0.0026693430308330868, 0.0006408677673673498,
+    -2.439037717514033e-06, -9.303491434218823e-05, 5.951649653850186e-05,
+    -2.385421463435252e-05, 5.898940796125656e-06, 2.0800618555565896e-07,
+    -1.285423279379192e-06, 9.381323134644784e-07, -4.53587980124466e-07,
+    1.3113829357146772e-07, -1.3406163812045211e-08, 1.1884353460017177e-08,
+    2.05890947990703e-09, -2.5395948532513617e-08, 1.3821919789914545e-08,
+    2.6113001726333684e-09, -2.410911015854589e-09};
+#endif
+
+/**
+ * @brief Reinterpret the bits of a double as a 64-bit integer
+ */
+#pragma omp declare simd
+static inline int64_t vecmath_asint(real x) {
+    union {real d; int64_t i;} u = {x};
+    return u.i;
+}
+
+/**
+ * @brief Reinterpret a 64-bit integer as a double
+ */
+#pragma omp declare simd
+static inline real vecmath_asreal(int64_t i) {
+    union {int64_t i; real d;} u = {i};
+    return u.d;
+}
+
+/**
+ * @brief Evaluate polynomial c[0] + c[1]*x + ... + c[n-1]*x^(n-1)
+ *
+ * The loop is unrolled so that the enclosing simd loop has no inner loops.
+ */
+#pragma omp declare simd uniform(c, n)
+static inline real vecmath_poly(real x, const real* c, int n) {
+    real p = c[n-1];
+    #pragma GCC unroll 32
+    for(int k = n - 2; k >= 0; k--) {
+        p = p * x + c[k];
+    }
+    return p;
+}
+
+/**
+ * @brief Exponential function
+ *
+ * x = k ln(2) + r with |r| < ln(2)/2 and exp(x) = 2^k exp(r), where exp(r) is
+ * evaluated from its Taylor series and 2^k is built from the exponent bits.
+ */
+#pragma omp declare simd
+static inline real vecmath_exp(real x) {
+    /* Arguments outside the range are not clamped, since the selects at the
+     * end override the result, and clamping would introduce branches that
+     * prevent if-conversion */
+    real y  = x * 1.44269504088896340736 + VECMATH_SHIFTER;
+    int64_t k = vecmath_asint(y) - vecmath_asint(VECMATH_SHIFTER);
+    real kf = y - VECMATH_SHIFTER;
+    real r  = ( x - kf * VECMATH_LN2HI ) - kf * VECMATH_LN2LO;
+
+    /* 2^k is applied in two factors so that the limits of the exponent
+     * range do not overflow the exponent bits. Only 64-bit integer add,
+     * subtract and logical shift are used since other 64-bit integer vector
+     * operations are missing from SSE2 and AVX2. */
+    real p = vecmath_poly(r, vecmath_exp_c, VECMATH_EXP_N);
+    real y1 = kf * 0.5 + VECMATH_SHIFTER;
+    int64_t k1 = vecmath_asint(y1) - vecmath_asint(VECMATH_SHIFTER);
+    real scale1 = vecmath_asreal( (int64_t)( (uint64_t)(k1 + 1023) << 52 ) );
+    real scale2 = vecmath_asreal(
+        (int64_t)( (uint64_t)(k - k1 + 1023) << 52 ) );
+
+    real e = p * scale1 * scale2;
+    e = x < -745.2 ? 0.0 : e;
+    e = x > 709.79 ? HUGE_VAL : e;
+    return e;
+}
+
+/**
+ * @brief Natural logarithm
+ *
+ * x = 2^k z with z in [sqrt(1/2), sqrt(2)) and log(z) = 2 atanh(f), where
+ * f = (z - 1)/(z + 1) and |f| < 0.172.
+ */
+#pragma omp declare simd
+static inline real vecmath_log(real x) {
+    /* Scale subnormals to the normal range */
+    real sub = x < 2.2250738585072014e-308 ? 52.0 : 0.0;
+    real xs  = x < 2.2250738585072014e-308 ? x * 4503599627370496.0 : x;
+
+    /* Exponent k + 1023 relative to sqrt(1/2), biased so that the shift is
+     * logical, and converted to double via the shifter constant */
+    uint64_t ix = (uint64_t)vecmath_asint(xs);
+    uint64_t kb = ( ix - VECMATH_SQRTHALF_BITS + (1023ULL << 52) ) >> 52;
+    real z  = vecmath_asreal( (int64_t)( ix - ( (kb - 1023) << 52 ) ) );
+    real kf = vecmath_asreal(
+        (int64_t)( kb + (uint64_t)vecmath_asint(VECMATH_SHIFTER) ) )
+        - VECMATH_SHIFTER - 1023.0 - sub;
+
+    real f = (z - 1.0) / (z + 1.0);
+    real s = f * f;
+    real t = 2.0 * f;
+    real l = kf * VECMATH_LN2HI
+        + ( t + ( t * s * vecmath_poly(s, vecmath_log_c, VECMATH_LOG_N)
+                  + kf * VECMATH_LN2LO ) );
+
+    l = x == 0.0 ? -HUGE_VAL : l;
+    l = x < 0.0  ? NAN : l;
+    l = ( x == HUGE_VAL || x != x ) ? x : l;
+    return l;
+}
+
+/**
+ * @brief Sine and cosine of the same argument
+ *
+ * x = k pi/2 + r with |r| < pi/4, and the quadrant k selects between
+ * +-sin(r) and +-cos(r).
+ */
+#pragma omp declare simd linear(s, c)
+static inline void vecmath_sincos(real x, real* s, real* c) {
+    real y  = x * 0.63661977236758134308 + VECMATH_SHIFTER;
+    int64_t q = vecmath_asint(y) - vecmath_asint(VECMATH_SHIFTER);
+    real kf = y - VECMATH_SHIFTER;
+    real r  = ( ( x - kf * VECMATH_PIO2_1 ) - kf * VECMATH_PIO2_2 )
+        - kf * VECMATH_PIO2_3;
+
+    real r2 = r * r;
+    real sr = r + r * r2 * vecmath_poly(r2, vecmath_sin_c, VECMATH_SIN_N);
+    real cr = 1.0 + r2 * vecmath_poly(r2, vecmath_cos_c, VECMATH_COS_N);
+
+    /* The quadrant selects and sign flips are done with bit masks; selects
+     * on 64-bit integer conditions would need SSE4 */
+    uint64_t swap = (uint64_t)0 - (uint64_t)(q & 1);
+    uint64_t isr  = (uint64_t)vecmath_asint(sr);
+    uint64_t icr  = (uint64_t)vecmath_asint(cr);
+    uint64_t isv  = ( icr & swap ) | ( isr & ~swap );
+    uint64_t icv  = ( isr & swap ) | ( icr & ~swap );
+    *s = vecmath_asreal( (int64_t)( isv ^ ( (uint64_t)(q & 2) << 62 ) ) );
+    *c = vecmath_asreal(
+        (int64_t)( icv ^ ( (uint64_t)( (q + 1) & 2 ) << 62 ) ) );
+}
+
+/**
+ * @brief Sine function
+ */
+#pragma omp declare simd
+static inline real vecmath_sin(real x) {
+    real s, c;
+    vecmath_sincos(x, &s, &c);
+    return s;
+}
+
+/**
+ * @brief Cosine function
+ */
+#pragma omp declare simd
+static inline real vecmath_cos(real x) {
+    real s, c;
+    vecmath_sincos(x, &s, &c);
+    return c;
+}
+
+/**
+ * @brief Four-quadrant arctangent of y/x
+ *
+ * The ratio t = min(|x|,|y|)/max(|x|,|y|) is reduced to |t| < tan(pi/8) with
+ * atan(t) = pi/4 + atan((t-1)/(t+1)) and the result is mapped to the correct
+ * octant.
+ */
+#pragma omp declare simd
+static inline real vecmath_atan2(real y, real x) {
+    real ax = fabs(x);
+    real ay = fabs(y);
+    real mx = ax > ay ? ax : ay;
+    real mn = ax > ay ? ay : ax;
+    real t  = mn / ( mx > 0.0 ? mx : 1.0 );
+
+    int  big = t > 0.41421356237309504880;
+    real off = big ? VECMATH_PIO4 : 0.0;
+    t = big ? (t - 1.0) / (t + 1.0) : t;
+
+    real s = t * t;
+    real a = off + ( t + t * s * vecmath_poly(s, vecmath_atan_c,
+                                              VECMATH_ATAN_N) );
+    a = ay > ax ? VECMATH_PIO2 - a : a;
+    a = copysign(1.0, x) < 0 ? VECMATH_PI - a : a;
+    return copysign(a, y);
+}
+
+/**
+ * @brief Error function
+ *
+ * A polynomial in x^2 is used for |x| < 1 and erf(x) = 1 - erfc(x) with
+ * erfc(x) = exp(-x^2) p(u)/x, u linear in 1/x, otherwise. Both branches are
+ * evaluated and the result is selected.
+ */
+#pragma omp declare simd
+static inline real vecmath_erf(real x) {
+    real ax = fabs(x);
+    ax = ax < VECMATH_ERF_XMAX ? ax : VECMATH_ERF_XMAX;
+
+    /* Small argument */
+    real s  = ax * ax;
+    real es = 1.1283791670955125739 * ax
+        * ( 1.0 + s * vecmath_poly(s, vecmath_erf_c, VECMATH_ERF_N) );
+
+    /* Large argument */
+    real w  = 1.0 / ( ax > 1.0 ? ax : 1.0 );
+    real u  = 2.4 * w - 1.4;
+    real g  = vecmath_poly(u, vecmath_erfc_c, VECMATH_ERFC_N) * w;
+    real el = 1.0 - vecmath_exp(-s) * g;
+
+    real e = copysign(ax > 1.0 ? el : es, x);
+    return x != x ? x : e;
+}
+
+#endif
+
+#endif
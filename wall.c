@@ -46,10 +46,12 @@ int wall_init_offload(wall_offload_data* offload_data, real** offload_array,
     switch(offload_data->type) {
 
         case wall_type_2D:
-            err = wall_2d_init_offload(&(offload_data->w2d), offload_array);
+            err = wall_2d_init_offload(&(offload_data->w2d), offload_array,
+                                       int_offload_array);
             offload_data->offload_array_length =
                 offload_data->w2d.offload_array_length;
-            offload_data->int_offload_array_length = 0;
+            offload_data->int_offload_array_length =
+                offload_data->w2d.int_offload_array_length;
             break;
 
         case wall_type_3D:
@@ -90,7 +92,8 @@ void wall_free_offload(wall_offload_data* offload_data, real** offload_array,
                        int** int_offload_array) {
     switch(offload_data->type) {
         case wall_type_2D:
-            wall_2d_free_offload(&(offload_data->w2d), offload_array);
+            wall_2d_free_offload(&(offload_data->w2d), offload_array,
+                                 int_offload_array);
             break;
 
         case wall_type_3D:
@@ -100,6 +103,29 @@ void wall_free_offload(wall_offload_data* offload_data, real** offload_array,
     }
 }
 
+/**
+ * @brief Get the number of wall elements
+ *
+ * Element IDs returned by wall_hit_wall() run from 1 to this number.
+ *
+ * @param offload_data pointer to offload data struct
+ *
+ * @return number of wall elements
+ */
+int wall_get_n_elements(wall_offload_data* offload_data) {
+    int n = 0;
+    switch(offload_data->type) {
+        case wall_type_2D:
+            n = offload_data->w2d.n - 1;
+            break;
+
+        case wall_type_3D:
+            n = offload_data->w3d.n;
+            break;
+    }
+    return n;
+}
+
 /**
  * @brief Initialize wall data struct on target
  *
@@ -118,7 +144,8 @@ int wall_init(wall_data* w, wall_offload_data* offload_data,
     int err = 0;
     switch(offload_data->type) {
         case wall_type_2D:
-            wall_2d_init(&(w->w2d), &(offload_data->w2d), offload_array);
+            wall_2d_init(&(w->w2d), &(offload_data->w2d), offload_array,
+                         int_offload_array);
             break;
 
         case wall_type_3D:
@@ -160,7 +187,8 @@ int wall_hit_wall(real r1, real phi1, real z1, real r2, real phi2, real z2,
     int ret = 0;
     switch(w->type) {
         case wall_type_2D:
-            ret = wall_2d_hit_wall(r1, phi1, z1, r2, phi2, z2, &(w->w2d));
+            ret = wall_2d_hit_wall(r1, phi1, z1, r2, phi2, z2, &(w->w2d),
+                                   w_coll);
             break;
 
         case wall_type_3D:
@@ -169,3 +197,26 @@ int wall_hit_wall(real r1, real phi1, real z1, real r2, real phi2, real z2,
     }
     return ret;
 }
+
+/**
+ * @brief Unit normal of a wall element
+ *
+ * The sign of the normal, i.e. whether it points into the plasma or out of
+ * it, is not specified.
+ *
+ * @param nvec pointer to array where the cartesian normal is stored
+ * @param phi toroidal angle of the point on the element [rad]
+ * @param tile wall element ID as returned by wall_hit_wall()
+ * @param w pointer to data struct on target
+ */
+void wall_normal_vector(real nvec[3], real phi, int tile, wall_data* w) {
+    switch(w->type) {
+        case wall_type_2D:
+            wall_2d_normal_vector(nvec, phi, tile, &(w->w2d));
+            break;
+
+        case wall_type_3D:
+            wall_3d_normal_vector(nvec, tile, &(w->w3d));
+            break;
+    }
+}
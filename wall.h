@@ -61,6 +61,7 @@ int wall_init_offload(wall_offload_data* offload_data, real** offload_array,
                       int** int_offload_array);
 void wall_free_offload(wall_offload_data* offload_data, real** offload_array,
                        int** int_offload_array);
+int wall_get_n_elements(wall_offload_data* offload_data);
 
 #pragma omp declare target
 int wall_init(wall_data* w, wall_offload_data* offload_data,
@@ -68,6 +69,7 @@ int wall_init(wall_data* w, wall_offload_data* offload_data,
 #pragma omp declare simd uniform(w)
 int wall_hit_wall(real r1, real phi1, real z1, real r2, real phi2, real z2,
                   wall_data* w, real* w_coll);
+void wall_normal_vector(real nvec[3], real phi, int tile, wall_data* w);
 #pragma omp end declare target
 
 #endif
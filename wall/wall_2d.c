@@ -18,16 +18,23 @@
  * &(*offload_array)[0] = Wall polygon R coordinates
  * &(*offload_array)[n] = Wall polygon z coordinates
  *
- * Since this data requires no initialization, the only thing this function does
- * is that it prints some values as sanity check.
+ * This function prints some values as sanity check and appends to the offload
+ * array a grid over the polygon's bounding box holding, for each cell lying
+ * entirely inside the wall, a lower bound for the distance from the cell to
+ * the wall. It is used to skip the wall check for steps far from the wall.
+ *
+ * The int offload array is allocated here and it lists for each z row of the
+ * same grid the polygon segments whose z range overlaps the row, so that the
+ * point-in-polygon and segment intersection tests only visit those segments.
  *
  * @param offload_data pointer to offload data struct
  * @param offload_array pointer to pointer to offload array
+ * @param int_offload_array pointer to pointer to int offload array
  *
  * @return zero to indicate success
  */
 int wall_2d_init_offload(wall_2d_offload_data* offload_data,
-                         real** offload_array) {
+                         real** offload_array, int** int_offload_array) {
     // Do no initialization
 
     int n = offload_data->n;
@@ -45,9 +52,117 @@ int wall_2d_init_offload(wall_2d_offload_data* offload_data,
               " R extend = [%2.2f, %2.2f], z extend = [%2.2f, %2.2f]\n",
               n, rmin, rmax, zmin, zmax);
 
+    offload_data->nr   = WALL_2D_NDIST;
+    offload_data->nz   = WALL_2D_NDIST;
+    offload_data->rmin = rmin;
+    offload_data->rmax = rmax;
+    offload_data->zmin = zmin;
+    offload_data->zmax = zmax;
+    int ncell = offload_data->nr * offload_data->nz;
+    offload_data->offload_array_length = 2*n + ncell;
+    *offload_array = (real*) realloc(*offload_array,
+        offload_data->offload_array_length * sizeof(real));
+
+    /* Rows spanned by each segment, first counted and then listed */
+    int nz = offload_data->nz;
+    real* wz = &(*offload_array)[n];
+    real dz = ( zmax - zmin ) / nz;
+    int* nrow = (int*) calloc(nz, sizeof(int));
+    int nlist = 0;
+    for(int i = 0; i < n - 1; i++) {
+        int iz1 = (int) floor( ( fmin(wz[i], wz[i+1]) - zmin ) / dz );
+        int iz2 = (int) floor( ( fmax(wz[i], wz[i+1]) - zmin ) / dz );
+        iz1 = iz1 < nz - 1 ? iz1 : nz - 1;
+        iz2 = iz2 < nz - 1 ? iz2 : nz - 1;
+        for(int iz = iz1 > 0 ? iz1 : 0; iz <= iz2; iz++) {
+            nrow[iz]++;
+            nlist++;
+        }
+    }
+
+    offload_data->int_offload_array_length = 2*nz + nlist;
+    *int_offload_array = (int*) malloc(
+        offload_data->int_offload_array_length * sizeof(int));
+    int* row_array = *int_offload_array;
+    int next = nz;
+    for(int iz = 0; iz < nz; iz++) {
+        row_array[iz]   = next;
+        row_array[next] = 0;
+        next += nrow[iz] + 1;
+    }
+    for(int i = 0; i < n - 1; i++) {
+        int iz1 = (int) floor( ( fmin(wz[i], wz[i+1]) - zmin ) / dz );
+        int iz2 = (int) floor( ( fmax(wz[i], wz[i+1]) - zmin ) / dz );
+        iz1 = iz1 < nz - 1 ? iz1 : nz - 1;
+        iz2 = iz2 < nz - 1 ? iz2 : nz - 1;
+        for(int iz = iz1 > 0 ? iz1 : 0; iz <= iz2; iz++) {
+            int* list = &row_array[row_array[iz]];
+            list[0]++;
+            list[list[0]] = i;
+        }
+    }
+    free(nrow);
+
+    wall_2d_data w;
+    wall_2d_init(&w, offload_data, *offload_array, *int_offload_array);
+    real dr = ( rmax - rmin ) / w.nr;
+    real halfdiag = 0.5 * sqrt( dr * dr + dz * dz );
+
+    #pragma omp parallel for
+    for(int i = 0; i < ncell; i++) {
+        real r = rmin + ( i / w.nz + 0.5 ) * dr;
+        real z = zmin + ( i % w.nz + 0.5 ) * dz;
+        w.dist[i] = 0.0;
+        if(wall_2d_inside(r, z, &w)) {
+            w.dist[i] = fmax( wall_2d_distance(r, z, &w) - halfdiag, 0.0 );
+        }
+    }
+
     return 0;
 }
 
+/**
+ * @brief Distance from a point to the boundary of the region inside the wall
+ *
+ * The region is the one where wall_2d_inside() is true. Its boundary consists
+ * of the polygon segments and, if the first and last points do not coincide,
+ * of the half-lines extending from them in the negative R direction, across
+ * which the number of crossings counted by wall_2d_inside() also changes.
+ *
+ * @param r R coordinate [m]
+ * @param z z coordinate [m]
+ * @param w 2D wall data structure
+ *
+ * @return distance [m]
+ */
+real wall_2d_distance(real r, real z, wall_2d_data* w) {
+    real d2 = INFINITY;
+    for(int i = 0; i < w->n - 1; i++) {
+        real er = w->wall_r[i+1] - w->wall_r[i];
+        real ez = w->wall_z[i+1] - w->wall_z[i];
+        real pr = r - w->wall_r[i];
+        real pz = z - w->wall_z[i];
+        real l2 = er * er + ez * ez;
+        real t  = l2 > 0 ? ( pr * er + pz * ez ) / l2 : 0;
+        t = fmin( fmax(t, 0.0), 1.0 );
+        real dr = pr - t * er;
+        real dz = pz - t * ez;
+        d2 = fmin( d2, dr * dr + dz * dz );
+    }
+
+    int last = w->n - 1;
+    if(w->wall_r[0] != w->wall_r[last] || w->wall_z[0] != w->wall_z[last]) {
+        int ends[2] = {0, last};
+        for(int j = 0; j < 2; j++) {
+            real dr = fmax( r - w->wall_r[ends[j]], 0.0 );
+            real dz = z - w->wall_z[ends[j]];
+            d2 = fmin( d2, dr * dr + dz * dz );
+        }
+    }
+
+    return sqrt(d2);
+}
+
 /**
  * @brief Free offload array and reset parameters
  *
@@ -57,12 +172,15 @@ int wall_2d_init_offload(wall_2d_offload_data* offload_data,
  *
  * @param offload_data pointer to offload data struct
  * @param offload_array pointer to pointer to offload array
+ * @param int_offload_array pointer to pointer to int offload array
  */
 
 void wall_2d_free_offload(wall_2d_offload_data* offload_data,
-                          real** offload_array) {
+                          real** offload_array, int** int_offload_array) {
     free(*offload_array);
+    free(*int_offload_array);
     *offload_array = NULL;
+    *int_offload_array = NULL;
 }
 
 /**
@@ -74,12 +192,21 @@ void wall_2d_free_offload(wall_2d_offload_data* offload_data,
  * @param w pointer to data struct on target
  * @param offload_data pointer to offload data struct
  * @param offload_array the offload array
+ * @param int_offload_array the int offload array
  */
 void wall_2d_init(wall_2d_data* w, wall_2d_offload_data* offload_data,
-                  real* offload_array) {
+                  real* offload_array, int* int_offload_array) {
     w->n = offload_data->n;
     w->wall_r = &offload_array[0];
     w->wall_z = &offload_array[offload_data->n];
+    w->nr     = offload_data->nr;
+    w->nz     = offload_data->nz;
+    w->rmin   = offload_data->rmin;
+    w->rmax   = offload_data->rmax;
+    w->zmin   = offload_data->zmin;
+    w->zmax   = offload_data->zmax;
+    w->dist   = &offload_array[2*offload_data->n];
+    w->row_array = int_offload_array;
 }
 
 /**
@@ -89,6 +216,8 @@ void wall_2d_init(wall_2d_data* w, wall_2d_offload_data* offload_data,
  * by a 2D polygon using a modified axis crossing method [1]. Origin is moved
  * to the coordinates and the number of wall segments crossing the positive
  * r-axis are calculated. If this is odd, the point is inside the polygon.
+ * Only the segments overlapping the z row of the point are visited, since
+ * other segments cannot cross the axis.
  *
  * [1] D.G. Alciatore, R. Miranda. A Winding Number and Point-in-Polygon
  *     Algorithm. Technical report, Colorado State University, 1995.
@@ -101,8 +230,16 @@ void wall_2d_init(wall_2d_data* w, wall_2d_offload_data* offload_data,
 int wall_2d_inside(real r, real z, wall_2d_data* w) {
     int hits = 0;
 
-    int i;
-    for(i = 0; i < w->n - 1; i++) {
+    if(z < w->zmin || z > w->zmax) {
+        return 0;
+    }
+    int iz = (int) floor( ( z - w->zmin ) / ( ( w->zmax - w->zmin ) / w->nz ) );
+    iz = iz > 0 ? iz : 0;
+    iz = iz < w->nz - 1 ? iz : w->nz - 1;
+    int* list = &w->row_array[w->row_array[iz]];
+
+    for(int j = 1; j <= list[0]; j++) {
+        int i = list[j];
         real wz1 = w->wall_z[i] - z;
         real wz2 = w->wall_z[i+1] - z;
         real wr1 = w->wall_r[i] - r;
@@ -121,6 +258,16 @@ int wall_2d_inside(real r, real z, wall_2d_data* w) {
  * @brief Check if trajectory from (r1, phi1, z1) to (r2, phi2, z2) intersects
  *        the wall
  *
+ * The trajectory is intersected with the polygon segments overlapping the z
+ * rows it spans. The segment hit first is returned as the wall element ID,
+ * which is the index of the segment's first point plus one, and the
+ * parametric position of the intersection along the trajectory is stored in
+ * w_coll.
+ *
+ * If no intersection is found but the end point is outside the wall, e.g.
+ * because the marker started outside it, the segment closest to the start
+ * point is returned with w_coll = 0.
+ *
  * @param r1 start point R coordinate [m]
  * @param phi1 start point phi coordinate [rad]
  * @param z1 start point z coordinate [rad]
@@ -128,15 +275,98 @@ int wall_2d_inside(real r, real z, wall_2d_data* w) {
  * @param phi2 end point phi coordinate [rad]
  * @param z2 end point z coordinate [rad]
  * @param w pointer to data struct on target
+ * @param w_coll pointer for storing the parametric collision point
  *
  * @return wall element ID if hit, zero otherwise
- *
- * @todo Right now this returns only a boolean wall for hit but not the wall ID
  */
 int wall_2d_hit_wall(real r1, real phi1, real z1, real r2, real phi2, real z2,
-                     wall_2d_data* w) {
-    if(!wall_2d_inside(r2, z2, w))
-        return 1;
-    else
-        return 0;
+                     wall_2d_data* w, real* w_coll) {
+    /* The end point is inside the wall if the step is shorter than the
+     * distance from the start point to the wall */
+    int ir = (int) floor( ( r1 - w->rmin ) / ( w->rmax - w->rmin ) * w->nr );
+    int iz = (int) floor( ( z1 - w->zmin ) / ( w->zmax - w->zmin ) * w->nz );
+    if(ir >= 0 && ir < w->nr && iz >= 0 && iz < w->nz) {
+        real dist = w->dist[ir*w->nz + iz];
+        if( (r2 - r1) * (r2 - r1) + (z2 - z1) * (z2 - z1) < dist * dist ) {
+            return 0;
+        }
+    }
+
+    real dr = r2 - r1;
+    real dz = z2 - z1;
+    real rowdz = ( w->zmax - w->zmin ) / w->nz;
+    int iz1 = (int) floor( ( fmin(z1, z2) - w->zmin ) / rowdz );
+    int iz2 = (int) floor( ( fmax(z1, z2) - w->zmin ) / rowdz );
+    iz1 = iz1 > 0 ? iz1 : 0;
+    iz2 = iz2 < w->nz - 1 ? iz2 : w->nz - 1;
+
+    int hit = 0;
+    real smallest_t = 2.0;
+    for(int iz = iz1; iz <= iz2; iz++) {
+        int* list = &w->row_array[w->row_array[iz]];
+        for(int j = 1; j <= list[0]; j++) {
+            int i = list[j];
+            real er = w->wall_r[i+1] - w->wall_r[i];
+            real ez = w->wall_z[i+1] - w->wall_z[i];
+            real ar = w->wall_r[i] - r1;
+            real az = w->wall_z[i] - z1;
+            real det = dr * ez - dz * er;
+            if(det == 0) {
+                continue;
+            }
+            real t = ( ar * ez - az * er ) / det;
+            real s = ( ar * dz - az * dr ) / det;
+            if(t >= 0 && t <= 1 && s >= 0 && s <= 1 && t < smallest_t) {
+                smallest_t = t;
+                hit = i + 1;
+            }
+        }
+    }
+
+    if(hit > 0) {
+        *w_coll = smallest_t;
+        return hit;
+    }
+
+    if(!wall_2d_inside(r2, z2, w)) {
+        real d2min = INFINITY;
+        for(int i = 0; i < w->n - 1; i++) {
+            real er = w->wall_r[i+1] - w->wall_r[i];
+            real ez = w->wall_z[i+1] - w->wall_z[i];
+            real pr = r1 - w->wall_r[i];
+            real pz = z1 - w->wall_z[i];
+            real l2 = er * er + ez * ez;
+            real t  = l2 > 0 ? ( pr * er + pz * ez ) / l2 : 0;
+            t = fmin( fmax(t, 0.0), 1.0 );
+            real d2 = ( pr - t * er ) * ( pr - t * er )
+                    + ( pz - t * ez ) * ( pz - t * ez );
+            if(d2 < d2min) {
+                d2min = d2;
+                hit = i + 1;
+            }
+        }
+        *w_coll = 0;
+    }
+
+    return hit;
+}
+
+/**
+ * @brief Unit normal of a wall segment
+ *
+ * The normal of the axisymmetric surface swept by the segment lies in the
+ * poloidal plane, so its cartesian components depend on the toroidal angle.
+ *
+ * @param nvec pointer to array where the cartesian normal is stored
+ * @param phi toroidal angle of the point on the surface [rad]
+ * @param tile wall element ID as returned by wall_2d_hit_wall()
+ * @param w pointer to data struct on target
+ */
+void wall_2d_normal_vector(real nvec[3], real phi, int tile, wall_2d_data* w) {
+    real er = w->wall_r[tile] - w->wall_r[tile-1];
+    real ez = w->wall_z[tile] - w->wall_z[tile-1];
+    real l  = sqrt( er * er + ez * ez );
+    nvec[0] =  ez * cos(phi) / l;
+    nvec[1] =  ez * sin(phi) / l;
+    nvec[2] = -er / l;
 }
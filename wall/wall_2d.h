@@ -6,12 +6,22 @@
 #define WALL_2D_H
 #include "../ascot5.h"
 
+/** Number of cells in R and z in the distance-to-wall grid */
+#define WALL_2D_NDIST 128
+
 /**
  * @brief 2D wall offload data
  */
 typedef struct {
     int n;                    /**< Number of points in the wall polygon */
     int offload_array_length; /**< Length of the offload array          */
+    int int_offload_array_length; /**< Length of the int offload array  */
+    int nr;                   /**< Number of R cells in distance grid   */
+    int nz;                   /**< Number of z cells in distance grid   */
+    real rmin;                /**< Minimum R of distance grid [m]       */
+    real rmax;                /**< Maximum R of distance grid [m]       */
+    real zmin;                /**< Minimum z of distance grid [m]       */
+    real zmax;                /**< Maximum z of distance grid [m]       */
 } wall_2d_offload_data;
 
 /**
@@ -23,21 +33,36 @@ typedef struct {
     int n;          /**< Number of points in the wall polygon           */
     real* wall_r;   /**< R coordinates for the wall polygon points      */
     real* wall_z;   /**< z coordinates for the wall polygon points      */
+    int nr;         /**< Number of R cells in distance grid             */
+    int nz;         /**< Number of z cells in distance grid             */
+    real rmin;      /**< Minimum R of distance grid [m]                 */
+    real rmax;      /**< Maximum R of distance grid [m]                 */
+    real zmin;      /**< Minimum z of distance grid [m]                 */
+    real zmax;      /**< Maximum z of distance grid [m]                 */
+    real* dist;     /**< Lower bound for the distance from each grid cell
+                         to the wall, zero for cells not entirely inside
+                         the wall [m]                                   */
+    int* row_array; /**< Segments overlapping each z row of the grid;
+                         row_array[iz] is the index of a list whose first
+                         element is the number of segments followed by
+                         their indices                                  */
 } wall_2d_data;
 
 int wall_2d_init_offload(wall_2d_offload_data* offload_data,
-                         real** offload_array);
+                         real** offload_array, int** int_offload_array);
 void wall_2d_free_offload(wall_2d_offload_data* offload_data,
-                          real** offload_array);
+                          real** offload_array, int** int_offload_array);
 
 #pragma omp declare target
 void wall_2d_init(wall_2d_data* w, wall_2d_offload_data* offload_data,
-                  real* offload_array);
+                  real* offload_array, int* int_offload_array);
 #pragma omp declare simd uniform(w)
 int wall_2d_inside(real r, real z, wall_2d_data* w);
+real wall_2d_distance(real r, real z, wall_2d_data* w);
 #pragma omp declare simd uniform(w)
 int wall_2d_hit_wall(real r1, real phi1, real z1, real r2, real phi2, real z2,
-                     wall_2d_data* w);
+                     wall_2d_data* w, real* w_coll);
+void wall_2d_normal_vector(real nvec[3], real phi, int tile, wall_2d_data* w);
 #pragma omp end declare target
 
 #endif
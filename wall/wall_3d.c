@@ -7,16 +7,16 @@
  * plane. During initialization, the computational model is divided into
  * smaller cell using octree, and wall triangles are divided according to
  * which cell(s) they inhabit. Collision checks are only made with respect to
- * triangles that are in the same cell as the marker.
+ * triangles that are in the cells the marker step passes through.
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <float.h>
+#include <omp.h>
 #include "../ascot5.h"
 #include "wall_3d.h"
 #include "../math.h"
-#include "../list.h"
-#include "../octree.h"
 #include "../print.h"
 
 /**
@@ -45,17 +45,41 @@
 int wall_3d_init_offload(wall_3d_offload_data* offload_data,
                          real** offload_array, int** int_offload_array) {
 
+    wall_3d_init_grid(offload_data, *offload_array);
+    if( wall_3d_init_octree(offload_data, *offload_array, int_offload_array) ) {
+        return 1;
+    }
+    wall_3d_init_soa(offload_data, offload_array, *int_offload_array);
+    wall_3d_init_dist(offload_data, offload_array, *int_offload_array);
+
+    return 0;
+}
+
+/**
+ * @brief Set the extent and resolution of the octree grid
+ *
+ * The grid covers the volume occupied by the wall triangles with a small
+ * padding. This fills all fields of the offload struct except the octree
+ * array length, so that a precomputed octree array can be used instead of
+ * calling wall_3d_init_octree().
+ *
+ * @param offload_data pointer to offload data struct
+ * @param offload_array offload array containing the triangles
+ */
+void wall_3d_init_grid(wall_3d_offload_data* offload_data,
+                       real* offload_array) {
+
     /* Find min & max values of the volume occupied by the wall triangles. */
-    real xmin = (*offload_array)[0], xmax = (*offload_array)[0];
-    real ymin = (*offload_array)[1], ymax = (*offload_array)[1];
-    real zmin = (*offload_array)[2], zmax = (*offload_array)[2];
+    real xmin = offload_array[0], xmax = offload_array[0];
+    real ymin = offload_array[1], ymax = offload_array[1];
+    real zmin = offload_array[2], zmax = offload_array[2];
     for(int i=0; i<offload_data->n*3; i++) {
-        xmin = fmin( xmin, (*offload_array)[i*3 + 0] );
-        xmax = fmax( xmax, (*offload_array)[i*3 + 0] );
-        ymin = fmin( ymin, (*offload_array)[i*3 + 1] );
-        ymax = fmax( ymax, (*offload_array)[i*3 + 1] );
-        zmin = fmin( zmin, (*offload_array)[i*3 + 2] );
-        zmax = fmax( zmax, (*offload_array)[i*3 + 2] );
+        xmin = fmin( xmin, offload_array[i*3 + 0] );
+        xmax = fmax( xmax, offload_array[i*3 + 0] );
+        ymin = fmin( ymin, offload_array[i*3 + 1] );
+        ymax = fmax( ymax, offload_array[i*3 + 1] );
+        zmin = fmin( zmin, offload_array[i*3 + 2] );
+        zmax = fmax( zmax, offload_array[i*3 + 2] );
     }
 
     /* Add a little bit of padding so we don't need to worry about triangles
@@ -91,10 +115,6 @@ int wall_3d_init_offload(wall_3d_offload_data* offload_data,
               offload_data->n,
               offload_data->xmin, offload_data->xmax, offload_data->ymin,
               offload_data->ymax, offload_data->zmin, offload_data->zmax);
-
-    wall_3d_init_octree(offload_data, *offload_array, int_offload_array);
-
-    return 0;
 }
 
 /**
@@ -144,178 +164,467 @@ void wall_3d_init(wall_3d_data* w, wall_3d_offload_data* offload_data,
     w->depth = offload_data->depth;
     w->ngrid = offload_data->ngrid;
     w->wall_tris = &offload_array[0];
+    w->tri_soa = &offload_array[9*w->n];
+    w->dist = &offload_array[9*w->n + 9*(offload_data->int_offload_array_length
+                                         - 2*w->ngrid*w->ngrid*w->ngrid)];
 
     w->tree_array_size = offload_data->int_offload_array_length;
     w->tree_array = &int_offload_array[0];
 }
 
 /**
- * @brief Construct wall octree iteratively
+ * @brief Sort wall triangles into grid cells
  *
- * Constructs the octree array by iterating through all wall triangles and
- * octree grid to identify triangles belonging to each grid cell.
+ * Each triangle is tested only against the cells that overlap its bounding
+ * box. The triangles are divided between threads in contiguous blocks and
+ * each thread stores the (cell, triangle) pairs it finds in a private list.
+ * The lists are then merged in thread order so that the triangles in each
+ * cell are in ascending order regardless of the number of threads.
  *
- * Slow, only for testing purposes.
+ * The resulting array has ncell = ngrid^3 offsets followed by the cell
+ * lists, each consisting of the number of triangles and their indices.
  *
- * @param w pointer to wall data
- * @param offload_array offload array
+ * The team may have fewer threads than requested, in which case the lists of
+ * the missing threads are left empty.
+ *
+ * @param n number of triangles
+ * @param tris triangle vertex coordinates [x1 y1 z1 x2 y2 z2 x3 y3 z3; ...]
+ * @param ngrid number of cells in each direction
+ * @param bmin minimum x, y, and z of the grid [m]
+ * @param width cell width in x, y, and z [m]
+ * @param tree_array pointer to the array that is allocated here
+ *
+ * @return length of the allocated array or -1 if allocation failed
  */
-void wall_3d_init_tree(wall_3d_data* w, real* offload_array) {
-    /* create a list for holding the triangle ids in each cell */
-    int ncell = w->ngrid*w->ngrid*w->ngrid;
-    list_int_node** tri_list = (list_int_node**) malloc(ncell
-                                                    *sizeof(list_int_node*));
-    int i;
-    for(i = 0; i < ncell; i++) {
-        list_int_create(&tri_list[i]);
+static int wall_3d_build_grid(int n, real* tris, int ngrid, real bmin[3],
+                              real width[3], int** tree_array) {
+    real epsilon = 1e-6;
+    int ncell = ngrid*ngrid*ngrid;
+
+    *tree_array = NULL;
+    int nthreads = omp_get_max_threads();
+    int** pairs = (int**) calloc(nthreads, sizeof(int*));
+    int* npairs = (int*) calloc(nthreads, sizeof(int));
+    if(pairs == NULL || npairs == NULL) {
+        free(pairs);
+        free(npairs);
+        return -1;
     }
 
-    /* iterate through all triangles and cells and fill the lists */
-    for(i = 0; i < w->n; i++) {
-        real t1[3], t2[3], t3[3];
-        t1[0] = offload_array[i*9];
-        t1[1] = offload_array[i*9+1];
-        t1[2] = offload_array[i*9+2];
-        t2[0] = offload_array[i*9+3];
-        t2[1] = offload_array[i*9+4];
-        t2[2] = offload_array[i*9+5];
-        t3[0] = offload_array[i*9+6];
-        t3[1] = offload_array[i*9+7];
-        t3[2] = offload_array[i*9+8];
-
-        int ix, iy, iz;
-        #pragma omp parallel for private(ix, iy, iz)
-        for(ix = 0; ix < w->ngrid; ix++) {
-            for(iy = 0; iy < w->ngrid; iy++) {
-                for(iz = 0; iz < w->ngrid; iz++) {
-                    real c1[3], c2[3];
-                    real epsilon = 1e-6;
-                    c1[0] = w->xmin + ix * w->xgrid - epsilon;
-                    c2[0] = w->xmin + (ix+1) * w->xgrid + epsilon;
-                    c1[1] = w->ymin + iy * w->ygrid - epsilon;
-                    c2[1] = w->ymin + (iy+1) * w->ygrid + epsilon;
-                    c1[2] = w->zmin + iz * w->zgrid - epsilon;
-                    c2[2] = w->zmin + (iz+1) * w->zgrid + epsilon;
-                    int result = wall_3d_tri_in_cube(t1, t2, t3, c1, c2);
-                    int cell_index = ix*w->ngrid*w->ngrid+iy*w->ngrid+iz;
-                    if(result > 0) {
-                        list_int_add(tri_list[cell_index], i);
+    int failed = 0;
+    #pragma omp parallel num_threads(nthreads)
+    {
+        int ithread = omp_get_thread_num();
+        int maxpairs = 1024;
+        int* mypairs = (int*) malloc(2*maxpairs*sizeof(int));
+        int nmypairs = 0;
+        if(mypairs == NULL) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for schedule(static)
+        for(int i = 0; i < n; i++) {
+            int skip;
+            #pragma omp atomic read
+            skip = failed;
+            if(skip) {
+                continue;
+            }
+
+            real* t1 = &tris[i*9];
+            real* t2 = &tris[i*9+3];
+            real* t3 = &tris[i*9+6];
+
+            /* Range of cells overlapping the triangle bounding box */
+            int imin[3], imax[3];
+            for(int k = 0; k < 3; k++) {
+                real tmin = fmin(t1[k], fmin(t2[k], t3[k]));
+                real tmax = fmax(t1[k], fmax(t2[k], t3[k]));
+                imin[k] = (int) floor( (tmin - epsilon - bmin[k]) / width[k] );
+                imax[k] = (int) floor( (tmax + epsilon - bmin[k]) / width[k] );
+                imin[k] = imin[k] < 0 ? 0 : imin[k];
+                imax[k] = imax[k] > ngrid - 1 ? ngrid - 1 : imax[k];
+            }
+
+            for(int ix = imin[0]; ix <= imax[0]; ix++) {
+                for(int iy = imin[1]; iy <= imax[1]; iy++) {
+                    for(int iz = imin[2]; iz <= imax[2]; iz++) {
+                        real c1[3], c2[3];
+                        c1[0] = bmin[0] + ix * width[0] - epsilon;
+                        c2[0] = bmin[0] + (ix+1) * width[0] + epsilon;
+                        c1[1] = bmin[1] + iy * width[1] - epsilon;
+                        c2[1] = bmin[1] + (iy+1) * width[1] + epsilon;
+                        c1[2] = bmin[2] + iz * width[2] - epsilon;
+                        c2[2] = bmin[2] + (iz+1) * width[2] + epsilon;
+                        if(skip
+                           || wall_3d_tri_in_cube(t1, t2, t3, c1, c2) <= 0) {
+                            continue;
+                        }
+                        if(nmypairs == maxpairs) {
+                            int* newpairs = (int*) realloc(
+                                mypairs, 4*maxpairs*sizeof(int));
+                            if(newpairs == NULL) {
+                                #pragma omp atomic write
+                                failed = 1;
+                                skip = 1;
+                                continue;
+                            }
+                            mypairs = newpairs;
+                            maxpairs *= 2;
+                        }
+                        mypairs[2*nmypairs]   = ix*ngrid*ngrid + iy*ngrid + iz;
+                        mypairs[2*nmypairs+1] = i;
+                        nmypairs++;
                     }
                 }
             }
         }
+        pairs[ithread]  = mypairs;
+        npairs[ithread] = nmypairs;
     }
 
-    /* construct an array from the triangle lists */
-    int list_size = 0;
-    for(i = 0; i < ncell; i++) {
-        list_size += list_int_size(tri_list[i]);
+    /* Count the triangles in each cell and place the lists */
+    int length = -1;
+    int* next = failed ? NULL : (int*) calloc(ncell, sizeof(int));
+    if(next != NULL) {
+        int list_size = 0;
+        for(int t = 0; t < nthreads; t++) {
+            for(int j = 0; j < npairs[t]; j++) {
+                next[pairs[t][2*j]]++;
+            }
+            list_size += npairs[t];
+        }
+        length = 2*ncell + list_size;
+        *tree_array = (int*) malloc(length*sizeof(int));
     }
 
-    w->tree_array_size = 2*ncell + list_size;
-    w->tree_array = (int*) malloc((w->tree_array_size)*sizeof(int));
+    if(*tree_array != NULL) {
+        int next_empty_list = ncell;
+        for(int i = 0; i < ncell; i++) {
+            (*tree_array)[i] = next_empty_list;
+            (*tree_array)[next_empty_list] = next[i];
+            next[i] = next_empty_list + 1;
+            next_empty_list += (*tree_array)[next_empty_list] + 1;
+        }
 
-    int next_empty_list = ncell;
-    for(i = 0; i < ncell; i++) {
-        w->tree_array[i] = next_empty_list;
-        w->tree_array[next_empty_list] = list_int_size(tri_list[i]);
-        int j;
-        for(j = 0; j < w->tree_array[next_empty_list]; j++) {
-            w->tree_array[next_empty_list+j+1] = list_int_get(tri_list[i], j);
+        for(int t = 0; t < nthreads; t++) {
+            for(int j = 0; j < npairs[t]; j++) {
+                (*tree_array)[next[pairs[t][2*j]]++] = pairs[t][2*j+1];
+            }
+        }
+    }
+    else {
+        length = -1;
+    }
+
+    for(int t = 0; t < nthreads; t++) {
+        free(pairs[t]);
+    }
+    free(next);
+    free(npairs);
+    free(pairs);
+
+    return length;
+}
+
+/**
+ * @brief Copy the triangles in the cell lists to a structure of arrays
+ *
+ * For each entry in the cell lists, the first vertex and the two edges
+ * starting from it are stored in nine arrays of length nlist, in the same
+ * order as the entries appear in the tree array. This lets the triangles of
+ * a cell be read with unit stride. Edges of triangles with zero area are set
+ * to NaN so that they are never hit.
+ *
+ * @param tris triangle vertex coordinates [x1 y1 z1 x2 y2 z2 x3 y3 z3; ...]
+ * @param ncell number of grid cells
+ * @param tree_array octree array
+ * @param nlist total number of entries in the cell lists
+ * @param soa array of length 9*nlist where the data is stored
+ */
+static void wall_3d_fill_soa(real* tris, int ncell, int* tree_array,
+                             int nlist, real* soa) {
+    #pragma omp parallel for
+    for(int icell = 0; icell < ncell; icell++) {
+        int ilist = tree_array[icell];
+        int first = ilist - ncell - icell;
+        for(int l = 0; l < tree_array[ilist]; l++) {
+            real* t = &tris[9*tree_array[ilist+l+1]];
+            real edge12[3], edge13[3], normal[3];
+            for(int k = 0; k < 3; k++) {
+                edge12[k] = t[3+k] - t[k];
+                edge13[k] = t[6+k] - t[k];
+            }
+            math_cross(edge12, edge13, normal);
+            if( !(math_norm(normal) > WALL_EPSILON) ) {
+                for(int k = 0; k < 3; k++) {
+                    edge12[k] = NAN;
+                }
+            }
+            int j = first + l;
+            for(int k = 0; k < 3; k++) {
+                soa[(0+k)*nlist + j] = t[k];
+                soa[(3+k)*nlist + j] = edge12[k];
+                soa[(6+k)*nlist + j] = edge13[k];
+            }
         }
-        next_empty_list += w->tree_array[next_empty_list] + 1;
-        list_int_free(&tri_list[i]);
     }
-    free(tri_list);
 }
 
 /**
- * @brief Construct wall octree recursively
+ * @brief Construct wall octree iteratively
  *
- * Constructs the octree array by iterating through all wall triangles and
- * placing them into an octree structure
+ * Constructs the octree array for wall data already on target.
+ *
+ * @param w pointer to wall data
+ * @param offload_array offload array
+ *
+ * @return zero if the octree was constructed
+ */
+int wall_3d_init_tree(wall_3d_data* w, real* offload_array) {
+    real bmin[3]  = {w->xmin,  w->ymin,  w->zmin};
+    real width[3] = {w->xgrid, w->ygrid, w->zgrid};
+    w->tree_array_size = wall_3d_build_grid(w->n, offload_array, w->ngrid,
+                                            bmin, width, &w->tree_array);
+    if(w->tree_array_size < 0) {
+        return 1;
+    }
+
+    int ncell = w->ngrid*w->ngrid*w->ngrid;
+    int nlist = w->tree_array_size - 2*ncell;
+    w->wall_tris = offload_array;
+    w->tri_soa = (real*) malloc(9*nlist*sizeof(real));
+    wall_3d_fill_soa(offload_array, ncell, w->tree_array, nlist, w->tri_soa);
+    w->dist = (real*) calloc(ncell, sizeof(real));
+    return 0;
+}
+
+/**
+ * @brief Construct wall octree
+ *
+ * Constructs the octree array by sorting the wall triangles into the grid
+ * cells they overlap.
  *
  * @param w pointer to wall data
  * @param offload_array the offload array
+ * @param tree_array pointer to the octree array that is allocated here
+ *
+ * @return zero if the octree was constructed
  */
-void wall_3d_init_octree(wall_3d_offload_data* w, real* offload_array,
+int wall_3d_init_octree(wall_3d_offload_data* w, real* offload_array,
                          int** tree_array) {
 
-
     if (w->n > 1000000){
         print_out(VERBOSE_NORMAL, "Starting to initialize 3D-wall octree with %d triangles.\n", w->n);
     }
 
-    /* construct the octree and store triangles there */
-    octree_node* tree;
-    octree_create(&tree, w->xmin, w->xmax, w->ymin, w->ymax, w->zmin, w->zmax,
-                  w->depth);
-    int i;
-    for(i = 0; i < w->n; i++) {
-        real t1[3], t2[3], t3[3];
-        t1[0] = offload_array[i*9];
-        t1[1] = offload_array[i*9+1];
-        t1[2] = offload_array[i*9+2];
-        t2[0] = offload_array[i*9+3];
-        t2[1] = offload_array[i*9+4];
-        t2[2] = offload_array[i*9+5];
-        t3[0] = offload_array[i*9+6];
-        t3[1] = offload_array[i*9+7];
-        t3[2] = offload_array[i*9+8];
-        octree_add(tree, t1, t2, t3, i);
-        if (i%1000000==0 && i > 0){
-            print_out(VERBOSE_NORMAL, "  Adding triangle %10d/%d.\n",i,w->n);
-        }
+    real bmin[3]  = {w->xmin,  w->ymin,  w->zmin};
+    real width[3] = {w->xgrid, w->ygrid, w->zgrid};
+    w->int_offload_array_length = wall_3d_build_grid(w->n, offload_array,
+                                                     w->ngrid, bmin, width,
+                                                     tree_array);
+    if(w->int_offload_array_length < 0) {
+        print_err("Error: Failed to allocate the 3D wall octree.\n");
+        return 1;
     }
+    return 0;
+}
 
-    /* create lists for triangles in each grid square and fill the lists
-       by querying the octree in each grid point */
+/**
+ * @brief Append the structure-of-arrays triangle data to the offload array
+ *
+ * The offload array holding the triangles is extended with the data
+ * produced by wall_3d_fill_soa(), and its length in the offload struct is
+ * updated accordingly. To be called once the octree array is available.
+ *
+ * @param w pointer to offload data
+ * @param offload_array pointer to the offload array
+ * @param tree_array octree array
+ */
+void wall_3d_init_soa(wall_3d_offload_data* w, real** offload_array,
+                      int* tree_array) {
     int ncell = w->ngrid*w->ngrid*w->ngrid;
-    list_int_node** tri_list = (list_int_node**) malloc(ncell
-                                                    *sizeof(list_int_node*));
-    int ix, iy, iz;
-    for(ix = 0; ix < w->ngrid; ix++) {
-        for(iy = 0; iy < w->ngrid; iy++) {
-            for(iz = 0; iz < w->ngrid; iz++) {
-                real p[3];
-                p[0] = w->xmin + ix * w->xgrid + 0.5*w->xgrid;
-                p[1] = w->ymin + iy * w->ygrid + 0.5*w->ygrid;
-                p[2] = w->zmin + iz * w->zgrid + 0.5*w->zgrid;
-
-                int cell_index = ix*w->ngrid*w->ngrid+iy*w->ngrid+iz;
-                tri_list[cell_index] = octree_get(tree, p);
+    int nlist = w->int_offload_array_length - 2*ncell;
+
+    w->offload_array_length = 9*w->n + 9*nlist;
+    *offload_array = (real*) realloc(*offload_array,
+                                     w->offload_array_length*sizeof(real));
+    wall_3d_fill_soa(*offload_array, ncell, tree_array, nlist,
+                     &(*offload_array)[9*w->n]);
+}
+
+/**
+ * @brief Append a distance-to-wall lower bound for each grid cell
+ *
+ * The chessboard distance k from each cell to the nearest cell containing
+ * triangles is found with a two-pass distance transform over the grid. Since
+ * all triangles lie within their cells, no point in the cell is closer to
+ * the wall than (k - 1) times the smallest cell width, which is stored in
+ * the offload array after the structure-of-arrays data. The value is zero
+ * for cells that contain triangles and their neighbours.
+ *
+ * To be called after wall_3d_init_soa().
+ *
+ * @param w pointer to offload data
+ * @param offload_array pointer to the offload array
+ * @param tree_array octree array
+ */
+void wall_3d_init_dist(wall_3d_offload_data* w, real** offload_array,
+                       int* tree_array) {
+    int ngrid = w->ngrid;
+    int ncell = ngrid*ngrid*ngrid;
+    int* k = (int*) malloc(ncell*sizeof(int));
+    for(int i = 0; i < ncell; i++) {
+        k[i] = tree_array[tree_array[i]] > 0 ? 0 : 3*ngrid;
+    }
+
+    /* Forward pass takes the minimum over the neighbours preceding the cell
+     * in memory order and the backward pass over those following it */
+    for(int pass = 0; pass < 2; pass++) {
+        int sgn = pass == 0 ? 1 : -1;
+        for(int c = 0; c < ncell; c++) {
+            int icell = pass == 0 ? c : ncell - 1 - c;
+            int ix = icell / (ngrid*ngrid);
+            int iy = ( icell / ngrid ) % ngrid;
+            int iz = icell % ngrid;
+            for(int dx = -1; dx <= 1; dx++) {
+                for(int dy = -1; dy <= 1; dy++) {
+                    for(int dz = -1; dz <= 1; dz++) {
+                        int d = dx*ngrid*ngrid + dy*ngrid + dz;
+                        if(sgn*d >= 0 || ix+dx < 0 || ix+dx >= ngrid
+                           || iy+dy < 0 || iy+dy >= ngrid
+                           || iz+dz < 0 || iz+dz >= ngrid) {
+                            continue;
+                        }
+                        if(k[icell+d] + 1 < k[icell]) {
+                            k[icell] = k[icell+d] + 1;
+                        }
+                    }
+                }
             }
         }
     }
 
+    real width = fmin(w->xgrid, fmin(w->ygrid, w->zgrid));
+    int offset = w->offload_array_length;
+    w->offload_array_length += ncell;
+    *offload_array = (real*) realloc(*offload_array,
+                                     w->offload_array_length*sizeof(real));
+    for(int i = 0; i < ncell; i++) {
+        (*offload_array)[offset+i] = k[i] > 1 ? (k[i] - 1) * width : 0.0;
+    }
+    free(k);
+}
 
-    /* construct an array from the triangle lists */
-    int list_size = 0;
-    for(i = 0; i < ncell; i++) {
-        list_size += list_int_size(tri_list[i]);
+/**
+ * @brief Test a segment against the triangles in a single grid cell
+ *
+ * The triangles are read from the structure-of-arrays copy of the cell list
+ * and tested WALL_3D_NBLOCK at a time with the same arithmetic as in
+ * wall_3d_tri_collision(), so the result is identical. The rare case where
+ * the segment is nearly parallel to a triangle is passed on to
+ * wall_3d_tri_collision().
+ *
+ * @param q1 segment start point xyz coordinates [m]
+ * @param q2 segment end point xyz coordinates [m]
+ * @param idx cell indices in x, y, and z
+ * @param wdata pointer to data struct on target
+ * @param smallest_w nearest intersection so far, updated if a nearer one is
+ *        found
+ * @param hit_tri id of the nearest triangle hit so far, updated likewise
+ */
+static void wall_3d_hit_cell(real q1[3], real q2[3], int idx[3],
+                             wall_3d_data* wdata, real* smallest_w,
+                             int* hit_tri) {
+    int ncell = wdata->ngrid*wdata->ngrid*wdata->ngrid;
+    int icell = idx[0]*wdata->ngrid*wdata->ngrid + idx[1]*wdata->ngrid + idx[2];
+    int ilist = wdata->tree_array[icell];
+    int ntri  = wdata->tree_array[ilist];
+    if(ntri == 0) {
+        return;
     }
 
-    w->int_offload_array_length = 2*ncell + list_size;
-    *tree_array = (int*) malloc((w->int_offload_array_length)*sizeof(int));
+    /* Cell lists are stored back to back both in the tree array, where each
+     * list is preceded by its length, and in the structure of arrays */
+    int nlist = wdata->tree_array_size - 2*ncell;
+    int first = ilist - ncell - icell;
+    const real* t1x  = &wdata->tri_soa[0*nlist + first];
+    const real* t1y  = &wdata->tri_soa[1*nlist + first];
+    const real* t1z  = &wdata->tri_soa[2*nlist + first];
+    const real* e12x = &wdata->tri_soa[3*nlist + first];
+    const real* e12y = &wdata->tri_soa[4*nlist + first];
+    const real* e12z = &wdata->tri_soa[5*nlist + first];
+    const real* e13x = &wdata->tri_soa[6*nlist + first];
+    const real* e13y = &wdata->tri_soa[7*nlist + first];
+    const real* e13z = &wdata->tri_soa[8*nlist + first];
+
+    real Q12[3], q12[3];
+    Q12[0] = q2[0] - q1[0];
+    Q12[1] = q2[1] - q1[1];
+    Q12[2] = q2[2] - q1[2];
+    math_unit(Q12, q12);
+    real lenQ12 = math_norm(Q12);
+
+    for(int l0 = 0; l0 < ntri; l0 += WALL_3D_NBLOCK) {
+        int nl = ntri - l0 < WALL_3D_NBLOCK ? ntri - l0 : WALL_3D_NBLOCK;
+        real w[WALL_3D_NBLOCK];
+
+        #pragma omp simd
+        for(int l = 0; l < nl; l++) {
+            int j = l0 + l;
+            real h[3], edge12[3], edge13[3], tq11[3], n[3];
+            edge12[0] = e12x[j];
+            edge12[1] = e12y[j];
+            edge12[2] = e12z[j];
+            edge13[0] = e13x[j];
+            edge13[1] = e13y[j];
+            edge13[2] = e13z[j];
+            math_cross(q12, edge13, h);
+            real det = math_dot(h, edge12);
+
+            tq11[0] = q1[0] - t1x[j];
+            tq11[1] = q1[1] - t1y[j];
+            tq11[2] = q1[2] - t1z[j];
+            math_cross(tq11, edge12, n);
+
+            real u = math_dot(h, tq11) / det;
+            real v = math_dot(q12, n) / det;
 
-    int next_empty_list = ncell;
-    for(i = 0; i < ncell; i++) {
-        (*tree_array)[i] = next_empty_list;
-        (*tree_array)[next_empty_list] = list_int_size(tri_list[i]);
-        int j;
-        for(j = 0; j < (*tree_array)[next_empty_list]; j++) {
-            (*tree_array)[next_empty_list+j+1] = list_int_get(tri_list[i], j);
+            w[l] = -1.0;
+            if( ( u >= 0.0 && u <= 1.0 ) && ( v >= 0.0 && u + v <= 1.0 )  ) {
+                w[l] = ( math_dot(n, edge13) / det ) / lenQ12;
+                w[l] = w[l] > 1.0 ? -1.0 : w[l];
+            }
+            /* Degenerate triangles have NaN edges and never pass this */
+            w[l] = fabs(det) < WALL_EPSILON ? -2.0 : w[l];
+        }
+
+        for(int l = 0; l < nl; l++) {
+            int itri = wdata->tree_array[ilist+l0+l+1];
+            if(w[l] == -2.0) {
+                w[l] = wall_3d_tri_collision(q1, q2,
+                                             &wdata->wall_tris[9*itri],
+                                             &wdata->wall_tris[9*itri+3],
+                                             &wdata->wall_tris[9*itri+6]);
+            }
+            if(w[l] >= 0 && w[l] < *smallest_w) {
+                *smallest_w = w[l];
+                *hit_tri = itri+1;
+            }
         }
-        next_empty_list += (*tree_array)[next_empty_list] + 1;
     }
-    free(tri_list);
-    octree_free(&tree);
 }
 
 /**
  * @brief Check if trajectory from (r1, phi1, z1) to (r2, phi2, z2) intersects
  *        the wall using the octree structure
  *
+ * The grid cells are visited in the order the segment passes through them
+ * (3D-DDA). Triangles in each cell are tested and the traversal stops at the
+ * first cell whose exit point lies beyond the nearest intersection found so
+ * far, since no triangle in the remaining cells can be hit before it.
+ *
  * @param r1 start point R coordinate [m]
  * @param phi1 start point phi coordinate [rad]
  * @param z1 start point z coordinate [rad]
@@ -323,6 +632,7 @@ void wall_3d_init_octree(wall_3d_offload_data* w, real* offload_array,
  * @param phi2 end point phi coordinate [rad]
  * @param z2 end point z coordinate [rad]
  * @param wdata pointer to data struct on target
+ * @param w_coll pointer for storing the parametric intersection point
  *
  * @return id, which is the first element id if hit, zero otherwise
  */
@@ -340,51 +650,114 @@ int wall_3d_hit_wall(real r1, real phi1, real z1, real r2, real phi2,
     math_rpz2xyz(rpz1, q1);
     math_rpz2xyz(rpz2, q2);
 
-    int ix1 = (int) floor((q1[0] - wdata->xmin)
-                          / ((wdata->xmax - wdata->xmin) / (wdata->ngrid)));
-    int iy1 = (int) floor((q1[1] - wdata->ymin)
-                          / ((wdata->ymax - wdata->ymin) / (wdata->ngrid)));
-    int iz1 = (int) floor((q1[2] - wdata->zmin)
-                          / ((wdata->zmax - wdata->zmin) / (wdata->ngrid)));
-
-    int ix2 = (int) floor((q2[0] - wdata->xmin)
-                          / ((wdata->xmax - wdata->xmin) / (wdata->ngrid)));
-    int iy2 = (int) floor((q2[1] - wdata->ymin)
-                          / ((wdata->ymax - wdata->ymin) / (wdata->ngrid)));
-    int iz2 = (int) floor((q2[2] - wdata->zmin)
-                          / ((wdata->zmax - wdata->zmin) / (wdata->ngrid)));
-
     int hit_tri = 0;
     real smallest_w = 1.1;
+    *w_coll = smallest_w;
 
-    for(int i = 0; i <= abs(ix2-ix1); i++) {
-        for(int j = 0; j <= abs(iy2-iy1); j++) {
-            for(int k = 0; k <= abs(iz2-iz1); k++) {
-                int ix = ix1 + i*((int) copysign(1, ix2-ix1));
-                int iy = iy1 + j*((int) copysign(1, iy2-iy1));
-                int iz = iz1 + k*((int) copysign(1, iz2-iz1));
-
-                if(ix >= 0 && ix < wdata->ngrid && iy >= 0 && iy < wdata->ngrid
-                   && iz >= 0 && iz < wdata->ngrid) {
-
-                    int ilist = wdata->tree_array[ix*wdata->ngrid*wdata->ngrid
-                                                  + iy*wdata->ngrid + iz];
-
-                    for(int l = 0; l < wdata->tree_array[ilist]; l++) {
-                        int itri = wdata->tree_array[ilist+l+1];
-                        real w = wall_3d_tri_collision(q1, q2,
-                                                       &wdata->wall_tris[9*itri],
-                                                       &wdata->wall_tris[9*itri+3],
-                                                       &wdata->wall_tris[9*itri+6]);
-                        if(w >= 0 && w < smallest_w) {
-                            smallest_w = w;
-                            hit_tri = itri+1;
-                        }
-                    }
+    real bmin[3]  = {wdata->xmin,  wdata->ymin,  wdata->zmin};
+    real bmax[3]  = {wdata->xmax,  wdata->ymax,  wdata->zmax};
+    real width[3] = {wdata->xgrid, wdata->ygrid, wdata->zgrid};
+
+    /* Most steps begin and end in the same cell */
+    int idx[3], samecell = 1, inside = 1;
+    for(int k = 0; k < 3; k++) {
+        idx[k] = (int) floor( (q1[k] - bmin[k]) / width[k] );
+        int idx2 = (int) floor( (q2[k] - bmin[k]) / width[k] );
+        inside = inside && idx[k] >= 0 && idx[k] < wdata->ngrid
+            && idx2 >= 0 && idx2 < wdata->ngrid;
+        samecell = samecell && idx[k] == idx2;
+    }
+
+    /* No triangle can be hit if the step is shorter than the distance from
+     * its start point to the wall */
+    if(inside) {
+        real dist = wdata->dist[idx[0]*wdata->ngrid*wdata->ngrid
+                                + idx[1]*wdata->ngrid + idx[2]];
+        real d2 = (q2[0] - q1[0]) * (q2[0] - q1[0])
+                + (q2[1] - q1[1]) * (q2[1] - q1[1])
+                + (q2[2] - q1[2]) * (q2[2] - q1[2]);
+        if(d2 < dist * dist) {
+            return 0;
+        }
+    }
+
+    if(inside && samecell) {
+        wall_3d_hit_cell(q1, q2, idx, wdata, &smallest_w, &hit_tri);
+        *w_coll = smallest_w;
+        return hit_tri;
+    }
+
+    /* The segment is parametrized as q1 + s*(q2-q1) with s in [0, 1]. If it
+     * is not entirely inside the grid, clip it. */
+    real d[3], invd[3], s_in = 0.0, s_out = 1.0;
+    for(int k = 0; k < 3; k++) {
+        d[k]    = q2[k] - q1[k];
+        invd[k] = d[k] != 0 ? 1.0 / d[k] : DBL_MAX;
+    }
+    if(!inside) {
+        for(int k = 0; k < 3; k++) {
+            if(d[k] == 0) {
+                if(q1[k] < bmin[k] || q1[k] > bmax[k]) {
+                    return 0;
                 }
+                continue;
             }
+            real s1 = (bmin[k] - q1[k]) * invd[k];
+            real s2 = (bmax[k] - q1[k]) * invd[k];
+            s_in  = fmax(s_in,  fmin(s1, s2));
+            s_out = fmin(s_out, fmax(s1, s2));
+        }
+        if(s_in > s_out) {
+            return 0;
+        }
+        for(int k = 0; k < 3; k++) {
+            real x = q1[k] + s_in * d[k];
+            idx[k] = (int) floor( (x - bmin[k]) / width[k] );
+            idx[k] = idx[k] < 0 ? 0 : idx[k];
+            idx[k] = idx[k] > wdata->ngrid - 1 ? wdata->ngrid - 1 : idx[k];
         }
     }
+
+    /* Values of s where the segment crosses the next cell boundary on each
+     * axis and the increment of s between boundaries */
+    int step[3];
+    real snext[3], sdelta[3];
+    for(int k = 0; k < 3; k++) {
+        if(d[k] > 0) {
+            step[k]   = 1;
+            sdelta[k] = width[k] * invd[k];
+            snext[k]  = (bmin[k] + (idx[k] + 1) * width[k] - q1[k]) * invd[k];
+        }
+        else if(d[k] < 0) {
+            step[k]   = -1;
+            sdelta[k] = -width[k] * invd[k];
+            snext[k]  = (bmin[k] + idx[k] * width[k] - q1[k]) * invd[k];
+        }
+        else {
+            step[k]   = 0;
+            sdelta[k] = DBL_MAX;
+            snext[k]  = DBL_MAX;
+        }
+    }
+
+    while(1) {
+        wall_3d_hit_cell(q1, q2, idx, wdata, &smallest_w, &hit_tri);
+
+        /* Move to the neighbouring cell through the nearest boundary */
+        int k = 0;
+        if(snext[1] < snext[k]) {k = 1;}
+        if(snext[2] < snext[k]) {k = 2;}
+        real sexit = snext[k];
+        if(smallest_w <= sexit || sexit > s_out) {
+            break;
+        }
+        idx[k]   += step[k];
+        snext[k] += sdelta[k];
+        if(idx[k] < 0 || idx[k] >= wdata->ngrid) {
+            break;
+        }
+    }
+
     *w_coll = smallest_w;
     return hit_tri;
 }
@@ -513,6 +886,22 @@ int wall_3d_tri_in_cube(real t1[3], real t2[3], real t3[3], real bb1[3],
     return 0;
 }
 
+/**
+ * @brief Unit normal of a wall triangle
+ *
+ * @param nvec pointer to array where the cartesian normal is stored
+ * @param tile wall element ID as returned by wall_3d_hit_wall()
+ * @param w pointer to data struct on target
+ */
+void wall_3d_normal_vector(real nvec[3], int tile, wall_3d_data* w) {
+    real* t = &w->wall_tris[9*(tile-1)];
+    real edge12[3] = {t[3] - t[0], t[4] - t[1], t[5] - t[2]};
+    real edge13[3] = {t[6] - t[0], t[7] - t[1], t[8] - t[2]};
+    real normal[3];
+    math_cross(edge12, edge13, normal);
+    math_unit(normal, nvec);
+}
+
 /**
  * @brief Check if a line segment intersects a triangle
  *
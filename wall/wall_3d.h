@@ -12,6 +12,9 @@
 /** Small value to check if x = 0 (i.e. abs(x) < WALL_EPSILON) */
 #define WALL_EPSILON 1e-9
 
+/** Number of triangles tested together in the vectorized collision check */
+#define WALL_3D_NBLOCK 16
+
 /**
  * @brief 3D wall offload data
  */
@@ -54,6 +57,10 @@ typedef struct {
     real* wall_tris;     /**< Array of wall triangle coordinates */
     int tree_array_size; /**<  */
     int* tree_array;     /**< Pointer to octree array */
+    real* tri_soa;       /**< Triangle vertex and edges in cell list order,
+                              stored as a structure of arrays                 */
+    real* dist;          /**< Lower bound for the distance from each grid cell
+                              to the wall [m]                                 */
 } wall_3d_data;
 
 int wall_3d_init_offload(wall_3d_offload_data* offload_data,
@@ -61,8 +68,14 @@ int wall_3d_init_offload(wall_3d_offload_data* offload_data,
 void wall_3d_free_offload(wall_3d_offload_data* offload_data,
                           real** offload_array, int** int_offload_array);
 
-void wall_3d_init_octree(wall_3d_offload_data* w, real* offload_array,
-                         int** int_offload_array);
+void wall_3d_init_grid(wall_3d_offload_data* offload_data,
+                       real* offload_array);
+int wall_3d_init_octree(wall_3d_offload_data* w, real* offload_array,
+                        int** int_offload_array);
+void wall_3d_init_soa(wall_3d_offload_data* w, real** offload_array,
+                      int* tree_array);
+void wall_3d_init_dist(wall_3d_offload_data* w, real** offload_array,
+                       int* tree_array);
 
 #pragma omp declare target
 void wall_3d_init(wall_3d_data* w, wall_3d_offload_data* offload_data,
@@ -76,8 +89,9 @@ int wall_3d_hit_wall_full(real r1, real phi1, real z1, real r2, real phi2,
 #pragma omp declare simd
 double wall_3d_tri_collision(real q1[3], real q2[3], real t1[3], real t2[3],
                              real t3[3]);
+void wall_3d_normal_vector(real nvec[3], int tile, wall_3d_data* w);
 
-void wall_3d_init_tree(wall_3d_data* w, real* offload_array);
+int wall_3d_init_tree(wall_3d_data* w, real* offload_array);
 int wall_3d_tri_in_cube(real t1[3], real t2[3], real t3[3], real bb1[3],
                         real bb2[3]);
 int wall_3d_quad_collision(real q1[3], real q2[3], real t1[3], real t2[3],